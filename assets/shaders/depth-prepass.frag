@@ -0,0 +1,5 @@
+#version 330 core
+
+// Nothing to shade, the depth pre-pass only writes depth
+void main() {
+}
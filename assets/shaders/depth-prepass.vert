@@ -0,0 +1,26 @@
+#version 330 core
+
+// Depth-only vertex shader used by the depth pre-pass.
+// The position computation must match "light/pbr.vert" exactly since the color pass tests depth with GL_EQUAL.
+// The "SKINNED" permutation is drawn with the full vertex stream of the mesh since it needs the bone attributes.
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+#ifdef SKINNED
+#include "include/skinning.glsl"
+#endif
+
+invariant gl_Position;
+
+void main() {
+#ifdef SKINNED
+	mat4 skinnedModel = model * getSkinMatrix();
+#else
+	mat4 skinnedModel = model;
+#endif
+	vec3 worldCoordinates = vec3(skinnedModel * vec4(aPos, 1.0f));
+	gl_Position = projection * view * vec4(worldCoordinates, 1.0f);
+}
@@ -0,0 +1,2 @@
+// Included once per stage (see ShaderPreprocessor), so it needs no include guard
+#define PI 3.1415926535897932384626433832795
@@ -0,0 +1,28 @@
+// Included once per stage (see ShaderPreprocessor), so it needs no include guard
+// Linear blend skinning from the matrices of all the skinned instances of the frame (see SkinningBuffer):
+// every matrix is 4 RGBA32F texels (its columns) and the matrices of the drawn instance start at "boneOffset".
+// The depth pre-pass and the color pass both skin through this file so that their positions are bit-identical.
+layout (location = 4) in ivec4 aBoneIds;
+layout (location = 5) in vec4 aWeights;
+
+uniform samplerBuffer boneMatrices;
+uniform int boneOffset;
+
+mat4 getBoneMatrix(int bone) {
+	int texel = (boneOffset + bone) * 4;
+	return mat4(texelFetch(boneMatrices, texel), texelFetch(boneMatrices, texel + 1),
+	            texelFetch(boneMatrices, texel + 2), texelFetch(boneMatrices, texel + 3));
+}
+
+// The weighted sum of the matrices of the bones influencing the vertex (the unused slots have a weight of 0 and
+// an id of -1, the vertices without any influence stay where they are)
+mat4 getSkinMatrix() {
+	if (aWeights.x + aWeights.y + aWeights.z + aWeights.w <= 0.0)
+		return mat4(1.0);
+	mat4 skin = mat4(0.0);
+	for (int i = 0; i < 4; i++) {
+		if (aWeights[i] > 0.0)
+			skin += getBoneMatrix(max(aBoneIds[i], 0)) * aWeights[i];
+	}
+	return skin;
+}
@@ -1,7 +1,13 @@
 #version 330 core
 precision highp float;
-#define PI 3.1415926535897932384626433832795
-#define MAX_LIGHTS 16
+// Must match the cluster grid of ClusteredLighting ("clustered-lighting.hpp")
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define TEXELS_PER_LIGHT 4
+#define LIGHT_TYPE_DIRECTIONAL 0
+#define LIGHT_TYPE_POINT 1
+#define LIGHT_TYPE_SPOT 2
 #define GREYSCALE_WEIGHT_VECTOR vec3(0.2126, 0.7152, 0.0722)
 
 layout (location = 0) out vec4 FragColor;
@@ -11,46 +17,55 @@ in vec3 worldCoordinates;
 in vec2 textureCoordinates;
 in vec3 normal;
 
+// The textures are compiled in by the permutation defines (see LitMaterial::getDefines)
 struct Material {
-    bool useTextureAlbedo;
-    bool useTextureMetallic;
-    bool useTextureRoughness;
-    bool useTextureMetallicRoughness;
-    bool useTextureNormal;
-    bool useTextureAmbientOcclusion;
-    bool useTextureEmissive;
-
     vec3 albedo;
     float metallic;
     float roughness;
     float ambientOcclusion;
     vec3 emission;
 
+#ifdef USE_TEXTURE_ALBEDO
     sampler2D textureAlbedo;
+#endif
+#ifdef USE_TEXTURE_METALLIC
     sampler2D textureMetallic;
+#endif
+#ifdef USE_TEXTURE_ROUGHNESS
     sampler2D textureRoughness;
+#endif
+#ifdef USE_TEXTURE_METALLIC_ROUGHNESS
     sampler2D textureMetallicRoughness;
+#endif
+#ifdef USE_TEXTURE_NORMAL
     sampler2D textureNormal;
+#endif
+#ifdef USE_TEXTURE_AMBIENT_OCCLUSION
     sampler2D textureAmbientOcclusion;
+#endif
+#ifdef USE_TEXTURE_EMISSIVE
     sampler2D textureEmissive;
-};
-
-struct Light {
-    vec3 position;
-    vec3 color;
-    vec3 direction;
-    int type; // 0 = directional, 1 = point, 2 = spot
-    float inner_angle;
-    float outer_angle;
-    float attenuation_constant;
-    float attenuation_linear;
-    float attenuation_quadratic;
+#endif
 };
 
 uniform Material material;
 uniform vec3 cameraPosition;
-uniform Light lights[MAX_LIGHTS];
-uniform int lightCount;
+uniform mat4 view;
+
+// Clustered lights
+// Each light is 4 texels: (position, range), (color, type + 4 * mask bit), (direction, cos(outer)),
+// (cos(inner), constant, linear, quadratic attenuation)
+// The directional lights are stored first and affect every fragment.
+// Every cluster stores the (offset, count) of its lights in the light index list.
+// Only the lights whose bit is set in "lightMask" light the material.
+uniform samplerBuffer clusterLightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform int directionalLightCount;
+uniform uint lightMask;
+uniform vec2 clusterTileSize;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
 
 // Debug mode
 uniform int debugMode;
@@ -63,64 +78,9 @@ uniform sampler2D brdfLUT;
 // Post parameters
 uniform float bloomBrightnessCutoff;
 
-// Fresnel function (Fresnel-Schlick approximation)
-//
-// F_schlick = f0 + (1 - f0)(1 - (h * v))^5
-//
-vec3 fresnelSchlick(float cosTheta, vec3 F0) {
-    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
-}
-//----------------------------------------------------------------------------
-vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
-{
-    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
-}   
-
-// Normal distribution function (Trowbridge-Reitz GGX)
-//
-//                alpha ^ 2
-//     ---------------------------------
-//      PI((n * h)^2(alpha^2 - 1) + 1)^2
-//
-float distributionGGX(vec3 N, vec3 H, float roughness) {
-    float a = roughness*roughness;
-    float a2 = a*a;
-    float NdotH = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH*NdotH;
-
-    float nom   = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-
-    return nom / denom;
-}
-
-// Geometry function
-//
-//         n * v
-//   -------------------
-//   (n * v)(1 - k) + k
-//
-float geometrySchlickGGX(float NdotV, float roughness) {
-    float r = (roughness + 1.0);
-    float k = (r*r) / 8.0;
-
-    float nom   = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
-
-    return nom / denom;
-}
-
-// smiths method for taking into account view direction and light direction
-float geometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2 = geometrySchlickGGX(NdotV, roughness);
-    float ggx1 = geometrySchlickGGX(NdotL, roughness);
-
-    return ggx1 * ggx2;
-}
+#include "../include/brdf.glsl"
 
+#ifdef USE_TEXTURE_NORMAL
 // ----------------------------------------------------------------------------
 // Easy trick to get tangent-normals to world-space to keep PBR code simplified.
 // Don't worry if you don't get what's going on; you generally want to do normal 
@@ -128,7 +88,11 @@ float geometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
 // technique somewhere later in the normal mapping tutorial.
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(material.textureNormal, textureCoordinates).xyz * 2.0 - 1.0;
+    // Only x and y are read, z is reconstructed (the normal is unit length and points out of the surface)
+    // so that two channel normal maps (e.g. cooked as BC5) work too
+    vec3 tangentNormal;
+    tangentNormal.xy = texture(material.textureNormal, textureCoordinates).xy * 2.0 - 1.0;
+    tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
 
     vec3 Q1  = dFdx(worldCoordinates);
     vec3 Q2  = dFdy(worldCoordinates);
@@ -142,52 +106,110 @@ vec3 getNormalFromMap()
 
     return normalize(TBN * tangentNormal);
 }
+#endif
+
+// Returns the cluster that contains the current fragment
+int getClusterIndex() {
+    float viewDepth = -(view * vec4(worldCoordinates, 1.0)).z;
+    int slice = clamp(int(floor(log(viewDepth) * clusterSliceScale + clusterSliceBias)), 0, CLUSTER_Z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    return tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+}
+
+// Returns the radiance reflected towards the viewer from the given light
+vec3 computeLight(int lightIndex, vec3 N, vec3 V, vec3 F0, vec3 albedo, float metallic, float roughness) {
+    int base = lightIndex * TEXELS_PER_LIGHT;
+    vec4 colorType = texelFetch(clusterLightData, base + 1);
+    int typeAndBit = int(colorType.w);
+    if ((lightMask & (1u << uint(typeAndBit >> 2))) == 0u)
+        return vec3(0.0);
+    int type = typeAndBit & 3;
+    vec4 positionRange = texelFetch(clusterLightData, base);
+    vec4 directionCosOuter = texelFetch(clusterLightData, base + 2);
+
+    vec3 L;
+    float attenuation;
+    if (type == LIGHT_TYPE_DIRECTIONAL) {
+        L = -directionCosOuter.xyz;
+        attenuation = 1.0;
+    }
+    else {
+        vec3 toLight = positionRange.xyz - worldCoordinates;
+        float distance = length(toLight);
+        L = toLight / distance;
+        // 1 / (quadratic * d^2 + linear * d + constant), windowed so that it reaches 0 at the light range
+        // (where the light was culled)
+        vec4 cosInnerAttenuation = texelFetch(clusterLightData, base + 3);
+        float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+        float falloff = dot(cosInnerAttenuation.yzw, vec3(1.0, distance, distance * distance));
+        attenuation = window * window / max(falloff, 0.0001);
+        if (type == LIGHT_TYPE_SPOT) {
+            float cosInner = cosInnerAttenuation.x;
+            float theta = dot(-L, directionCosOuter.xyz);
+            attenuation *= clamp((theta - directionCosOuter.w) / max(cosInner - directionCosOuter.w, 0.0001), 0.0, 1.0);
+        }
+    }
+
+    vec3 H = normalize(V + L);
+    vec3 radiance = colorType.rgb * attenuation;
+
+    float NDF = distributionGGX(N, H, roughness);
+    float G = geometrySmith(N, V, L, roughness);
+    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
+    vec3 specular = numerator / denominator;
+
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic;
+
+    vec3 diffuse = kD * albedo / PI;
+    float NdotL = max(dot(N, L), 0.0);
+
+    return (diffuse + specular) * radiance * NdotL;
+}
 
 void main() {
     // retrieve all the material properties
 
     // albedo
     vec3 albedo = material.albedo;
-    if (material.useTextureAlbedo) {
-        albedo = pow(texture(material.textureAlbedo, textureCoordinates).rgb, vec3(2.2));
-    }
+#ifdef USE_TEXTURE_ALBEDO
+    albedo = pow(texture(material.textureAlbedo, textureCoordinates).rgb, vec3(2.2));
+#endif
 
     // metallic/roughness
     float metallic = material.metallic;
     float roughness = material.roughness;
-
-    if (material.useTextureMetallic && material.useTextureRoughness) {
-        if (material.useTextureMetallic) {
-            metallic = texture(material.textureMetallic, textureCoordinates).r;
-        }
-
-        if (material.useTextureRoughness) {
-            roughness = texture(material.textureRoughness, textureCoordinates).r;
-        }
-    }
-    else if (material.useTextureMetallicRoughness) {
-        vec3 metallicRoughness = texture(material.textureMetallicRoughness, textureCoordinates).rgb;
-        metallic = metallicRoughness.b;
-        roughness = metallicRoughness.g;
-    }
+#if defined(USE_TEXTURE_METALLIC) && defined(USE_TEXTURE_ROUGHNESS)
+    metallic = texture(material.textureMetallic, textureCoordinates).r;
+    roughness = texture(material.textureRoughness, textureCoordinates).r;
+#elif defined(USE_TEXTURE_METALLIC_ROUGHNESS)
+    vec3 metallicRoughness = texture(material.textureMetallicRoughness, textureCoordinates).rgb;
+    metallic = metallicRoughness.b;
+    roughness = metallicRoughness.g;
+#endif
 
     // normal
+#ifdef USE_TEXTURE_NORMAL
+    vec3 N = getNormalFromMap();
+#else
     vec3 N = normalize(normal);
-    if (material.useTextureNormal) {
-        N = getNormalFromMap();
-    }
+#endif
 
     // ambient occlusion
     float ao = material.ambientOcclusion;
-    if (material.useTextureAmbientOcclusion) {
-        ao = texture(material.textureAmbientOcclusion, textureCoordinates).r;
-    }
+#ifdef USE_TEXTURE_AMBIENT_OCCLUSION
+    ao = texture(material.textureAmbientOcclusion, textureCoordinates).r;
+#endif
 
     // emissive
     vec3 emission = material.emission;
-    if (material.useTextureEmissive) {
-        emission = texture(material.textureEmissive, textureCoordinates).rgb;
-    }
+#ifdef USE_TEXTURE_EMISSIVE
+    emission = texture(material.textureEmissive, textureCoordinates).rgb;
+#endif
 
     vec3 V = normalize(cameraPosition - worldCoordinates); // view vector pointing at camera
     vec3 R = reflect(-V, N); // reflection vector
@@ -201,40 +223,14 @@ void main() {
     // Direct lighting
 	// Sum up the radiance contributions of each light source.
 	// This loop is essentially the integral of the rendering equation.
-    for (int i = 0; i < lightCount; i++) {
-        vec3 L;
-        float attenuation;
-        if (lights[i].type == 0) {
-            // directional light
-            L = -normalize(lights[i].direction);
-            attenuation = 1.0;
-        }
-        else if (lights[i].type == 1) {
-            // point light
-            L = normalize(lights[i].position - worldCoordinates);
-            float distance = length(lights[i].position - worldCoordinates);
-            attenuation = 1.0 / (distance * distance);
-        }
-
-        vec3 H = normalize(V + L);
-        vec3 radiance = lights[i].color * attenuation;
-
-        float NDF = distributionGGX(N, H, roughness);
-        float G = geometrySmith(N, V, L, roughness);
-        vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
-
-        vec3 numerator = NDF * G * F;
-        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
-        vec3 specular = numerator / denominator;
-
-        vec3 kS = F;
-        vec3 kD = vec3(1.0) - kS;
-        kD *= 1.0 - metallic;
-
-        vec3 diffuse = kD * albedo / PI;
-        float NdotL = max(dot(N, L), 0.0);
-
-        Lo += (diffuse + specular) * radiance * NdotL;
+    // Only the lights of the cluster containing this fragment are evaluated.
+    for (int i = 0; i < directionalLightCount; i++) {
+        Lo += computeLight(i, N, V, F0, albedo, metallic, roughness);
+    }
+    uvec2 cluster = texelFetch(clusterGrid, getClusterIndex()).rg;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int lightIndex = int(texelFetch(clusterLightIndices, int(cluster.x + i)).r);
+        Lo += computeLight(lightIndex, N, V, F0, albedo, metallic, roughness);
     }
 
     // ambient lighting (we now use IBL as the ambient term)
@@ -300,13 +296,26 @@ void main() {
             FragColor = vec4(ambient, 1.0);
             break;
         case 8: // metallic roughness 
+#ifdef USE_TEXTURE_METALLIC_ROUGHNESS
             FragColor = vec4(texture(material.textureMetallicRoughness, textureCoordinates).rgb , 1.0);
+#else
+            FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
             break;
         case 9: // wireframe
             break;
         case 10: // uv texture coordinates
             FragColor = vec4(textureCoordinates, 0.0, 1.0);
             break;
+        case 11: // overdraw (the renderer enables additive blending so every shaded fragment adds up)
+            FragColor = vec4(0.1, 0.04, 0.01, 1.0);
+            BloomColor = vec4(0.0);
+            break;
+        case 12: { // light clusters (the number of local lights evaluated by the fragment, red at 16 or more)
+            float clusterLightCount = float(texelFetch(clusterGrid, getClusterIndex()).g);
+            FragColor = vec4(mix(vec3(0.0, 0.0, 0.2), vec3(1.0, 0.0, 0.0), clamp(clusterLightCount / 16.0, 0.0, 1.0)), 1.0);
+            break;
+        }
         default:
             FragColor = vec4(color , 1.0);
             break;
@@ -12,11 +12,23 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+#ifdef SKINNED
+#include "../include/skinning.glsl"
+#endif
+
+// The depth pre-pass ("depth-prepass.vert") must produce bit-identical depth values
+invariant gl_Position;
+
 void main() {
-	worldCoordinates = vec3(model * vec4(aPos, 1.0f));
+#ifdef SKINNED
+	mat4 skinnedModel = model * getSkinMatrix();
+#else
+	mat4 skinnedModel = model;
+#endif
+	worldCoordinates = vec3(skinnedModel * vec4(aPos, 1.0f));
 	textureCoordinates = aTextureCoordinates;
 
-	mat3 normalMatrix = transpose(inverse(mat3(model)));
+	mat3 normalMatrix = transpose(inverse(mat3(skinnedModel)));
 
 	normal = normalize(normalMatrix * aNormal);
 	
@@ -167,4 +167,21 @@ if [[ "$*" == *"physics-test"* ]]; then
         "config/light-test/forces-0.jsonc"
     )
     run_tests "${configs[@]}"
-fi 
\ No newline at end of file
+fi 
+# The log is checked: the materials of a level must find the lights it creates when it becomes current
+if [ $# -eq 0 ] || [[ "$*" == *"level-test"* ]]; then
+    echo -e "\nRunning level-test:\n"
+    output=$(./bin/GAME_APPLICATION -f=5 -c="config/level-test/test-0.jsonc" 2>&1)
+    echo "$output"
+    if echo "$output" | grep -q "unknown light"; then
+        echo "level-test: FAILED (a material names a light that wasn't created)"
+    else
+        echo "level-test: passed"
+    fi
+fi
+
+# Headless: the CPU skinning is checked numerically, no screenshot is taken
+if [ $# -eq 0 ] || [[ "$*" == *"skinning-test"* ]]; then
+    echo -e "\nRunning skinning-test:\n"
+    ./bin/supercold-skinning-test config/skinning-test
+fi
@@ -0,0 +1,286 @@
+#include "animation-bounds.hpp"
+#include "animation-compression.hpp"
+#include "animation-player.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace our::animation_bounds {
+
+    static AnimationBounds emptyBounds() {
+        return {glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+    }
+
+    static void mergePoint(AnimationBounds& bounds, const glm::vec3& point) {
+        bounds.minimum = glm::min(bounds.minimum, point);
+        bounds.maximum = glm::max(bounds.maximum, point);
+    }
+
+    // The bone with the largest weight in the vertex (-1 if none)
+    static int getDominantBone(const Vertex& vertex, size_t boneCount) {
+        int dominant = -1;
+        float largest = 0.0f;
+        for (int slot = 0; slot < MAX_BONE_INFLUENCE; ++slot) {
+            int bone = vertex.bone_ids[slot];
+            if (vertex.weights[slot] > largest && bone >= 0 && static_cast<size_t>(bone) < boneCount) {
+                largest = vertex.weights[slot];
+                dominant = bone;
+            }
+        }
+        return dominant;
+    }
+
+    static float getDistanceToSegment(const glm::vec3& point, const glm::vec3& start, const glm::vec3& end) {
+        glm::vec3 segment = end - start;
+        float lengthSquared = glm::dot(segment, segment);
+        float t = lengthSquared > 0.0f ? glm::clamp(glm::dot(point - start, segment) / lengthSquared, 0.0f, 1.0f)
+                                       : 0.0f;
+        return glm::length(point - (start + segment * t));
+    }
+
+    // Translation * Rotation * Scale, like pose_blending::toMatrices
+    static glm::mat4 compose(const KeyFrame& frame) {
+        glm::mat4 matrix = glm::mat4_cast(frame.rotation);
+        matrix[0] *= frame.scale.x;
+        matrix[1] *= frame.scale.y;
+        matrix[2] *= frame.scale.z;
+        matrix[3] = glm::vec4(frame.position, 1.0f);
+        return matrix;
+    }
+
+    void merge(AnimationBounds& bounds, const AnimationBounds& other) {
+        bounds.minimum = glm::min(bounds.minimum, other.minimum);
+        bounds.maximum = glm::max(bounds.maximum, other.maximum);
+    }
+
+    AnimationBounds transform(const AnimationBounds& bounds, const glm::mat4& transform) {
+        // The extents of the moved box are the absolute values of the matrix applied to the extents
+        glm::vec3 center = (bounds.minimum + bounds.maximum) * 0.5f;
+        glm::vec3 extents = (bounds.maximum - bounds.minimum) * 0.5f;
+        glm::mat3 linear(transform);
+        glm::mat3 absolute(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+        glm::vec3 movedCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+        glm::vec3 movedExtents = absolute * extents;
+        return {movedCenter - movedExtents, movedCenter + movedExtents};
+    }
+
+    std::vector<BoneCapsule> computeBoneCapsules(const std::vector<Bone>& bones,
+                                                 const std::vector<SkinnedMesh>& meshes) {
+        size_t boneCount = bones.size();
+        std::vector<BoneCapsule> capsules(boneCount, BoneCapsule{glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), -1});
+
+        // The submesh holding most of the vertices of each bone
+        std::vector<uint32_t> counts(meshes.size() * boneCount, 0);
+        for (size_t mesh = 0; mesh < meshes.size(); ++mesh)
+            for (size_t i = 0; i < meshes[mesh].vertexCount; ++i) {
+                int bone = getDominantBone(meshes[mesh].vertices[i], boneCount);
+                if (bone >= 0)
+                    counts[mesh * boneCount + bone]++;
+            }
+
+        std::vector<glm::vec3> points;
+        for (size_t bone = 0; bone < boneCount; ++bone) {
+            size_t best = 0;
+            for (size_t mesh = 1; mesh < meshes.size(); ++mesh)
+                if (counts[mesh * boneCount + bone] > counts[best * boneCount + bone])
+                    best = mesh;
+            if (meshes.empty() || counts[best * boneCount + bone] == 0)
+                continue;
+
+            // The vertices in the space of the bone
+            points.clear();
+            AnimationBounds box = emptyBounds();
+            const glm::mat4& offset = bones[bone].offsetMatrix;
+            for (size_t i = 0; i < meshes[best].vertexCount; ++i) {
+                const Vertex& vertex = meshes[best].vertices[i];
+                if (getDominantBone(vertex, boneCount) != static_cast<int>(bone))
+                    continue;
+                points.push_back(glm::vec3(offset * glm::vec4(vertex.position, 1.0f)));
+                mergePoint(box, points.back());
+            }
+
+            // The axis of the capsule is the longest axis of the box, through its center
+            glm::vec3 size = box.maximum - box.minimum;
+            int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+            BoneCapsule& capsule = capsules[bone];
+            capsule.start = capsule.end = (box.minimum + box.maximum) * 0.5f;
+            capsule.start[axis] = box.minimum[axis];
+            capsule.end[axis] = box.maximum[axis];
+            capsule.radius = 0.0f;
+            for (const glm::vec3& point : points)
+                capsule.radius = std::max(capsule.radius, getDistanceToSegment(point, capsule.start, capsule.end));
+            capsule.submesh = static_cast<int32_t>(best);
+        }
+        return capsules;
+    }
+
+    bool computeClipBounds(Animation& animation, const std::vector<Bone>& bones,
+                           const std::vector<SkinnedMesh>& meshes) {
+        animation.segmentBounds.clear();
+        animation.boneBounds.clear();
+        if (!animation.isCompressed())
+            return false;
+        size_t boneCount = bones.size();
+
+        // The box of the vertices each bone drives in each submesh, in the space of the bone
+        std::vector<AnimationBounds> boneBoxes(meshes.size() * boneCount, emptyBounds());
+        bool skinned = false;
+        for (size_t mesh = 0; mesh < meshes.size(); ++mesh)
+            for (size_t i = 0; i < meshes[mesh].vertexCount; ++i) {
+                const Vertex& vertex = meshes[mesh].vertices[i];
+                for (int slot = 0; slot < MAX_BONE_INFLUENCE; ++slot) {
+                    int bone = vertex.bone_ids[slot];
+                    if (vertex.weights[slot] <= 0.0f || bone < 0 || static_cast<size_t>(bone) >= boneCount)
+                        continue;
+                    mergePoint(boneBoxes[mesh * boneCount + bone],
+                               glm::vec3(bones[bone].offsetMatrix * glm::vec4(vertex.position, 1.0f)));
+                    skinned = true;
+                }
+            }
+        if (!skinned)
+            return false;
+
+        // The track of each bone
+        std::unordered_map<std::string, int> trackIndices;
+        for (size_t track = 0; track < animation.boneAnimations.size(); ++track)
+            trackIndices.emplace(animation.boneAnimations[track].boneName, static_cast<int>(track));
+        std::vector<int> tracks(boneCount, -1);
+        for (size_t bone = 0; bone < boneCount; ++bone) {
+            auto it = trackIndices.find(bones[bone].name);
+            if (it != trackIndices.end())
+                tracks[bone] = it->second;
+        }
+
+        std::vector<TrackCursor> cursors(animation.boneAnimations.size());
+        std::vector<glm::mat4> boneTransforms(boneCount);
+        std::vector<AnimationBounds> previous(boneBoxes.size());
+        std::vector<float> bonePadding(boneCount, 0.0f);
+        animation.segmentBounds.assign(SEGMENT_COUNT, emptyBounds());
+        animation.boneBounds.assign(boneCount, emptyBounds());
+
+        for (size_t segment = 0; segment < SEGMENT_COUNT; ++segment) {
+            float segmentPadding = 0.0f;
+            for (size_t sample = 0; sample <= SAMPLES_PER_SEGMENT; ++sample) {
+                float ticks = animation.duration * float(segment * SAMPLES_PER_SEGMENT + sample) /
+                              float(SEGMENT_COUNT * SAMPLES_PER_SEGMENT);
+                // The bone transforms like Skeleton::evaluatePose (the parents come first)
+                for (size_t bone = 0; bone < boneCount; ++bone) {
+                    glm::mat4 local = tracks[bone] < 0 ? bones[bone].localBindTransform
+                                                       : compose(animation_compression::decodeTrack(
+                                                             animation, tracks[bone], ticks, cursors[tracks[bone]]));
+                    int parent = bones[bone].parentIndex;
+                    boneTransforms[bone] = parent < 0 ? local : boneTransforms[parent] * local;
+                }
+
+                for (size_t mesh = 0; mesh < meshes.size(); ++mesh)
+                    for (size_t bone = 0; bone < boneCount; ++bone) {
+                        size_t index = mesh * boneCount + bone;
+                        if (isEmpty(boneBoxes[index]))
+                            continue;
+                        AnimationBounds box =
+                            transform(boneBoxes[index], meshes[mesh].localToParent * boneTransforms[bone]);
+                        if (sample > 0) {
+                            float move = std::max(glm::length(box.minimum - previous[index].minimum),
+                                                  glm::length(box.maximum - previous[index].maximum));
+                            segmentPadding = std::max(segmentPadding, move * 0.5f);
+                            bonePadding[bone] = std::max(bonePadding[bone], move * 0.5f);
+                        }
+                        previous[index] = box;
+                        merge(animation.segmentBounds[segment], box);
+                        merge(animation.boneBounds[bone], box);
+                    }
+            }
+            animation.segmentBounds[segment].minimum -= glm::vec3(segmentPadding);
+            animation.segmentBounds[segment].maximum += glm::vec3(segmentPadding);
+        }
+        for (size_t bone = 0; bone < boneCount; ++bone) {
+            if (isEmpty(animation.boneBounds[bone]))
+                continue;
+            animation.boneBounds[bone].minimum -= glm::vec3(bonePadding[bone]);
+            animation.boneBounds[bone].maximum += glm::vec3(bonePadding[bone]);
+        }
+        return true;
+    }
+
+    size_t getSegment(const Animation& animation, float timeInAnimationTicks) {
+        if (animation.duration <= 0.0f)
+            return 0;
+        float segment = std::floor(timeInAnimationTicks / animation.duration * float(SEGMENT_COUNT));
+        return static_cast<size_t>(glm::clamp(segment, 0.0f, float(SEGMENT_COUNT - 1)));
+    }
+
+    bool intersectBox(const glm::vec3& start, const glm::vec3& end, const AnimationBounds& bounds, float& fraction) {
+        glm::vec3 direction = end - start;
+        float enter = 0.0f, exit = 1.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (std::abs(direction[axis]) < 1e-8f) {
+                if (start[axis] < bounds.minimum[axis] || start[axis] > bounds.maximum[axis])
+                    return false;
+                continue;
+            }
+            float near = (bounds.minimum[axis] - start[axis]) / direction[axis];
+            float far = (bounds.maximum[axis] - start[axis]) / direction[axis];
+            if (near > far)
+                std::swap(near, far);
+            enter = std::max(enter, near);
+            exit = std::min(exit, far);
+            if (enter > exit)
+                return false;
+        }
+        fraction = enter;
+        return true;
+    }
+
+    bool intersectCapsule(const glm::vec3& start, const glm::vec3& end, const glm::vec3& capsuleStart,
+                          const glm::vec3& capsuleEnd, float radius, float& fraction) {
+        if (getDistanceToSegment(start, capsuleStart, capsuleEnd) <= radius) {
+            fraction = 0.0f;
+            return true;
+        }
+        float length = glm::length(end - start);
+        if (length <= 0.0f)
+            return false;
+        glm::vec3 direction = (end - start) / length;
+
+        // The infinite cylinder around the axis first, then the sphere of the nearest end if the hit is past it
+        glm::vec3 axis = capsuleEnd - capsuleStart;
+        glm::vec3 offset = start - capsuleStart;
+        float axisAxis = glm::dot(axis, axis);
+        float axisDirection = glm::dot(axis, direction);
+        float axisOffset = glm::dot(axis, offset);
+        float distance = -1.0f;
+        float a = axisAxis - axisDirection * axisDirection;
+        if (a > 1e-8f) {
+            float b = axisAxis * glm::dot(direction, offset) - axisOffset * axisDirection;
+            float c = axisAxis * glm::dot(offset, offset) - axisOffset * axisOffset - radius * radius * axisAxis;
+            float h = b * b - a * c;
+            if (h < 0.0f)
+                return false;
+            float t = (-b - std::sqrt(h)) / a;
+            float y = axisOffset + t * axisDirection;
+            if (y > 0.0f && y < axisAxis)
+                distance = t;
+        }
+        if (distance < 0.0f) {
+            // The caps (also the whole capsule when it is a sphere or the segment runs along its axis)
+            for (const glm::vec3* center : {&capsuleStart, &capsuleEnd}) {
+                glm::vec3 toStart = start - *center;
+                float b = glm::dot(direction, toStart);
+                float h = b * b - (glm::dot(toStart, toStart) - radius * radius);
+                if (h < 0.0f)
+                    continue;
+                float t = -b - std::sqrt(h);
+                if (t >= 0.0f && (distance < 0.0f || t < distance))
+                    distance = t;
+            }
+        }
+        if (distance < 0.0f || distance > length)
+            return false;
+        fraction = distance / length;
+        return true;
+    }
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+#include <mesh/vertex.hpp>
+#include "animation.hpp"
+#include "bone.hpp"
+
+// Bounding volumes of animated meshes that don't need the skinned vertices:
+// - When a clip is cooked, it is sampled SAMPLES_PER_SEGMENT times over each of its SEGMENT_COUNT equal parts.
+//   The box of the vertices each bone drives (in the space of the bone) is moved by the bone transform of every
+//   sample, which gives the bounds of each bone over the whole clip and of the whole mesh over each segment
+//   (Animation::boneBounds and Animation::segmentBounds). A skinned vertex is a weighted average of its bone
+//   transforms, so it stays inside the box of the boxes of its bones. The motion between two samples strays from
+//   their chord by less than half of it, so the boxes are padded by half the largest move between two samples.
+// - A capsule is fitted around the vertices each bone drives the most (BoneCapsule, in the space of the bone), so
+//   the hit tests follow the limbs of any pose by moving one capsule per bone.
+// At runtime, the box of an instance is the union of the segment boxes of the clips it plays (see
+// AnimationComponent::getAnimatedBounds) which is a few lookups instead of skinning the mesh.
+// The cooking functions don't depend on OpenGL so they can run in the cooker.
+namespace our::animation_bounds {
+
+    constexpr size_t SEGMENT_COUNT = 16;
+    constexpr size_t SAMPLES_PER_SEGMENT = 4;
+
+    // The vertices of a submesh and its transform in the model
+    struct SkinnedMesh {
+        const Vertex* vertices;
+        size_t vertexCount;
+        glm::mat4 localToParent;
+    };
+
+    // Fits a capsule around the vertices each bone drives the most ("bones" are in skeleton order)
+    std::vector<BoneCapsule> computeBoneCapsules(const std::vector<Bone>& bones,
+                                                 const std::vector<SkinnedMesh>& meshes);
+
+    // Samples the clip (which must be compressed) and fills its segment and bone bounds.
+    // Returns false (leaving them empty) if no vertex of the meshes is skinned.
+    bool computeClipBounds(Animation& animation, const std::vector<Bone>& bones,
+                           const std::vector<SkinnedMesh>& meshes);
+
+    // The segment of the clip that contains the time
+    size_t getSegment(const Animation& animation, float timeInAnimationTicks);
+
+    inline bool isEmpty(const AnimationBounds& bounds) { return bounds.minimum.x > bounds.maximum.x; }
+    // Grows "bounds" to contain "other"
+    void merge(AnimationBounds& bounds, const AnimationBounds& other);
+    // The bounds of the box moved by the transform
+    AnimationBounds transform(const AnimationBounds& bounds, const glm::mat4& transform);
+
+    // The intersections of the segment [start, end] with a box and a capsule. On a hit, "fraction" is where the
+    // segment enters the volume (0 at "start", 1 at "end").
+    bool intersectBox(const glm::vec3& start, const glm::vec3& end, const AnimationBounds& bounds, float& fraction);
+    bool intersectCapsule(const glm::vec3& start, const glm::vec3& end, const glm::vec3& capsuleStart,
+                          const glm::vec3& capsuleEnd, float radius, float& fraction);
+
+}
@@ -0,0 +1,28 @@
+#include "animation-clip-id.hpp"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace our {
+
+// A deque never moves its elements, so the returned names stay valid
+static std::mutex clipNamesMutex;
+static std::unordered_map<std::string, AnimationClipId> clipIds;
+static std::deque<std::string> clipNames;
+
+AnimationClipId internAnimationClip(const std::string& name) {
+    std::lock_guard<std::mutex> lock(clipNamesMutex);
+    auto [it, inserted] = clipIds.try_emplace(name, AnimationClipId(clipNames.size()));
+    if (inserted)
+        clipNames.push_back(name);
+    return it->second;
+}
+
+const std::string& getAnimationClipName(AnimationClipId id) {
+    static const std::string empty;
+    std::lock_guard<std::mutex> lock(clipNamesMutex);
+    return id < clipNames.size() ? clipNames[id] : empty;
+}
+
+} // namespace our
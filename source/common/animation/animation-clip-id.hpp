@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace our {
+
+// The clips are identified by their interned name: the name is hashed once (when a clip is loaded or when a
+// component asks for it) and everything after that compares integers.
+// The same name always gives the same id, in every model, for the whole run.
+using AnimationClipId = uint32_t;
+constexpr AnimationClipId INVALID_ANIMATION_CLIP = UINT32_MAX;
+
+// Returns the id of the name (a new one the first time the name is seen), it can be called from any thread
+AnimationClipId internAnimationClip(const std::string& name);
+// Returns the name of an interned id (an empty string for an unknown id)
+const std::string& getAnimationClipName(AnimationClipId id);
+
+} // namespace our
@@ -0,0 +1,351 @@
+#include "animation-compression.hpp"
+#include "animation-player.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace our::animation_compression {
+
+    static const float MAX_KEY_TIME = 65535.0f;
+    static const float MAX_VALUE = 65535.0f;
+    // The three smallest components of a unit quaternion are within [-1/sqrt(2), 1/sqrt(2)]
+    static const float SMALLEST_THREE_RANGE = 0.70710678f;
+    static const float MAX_SMALLEST_THREE = 32767.0f;
+    // The number of keys a cursor is walked forward before falling back to a binary search
+    static const uint32_t MAX_CURSOR_STEPS = 4;
+
+    // ------------------------------------------------------------------------------------------------------------
+    // Encoding
+    // ------------------------------------------------------------------------------------------------------------
+
+    // The time of a key in the quantized units (0 to 65535 over the duration of the clip)
+    static float toKeyTime(float timeInAnimationTicks, float duration) {
+        if (duration <= 0.00001f)
+            return 0.0f;
+        return glm::clamp(timeInAnimationTicks / duration, 0.0f, 1.0f) * MAX_KEY_TIME;
+    }
+
+    static uint16_t quantize(float value, float min, float extent) {
+        if (extent <= 0.0f)
+            return 0;
+        return static_cast<uint16_t>(std::lround(glm::clamp((value - min) / extent, 0.0f, 1.0f) * MAX_VALUE));
+    }
+
+    static void encodeRotation(glm::quat rotation, uint16_t* out) {
+        rotation = glm::normalize(rotation);
+        float components[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+        uint32_t largest = 0;
+        for (uint32_t i = 1; i < 4; ++i)
+            if (std::abs(components[i]) > std::abs(components[largest]))
+                largest = i;
+        // q and -q are the same rotation, the sign is chosen so the dropped component is positive
+        float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+        for (uint32_t i = 0, j = 0; i < 4; ++i) {
+            if (i == largest)
+                continue;
+            float normalized = glm::clamp(sign * components[i] / SMALLEST_THREE_RANGE, -1.0f, 1.0f) * 0.5f + 0.5f;
+            out[j++] = static_cast<uint16_t>(std::lround(normalized * MAX_SMALLEST_THREE));
+        }
+        out[0] |= static_cast<uint16_t>((largest & 1) << 15);
+        out[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+    }
+
+    static glm::vec3 interpolate(const VectorKey& k0, const VectorKey& k1, float time) {
+        float factor = k1.timeStamp - k0.timeStamp > 0.00001f ? (time - k0.timeStamp) / (k1.timeStamp - k0.timeStamp)
+                                                             : 0.0f;
+        return glm::mix(k0.value, k1.value, factor);
+    }
+    static glm::quat interpolate(const RotationKey& k0, const RotationKey& k1, float time) {
+        float factor = k1.timeStamp - k0.timeStamp > 0.00001f ? (time - k0.timeStamp) / (k1.timeStamp - k0.timeStamp)
+                                                             : 0.0f;
+        return glm::slerp(k0.value, k1.value, factor);
+    }
+
+    static float distance(const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b); }
+    // The angle of the rotation between the two
+    static float distance(const glm::quat& a, const glm::quat& b) {
+        float dot = std::min(std::abs(glm::dot(glm::normalize(a), glm::normalize(b))), 1.0f);
+        return 2.0f * std::acos(dot);
+    }
+
+    // Returns the indices of the keys to keep. The first and the last keys are always kept (a single key is kept
+    // if the channel is constant within the tolerance).
+    template <typename Key> static std::vector<uint32_t> reduceKeys(const std::vector<Key>& keys, float tolerance) {
+        uint32_t count = static_cast<uint32_t>(keys.size());
+        std::vector<uint32_t> kept;
+        if (count == 0)
+            return kept;
+
+        bool constant = true;
+        for (uint32_t i = 1; i < count && constant; ++i)
+            constant = distance(keys[i].value, keys[0].value) <= tolerance;
+        kept.push_back(0);
+        if (constant)
+            return kept;
+
+        // Can the keys between "from" and "to" be removed?
+        auto canSkip = [&](uint32_t from, uint32_t to) {
+            for (uint32_t i = from + 1; i < to; ++i)
+                if (distance(interpolate(keys[from], keys[to], keys[i].timeStamp), keys[i].value) > tolerance)
+                    return false;
+            return true;
+        };
+        uint32_t from = 0;
+        while (from + 1 < count) {
+            uint32_t to = from + 1;
+            while (to + 1 < count && canSkip(from, to + 1))
+                ++to;
+            kept.push_back(to);
+            from = to;
+        }
+        return kept;
+    }
+
+    // Appends zeros until the size is a multiple of 4
+    static void align(std::vector<uint8_t>& blob) { blob.resize((blob.size() + 3) & ~size_t(3), 0); }
+
+    template <typename Key>
+    static void writeTimes(std::vector<uint8_t>& blob, ChannelHeader& header, const std::vector<Key>& keys,
+                           const std::vector<uint32_t>& kept, float duration) {
+        header.keyCount = static_cast<uint32_t>(kept.size());
+        header.timesOffset = static_cast<uint32_t>(blob.size());
+        blob.resize(blob.size() + kept.size() * sizeof(uint16_t));
+        auto times = reinterpret_cast<uint16_t*>(blob.data() + header.timesOffset);
+        for (size_t i = 0; i < kept.size(); ++i)
+            times[i] = static_cast<uint16_t>(std::lround(toKeyTime(keys[kept[i]].timeStamp, duration)));
+        align(blob);
+        header.valuesOffset = static_cast<uint32_t>(blob.size());
+        blob.resize(blob.size() + kept.size() * 3 * sizeof(uint16_t));
+    }
+
+    static void writeChannel(std::vector<uint8_t>& blob, ChannelHeader& header, const std::vector<VectorKey>& keys,
+                             float tolerance, float duration) {
+        std::vector<uint32_t> kept = reduceKeys(keys, tolerance);
+        header.rangeMin = glm::vec3(0.0f);
+        header.rangeExtent = glm::vec3(0.0f);
+        if (!kept.empty()) {
+            glm::vec3 min = keys[kept[0]].value, max = min;
+            for (uint32_t index : kept) {
+                min = glm::min(min, keys[index].value);
+                max = glm::max(max, keys[index].value);
+            }
+            header.rangeMin = min;
+            header.rangeExtent = max - min;
+        }
+        writeTimes(blob, header, keys, kept, duration);
+        auto values = reinterpret_cast<uint16_t*>(blob.data() + header.valuesOffset);
+        for (size_t i = 0; i < kept.size(); ++i)
+            for (int c = 0; c < 3; ++c)
+                values[i * 3 + c] = quantize(keys[kept[i]].value[c], header.rangeMin[c], header.rangeExtent[c]);
+        align(blob);
+    }
+
+    static void writeChannel(std::vector<uint8_t>& blob, ChannelHeader& header, const std::vector<RotationKey>& keys,
+                             float tolerance, float duration) {
+        std::vector<uint32_t> kept = reduceKeys(keys, tolerance);
+        header.rangeMin = glm::vec3(0.0f);
+        header.rangeExtent = glm::vec3(0.0f);
+        writeTimes(blob, header, keys, kept, duration);
+        auto values = reinterpret_cast<uint16_t*>(blob.data() + header.valuesOffset);
+        for (size_t i = 0; i < kept.size(); ++i)
+            encodeRotation(keys[kept[i]].value, values + i * 3);
+        align(blob);
+    }
+
+    // ------------------------------------------------------------------------------------------------------------
+    // Decoding
+    // ------------------------------------------------------------------------------------------------------------
+
+    static const TrackHeader* getTracks(const std::vector<uint8_t>& blob) {
+        return reinterpret_cast<const TrackHeader*>(blob.data() + sizeof(ClipHeader));
+    }
+
+    // Returns the index of the last key at or before the time (0 if the time is before the first key), the same
+    // search as the one of the raw keys (see AnimationPlayer): a short walk forward from the cursor during playback,
+    // a binary search otherwise. The cursor is updated.
+    static uint32_t findKey(const uint16_t* times, uint32_t count, float time, uint32_t& cursor) {
+        uint32_t from = 0;
+        if (cursor < count && times[cursor] <= time) {
+            for (uint32_t step = 0; step < MAX_CURSOR_STEPS; ++step) {
+                if (cursor + 1 >= count || time < times[cursor + 1])
+                    return cursor;
+                ++cursor;
+            }
+            from = cursor;
+        }
+        const uint16_t* next =
+            std::upper_bound(times + from, times + count, time, [](float t, uint16_t key) { return t < key; });
+        cursor = next == times ? 0 : static_cast<uint32_t>(next - times - 1);
+        return cursor;
+    }
+
+    // The interpolation factor between the keys "index" and "index + 1" (-1 if the value of "index" is used as is)
+    static float getFactor(const uint16_t* times, uint32_t count, uint32_t index, float time) {
+        if (index + 1 >= count || time <= times[index] || times[index + 1] <= times[index])
+            return -1.0f;
+        return std::min((time - times[index]) / float(times[index + 1] - times[index]), 1.0f);
+    }
+
+    static glm::vec3 dequantize(const uint16_t* value, const ChannelHeader& header) {
+        return header.rangeMin + glm::vec3(value[0], value[1], value[2]) * (header.rangeExtent / MAX_VALUE);
+    }
+
+    static glm::quat decodeRotation(const uint16_t* value) {
+        uint32_t largest = ((value[0] >> 15) & 1) | (((value[1] >> 15) & 1) << 1);
+        float components[4];
+        float sumOfSquares = 0.0f;
+        for (uint32_t i = 0, j = 0; i < 4; ++i) {
+            if (i == largest)
+                continue;
+            float normalized = float(value[j++] & 0x7FFF) / MAX_SMALLEST_THREE;
+            components[i] = (normalized * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+            sumOfSquares += components[i] * components[i];
+        }
+        components[largest] = std::sqrt(std::max(0.0f, 1.0f - sumOfSquares));
+        return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+    }
+
+    static glm::vec3 decodeVector(const std::vector<uint8_t>& blob, const ChannelHeader& header, float time,
+                                  uint32_t& cursor, const glm::vec3& fallback) {
+        if (header.keyCount == 0)
+            return fallback;
+        auto times = reinterpret_cast<const uint16_t*>(blob.data() + header.timesOffset);
+        auto values = reinterpret_cast<const uint16_t*>(blob.data() + header.valuesOffset);
+        uint32_t index = findKey(times, header.keyCount, time, cursor);
+        glm::vec3 v0 = dequantize(values + index * 3, header);
+        float factor = getFactor(times, header.keyCount, index, time);
+        if (factor < 0.0f)
+            return v0;
+        return glm::mix(v0, dequantize(values + (index + 1) * 3, header), factor);
+    }
+
+    static glm::quat decodeRotation(const std::vector<uint8_t>& blob, const ChannelHeader& header, float time,
+                                    uint32_t& cursor) {
+        if (header.keyCount == 0)
+            return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        auto times = reinterpret_cast<const uint16_t*>(blob.data() + header.timesOffset);
+        auto values = reinterpret_cast<const uint16_t*>(blob.data() + header.valuesOffset);
+        uint32_t index = findKey(times, header.keyCount, time, cursor);
+        glm::quat q0 = decodeRotation(values + index * 3);
+        float factor = getFactor(times, header.keyCount, index, time);
+        if (factor < 0.0f)
+            return q0;
+        return glm::slerp(q0, decodeRotation(values + (index + 1) * 3), factor);
+    }
+
+    KeyFrame decodeTrack(const Animation& animation, size_t track, float timeInAnimationTicks, TrackCursor& cursor) {
+        const TrackHeader& header = getTracks(animation.compressedData)[track];
+        float time = toKeyTime(timeInAnimationTicks, animation.duration);
+        KeyFrame frame;
+        frame.timeStamp = timeInAnimationTicks;
+        frame.position =
+            decodeVector(animation.compressedData, header.channels[POSITION], time, cursor.position, glm::vec3(0.0f));
+        frame.rotation = decodeRotation(animation.compressedData, header.channels[ROTATION], time, cursor.rotation);
+        frame.scale =
+            decodeVector(animation.compressedData, header.channels[SCALE], time, cursor.scale, glm::vec3(1.0f));
+        return frame;
+    }
+
+    void decodePose(const Animation& animation, float timeInAnimationTicks, const std::vector<BoneTransform>& bindPose,
+                    std::vector<TrackCursor>& cursors, std::vector<BoneTransform>& localPose) {
+        const std::vector<uint8_t>& blob = animation.compressedData;
+        const TrackHeader* tracks = getTracks(blob);
+        float time = toKeyTime(timeInAnimationTicks, animation.duration);
+        cursors.resize(animation.boneAnimations.size());
+        localPose.resize(bindPose.size());
+
+        for (size_t bone = 0; bone < bindPose.size(); ++bone) {
+            int track = animation.boneTracks[bone];
+            if (track < 0) {
+                localPose[bone] = bindPose[bone];
+                continue;
+            }
+            const TrackHeader& header = tracks[track];
+            TrackCursor& cursor = cursors[track];
+            BoneTransform& local = localPose[bone];
+            local.position = decodeVector(blob, header.channels[POSITION], time, cursor.position, glm::vec3(0.0f));
+            local.rotation = decodeRotation(blob, header.channels[ROTATION], time, cursor.rotation);
+            local.scale = decodeVector(blob, header.channels[SCALE], time, cursor.scale, glm::vec3(1.0f));
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------------------
+    // Compression
+    // ------------------------------------------------------------------------------------------------------------
+
+    std::vector<uint8_t> compress(const Animation& animation, Report& report) {
+        report = Report();
+        uint32_t trackCount = static_cast<uint32_t>(animation.boneAnimations.size());
+        std::vector<uint8_t> blob(sizeof(ClipHeader) + trackCount * sizeof(TrackHeader), 0);
+        reinterpret_cast<ClipHeader*>(blob.data())->trackCount = trackCount;
+
+        // The headers are written last since the blob moves as it grows
+        std::vector<TrackHeader> headers(trackCount);
+        for (uint32_t i = 0; i < trackCount; ++i) {
+            const BoneAnimation& track = animation.boneAnimations[i];
+            TrackHeader& header = headers[i];
+            writeChannel(blob, header.channels[POSITION], track.positionKeys, POSITION_TOLERANCE, animation.duration);
+            writeChannel(blob, header.channels[ROTATION], track.rotationKeys, ROTATION_TOLERANCE, animation.duration);
+            writeChannel(blob, header.channels[SCALE], track.scaleKeys, SCALE_TOLERANCE, animation.duration);
+
+            report.rawKeys += track.positionKeys.size() + track.rotationKeys.size() + track.scaleKeys.size();
+            report.rawBytes += track.positionKeys.size() * sizeof(VectorKey) +
+                               track.rotationKeys.size() * sizeof(RotationKey) +
+                               track.scaleKeys.size() * sizeof(VectorKey);
+            for (const ChannelHeader& channel : header.channels)
+                report.keptKeys += channel.keyCount;
+        }
+        std::memcpy(blob.data() + sizeof(ClipHeader), headers.data(), headers.size() * sizeof(TrackHeader));
+        report.compressedBytes = blob.size();
+
+        // The errors are measured at the original keys: the raw and the compressed channels are both linear
+        // between their keys, and the kept keys are among the original ones, so that's where the errors peak
+        for (uint32_t i = 0; i < trackCount; ++i) {
+            const BoneAnimation& track = animation.boneAnimations[i];
+            const TrackHeader& header = headers[i];
+            uint32_t cursor = 0;
+            for (const VectorKey& key : track.positionKeys) {
+                float time = toKeyTime(key.timeStamp, animation.duration);
+                glm::vec3 value = decodeVector(blob, header.channels[POSITION], time, cursor, glm::vec3(0.0f));
+                report.maxPositionError = std::max(report.maxPositionError, distance(value, key.value));
+            }
+            cursor = 0;
+            for (const RotationKey& key : track.rotationKeys) {
+                float time = toKeyTime(key.timeStamp, animation.duration);
+                glm::quat value = decodeRotation(blob, header.channels[ROTATION], time, cursor);
+                report.maxRotationError = std::max(report.maxRotationError, distance(value, key.value));
+            }
+            cursor = 0;
+            for (const VectorKey& key : track.scaleKeys) {
+                float time = toKeyTime(key.timeStamp, animation.duration);
+                glm::vec3 value = decodeVector(blob, header.channels[SCALE], time, cursor, glm::vec3(1.0f));
+                report.maxScaleError = std::max(report.maxScaleError, distance(value, key.value));
+            }
+        }
+        return blob;
+    }
+
+    bool validate(const Animation& animation) {
+        const std::vector<uint8_t>& blob = animation.compressedData;
+        if (blob.size() < sizeof(ClipHeader))
+            return false;
+        uint32_t trackCount = reinterpret_cast<const ClipHeader*>(blob.data())->trackCount;
+        if (trackCount != animation.boneAnimations.size() ||
+            (blob.size() - sizeof(ClipHeader)) / sizeof(TrackHeader) < trackCount)
+            return false;
+        const TrackHeader* tracks = getTracks(blob);
+        for (uint32_t i = 0; i < trackCount; ++i) {
+            for (const ChannelHeader& channel : tracks[i].channels) {
+                uint64_t timesEnd = uint64_t(channel.timesOffset) + uint64_t(channel.keyCount) * sizeof(uint16_t);
+                uint64_t valuesEnd = uint64_t(channel.valuesOffset) + uint64_t(channel.keyCount) * 3 * sizeof(uint16_t);
+                if (channel.timesOffset % 2 != 0 || channel.valuesOffset % 2 != 0 || timesEnd > blob.size() ||
+                    valuesEnd > blob.size())
+                    return false;
+            }
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "animation-pose.hpp"
+#include "animation.hpp"
+
+namespace our {
+    struct TrackCursor;
+}
+
+// Compresses the animation clips when they are cooked, then samples them straight from the compressed data:
+// - The keys that the linear interpolation of their neighbours reproduces within a tolerance are removed
+//   (greedily: each kept key is followed by the furthest key that still reproduces all the keys in between).
+// - The key times are quantized to 16 bits over the duration of the clip.
+// - The rotations are stored as "smallest three" quaternions: the largest component is dropped (it is recomputed
+//   from the unit length) and the other three are quantized to 15 bits, with the index of the dropped one in the
+//   remaining 2 bits (6 bytes per rotation instead of 16).
+// - The positions and scales are quantized to 16 bits over the range of their channel (6 bytes instead of 12).
+// The whole clip is one contiguous blob (Animation::compressedData):
+//   ClipHeader, TrackHeader[trackCount], then the times and the values of each channel (4 byte aligned).
+// Nothing in here depends on OpenGL so it can run in the cooker.
+namespace our::animation_compression {
+
+    // The largest errors the key removal allows (the quantization adds a little on top, see Report)
+    constexpr float POSITION_TOLERANCE = 0.0005f; // In model units
+    constexpr float ROTATION_TOLERANCE = 0.0005f; // In radians
+    constexpr float SCALE_TOLERANCE = 0.0005f;
+
+    enum Channel : uint32_t { POSITION = 0, ROTATION = 1, SCALE = 2, CHANNEL_COUNT = 3 };
+
+    struct ChannelHeader {
+        uint32_t keyCount;
+        // From the start of the blob: "keyCount" uint16 times, then "keyCount" * 3 uint16 values
+        uint32_t timesOffset, valuesOffset;
+        // The range of the quantized values (unused by the rotations)
+        glm::vec3 rangeMin, rangeExtent;
+    };
+
+    struct TrackHeader {
+        ChannelHeader channels[CHANNEL_COUNT];
+    };
+
+    struct ClipHeader {
+        uint32_t trackCount;
+    };
+
+    // What the compression of a clip achieved
+    struct Report {
+        size_t rawKeys = 0, keptKeys = 0;
+        size_t rawBytes = 0, compressedBytes = 0; // The keys as they were stored before and the blob
+        // The largest errors at the times of the original keys
+        float maxPositionError = 0.0f, maxRotationError = 0.0f, maxScaleError = 0.0f;
+
+        float getRatio() const { return compressedBytes > 0 ? float(rawBytes) / float(compressedBytes) : 0.0f; }
+    };
+
+    // Returns the compressed blob of the clip, the raw keys of its tracks are left as they are
+    std::vector<uint8_t> compress(const Animation& animation, Report& report);
+
+    // Checks that the blob of the clip is consistent with its tracks (for the clips read from a file)
+    bool validate(const Animation& animation);
+
+    // Decodes the local transform of every bone at the time (in ticks) like AnimationPlayer::sampleLocalPose:
+    // through the bone tracks of the animation, the bones without a track keep their bind transform.
+    // The key searches start from the cursors (one per track) which are updated.
+    void decodePose(const Animation& animation, float timeInAnimationTicks, const std::vector<BoneTransform>& bindPose,
+                    std::vector<TrackCursor>& cursors, std::vector<BoneTransform>& localPose);
+
+    // Decodes a single track (for the lookups by bone name)
+    KeyFrame decodeTrack(const Animation& animation, size_t track, float timeInAnimationTicks, TrackCursor& cursor);
+
+}
@@ -1,4 +1,5 @@
 #include "animation-player.hpp"
+#include "animation-compression.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <algorithm>
@@ -16,6 +17,8 @@ void AnimationPlayer::playAnimation(Animation* animation, bool loop) {
     m_CurrentTimeSeconds = 0.0f;
     m_IsPlaying = (m_CurrentAnimation != nullptr);
     m_IsLooping = loop;
+    // The cursors of the previous animation mean nothing for this one
+    m_TrackCursors.assign(m_CurrentAnimation ? m_CurrentAnimation->boneAnimations.size() : 0, TrackCursor());
 
     if (m_CurrentAnimation && m_IsPlaying) {
         std::cout << "[AnimationPlayer] Playing animation: '" << m_CurrentAnimation->name
@@ -129,67 +132,74 @@ const BoneAnimation* AnimationPlayer::findBoneAnimationTrack(const std::string&
     return nullptr;
 }
 
-int AnimationPlayer::getPreviousKeyFrameIndex(const std::vector<KeyFrame>& keyFrames, float timeInAnimationTicks) {
-    if (keyFrames.empty()) {
-        return -1;
-    }
-    if (keyFrames.size() == 1 || timeInAnimationTicks <= keyFrames[0].timeStamp) {
-        return 0;
-    }
-    if (timeInAnimationTicks >= keyFrames.back().timeStamp) {
-        return static_cast<int>(keyFrames.size() - 1); // Use the last keyframe.
-    }
-
-    // Binary search could be an optimization here if keyFrames are numerous and sorted.
-    // For now, linear scan is fine and matches typical Assimp loader behavior.
-    for (size_t i = 0; i < keyFrames.size() - 1; ++i) {
-        if (timeInAnimationTicks < keyFrames[i + 1].timeStamp) {
-            return static_cast<int>(i);
+// The number of keys the cursor is walked forward before falling back to a binary search
+static const uint32_t MAX_CURSOR_STEPS = 4;
+
+// Returns the index of the last key at or before the time (0 if the time is before the first key).
+// The cursor is walked forward when the time moved forward by a few keys since the last sample (the usual case
+// during playback), a seek or a loop back to the start is a binary search instead. The cursor is updated.
+template <typename Key> static uint32_t findKey(const std::vector<Key>& keys, float time, uint32_t& cursor) {
+    uint32_t count = static_cast<uint32_t>(keys.size());
+    uint32_t from = 0;
+    if (cursor < count && keys[cursor].timeStamp <= time) {
+        for (uint32_t step = 0; step < MAX_CURSOR_STEPS; ++step) {
+            if (cursor + 1 >= count || time < keys[cursor + 1].timeStamp) {
+                return cursor;
+            }
+            ++cursor;
         }
+        from = cursor;
     }
-
-    return static_cast<int>(keyFrames.size() - 1);
+    auto next = std::upper_bound(keys.begin() + from, keys.end(), time,
+                                 [](float t, const Key& key) { return t < key.timeStamp; });
+    cursor = next == keys.begin() ? 0 : static_cast<uint32_t>(next - keys.begin() - 1);
+    return cursor;
 }
 
-KeyFrame AnimationPlayer::interpolateKeyFrames(const std::vector<KeyFrame>& keyFrames, float timeInAnimationTicks) {
-    if (keyFrames.empty()) {
-        // Return a default/identity KeyFrame if there are no keyframes for this bone track
-        return {timeInAnimationTicks, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f)};
+// The interpolation factor between two keys, clamped to prevent extrapolation if time is slightly outside due to
+// precision
+static float getFactor(float time0, float time1, float time) {
+    float deltaTimeBetweenKeys = time1 - time0;
+    if (deltaTimeBetweenKeys <= 0.00001f) {
+        return 0.0f;
     }
+    return glm::clamp((time - time0) / deltaTimeBetweenKeys, 0.0f, 1.0f);
+}
 
-    int p0_Index = getPreviousKeyFrameIndex(keyFrames, timeInAnimationTicks);
-
-    if (p0_Index == 0 && (timeInAnimationTicks <= keyFrames[0].timeStamp || keyFrames.size() == 1)) {
-        return keyFrames[0];
+static glm::vec3 sampleVectorKeys(const std::vector<VectorKey>& keys, float time, uint32_t& cursor,
+                                  const glm::vec3& fallback) {
+    if (keys.empty()) {
+        return fallback;
     }
-    if (p0_Index == static_cast<int>(keyFrames.size()) - 1) {
-        return keyFrames.back();
+    uint32_t index = findKey(keys, time, cursor);
+    if (index + 1 >= keys.size() || time <= keys[index].timeStamp) {
+        return keys[index].value;
     }
+    const VectorKey& k0 = keys[index];
+    const VectorKey& k1 = keys[index + 1];
+    return glm::mix(k0.value, k1.value, getFactor(k0.timeStamp, k1.timeStamp, time));
+}
 
-    int p1_Index = p0_Index + 1;
-    if (p1_Index >= static_cast<int>(keyFrames.size())) {
-        return keyFrames[p0_Index];
+static glm::quat sampleRotationKeys(const std::vector<RotationKey>& keys, float time, uint32_t& cursor) {
+    if (keys.empty()) {
+        return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
     }
-
-    const KeyFrame& p0 = keyFrames[p0_Index];
-    const KeyFrame& p1 = keyFrames[p1_Index];
-
-    float deltaTimeBetweenKeys = p1.timeStamp - p0.timeStamp;
-    float factor = 0.0f;
-
-    if (deltaTimeBetweenKeys > 0.00001f) {
-        factor = (timeInAnimationTicks - p0.timeStamp) / deltaTimeBetweenKeys;
+    uint32_t index = findKey(keys, time, cursor);
+    if (index + 1 >= keys.size() || time <= keys[index].timeStamp) {
+        return keys[index].value;
     }
-    // Clamp factor to [0, 1] to prevent extrapolation if time is slightly outside due to precision
-    factor = glm::clamp(factor, 0.0f, 1.0f);
-
-    KeyFrame interpolatedFrame;
-    interpolatedFrame.timeStamp = timeInAnimationTicks;
-    interpolatedFrame.position = glm::mix(p0.position, p1.position, factor);
-    interpolatedFrame.rotation = glm::slerp(p0.rotation, p1.rotation, factor);
-    interpolatedFrame.scale = glm::mix(p0.scale, p1.scale, factor);
+    const RotationKey& k0 = keys[index];
+    const RotationKey& k1 = keys[index + 1];
+    return glm::slerp(k0.value, k1.value, getFactor(k0.timeStamp, k1.timeStamp, time));
+}
 
-    return interpolatedFrame;
+KeyFrame AnimationPlayer::sampleTrack(const BoneAnimation& track, float timeInAnimationTicks, TrackCursor& cursor) {
+    KeyFrame frame;
+    frame.timeStamp = timeInAnimationTicks;
+    frame.position = sampleVectorKeys(track.positionKeys, timeInAnimationTicks, cursor.position, glm::vec3(0.0f));
+    frame.rotation = sampleRotationKeys(track.rotationKeys, timeInAnimationTicks, cursor.rotation);
+    frame.scale = sampleVectorKeys(track.scaleKeys, timeInAnimationTicks, cursor.scale, glm::vec3(1.0f));
+    return frame;
 }
 
 glm::mat4 AnimationPlayer::getBoneTransformAtArbitraryTime(const std::string& boneName,
@@ -200,7 +210,13 @@ glm::mat4 AnimationPlayer::getBoneTransformAtArbitraryTime(const std::string& bo
         return glm::mat4(1.0f);
     }
 
-    KeyFrame interpolatedFrame = interpolateKeyFrames(boneAnimTrack->keyFrames, timeInAnimationTicks);
+    // Arbitrary times have no cursor to start from
+    TrackCursor cursor;
+    KeyFrame interpolatedFrame =
+        m_CurrentAnimation->isCompressed()
+            ? animation_compression::decodeTrack(*m_CurrentAnimation, boneAnimTrack - m_CurrentAnimation->boneAnimations.data(),
+                                                 timeInAnimationTicks, cursor)
+            : sampleTrack(*boneAnimTrack, timeInAnimationTicks, cursor);
 
     glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), interpolatedFrame.position);
     glm::mat4 rotationMatrix = glm::toMat4(interpolatedFrame.rotation); // Convert quaternion to rotation matrix
@@ -209,11 +225,7 @@ glm::mat4 AnimationPlayer::getBoneTransformAtArbitraryTime(const std::string& bo
     return translationMatrix * rotationMatrix * scaleMatrix;
 }
 
-glm::mat4 AnimationPlayer::getCurrentBoneTransform(const std::string& boneName) const {
-    if (!m_CurrentAnimation) {
-        return glm::mat4(1.0f);
-    }
-
+float AnimationPlayer::getCurrentTimeInTicks() const {
     float ticksPerSecond = m_CurrentAnimation->ticksPerSecond;
     if (ticksPerSecond <= 0.0f)
         ticksPerSecond = 25.0f;
@@ -226,8 +238,45 @@ glm::mat4 AnimationPlayer::getCurrentBoneTransform(const std::string& boneName)
             timeInAnimationTicks += m_CurrentAnimation->duration;
         }
     }
+    return timeInAnimationTicks;
+}
+
+glm::mat4 AnimationPlayer::getCurrentBoneTransform(const std::string& boneName) const {
+    if (!m_CurrentAnimation) {
+        return glm::mat4(1.0f);
+    }
+    return getBoneTransformAtArbitraryTime(boneName, getCurrentTimeInTicks());
+}
+
+void AnimationPlayer::sampleLocalPose(const std::vector<BoneTransform>& bindPose,
+                                      std::vector<BoneTransform>& localPose) {
+    localPose.resize(bindPose.size());
+    const std::vector<int16_t>* boneTracks = m_CurrentAnimation ? &m_CurrentAnimation->boneTracks : nullptr;
+    if (!boneTracks || boneTracks->size() != bindPose.size()) {
+        // Not bound to this skeleton
+        std::copy(bindPose.begin(), bindPose.end(), localPose.begin());
+        return;
+    }
 
-    return getBoneTransformAtArbitraryTime(boneName, timeInAnimationTicks);
+    float timeInAnimationTicks = getCurrentTimeInTicks();
+    if (m_CurrentAnimation->isCompressed()) {
+        animation_compression::decodePose(*m_CurrentAnimation, timeInAnimationTicks, bindPose, m_TrackCursors,
+                                          localPose);
+        return;
+    }
+    const std::vector<BoneAnimation>& tracks = m_CurrentAnimation->boneAnimations;
+    m_TrackCursors.resize(tracks.size());
+    for (size_t bone = 0; bone < bindPose.size(); ++bone) {
+        int track = (*boneTracks)[bone];
+        if (track < 0) {
+            localPose[bone] = bindPose[bone];
+            continue;
+        }
+        KeyFrame frame = sampleTrack(tracks[track], timeInAnimationTicks, m_TrackCursors[track]);
+        localPose[bone].position = frame.position;
+        localPose[bone].rotation = frame.rotation;
+        localPose[bone].scale = frame.scale;
+    }
 }
 
 } // namespace our
@@ -4,9 +4,16 @@
 #include <string>
 #include <vector>
 #include "animation/animation.hpp"
+#include "animation-pose.hpp"
 
 namespace our {
 
+// Where the sampling of a track stopped: the index of the key at or before the last sampled time in each channel.
+// Sampling the next frame of a forward playback starts from there and moves by a key or two at most.
+struct TrackCursor {
+    uint32_t position = 0, rotation = 0, scale = 0;
+};
+
 class AnimationPlayer {
     public:
     AnimationPlayer();
@@ -33,19 +40,29 @@ class AnimationPlayer {
 
     glm::mat4 getCurrentBoneTransform(const std::string& boneName) const;
 
-    static KeyFrame interpolateKeyFrames(const std::vector<KeyFrame>& keyFrames, float timeInAnimationTicks);
+    // Samples the channels of the track, the key search starts from the cursor which is updated
+    static KeyFrame sampleTrack(const BoneAnimation& track, float timeInAnimationTicks, TrackCursor& cursor);
 
     glm::mat4 getBoneTransformAtArbitraryTime(const std::string& boneName, float timeInAnimationTicks) const;
 
+    // The current time in the ticks of the animation (wrapped if it loops)
+    float getCurrentTimeInTicks() const;
+
+    // Samples the local transform of every bone at the current time through the bone tracks of the animation
+    // (see Animation::boneTracks), the bones without a track keep their bind transform.
+    // Both vectors are indexed by bone index, the animation must be bound to the skeleton they come from.
+    // It advances the cursors of the player, so each instance needs its own player.
+    void sampleLocalPose(const std::vector<BoneTransform>& bindPose, std::vector<BoneTransform>& localPose);
+
     private:
     Animation* m_CurrentAnimation;
     float m_CurrentTimeSeconds;
     bool m_IsPlaying;
     bool m_IsLooping;
+    // One per track of the current animation
+    std::vector<TrackCursor> m_TrackCursors;
 
     const BoneAnimation* findBoneAnimationTrack(const std::string& boneName) const;
-
-    static int getPreviousKeyFrameIndex(const std::vector<KeyFrame>& keyFrames, float timeInAnimationTicks);
 };
 
 } // namespace our
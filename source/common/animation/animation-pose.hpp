@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+namespace our {
+
+// The local transform of a bone as its translation, rotation and scale: the sampled poses are kept in this form
+// until they are blended (see pose-blending.hpp) since matrices can't be interpolated.
+// Each part fills 16 bytes so the blending loads them as whole SSE registers.
+struct alignas(16) BoneTransform {
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 position = glm::vec3(0.0f);
+    float padding0 = 0.0f;
+    glm::vec3 scale = glm::vec3(1.0f);
+    float padding1 = 0.0f;
+};
+
+// The pose of one animated instance of a model.
+// The Model only holds the immutable bind skeleton (the bones and their offset matrices) so that one loaded model
+// can back any number of independently animated entities: each AnimationComponent owns its pose and the
+// renderer reads the pose of the instance it draws.
+// The matrices are stored as contiguous arrays indexed by bone index (see Skeleton).
+struct AnimationPose {
+    std::vector<BoneTransform> localPose;    // Sampled from the animations and blended (see AnimationComponent)
+    std::vector<glm::mat4> localTransforms; // The local pose as matrices (bone space to parent bone space)
+    std::vector<glm::mat4> boneTransforms;  // Current pose transforms (bone space to model space)
+    std::vector<glm::mat4> finalTransforms; // Final matrices sent to shader (mesh space to bone space)
+
+    void resize(size_t boneCount) {
+        localPose.resize(boneCount);
+        localTransforms.resize(boneCount, glm::mat4(1.0f));
+        boneTransforms.resize(boneCount, glm::mat4(1.0f));
+        finalTransforms.resize(boneCount, glm::mat4(1.0f));
+    }
+    size_t getBoneCount() const {
+        return finalTransforms.size();
+    }
+};
+
+} // namespace our
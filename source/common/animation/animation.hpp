@@ -2,9 +2,12 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <cstdint>
 #include <string>
 #include <vector>
+#include "animation-clip-id.hpp"
 
+// The transform of a bone sampled at a time
 struct KeyFrame {
     float timeStamp;
     glm::vec3 position;
@@ -12,9 +15,30 @@ struct KeyFrame {
     glm::vec3 scale;
 };
 
+// A key of a position or scale channel
+struct VectorKey {
+    float timeStamp;
+    glm::vec3 value;
+};
+
+struct RotationKey {
+    float timeStamp;
+    glm::quat value;
+};
+
+// The channels keep the key times of the source file, each one is sorted by time
+// (e.g. a bone that only rotates has a single position key and a single scale key)
 struct BoneAnimation {
     std::string boneName;
-    std::vector<KeyFrame> keyFrames;
+    std::vector<VectorKey> positionKeys;
+    std::vector<RotationKey> rotationKeys;
+    std::vector<VectorKey> scaleKeys;
+};
+
+// An axis aligned box in the space of the model (see animation-bounds.hpp), empty if minimum > maximum
+struct AnimationBounds {
+    glm::vec3 minimum;
+    glm::vec3 maximum;
 };
 
 class Animation {
@@ -23,6 +47,22 @@ public:
     float duration;
     float ticksPerSecond;
     std::vector<BoneAnimation> boneAnimations;
+    // The keys of all the tracks compressed into one blob (see animation-compression.hpp). The tracks of the
+    // compressed clips keep their bone names but no keys.
+    std::vector<uint8_t> compressedData;
+
+    // The interned name, set when the clip is loaded by a Model
+    our::AnimationClipId id = our::INVALID_ANIMATION_CLIP;
+    // The track of each bone of the skeleton the clip is bound to (-1 for the bones the clip doesn't animate)
+    // Built the first time the clip is played (see Model::bindAnimation) so the sampling never compares names
+    std::vector<int16_t> boneTracks;
+    // The bounds of the skinned mesh while the clip plays, computed when the clip is cooked (see animation_bounds):
+    // over each of the animation_bounds::SEGMENT_COUNT equal parts of the clip, and of the vertices of each bone
+    // over the whole clip. Both are empty if the model has no skinned vertex.
+    std::vector<AnimationBounds> segmentBounds;
+    std::vector<AnimationBounds> boneBounds;
 
     Animation(): name(""), duration(0.0f), ticksPerSecond(0.0f) {}
+
+    bool isCompressed() const { return !compressedData.empty(); }
 };
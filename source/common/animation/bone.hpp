@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -12,3 +13,13 @@ struct Bone {
     int parentIndex;              // -1 for root bones
     std::vector<int> children;    // Child bone indices
 };
+
+// A capsule around the vertices a bone drives (in the space of the bone), for the hit tests of animated meshes.
+// The bone space of a vertex depends on the submesh holding it, so the capsule only covers the vertices of one
+// submesh (-1 if the bone drives no vertex).
+struct BoneCapsule {
+    glm::vec3 start;
+    float radius;
+    glm::vec3 end;
+    int32_t submesh;
+};
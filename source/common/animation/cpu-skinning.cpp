@@ -0,0 +1,133 @@
+#include "cpu-skinning.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_SKINNING_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace our::cpu_skinning {
+
+#ifdef CPU_SKINNING_SSE
+    // The weighted sum of the bone matrices of a vertex, as 4 columns
+    struct SkinMatrix {
+        __m128 columns[4];
+    };
+
+    // Returns false if no bone influences the vertex
+    static inline bool blendMatrices(const Vertex& vertex, const glm::mat4* matrices, size_t matrixCount,
+                                     SkinMatrix& skin) {
+        bool influenced = false;
+        for (int column = 0; column < 4; ++column)
+            skin.columns[column] = _mm_setzero_ps();
+        for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+            float weight = vertex.weights[i];
+            int bone = vertex.bone_ids[i];
+            if (weight <= 0.0f || bone < 0 || static_cast<size_t>(bone) >= matrixCount)
+                continue;
+            // The matrices of a std::vector are not guaranteed to be 16 byte aligned
+            const float* matrix = glm::value_ptr(matrices[bone]);
+            __m128 w = _mm_set1_ps(weight);
+            for (int column = 0; column < 4; ++column)
+                skin.columns[column] =
+                    _mm_add_ps(skin.columns[column], _mm_mul_ps(_mm_loadu_ps(matrix + column * 4), w));
+            influenced = true;
+        }
+        return influenced;
+    }
+
+    static inline glm::vec3 transformPosition(const SkinMatrix& skin, const glm::vec3& position) {
+        __m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(skin.columns[0], _mm_set1_ps(position.x)),
+                                              _mm_mul_ps(skin.columns[1], _mm_set1_ps(position.y))),
+                                   _mm_add_ps(_mm_mul_ps(skin.columns[2], _mm_set1_ps(position.z)), skin.columns[3]));
+        alignas(16) float values[4];
+        _mm_store_ps(values, result);
+        return glm::vec3(values[0], values[1], values[2]);
+    }
+
+    static inline glm::vec3 transformDirection(const SkinMatrix& skin, const glm::vec3& direction) {
+        __m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(skin.columns[0], _mm_set1_ps(direction.x)),
+                                              _mm_mul_ps(skin.columns[1], _mm_set1_ps(direction.y))),
+                                   _mm_mul_ps(skin.columns[2], _mm_set1_ps(direction.z)));
+        alignas(16) float values[4];
+        _mm_store_ps(values, result);
+        return glm::vec3(values[0], values[1], values[2]);
+    }
+#else
+    struct SkinMatrix {
+        glm::mat4 matrix;
+    };
+
+    static inline bool blendMatrices(const Vertex& vertex, const glm::mat4* matrices, size_t matrixCount,
+                                     SkinMatrix& skin) {
+        bool influenced = false;
+        skin.matrix = glm::mat4(0.0f);
+        for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+            float weight = vertex.weights[i];
+            int bone = vertex.bone_ids[i];
+            if (weight <= 0.0f || bone < 0 || static_cast<size_t>(bone) >= matrixCount)
+                continue;
+            skin.matrix += matrices[bone] * weight;
+            influenced = true;
+        }
+        return influenced;
+    }
+
+    static inline glm::vec3 transformPosition(const SkinMatrix& skin, const glm::vec3& position) {
+        return glm::vec3(skin.matrix * glm::vec4(position, 1.0f));
+    }
+
+    static inline glm::vec3 transformDirection(const SkinMatrix& skin, const glm::vec3& direction) {
+        return glm::mat3(skin.matrix) * direction;
+    }
+#endif
+
+    void skin(const Vertex* source, size_t count, const glm::mat4* matrices, size_t matrixCount,
+              Vertex* destination) {
+        SkinMatrix skin;
+        for (size_t i = 0; i < count; ++i) {
+            const Vertex& vertex = source[i];
+            Vertex& result = destination[i];
+            if (&result != &vertex)
+                result = vertex;
+            if (blendMatrices(vertex, matrices, matrixCount, skin)) {
+                result.position = transformPosition(skin, vertex.position);
+                // The shaders use the inverse transpose, which only differs for non-uniform bone scales
+                glm::vec3 normal = transformDirection(skin, vertex.normal);
+                float length = glm::length(normal);
+                result.normal = length > 0.0f ? normal / length : vertex.normal;
+            }
+            for (int slot = 0; slot < MAX_BONE_INFLUENCE; ++slot)
+                result.weights[slot] = 0.0f;
+        }
+    }
+
+    void skinPositions(const Vertex* source, size_t count, const glm::mat4* matrices, size_t matrixCount,
+                       glm::vec3* positions) {
+        SkinMatrix skin;
+        for (size_t i = 0; i < count; ++i)
+            positions[i] = blendMatrices(source[i], matrices, matrixCount, skin)
+                               ? transformPosition(skin, source[i].position)
+                               : source[i].position;
+    }
+
+    bool computeBounds(const Vertex* source, size_t count, const glm::mat4* matrices, size_t matrixCount,
+                       glm::vec3& minimum, glm::vec3& maximum) {
+        if (count == 0)
+            return false;
+        minimum = glm::vec3(std::numeric_limits<float>::max());
+        maximum = glm::vec3(std::numeric_limits<float>::lowest());
+        SkinMatrix skin;
+        for (size_t i = 0; i < count; ++i) {
+            glm::vec3 position = blendMatrices(source[i], matrices, matrixCount, skin)
+                                     ? transformPosition(skin, source[i].position)
+                                     : source[i].position;
+            minimum = glm::min(minimum, position);
+            maximum = glm::max(maximum, position);
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <mesh/vertex.hpp>
+
+// Skins vertices on the CPU with the same linear blend skinning as the "SKINNED" shaders (see skinning.glsl):
+// every vertex is transformed by the sum of the matrices of its bones (up to MAX_BONE_INFLUENCE) scaled by their
+// weights. The weighted matrix is accumulated a column at a time using SSE when it is available.
+// It serves the runs that can't (or shouldn't) skin on the GPU: the poses of a headless run can be checked against
+// expected positions, and the skinned geometry gives tight bounds to the culling and the hit detection of animated
+// meshes. Nothing in here depends on OpenGL.
+// "matrices" are the final transforms of a pose (mesh space to skinned mesh space, see AnimationPose), the bone
+// ids outside [0, matrixCount) are ignored and the vertices without any weight are left as they are.
+namespace our::cpu_skinning {
+
+    // Writes the skinned vertices to "destination" (which may be "source"): the positions and the normals are
+    // skinned, the other attributes are copied and the weights are cleared so that the "SKINNED" shaders draw the
+    // result as it is.
+    void skin(const Vertex* source, size_t count, const glm::mat4* matrices, size_t matrixCount,
+              Vertex* destination);
+
+    // Only skins the positions (e.g. to validate a pose or for a hit test)
+    void skinPositions(const Vertex* source, size_t count, const glm::mat4* matrices, size_t matrixCount,
+                       glm::vec3* positions);
+
+    // The bounding box of the skinned positions, returns false if there is no vertex
+    bool computeBounds(const Vertex* source, size_t count, const glm::mat4* matrices, size_t matrixCount,
+                       glm::vec3& minimum, glm::vec3& maximum);
+
+}
@@ -0,0 +1,90 @@
+#include "pose-blending.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POSE_BLENDING_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace our::pose_blending {
+
+    static_assert(sizeof(BoneTransform) == 48 && alignof(BoneTransform) == 16,
+                  "The parts of BoneTransform must be 16 byte aligned to be loaded as SSE registers");
+
+#ifdef POSE_BLENDING_SSE
+    // The dot product of the 4 lanes, in all the lanes
+    static inline __m128 dot4(__m128 a, __m128 b) {
+        __m128 products = _mm_mul_ps(a, b);
+        __m128 pairs = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    static inline __m128 lerp(__m128 a, __m128 b, __m128 weight) {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), weight));
+    }
+#endif
+
+    static inline void blendBone(BoneTransform& result, const BoneTransform& pose, float weight) {
+#ifdef POSE_BLENDING_SSE
+        __m128 w = _mm_set1_ps(weight);
+        __m128 a = _mm_load_ps(&result.rotation.x);
+        __m128 b = _mm_load_ps(&pose.rotation.x);
+        // The shortest path: b is negated (its sign bits flipped) if it is on the other side of the hypersphere
+        __m128 opposite = _mm_cmplt_ps(dot4(a, b), _mm_setzero_ps());
+        b = _mm_xor_ps(b, _mm_and_ps(opposite, _mm_set1_ps(-0.0f)));
+        __m128 rotation = lerp(a, b, w);
+        _mm_store_ps(&result.rotation.x, _mm_div_ps(rotation, _mm_sqrt_ps(dot4(rotation, rotation))));
+        // The paddings are blended with the positions and the scales, they stay 0
+        _mm_store_ps(&result.position.x, lerp(_mm_load_ps(&result.position.x), _mm_load_ps(&pose.position.x), w));
+        _mm_store_ps(&result.scale.x, lerp(_mm_load_ps(&result.scale.x), _mm_load_ps(&pose.scale.x), w));
+#else
+        glm::quat b = glm::dot(result.rotation, pose.rotation) < 0.0f ? -pose.rotation : pose.rotation;
+        result.rotation = glm::normalize(result.rotation + (b - result.rotation) * weight);
+        result.position = glm::mix(result.position, pose.position, weight);
+        result.scale = glm::mix(result.scale, pose.scale, weight);
+#endif
+    }
+
+    void blend(BoneTransform* result, const BoneTransform* pose, size_t count, float weight, const float* mask) {
+        for (size_t i = 0; i < count; ++i) {
+            float boneWeight = mask ? weight * mask[i] : weight;
+            if (boneWeight <= 0.0f)
+                continue;
+            if (boneWeight >= 1.0f)
+                result[i] = pose[i];
+            else
+                blendBone(result[i], pose[i], boneWeight);
+        }
+    }
+
+    void add(BoneTransform* result, const BoneTransform* pose, const BoneTransform* reference, size_t count,
+             float weight, const float* mask) {
+        for (size_t i = 0; i < count; ++i) {
+            float boneWeight = mask ? weight * mask[i] : weight;
+            if (boneWeight <= 0.0f)
+                continue;
+            glm::quat delta = glm::inverse(reference[i].rotation) * pose[i].rotation;
+            if (delta.w < 0.0f)
+                delta = -delta;
+            glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+            result[i].rotation = glm::normalize(result[i].rotation *
+                                                glm::normalize(identity + (delta - identity) * boneWeight));
+            result[i].position += (pose[i].position - reference[i].position) * boneWeight;
+            glm::vec3 scale = pose[i].scale / glm::max(reference[i].scale, glm::vec3(1e-6f));
+            result[i].scale *= glm::mix(glm::vec3(1.0f), scale, boneWeight);
+        }
+    }
+
+    void toMatrices(const BoneTransform* pose, glm::mat4* matrices, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            glm::mat4& matrix = matrices[i];
+            matrix = glm::mat4_cast(pose[i].rotation);
+            matrix[0] *= pose[i].scale.x;
+            matrix[1] *= pose[i].scale.y;
+            matrix[2] *= pose[i].scale.z;
+            matrix[3] = glm::vec4(pose[i].position, 1.0f);
+        }
+    }
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include "animation-pose.hpp"
+
+// Blends local poses (arrays of BoneTransform indexed by bone index) for the crossfades and the layers of the
+// AnimationComponent. The rotations are blended with nlerp (a normalized lerp: it takes the shortest path like
+// slerp, it doesn't keep a constant angular speed but that can't be seen over a blend) and the positions and
+// scales with lerp, on 4 floats at a time using SSE when it is available.
+// "mask" is an optional weight per bone (0 for the bones the blend doesn't affect), multiplied by "weight".
+namespace our::pose_blending {
+
+    // result = blend(result, pose, weight)
+    void blend(BoneTransform* result, const BoneTransform* pose, size_t count, float weight,
+               const float* mask = nullptr);
+
+    // Adds the difference between the pose and the reference pose to the result, scaled by the weight
+    // (an additive layer: its clip is authored relative to its first frame which is the reference)
+    void add(BoneTransform* result, const BoneTransform* pose, const BoneTransform* reference, size_t count,
+             float weight, const float* mask = nullptr);
+
+    // Converts the pose to local transform matrices (Translation * Rotation * Scale)
+    void toMatrices(const BoneTransform* pose, glm::mat4* matrices, size_t count);
+
+}
@@ -1,14 +1,19 @@
 #include "skeleton.hpp"
+#include <glm/gtx/matrix_decompose.hpp>
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include "pose-blending.hpp"
 
 namespace our {
 
 Skeleton::Skeleton() {
     // Reserve some space to avoid frequent reallocations
     bones.reserve(64);
-    boneTransforms.reserve(64);
-    finalTransforms.reserve(64);
+    parents.reserve(64);
+    localBindTransforms.reserve(64);
+    localBindPose.reserve(64);
+    offsetMatrices.reserve(64);
 }
 
 Skeleton::~Skeleton() {
@@ -37,11 +42,14 @@ int Skeleton::addBone(const Bone& bone) {
 
     bones.push_back(newBone);
     boneNameToIndex[bone.name] = boneIndex;
-
-    // Resize transform arrays when a new bone is added.
-    // Initialize with identity matrix.
-    boneTransforms.resize(bones.size(), glm::mat4(1.0f));
-    finalTransforms.resize(bones.size(), glm::mat4(1.0f));
+    parents.push_back(bone.parentIndex);
+    localBindTransforms.push_back(bone.localBindTransform);
+    BoneTransform bindPose;
+    glm::vec3 skew;
+    glm::vec4 perspective;
+    glm::decompose(bone.localBindTransform, bindPose.scale, bindPose.rotation, bindPose.position, skew, perspective);
+    localBindPose.push_back(bindPose);
+    offsetMatrices.push_back(bone.offsetMatrix);
 
     if (bone.parentIndex >= 0) {
         if (isValidBoneIndex(bone.parentIndex)) { // Additional check
@@ -97,70 +105,71 @@ const Bone* Skeleton::getBone(const std::string& name) const {
     return nullptr;
 }
 
-void Skeleton::calculateBoneTransforms(const glm::mat4& rootTransform) {
+void Skeleton::calculateBoneTransforms(AnimationPose& pose, const glm::mat4& rootTransform) const {
     if (bones.empty()) {
         return;
     }
-    for (int rootBoneIndex : rootBones) {
-        calculateBoneTransformsRecursive(rootBoneIndex, rootTransform);
-    }
-    calculateFinalTransforms();
+    pose.resize(bones.size());
+    std::copy(localBindTransforms.begin(), localBindTransforms.end(), pose.localTransforms.begin());
+    std::copy(localBindPose.begin(), localBindPose.end(), pose.localPose.begin());
+    evaluatePose(pose, rootTransform);
 }
 
-void Skeleton::calculateBoneTransformsRecursive(int boneIndex, const glm::mat4& parentTransform) {
-    if (!isValidBoneIndex(boneIndex)) {
-        std::cerr << "[Skeleton] ERROR: Invalid bone index " << boneIndex << " in BIND POSE transform calculation"
-                  << std::endl;
+void Skeleton::evaluateLocalPose(AnimationPose& pose, const glm::mat4& rootTransform) const {
+    if (bones.empty()) {
         return;
     }
-    const Bone& bone = bones[boneIndex];
-    boneTransforms[boneIndex] = parentTransform * bone.localBindTransform;
-
-    for (int childIndex : bone.children) {
-        calculateBoneTransformsRecursive(childIndex, boneTransforms[boneIndex]);
-    }
+    pose.resize(bones.size());
+    pose_blending::toMatrices(pose.localPose.data(), pose.localTransforms.data(), bones.size());
+    evaluatePose(pose, rootTransform);
 }
 
-void Skeleton::calculateAnimatedPoseRecursive(AnimationPlayer* player, int boneIndex,
-                                              const glm::mat4& parentTransform) {
-    if (!isValidBoneIndex(boneIndex) || !player) {
-        std::cerr << "[Skeleton] ERROR: Invalid bone index " << boneIndex
-                  << " or null player in ANIMATED POSE transform calculation" << std::endl;
-        return;
-    }
-    const Bone& bone = bones[boneIndex];
-
-    glm::mat4 localAnimatedTransform = player->getCurrentBoneTransform(bone.name);
-
-    boneTransforms[boneIndex] = parentTransform * localAnimatedTransform;
-
-    for (int childIndex : bone.children) {
-        calculateAnimatedPoseRecursive(player, childIndex, boneTransforms[boneIndex]);
+std::vector<int16_t> Skeleton::buildTrackRemap(const Animation& animation) const {
+    std::vector<int16_t> boneTracks(bones.size(), -1);
+    for (size_t track = 0; track < animation.boneAnimations.size(); ++track) {
+        int boneIndex = findBoneIndex(animation.boneAnimations[track].boneName);
+        if (boneIndex < 0) {
+            continue;
+        }
+        if (track > size_t(INT16_MAX)) {
+            std::cerr << "[Skeleton] ERROR: Animation '" << animation.name << "' has more than " << INT16_MAX
+                      << " tracks, the others are ignored" << std::endl;
+            break;
+        }
+        boneTracks[boneIndex] = static_cast<int16_t>(track);
     }
+    return boneTracks;
 }
 
-void Skeleton::calculateAnimatedPose(AnimationPlayer* player, const glm::mat4& rootTransform) {
-    if (bones.empty()) {
-        return;
-    }
-    if (!player || !player->isCurrentlyPlaying() || !player->getCurrentAnimation()) {
-        calculateBoneTransforms(rootTransform);
-        return;
+std::vector<float> Skeleton::buildBoneMask(const std::string& rootBoneName) const {
+    int root = findBoneIndex(rootBoneName);
+    if (root < 0) {
+        std::cerr << "[Skeleton] WARNING: Mask bone '" << rootBoneName << "' not found, the mask covers all the bones"
+                  << std::endl;
+        return std::vector<float>(bones.size(), 1.0f);
     }
-
-    for (int rootBoneIndex : rootBones) {
-        calculateAnimatedPoseRecursive(player, rootBoneIndex, rootTransform);
+    // The parents come first, so a bone is in the subtree once its parent is
+    std::vector<float> mask(bones.size(), 0.0f);
+    for (size_t i = 0; i < bones.size(); ++i) {
+        if (int(i) == root || (parents[i] >= 0 && mask[parents[i]] > 0.0f)) {
+            mask[i] = 1.0f;
+        }
     }
-    calculateFinalTransforms();
+    return mask;
 }
 
-void Skeleton::calculateFinalTransforms() {
-    if (boneTransforms.size() != bones.size() || finalTransforms.size() != bones.size()) {
-        boneTransforms.resize(bones.size(), glm::mat4(1.0f));
-        finalTransforms.resize(bones.size(), glm::mat4(1.0f));
-    }
-    for (size_t i = 0; i < bones.size(); ++i) {
-        finalTransforms[i] = boneTransforms[i] * bones[i].offsetMatrix;
+void Skeleton::evaluatePose(AnimationPose& pose, const glm::mat4& rootTransform) const {
+    size_t boneCount = bones.size();
+    pose.resize(boneCount);
+    const int* parent = parents.data();
+    const glm::mat4* local = pose.localTransforms.data();
+    const glm::mat4* offset = offsetMatrices.data();
+    glm::mat4* model = pose.boneTransforms.data();
+    glm::mat4* skinning = pose.finalTransforms.data();
+    // The parents come first, so their model transform is always ready
+    for (size_t i = 0; i < boneCount; ++i) {
+        model[i] = (parent[i] < 0 ? rootTransform : model[parent[i]]) * local[i];
+        skinning[i] = model[i] * offset[i];
     }
 }
 
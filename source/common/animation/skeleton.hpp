@@ -7,23 +7,30 @@
 #include <unordered_map>
 #include <vector>
 #include "animation-player.hpp"
+#include "animation-pose.hpp"
 #include "bone.hpp"
 
 namespace our {
 
+// The bind skeleton of a model, it is immutable once loaded and shared by all the instances of the model
+// The poses are computed into the AnimationPose of each instance
+// Besides the bones (with their names and children, for the tools), the skeleton is kept flattened: the parent
+// index, bind transform and offset matrix of every bone in contiguous arrays. The bones are in topological order
+// (a parent is always added before its children, see "addBone") so a pose is evaluated by a single forward loop
+// over these arrays, without recursion or lookups.
 class Skeleton {
     private:
     std::vector<Bone> bones;                              // All bones in the skeleton
     std::unordered_map<std::string, int> boneNameToIndex; // Fast lookup: bone name -> bone index
-    std::vector<glm::mat4> boneTransforms;                // Current pose transforms (bone space to world space)
-    std::vector<glm::mat4> finalTransforms;               // Final matrices sent to shader (mesh space to bone space)
 
     // Root bone indices (bones with no parent)
     std::vector<int> rootBones;
 
-    void calculateBoneTransformsRecursive(int boneIndex, const glm::mat4& parentTransform);
-
-    void calculateAnimatedPoseRecursive(AnimationPlayer* player, int boneIndex, const glm::mat4& parentTransform);
+    // The flattened skeleton (indexed by bone index)
+    std::vector<int> parents;                  // -1 for root bones, otherwise always smaller than the bone index
+    std::vector<glm::mat4> localBindTransforms;
+    std::vector<BoneTransform> localBindPose;  // The same transforms decomposed (the bones the clips don't animate)
+    std::vector<glm::mat4> offsetMatrices;
 
     public:
     Skeleton();
@@ -44,20 +51,32 @@ class Skeleton {
     const std::vector<Bone>& getBones() const {
         return bones;
     }
-    const std::vector<glm::mat4>& getBoneTransforms() const {
-        return boneTransforms;
-    }
-    const std::vector<glm::mat4>& getFinalTransforms() const {
-        return finalTransforms;
-    }
     const std::vector<int>& getRootBones() const {
         return rootBones;
     }
+    const std::vector<int>& getParents() const {
+        return parents;
+    }
+    const std::vector<glm::mat4>& getLocalBindTransforms() const {
+        return localBindTransforms;
+    }
+    const std::vector<BoneTransform>& getLocalBindPose() const {
+        return localBindPose;
+    }
+
+    // Returns the track of the clip that animates each bone (-1 for none), see Animation::boneTracks
+    std::vector<int16_t> buildTrackRemap(const Animation& animation) const;
+    // Returns the weight of each bone for a layer that only affects the bone and its descendants (1 for those, 0
+    // for the others). All the bones get 1 if the bone doesn't exist.
+    std::vector<float> buildBoneMask(const std::string& rootBoneName) const;
 
-    // Transform calculations
-    void calculateBoneTransforms(const glm::mat4& rootTransform = glm::mat4(1.0f));
-    void calculateAnimatedPose(AnimationPlayer* player, const glm::mat4& rootTransform = glm::mat4(1.0f));
-    void calculateFinalTransforms();
+    // Transform calculations, they write into the given pose (which is resized to the bone count)
+    // The bind pose
+    void calculateBoneTransforms(AnimationPose& pose, const glm::mat4& rootTransform = glm::mat4(1.0f)) const;
+    // Converts the local pose (sampled and blended by the AnimationComponent) to matrices then evaluates them
+    void evaluateLocalPose(AnimationPose& pose, const glm::mat4& rootTransform = glm::mat4(1.0f)) const;
+    // Computes the bone and final transforms from the local transforms already in the pose
+    void evaluatePose(AnimationPose& pose, const glm::mat4& rootTransform = glm::mat4(1.0f)) const;
 
     // Utility functions
     void printHierarchy() const;
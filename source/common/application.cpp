@@ -1,4 +1,7 @@
 #include "application.hpp"
+#include "asset-database.hpp"
+#include "hot-reload.hpp"
+#include "shader/shader-cache.hpp"
 
 #include <ctime>
 #include <filesystem>
@@ -196,6 +199,14 @@ int our::Application::run(int run_for_frames) {
         return -1;
     }
 
+    // The asset database must know where the cooked assets are before anything is loaded
+    if (app_config.contains("asset-database"))
+        our::AssetDatabase::getInstance().configure(app_config["asset-database"]);
+    if (app_config.contains("hot-reload"))
+        our::HotReload::getInstance().configure(app_config["hot-reload"]);
+    if (app_config.contains("shader-cache"))
+        our::ShaderCache::getInstance().configure(app_config["shader-cache"]);
+
     configureOpenGL(); // This function sets OpenGL window hints.
 
     auto win_config = getWindowConfiguration(); // Returns the WindowConfiguration current struct instance.
@@ -295,6 +306,7 @@ int our::Application::run(int run_for_frames) {
         if (run_for_frames != 0 && current_frame >= run_for_frames)
             break;
         glfwPollEvents(); // Read all the user events and call relevant callbacks.
+        our::HotReload::getInstance().update(); // Apply the changes made to the watched files (if enabled).
 
         // Start a new ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
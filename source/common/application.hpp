@@ -41,6 +41,8 @@ namespace our {
         virtual void onImmediateGui(){}                 // Called every frame to draw the Immediate GUI (if any).
         virtual void onDraw(double deltaTime){}         // Called every frame in the game loop passing the time taken to draw the frame "Delta time".
         virtual void onDestroy(){}                      // Called once after the game loop ends for house cleaning.
+        // Called when the config of the running level changed on disk (see HotReload).
+        virtual void onLevelConfigReload(const nlohmann::json& oldConfig, const nlohmann::json& newConfig){}
 
 
         // Override these functions to get mouse and keyboard event.
@@ -135,8 +137,19 @@ namespace our {
 
         [[nodiscard]] const nlohmann::json& getLevelConfig() const { return levels_configs[current_level_index - 1]; }
 
+        [[nodiscard]] const std::vector<nlohmann::json>& getLevelsConfigs() const { return levels_configs; }
+
         [[nodiscard]] int getLevelIndex() const { return current_level_index; }
 
+        // Replaces the config of a level (1-based), the running state is notified if it is that level
+        void reloadLevelConfig(int level, const nlohmann::json& config) {
+            if (level < 1 || level > static_cast<int>(levels_configs.size())) return;
+            nlohmann::json oldConfig = std::move(levels_configs[level - 1]);
+            levels_configs[level - 1] = config;
+            if (currentState && level == current_level_index)
+                currentState->onLevelConfigReload(oldConfig, levels_configs[level - 1]);
+        }
+
         void resetLevelIndex() { current_level_index = 0; }
 
         void goToNextLevel() {
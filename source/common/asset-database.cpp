@@ -0,0 +1,393 @@
+#include "asset-database.hpp"
+#include "file-system.hpp"
+#include "model/model-cooker.hpp"
+#include "texture/texture-cooker.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace our {
+
+    // Increase it whenever the layout of the manifest changes (the outputs are then cooked again)
+    static const uint32_t MANIFEST_VERSION = 1;
+    static const char* MANIFEST_NAME = "assets.json";
+
+    static bool getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time) {
+        std::error_code error;
+        size = std::filesystem::file_size(sourcePath, error);
+        if (error)
+            return false;
+        time = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+        return !error;
+    }
+
+    static std::string toHex(uint64_t value) {
+        std::ostringstream stream;
+        stream << std::hex << std::setw(16) << std::setfill('0') << value;
+        return stream.str();
+    }
+
+    AssetDatabase::AssetDatabase() {
+        AssetCooker modelCooker;
+        modelCooker.version = model_cooker::COOKED_MODEL_VERSION;
+        modelCooker.extension = model_cooker::COOKED_MODEL_EXTENSION;
+        modelCooker.defaultSettings = nlohmann::json::object();
+        // Importing with Assimp is what we want to avoid, so the models are cooked the first time they are loaded
+        modelCooker.cookOnLoad = true;
+        modelCooker.cook = [](const std::string& sourcePath, const nlohmann::json&, const std::string& outputPath) {
+            return model_cooker::cookFile(sourcePath, outputPath);
+        };
+        registerCooker("model", std::move(modelCooker));
+
+        AssetCooker textureCooker;
+        textureCooker.version = texture_cooker::COOKED_TEXTURE_VERSION;
+        textureCooker.extension = texture_cooker::COOKED_TEXTURE_EXTENSION;
+        textureCooker.defaultSettings = {{"format", "auto"}, {"mips", true}};
+        // Block compressing a large texture takes longer than decoding it, so they are cooked offline by default
+        textureCooker.cookOnLoad = false;
+        textureCooker.cook = texture_cooker::cookFile;
+        registerCooker("texture", std::move(textureCooker));
+    }
+
+    AssetDatabase::~AssetDatabase() { saveManifest(); }
+
+    std::string AssetDatabase::getKey(const std::string& type, const std::string& sourcePath) {
+        return type + ":" + std::filesystem::path(sourcePath).lexically_normal().generic_string();
+    }
+
+    std::string AssetDatabase::getOutputPath(const std::string& type, const std::string& key,
+                                             const std::string& sourcePath, const AssetCooker& cooker) const {
+        // The name of the source keeps the cache readable, the hash of the key keeps it unique
+        std::filesystem::path output = std::filesystem::path(cacheDirectory) / type /
+                                       (std::filesystem::path(sourcePath).stem().string() + "-" +
+                                        toHex(hashBytes(key.data(), key.size())) + cooker.extension);
+        return output.generic_string();
+    }
+
+    std::string AssetDatabase::getManifestPath() const {
+        return (std::filesystem::path(cacheDirectory) / MANIFEST_NAME).string();
+    }
+
+    void AssetDatabase::loadManifest() {
+        loaded = true;
+        entries.clear();
+        // The manifest is written by the game itself, so a copy in a pack would always be outdated
+        FileView file = FileSystem::getInstance().openFromDisk(getManifestPath());
+        // A missing manifest is not an error, everything is simply cooked again
+        if (!file)
+            return;
+        nlohmann::json manifest = nlohmann::json::parse(file.asChars(), file.asChars() + file.size(), nullptr, false);
+        if (!manifest.is_object() || manifest.value("version", 0u) != MANIFEST_VERSION ||
+            !manifest["entries"].is_object()) {
+            std::cerr << "[AssetDatabase] Invalid or outdated manifest, everything will be cooked again: "
+                      << getManifestPath() << std::endl;
+            return;
+        }
+        for (auto& [key, item] : manifest["entries"].items()) {
+            if (!item.is_object())
+                continue;
+            Entry entry;
+            entry.type = item.value("type", "");
+            entry.source = item.value("source", "");
+            entry.output = item.value("output", "");
+            entry.sourceSize = item.value("sourceSize", uint64_t(0));
+            entry.sourceTime = item.value("sourceTime", int64_t(0));
+            entry.sourceHash = item.value("sourceHash", uint64_t(0));
+            entry.settings = item.value("settings", nlohmann::json::object());
+            entry.settingsHash = item.value("settingsHash", uint64_t(0));
+            entry.version = item.value("version", 0u);
+            entries[key] = std::move(entry);
+        }
+    }
+
+    void AssetDatabase::writeManifest() {
+        manifestChanged = false;
+        nlohmann::json manifestEntries = nlohmann::json::object();
+        for (const auto& [key, entry] : entries) {
+            manifestEntries[key] = {
+                {"type", entry.type},
+                {"source", entry.source},
+                {"output", entry.output},
+                {"sourceSize", entry.sourceSize},
+                {"sourceTime", entry.sourceTime},
+                {"sourceHash", entry.sourceHash},
+                {"settings", entry.settings},
+                {"settingsHash", entry.settingsHash},
+                {"version", entry.version},
+            };
+        }
+        nlohmann::json manifest = {{"version", MANIFEST_VERSION}, {"entries", std::move(manifestEntries)}};
+
+        // Written next to the manifest then renamed, so a crash never leaves a truncated manifest behind
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+        std::string path = getManifestPath();
+        std::string temporaryPath = FileSystem::getTemporaryPath(path);
+        {
+            std::ofstream file(temporaryPath);
+            file << manifest.dump(1, '\t');
+            if (!file) {
+                std::cerr << "[AssetDatabase] ERROR: Couldn't write the manifest: " << temporaryPath << std::endl;
+                return;
+            }
+        }
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+            std::cerr << "[AssetDatabase] ERROR: Couldn't write the manifest: " << path << std::endl;
+    }
+
+    AssetDatabase::Freshness AssetDatabase::getFreshness(const Entry& entry, const AssetCooker& cooker,
+                                                         uint64_t settingsHash, int64_t& sourceTime) const {
+        if (entry.version != cooker.version || entry.settingsHash != settingsHash)
+            return Freshness::OUTDATED;
+        // The output may be in a pack (when the game is shipped without its sources)
+        if (!FileSystem::getInstance().exists(entry.output))
+            return Freshness::OUTDATED;
+
+        uint64_t size;
+        // If the source is missing, the cooked file is all we have
+        if (!getSourceStamp(entry.source, size, sourceTime))
+            return Freshness::UP_TO_DATE;
+        if (size != entry.sourceSize)
+            return Freshness::OUTDATED;
+        return sourceTime == entry.sourceTime ? Freshness::UP_TO_DATE : Freshness::UNKNOWN;
+    }
+
+    nlohmann::json AssetDatabase::getSettings(const std::string& key, const AssetCooker& cooker,
+                                              const nlohmann::json& settings) const {
+        nlohmann::json result = cooker.defaultSettings.is_object() ? cooker.defaultSettings : nlohmann::json::object();
+        if (auto it = entries.find(key); it != entries.end() && it->second.settings.is_object())
+            result.update(it->second.settings);
+        if (settings.is_object())
+            result.update(settings);
+        return result;
+    }
+
+    AssetDatabase::CookResult AssetDatabase::cook(const std::string& type, const std::string& sourcePath,
+                                                  const nlohmann::json& settings, bool force, bool allowCooking) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!loaded)
+            loadManifest();
+        auto cookerIt = cookers.find(type);
+        if (cookerIt == cookers.end()) {
+            std::cerr << "[AssetDatabase] ERROR: No cooker for assets of type: " << type << std::endl;
+            return {};
+        }
+        const AssetCooker cooker = cookerIt->second;
+
+        // If another thread is cooking the same source, its output is what we need
+        std::string key = getKey(type, sourcePath);
+        cookFinished.wait(lock, [&]() { return cooking.count(key) == 0; });
+
+        nlohmann::json cookSettings = getSettings(key, cooker, settings);
+        std::string dumpedSettings = cookSettings.dump();
+        uint64_t settingsHash = hashBytes(dumpedSettings.data(), dumpedSettings.size());
+        // The key is claimed while the source is hashed or cooked without the lock, so only the threads that need
+        // the same output wait for it
+        bool claimed = false;
+        auto release = [&]() {
+            if (!claimed)
+                return;
+            cooking.erase(key);
+            cookFinished.notify_all();
+        };
+        auto it = entries.find(key);
+        if (!force && it != entries.end()) {
+            int64_t sourceTime = 0;
+            Freshness freshness = getFreshness(it->second, cooker, settingsHash, sourceTime);
+            if (freshness == Freshness::UNKNOWN) {
+                std::string source = it->second.source;
+                uint64_t sourceHash = it->second.sourceHash;
+                statistics.hashed++;
+                cooking.insert(key);
+                claimed = true;
+                lock.unlock();
+                uint64_t hash;
+                bool unchanged = hashFile(source, hash) && hash == sourceHash;
+                lock.lock();
+                // The entry may have been invalidated in the meantime
+                it = entries.find(key);
+                freshness = unchanged && it != entries.end() ? Freshness::UP_TO_DATE : Freshness::OUTDATED;
+                if (freshness == Freshness::UP_TO_DATE) {
+                    // Only the modification time changed (e.g. after a checkout), remember it to skip the hash next time
+                    it->second.sourceTime = sourceTime;
+                    manifestChanged = true;
+                }
+            }
+            if (freshness == Freshness::UP_TO_DATE) {
+                statistics.upToDate++;
+                release();
+                return {CookStatus::UP_TO_DATE, it->second.output};
+            }
+        }
+        if (!force && it == entries.end()) {
+            // The shipped game has neither the manifest nor the sources, only the outputs in its packs
+            std::string output = getOutputPath(type, key, sourcePath, cooker);
+            uint64_t sourceSize;
+            int64_t sourceTime;
+            if (!getSourceStamp(sourcePath, sourceSize, sourceTime) && FileSystem::getInstance().exists(output)) {
+                statistics.upToDate++;
+                return {CookStatus::UP_TO_DATE, output};
+            }
+        }
+        if (!allowCooking) {
+            release();
+            return {};
+        }
+
+        Entry entry;
+        entry.type = type;
+        entry.source = std::filesystem::path(sourcePath).lexically_normal().generic_string();
+        if (it != entries.end()) {
+            entry.output = it->second.output;
+        } else {
+            entry.output = getOutputPath(type, key, sourcePath, cooker);
+        }
+        entry.settings = cookSettings;
+        entry.settingsHash = settingsHash;
+        entry.version = cooker.version;
+        // The source is stamped before it is cooked, so a change made during the cook is caught next time
+        if (!getSourceStamp(sourcePath, entry.sourceSize, entry.sourceTime)) {
+            std::cerr << "[AssetDatabase] ERROR: Source not found: " << sourcePath << std::endl;
+            release();
+            return {};
+        }
+
+        cooking.insert(key);
+        claimed = true;
+        lock.unlock();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(entry.output).parent_path(), error);
+        // Cooked next to the output then renamed, so a failed cook never replaces a valid output and the loaders that
+        // still map the old output keep reading it (rewriting it in place would crash them)
+        std::string temporaryPath = FileSystem::getTemporaryPath(entry.output);
+        bool cooked = hashFile(sourcePath, entry.sourceHash) && cooker.cook(sourcePath, cookSettings, temporaryPath);
+        if (cooked) {
+            std::filesystem::rename(temporaryPath, entry.output, error);
+            cooked = !error;
+        }
+        if (!cooked)
+            std::filesystem::remove(temporaryPath, error);
+        auto milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        lock.lock();
+        CookResult result;
+        if (cooked) {
+            std::cout << "[AssetDatabase] Cooked " << sourcePath << " -> " << entry.output << " in " << milliseconds
+                      << " ms" << std::endl;
+            result = {CookStatus::COOKED, entry.output};
+            entries[key] = std::move(entry);
+            statistics.cooked++;
+        } else {
+            std::cerr << "[AssetDatabase] ERROR: Failed to cook: " << sourcePath << std::endl;
+            entries.erase(key);
+        }
+        manifestChanged = true;
+        release();
+        return result;
+    }
+
+    void AssetDatabase::configure(const nlohmann::json& config) {
+        if (!config.is_object())
+            return;
+        if (config.contains("cache"))
+            setCacheDirectory(config["cache"].get<std::string>());
+        if (config.contains("cook-on-load") && config["cook-on-load"].is_object())
+            for (auto& [type, value] : config["cook-on-load"].items())
+                setCookOnLoad(type, value.get<bool>());
+    }
+
+    void AssetDatabase::setCacheDirectory(const std::string& directory) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (directory == cacheDirectory)
+            return;
+        // The changes belong to the manifest of the previous directory
+        if (manifestChanged)
+            writeManifest();
+        cacheDirectory = directory;
+        entries.clear();
+        loaded = false;
+    }
+
+    void AssetDatabase::registerCooker(const std::string& type, AssetCooker cooker) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cookers[type] = std::move(cooker);
+    }
+
+    bool AssetDatabase::hasCooker(const std::string& type) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cookers.count(type) != 0;
+    }
+
+    void AssetDatabase::setCookOnLoad(const std::string& type, bool cookOnLoad) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto it = cookers.find(type); it != cookers.end())
+            it->second.cookOnLoad = cookOnLoad;
+        else
+            std::cerr << "[AssetDatabase] WARNING: No cooker for assets of type: " << type << std::endl;
+    }
+
+    std::string AssetDatabase::getCookedPath(const std::string& type, const std::string& sourcePath) {
+        bool cookOnLoad;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cookers.find(type);
+            if (it == cookers.end())
+                return "";
+            cookOnLoad = it->second.cookOnLoad;
+        }
+        return cook(type, sourcePath, nlohmann::json::object(), false, cookOnLoad).outputPath;
+    }
+
+    AssetDatabase::CookResult AssetDatabase::cook(const std::string& type, const std::string& sourcePath,
+                                                  const nlohmann::json& settings, bool force) {
+        return cook(type, sourcePath, settings, force, true);
+    }
+
+    void AssetDatabase::invalidate(const std::string& type, const std::string& sourcePath) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!loaded)
+            loadManifest();
+        if (entries.erase(getKey(type, sourcePath)))
+            manifestChanged = true;
+    }
+
+    void AssetDatabase::saveManifest() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (manifestChanged)
+            writeManifest();
+    }
+
+    AssetDatabase::Statistics AssetDatabase::getStatistics() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Statistics result = statistics;
+        result.entries = entries.size();
+        return result;
+    }
+
+    uint64_t AssetDatabase::hashBytes(const void* data, size_t size, uint64_t hash) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool AssetDatabase::hashFile(const std::string& path, uint64_t& hash) {
+        // Hashed in place in the mapped file
+        FileView file = FileSystem::getInstance().open(path);
+        if (!file)
+            return false;
+        hash = hashBytes(file.data(), file.size());
+        return true;
+    }
+
+}
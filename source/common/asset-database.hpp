@@ -0,0 +1,143 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace our {
+
+    // Converts a source file into a cooked file. On failure, an error is printed and false is returned.
+    using AssetCookFunction =
+        std::function<bool(const std::string& sourcePath, const nlohmann::json& settings, const std::string& outputPath)>;
+
+    struct AssetCooker {
+        // Increase it whenever the cooked format or the cooking itself changes so every output is cooked again
+        uint32_t version = 0;
+        std::string extension;          // The extension of the cooked files
+        nlohmann::json defaultSettings; // The settings used when nothing else is specified (an object)
+        // Whether the runtime cooks the missing or outdated outputs when it loads them (otherwise it only uses the
+        // outputs that are already up to date and loads the source when there is none)
+        bool cookOnLoad = false;
+        AssetCookFunction cook;
+    };
+
+    // The asset database knows which cooked file belongs to which source file and whether it is still up to date.
+    // For every cooked source it remembers the size, modification time and content hash of the source, the hash of
+    // the cook settings and the version of the cooker, and only cooks again when one of them changed.
+    // The size and modification time are compared first, the source is only hashed when they don't match (so a
+    // checkout that only touches the modification times doesn't re-cook anything).
+    // The cooked files are stored in a cache directory and the manifest ("assets.json") is stored next to them.
+    // The manifest is only read from the disk, a shipped game without it (nor the sources) finds the outputs in the
+    // packs by their path.
+    // The lookups only mark the manifest as changed, it is written once at the end of a batch (see saveManifest).
+    // It is used by the "supercold-cook" tool and by the runtime (through getCookedPath), and it is thread safe so
+    // the assets can be cooked and looked up from worker threads. Nothing in here depends on OpenGL.
+    class AssetDatabase {
+    public:
+        enum class CookStatus { UP_TO_DATE, COOKED, FAILED };
+        // UNKNOWN: only the modification time of the source changed, its content hash decides
+        enum class Freshness { UP_TO_DATE, OUTDATED, UNKNOWN };
+
+        struct CookResult {
+            CookStatus status = CookStatus::FAILED;
+            std::string outputPath;
+        };
+
+        struct Statistics {
+            size_t entries = 0;  // The sources that have a cooked output
+            size_t cooked = 0;   // The outputs cooked since the start
+            size_t upToDate = 0; // The lookups that found an up to date output
+            size_t hashed = 0;   // The sources that had to be hashed
+        };
+
+    private:
+        struct Entry {
+            std::string type, source, output;
+            uint64_t sourceSize = 0;
+            int64_t sourceTime = 0;
+            uint64_t sourceHash = 0;
+            nlohmann::json settings;
+            uint64_t settingsHash = 0;
+            uint32_t version = 0;
+        };
+
+        mutable std::mutex mutex;
+        // Signaled whenever a cook finishes, so the threads that need the same output can wait for it
+        std::condition_variable cookFinished;
+        std::string cacheDirectory = "cache";
+        bool loaded = false;
+        // Whether the entries changed since the manifest was last written
+        bool manifestChanged = false;
+        std::unordered_map<std::string, AssetCooker> cookers;
+        // Type + normalized source path -> entry
+        std::unordered_map<std::string, Entry> entries;
+        // The entries being cooked right now
+        std::unordered_set<std::string> cooking;
+        Statistics statistics;
+
+        AssetDatabase();
+        ~AssetDatabase();
+        AssetDatabase(const AssetDatabase&) = delete;
+        AssetDatabase& operator=(const AssetDatabase&) = delete;
+
+        static std::string getKey(const std::string& type, const std::string& sourcePath);
+        // Where the output of a source goes the first time it is cooked
+        std::string getOutputPath(const std::string& type, const std::string& key, const std::string& sourcePath,
+                                  const AssetCooker& cooker) const;
+        std::string getManifestPath() const;
+        // Both must be called with the mutex locked
+        void loadManifest();
+        void writeManifest();
+        // Checks the entry against the stamp of its source and its cooker without reading the source. If it returns
+        // UNKNOWN, "sourceTime" is the new modification time of the source. Must be called with the mutex locked
+        Freshness getFreshness(const Entry& entry, const AssetCooker& cooker, uint64_t settingsHash,
+                               int64_t& sourceTime) const;
+        // Returns the settings of an entry: the given ones over the ones it was cooked with over the defaults
+        nlohmann::json getSettings(const std::string& key, const AssetCooker& cooker, const nlohmann::json& settings) const;
+        CookResult cook(const std::string& type, const std::string& sourcePath, const nlohmann::json& settings,
+                        bool force, bool allowCooking);
+
+    public:
+        static AssetDatabase& getInstance() {
+            static AssetDatabase instance;
+            return instance;
+        }
+
+        // Reads the "cache" directory and the "cook-on-load" flags of each type from the configuration
+        void configure(const nlohmann::json& config);
+        // Changes the cache directory (and forgets the manifest of the previous one)
+        void setCacheDirectory(const std::string& directory);
+        const std::string& getCacheDirectory() const { return cacheDirectory; }
+
+        // Registers (or replaces) the cooker of a type of asset ("model" and "texture" are registered by default)
+        void registerCooker(const std::string& type, AssetCooker cooker);
+        bool hasCooker(const std::string& type) const;
+        void setCookOnLoad(const std::string& type, bool cookOnLoad);
+
+        // Returns the path of the up to date cooked version of the source, or an empty string if there is none.
+        // If the output is missing or outdated and the cooker cooks on load, the source is cooked first (with the
+        // settings it was last cooked with). If the source is missing, the cooked file is all we have so it is used.
+        std::string getCookedPath(const std::string& type, const std::string& sourcePath);
+        // Cooks the source if its output is missing or outdated (or always if "force" is true).
+        // The given settings are applied over the ones the source was last cooked with (or the cooker defaults).
+        CookResult cook(const std::string& type, const std::string& sourcePath,
+                        const nlohmann::json& settings = nlohmann::json::object(), bool force = false);
+        // Forgets the output of the source (e.g. if it turned out to be corrupted), it is cooked again on next use
+        void invalidate(const std::string& type, const std::string& sourcePath);
+        // Writes the manifest if the entries changed since it was last written (also done on exit)
+        void saveManifest();
+
+        Statistics getStatistics() const;
+
+        // 64-bit FNV-1a hashes
+        static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+        // Returns false if the file can't be read
+        static bool hashFile(const std::string& path, uint64_t& hash);
+    };
+
+}
@@ -0,0 +1,151 @@
+#include "asset-job-graph.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace our {
+
+    static double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    AssetJobGraph::~AssetJobGraph() {
+        // Make the pending tasks return right away
+        nextCpuJob.store(cpuJobs.size());
+        tasks.wait();
+    }
+
+    AssetJobGraph::JobId AssetJobGraph::add(const std::string& name, CpuStage cpu, UploadStage upload,
+                                            const std::vector<JobId>& dependencies) {
+        if (started) {
+            std::cerr << "[AssetJobGraph] ERROR: Job '" << name << "' was added after the graph started" << std::endl;
+            return jobs.size();
+        }
+        auto job = std::make_unique<Job>();
+        job->name = name;
+        job->cpu = std::move(cpu);
+        job->upload = std::move(upload);
+        for (JobId dependency : dependencies) {
+            if (dependency < jobs.size())
+                job->dependencies.push_back(dependency);
+            else
+                std::cerr << "[AssetJobGraph] ERROR: Job '" << name << "' depends on a job that was not added yet"
+                          << std::endl;
+        }
+        jobs.push_back(std::move(job));
+        return jobs.size() - 1;
+    }
+
+    bool AssetJobGraph::runNextCpuStage() {
+        size_t index = nextCpuJob.fetch_add(1);
+        if (index >= cpuJobs.size())
+            return false;
+        Job* cpuJob = cpuJobs[index];
+        auto cpuStart = std::chrono::high_resolution_clock::now();
+        try {
+            cpuJob->cpuSucceeded = cpuJob->cpu();
+        } catch (const std::exception& e) {
+            std::cerr << "[AssetJobGraph] ERROR: Failed to load '" << cpuJob->name << "': " << e.what() << std::endl;
+            cpuJob->cpuSucceeded = false;
+        }
+        cpuJob->cpuMilliseconds = millisecondsSince(cpuStart);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cpuJob->cpuDone.store(true, std::memory_order_release);
+            cpuFinishedCount++;
+        }
+        cpuFinished.notify_one();
+        return true;
+    }
+
+    void AssetJobGraph::start() {
+        if (started)
+            return;
+        started = true;
+        startTime = std::chrono::high_resolution_clock::now();
+        remaining = jobs.size();
+        for (auto& job : jobs) {
+            if (job->cpu)
+                cpuJobs.push_back(job.get());
+            else
+                job->cpuDone.store(true, std::memory_order_release);
+        }
+        for (size_t i = 0; i < cpuJobs.size(); i++)
+            tasks.run([this]() { runNextCpuStage(); });
+    }
+
+    bool AssetJobGraph::uploadNextJob() {
+        // Since the dependencies of a job were added before it, the first job that is not uploaded yet only waits
+        // for its own cpu stage, so there is always progress
+        for (auto& job : jobs) {
+            if (job->uploaded || !job->cpuDone.load(std::memory_order_acquire))
+                continue;
+            bool ready = std::all_of(job->dependencies.begin(), job->dependencies.end(),
+                                     [this](JobId dependency) { return jobs[dependency]->uploaded; });
+            if (!ready)
+                continue;
+            if (job->cpuSucceeded && job->upload) {
+                auto uploadStart = std::chrono::high_resolution_clock::now();
+                job->upload();
+                job->uploadMilliseconds = millisecondsSince(uploadStart);
+            }
+            job->uploaded = true;
+            remaining--;
+            return true;
+        }
+        return false;
+    }
+
+    bool AssetJobGraph::pump(double budgetMilliseconds) {
+        if (!started)
+            start();
+        bool blocking = budgetMilliseconds == std::numeric_limits<double>::infinity();
+        auto pumpStart = std::chrono::high_resolution_clock::now();
+        while (remaining > 0) {
+            if (!blocking && millisecondsSince(pumpStart) >= budgetMilliseconds)
+                return false;
+
+            size_t seenCpuFinishedCount;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                seenCpuFinishedCount = cpuFinishedCount;
+            }
+            if (uploadNextJob())
+                continue;
+            if (!blocking)
+                return false;
+            if (!runNextCpuStage()) {
+                // All the remaining cpu stages are already running on workers
+                std::unique_lock<std::mutex> lock(mutex);
+                cpuFinished.wait(lock, [&]() { return cpuFinishedCount != seenCpuFinishedCount; });
+            }
+        }
+        finish();
+        return true;
+    }
+
+    void AssetJobGraph::run() {
+        start();
+        pump();
+    }
+
+    void AssetJobGraph::finish() {
+        started = false;
+        if (jobs.empty())
+            return;
+        tasks.wait();
+
+        double cpuMilliseconds = 0, uploadMilliseconds = 0;
+        for (const auto& job : jobs) {
+            cpuMilliseconds += job->cpuMilliseconds;
+            uploadMilliseconds += job->uploadMilliseconds;
+        }
+        std::cout << "[AssetJobGraph] Loaded " << jobs.size() << " jobs in " << millisecondsSince(startTime)
+                  << " ms (sequential: " << cpuMilliseconds + uploadMilliseconds << " ms, " << cpuMilliseconds
+                  << " ms of CPU work, " << uploadMilliseconds << " ms of uploads)" << std::endl;
+        jobs.clear();
+        cpuJobs.clear();
+        nextCpuJob.store(0);
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <tbb/task_group.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // Runs the asset loading jobs of a level with as much overlap as possible.
+    // Each job has two optional stages:
+    //  - "cpu": runs on a TBB worker (file reading, parsing, decoding, ...). It must not touch OpenGL/OpenAL or the
+    //    asset maps. It returns false on failure, in which case the upload stage is skipped.
+    //  - "upload": runs on the thread calling "run"/"pump" (the OpenGL thread) once the cpu stage of the job is done
+    //    and all the jobs it depends on are uploaded. This is where the GL objects are created and the assets registered.
+    // All the cpu stages start right away, so the loading time becomes the critical path of the graph instead of
+    // the sum of all the jobs.
+    class AssetJobGraph {
+    public:
+        using JobId = size_t;
+        using CpuStage = std::function<bool()>;
+        using UploadStage = std::function<void()>;
+
+        AssetJobGraph() = default;
+        AssetJobGraph(const AssetJobGraph&) = delete;
+        AssetJobGraph& operator=(const AssetJobGraph&) = delete;
+        // Waits for the cpu stages that are already running (the ones that did not start yet are dropped)
+        ~AssetJobGraph();
+
+        // Adds a job, the dependencies must be jobs that were already added (so the graph can't have cycles).
+        // Jobs can't be added while the graph is running.
+        JobId add(const std::string& name, CpuStage cpu, UploadStage upload, const std::vector<JobId>& dependencies = {});
+
+        // Starts the cpu stages on the workers
+        void start();
+        // Uploads the jobs that are ready until the time budget runs out and returns true once all the jobs are uploaded.
+        // With a finite budget, it never blocks and never runs a cpu stage itself, so it can be called every frame
+        // while the game is running. With an infinite budget, it only returns once everything is uploaded and helps
+        // with the cpu stages when no upload is ready (so the graph still progresses if there are no free workers).
+        bool pump(double budgetMilliseconds = std::numeric_limits<double>::infinity());
+        // Runs all the jobs and returns once all of them are uploaded, then the graph is empty again
+        void run();
+
+        size_t getJobCount() const { return jobs.size(); }
+        // The number of jobs that were not uploaded yet
+        size_t getRemainingJobCount() const { return remaining; }
+        bool isStarted() const { return started; }
+        // True once all the jobs are uploaded (or if there are no jobs)
+        bool isFinished() const { return jobs.empty(); }
+
+    private:
+        struct Job {
+            std::string name;
+            CpuStage cpu;
+            UploadStage upload;
+            std::vector<JobId> dependencies;
+            std::atomic<bool> cpuDone = false;
+            bool cpuSucceeded = true;
+            bool uploaded = false;
+            double cpuMilliseconds = 0, uploadMilliseconds = 0;
+        };
+        std::vector<std::unique_ptr<Job>> jobs;
+
+        // The cpu stages are claimed in submission order by the workers (and by "pump" when it may block)
+        std::vector<Job*> cpuJobs;
+        std::atomic<size_t> nextCpuJob = 0;
+        // The workers count the finished cpu stages so a blocking "pump" can sleep until one finishes
+        std::mutex mutex;
+        std::condition_variable cpuFinished;
+        size_t cpuFinishedCount = 0;
+        tbb::task_group tasks;
+
+        bool started = false;
+        size_t remaining = 0;
+        std::chrono::high_resolution_clock::time_point startTime;
+
+        // Runs the next cpu stage that no one claimed yet, returns false if there is none left
+        bool runNextCpuStage();
+        // Uploads the first job that is ready (in submission order), returns false if there is none
+        bool uploadNextJob();
+        // Prints the timings and empties the graph
+        void finish();
+    };
+
+}
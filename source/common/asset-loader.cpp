@@ -1,8 +1,11 @@
 #include "asset-loader.hpp"
 #include <iostream>
 #include "shader/shader.hpp"
+#include "shader/shader-permutations.hpp"
 #include "texture/texture2d.hpp"
 #include "texture/texture-utils.hpp"
+#include "texture/async-texture-loader.hpp"
+#include "texture/texture-cache.hpp"
 #include "texture/sampler.hpp"
 #include "mesh/mesh.hpp"
 #include "mesh/mesh-utils.hpp"
@@ -11,6 +14,7 @@
 #include "audio/audio-buffer.hpp"
 #include "audio/audio-utils.hpp"
 #include "model/model.hpp"
+#include "asset-database.hpp"
 
 namespace our
 {
@@ -18,6 +22,8 @@ namespace our
     // This will load all the shaders defined in "data"
     // data must be in the form:
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
+    // A shader can also have "defines" (an array of "NAME" or "NAME=VALUE") that apply to both stages
+    // The shaders are registered in ShaderPermutations so the materials can ask for their permutations
     template <>
     void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json &data)
     {
@@ -25,17 +31,40 @@ namespace our
         {
             for (auto &[name, desc] : data.items())
             {
-                std::string vsPath = desc.value("vs", "");
-                std::string fsPath = desc.value("fs", "");
                 auto shader = new ShaderProgram();
-                shader->attach(vsPath, GL_VERTEX_SHADER);
-                shader->attach(fsPath, GL_FRAGMENT_SHADER);
+                ShaderPermutations::attachStages(*shader, desc);
+                uint64_t sourceHash = shader->getSourceHash();
                 shader->link();
                 assets[name] = shader;
+                ShaderPermutations::getInstance().add(name, shader, desc, sourceHash);
             }
         }
     };
 
+    // The permutations of a shader are deleted with it
+    template <>
+    void AssetLoader<ShaderProgram>::remove(const std::string &name)
+    {
+        ShaderPermutations::getInstance().remove(name);
+        if (auto it = assets.find(name); it != assets.end())
+        {
+            delete it->second;
+            assets.erase(it);
+        }
+    }
+
+    template <>
+    void AssetLoader<ShaderProgram>::clear()
+    {
+        ShaderPermutations::getInstance().clear();
+        for (auto &[name, shader] : assets)
+            delete shader;
+        assets.clear();
+    }
+
+    // The textures are owned by the texture cache, this keeps the handles of the textures loaded as assets
+    static std::unordered_map<std::string, std::shared_ptr<Texture2D>> textureHandles;
+
     // This will load all the textures defined in "data"
     // data must be in the form:
     //    { texture_name : "path/to/image", ... }
@@ -49,16 +78,85 @@ namespace our
                 std::string path = desc.get<std::string>();
                 std::string extension = path.substr(path.find_last_of(".") + 1);
                 std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+                // The images are decoded on worker threads and uploaded when "deserializeAllAssets" finishes
+                // (".ctex" files are handled by loadImage since they are their own up to date cooked version)
+                std::shared_ptr<Texture2D> texture;
                 if (extension == "hdr"){
-                    assets[name] = texture_utils::loadHDR(path);
+                    texture = TextureCache::getInstance().loadHDR(path);
                 }
                 else{
-                    assets[name] = texture_utils::loadImage(path);
+                    texture = TextureCache::getInstance().loadImage(path);
                 }
+                if (!texture) {
+                    std::cerr << "[AssetLoader] ERROR: Texture '" << name << "' couldn't be loaded from " << path
+                              << std::endl;
+                    continue;
+                }
+                textureHandles[name] = texture;
+                assets[name] = texture.get();
             }
         }
     };
 
+    // Same as "deserialize" but the images are read and hashed on worker threads, only the cache lookup (and the
+    // decode scheduling) runs on the OpenGL thread
+    template <>
+    std::vector<AssetJobGraph::JobId> AssetLoader<Texture2D>::schedule(const std::string&, const nlohmann::json &data,
+                                                                       AssetJobGraph &graph,
+                                                                       const std::vector<AssetJobGraph::JobId> &dependencies)
+    {
+        std::vector<AssetJobGraph::JobId> jobs;
+        if (data.is_object())
+        {
+            for (auto &[name, desc] : data.items())
+            {
+                std::string assetName = name;
+                std::string path = desc.get<std::string>();
+                std::string extension = path.substr(path.find_last_of(".") + 1);
+                std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+                // HDR images are only identified by their path so there is nothing to hash
+                bool hdr = extension == "hdr";
+                auto image = std::make_shared<TextureCache::PreparedImage>();
+                jobs.push_back(graph.add(path,
+                    [path, hdr, image]() {
+                        if (!hdr)
+                            *image = TextureCache::prepareImage(path);
+                        return true;
+                    },
+                    [assetName, path, hdr, image]() {
+                        std::shared_ptr<Texture2D> texture = hdr ? TextureCache::getInstance().loadHDR(path)
+                                                                 : TextureCache::getInstance().load(std::move(*image));
+                        if (!texture) {
+                            std::cerr << "[AssetLoader] ERROR: Texture '" << assetName << "' couldn't be loaded from "
+                                      << path << std::endl;
+                            return;
+                        }
+                        textureHandles[assetName] = texture;
+                        assets[assetName] = texture.get();
+                    },
+                    dependencies));
+            }
+        }
+        return jobs;
+    }
+
+    // The textures are shared with the models through the texture cache, so only the handles are released
+    template <>
+    void AssetLoader<Texture2D>::remove(const std::string &name)
+    {
+        assets.erase(name);
+        textureHandles.erase(name);
+        TextureCache::getInstance().collectGarbage();
+    }
+
+    template <>
+    void AssetLoader<Texture2D>::clear()
+    {
+        assets.clear();
+        textureHandles.clear();
+        TextureCache::getInstance().collectGarbage();
+    }
+
     // This will load all the samplers defined in "data"
     // data must be in the form:
     //    { sampler_name : parameters, ... }
@@ -107,6 +205,46 @@ namespace our
         }
     };
 
+    // The vertices and elements read by the CPU stage of a mesh job
+    struct MeshData {
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> elements;
+        std::vector<MeshLod> lods;
+    };
+
+    // Same as "deserialize" but the files are parsed on worker threads
+    template <>
+    std::vector<AssetJobGraph::JobId> AssetLoader<Mesh>::schedule(const std::string&, const nlohmann::json &data,
+                                                                  AssetJobGraph &graph,
+                                                                  const std::vector<AssetJobGraph::JobId> &dependencies)
+    {
+        std::vector<AssetJobGraph::JobId> jobs;
+        if (data.is_object())
+        {
+            for (auto &[name, desc] : data.items())
+            {
+                std::string assetName = name;
+                std::string path = desc.get<std::string>();
+                std::string extension  = path.substr(path.find_last_of(".") + 1);
+                std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+                if(extension != "obj" && extension != "gltf"){
+                    std::cerr << "Unsupported mesh file format: " << extension << std::endl;
+                    continue;
+                }
+                auto mesh = std::make_shared<MeshData>();
+                jobs.push_back(graph.add(path,
+                    [path, extension, mesh]() {
+                        if (extension == "obj")
+                            return mesh_utils::readOBJ(path, mesh->vertices, mesh->elements, mesh->lods);
+                        return mesh_utils::readGLTF(path, mesh->vertices, mesh->elements, mesh->lods);
+                    },
+                    [assetName, mesh]() { assets[assetName] = new Mesh(mesh->vertices, mesh->elements, mesh->lods); },
+                    dependencies));
+            }
+        }
+        return jobs;
+    }
+
     // This will load all the materials defined in "data"
     // Material deserialization depends on shaders, textures and samplers
     // so you must deserialize these 3 asset types before deserializing materials
@@ -129,6 +267,8 @@ namespace our
                 std::string type = desc.value("type", "");
                 auto material = createMaterialFromType(type);
                 material->deserialize(desc);
+                // An invalid material is still added, the errors tell what to fix
+                material->validate(name);
                 assets[name] = material;
             }
         }
@@ -161,6 +301,32 @@ namespace our
         }
     };
 
+    // Same as "deserialize" but the wav files are read on worker threads
+    template <>
+    std::vector<AssetJobGraph::JobId> AssetLoader<AudioBuffer>::schedule(
+        const std::string&, const nlohmann::json &data, AssetJobGraph &graph,
+        const std::vector<AssetJobGraph::JobId> &dependencies)
+    {
+        std::vector<AssetJobGraph::JobId> jobs;
+        if (data.is_object())
+        {
+            for (auto &[name, desc] : data.items())
+            {
+                std::string assetName = name;
+                std::string path = desc.get<std::string>();
+                auto wav = std::make_shared<audio_utils::WavData>();
+                jobs.push_back(graph.add(path,
+                    [path, wav]() {
+                        *wav = audio_utils::readWavFile(path);
+                        return true;
+                    },
+                    [assetName, wav]() { assets.try_emplace(assetName, audio_utils::createBuffer(*wav)); },
+                    dependencies));
+            }
+        }
+        return jobs;
+    }
+
     template <>
     void AssetLoader<Model>::deserialize(const nlohmann::json &data)
     {
@@ -176,31 +342,111 @@ namespace our
         }
     };
 
-    void deserializeAllAssets(const nlohmann::json &assetData)
+    // Same as "deserialize" but the models are read (or imported and cooked) on worker threads
+    template <>
+    std::vector<AssetJobGraph::JobId> AssetLoader<Model>::schedule(const std::string&, const nlohmann::json &data,
+                                                                   AssetJobGraph &graph,
+                                                                   const std::vector<AssetJobGraph::JobId> &dependencies)
+    {
+        std::vector<AssetJobGraph::JobId> jobs;
+        if (data.is_object())
+        {
+            for (auto &[name, desc] : data.items())
+            {
+                std::string assetName = name;
+                std::string path = desc.get<std::string>();
+                auto cooked = std::make_shared<model_cooker::CookedModel>();
+                auto textures = std::make_shared<Model::PreparedTextures>();
+                jobs.push_back(graph.add(path,
+                    [path, cooked, textures]() {
+                        // Like with "loadFromFile", a model that fails to load is still added (empty)
+                        if (Model::loadCookedModel(path, *cooked))
+                            Model::prepareTextures(path, *cooked, *textures);
+                        return true;
+                    },
+                    [assetName, path, cooked, textures]() {
+                        Model* model = new Model();
+                        model->createFromCookedModel(path, *cooked, std::move(*textures));
+                        assets[assetName] = model;
+                    },
+                    dependencies));
+            }
+        }
+        return jobs;
+    }
+
+    using JobIds = std::vector<AssetJobGraph::JobId>;
+
+    // Schedules the assets of the given type if "assetData" has any
+    template <typename T>
+    static JobIds scheduleAssets(const nlohmann::json &assetData, const char *type, AssetJobGraph &graph,
+                                 const JobIds &dependencies)
+    {
+        if (!assetData.contains(type))
+            return JobIds();
+        return AssetLoader<T>::schedule(type, assetData[type], graph, dependencies);
+    }
+
+    void scheduleAllAssets(const nlohmann::json &assetData, AssetJobGraph &graph)
     {
         if (!assetData.is_object())
             return;
-        if (assetData.contains("shaders"))
-            AssetLoader<ShaderProgram>::deserialize(assetData["shaders"]);
-        if (assetData.contains("textures"))
-            AssetLoader<Texture2D>::deserialize(assetData["textures"]);
-        if (assetData.contains("samplers"))
-            AssetLoader<Sampler>::deserialize(assetData["samplers"]);
-        if (assetData.contains("meshes"))
-            AssetLoader<Mesh>::deserialize(assetData["meshes"]);
-        if (assetData.contains("lights"))
-            AssetLoader<Light>::deserialize(assetData["lights"]);
-        if (assetData.contains("materials"))
-            AssetLoader<Material>::deserialize(assetData["materials"]);
-        if (assetData.contains("audio"))
-            AssetLoader<AudioBuffer>::deserialize(assetData["audio"]);
-        if (assetData.contains("models"))
-            AssetLoader<Model>::deserialize(assetData["models"]);
 
+        // Every asset type declares the asset types its uploads depend on, everything else overlaps
+        JobIds shaders = scheduleAssets<ShaderProgram>(assetData, "shaders", graph, {});
+        JobIds textures = scheduleAssets<Texture2D>(assetData, "textures", graph, {});
+        JobIds samplers = scheduleAssets<Sampler>(assetData, "samplers", graph, {});
+        scheduleAssets<Mesh>(assetData, "meshes", graph, {});
+        JobIds lights = scheduleAssets<Light>(assetData, "lights", graph, {});
+        // Materials reference shaders, textures, samplers and lights by name
+        JobIds materialDependencies = shaders;
+        materialDependencies.insert(materialDependencies.end(), lights.begin(), lights.end());
+        materialDependencies.insert(materialDependencies.end(), textures.begin(), textures.end());
+        materialDependencies.insert(materialDependencies.end(), samplers.begin(), samplers.end());
+        scheduleAssets<Material>(assetData, "materials", graph, materialDependencies);
+        scheduleAssets<AudioBuffer>(assetData, "audio", graph, {});
+        // Models create their materials with the "pbr" shader
+        scheduleAssets<Model>(assetData, "models", graph, shaders);
+    }
+
+    void deserializeAllAssets(const nlohmann::json &assetData)
+    {
+        AssetJobGraph graph;
+        scheduleAllAssets(assetData, graph);
+        graph.run();
+        // The models looked up (and maybe cooked) their outputs, the manifest is written once for all of them
+        AssetDatabase::getInstance().saveManifest();
+
+        // The textures were decoding while the other assets (and the models) were loading, upload them now
+        AsyncTextureLoader::getInstance().flush();
+    }
+
+    void removeAsset(const std::string &type, const std::string &name)
+    {
+        if (type == "shaders")
+            AssetLoader<ShaderProgram>::remove(name);
+        else if (type == "textures")
+            AssetLoader<Texture2D>::remove(name);
+        else if (type == "samplers")
+            AssetLoader<Sampler>::remove(name);
+        else if (type == "meshes")
+            AssetLoader<Mesh>::remove(name);
+        else if (type == "materials")
+            AssetLoader<Material>::remove(name);
+        else if (type == "lights")
+            AssetLoader<Light>::remove(name);
+        else if (type == "audio")
+            AssetLoader<AudioBuffer>::remove(name);
+        else if (type == "models")
+            AssetLoader<Model>::remove(name);
+        else
+            std::cerr << "[AssetLoader] ERROR: Unknown asset type '" << type << "'" << std::endl;
     }
 
     void clearAllAssets()
     {
+        // No decode may still be writing into a texture that is about to be deleted
+        AsyncTextureLoader::getInstance().flush();
         AssetLoader<ShaderProgram>::clear();
         AssetLoader<Texture2D>::clear();
         AssetLoader<Sampler>::clear();
@@ -209,6 +455,8 @@ namespace our
         AssetLoader<Light>::clear();
         AssetLoader<AudioBuffer>::clear();
         AssetLoader<Model>::clear();
+        // The models released the last handles of their textures
+        TextureCache::getInstance().collectGarbage();
     }
 
 }
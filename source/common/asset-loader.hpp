@@ -3,6 +3,7 @@
 #include <unordered_map>
 #include <string>
 #include <json/json.hpp>
+#include "asset-job-graph.hpp"
 
 namespace our {
 
@@ -21,6 +22,16 @@ namespace our {
         // For example: {"white": "textures/white.png", "polka": "textures/polka.png"} defines 2 textures
         // where the key will be asset name and the description holds the path to the texture file
         static void deserialize(const nlohmann::json&);
+        // This function adds the jobs that load the assets defined by the given json object to the graph
+        // and returns their ids (see "deserializeAllAssets"). The uploads wait for the given dependencies.
+        // The json object must stay alive until the graph runs.
+        // By default, the assets are loaded by "deserialize" in a single job on the OpenGL thread.
+        // The asset types whose loading is CPU heavy specialize it to read each asset on a worker thread.
+        static std::vector<AssetJobGraph::JobId> schedule(const std::string& type, const nlohmann::json& data,
+                                                          AssetJobGraph& graph,
+                                                          const std::vector<AssetJobGraph::JobId>& dependencies) {
+            return {graph.add(type, nullptr, [&data]() { deserialize(data); }, dependencies)};
+        }
         // This function find an asset by its name and returns a pointer to it
         // If no asset with the given name was found, the function returns a nullptr
         // WARNING: never delete the asset returned by the function.
@@ -36,6 +47,14 @@ namespace our {
         static std::unordered_map<std::string, T*>& getAll() {
             return assets;
         };
+        // This function deletes the asset with the given name (if any)
+        // WARNING: the pointers to it that were returned by "get" become invalid.
+        static void remove(const std::string& name){
+            if(auto it = assets.find(name); it != assets.end()){
+                delete it->second;
+                assets.erase(it);
+            }
+        }
         // This function deletes all the assets held by this class and clear the assets map 
         static void clear(){
             for(auto& [name, asset] : assets){
@@ -45,11 +64,26 @@ namespace our {
         }
     };
 
+    // The textures are owned by the texture cache (see "asset-loader.cpp")
+    class Texture2D;
+    template<> void AssetLoader<Texture2D>::remove(const std::string& name);
+    template<> void AssetLoader<Texture2D>::clear();
+    // The permutations of the shaders are owned by ShaderPermutations
+    class ShaderProgram;
+    template<> void AssetLoader<ShaderProgram>::remove(const std::string& name);
+    template<> void AssetLoader<ShaderProgram>::clear();
+
     // Given a json holding the data for all the assets
     // This function will call "AssetLoader<T>::deserialize" for all the different asset types T
     // For example, a json in the form {"shaders": ... , "textures": ... } will call "deserialize" for:
     // AssetLoader<ShaderProgram> and AssetLoader<Texture2D>
     void deserializeAllAssets(const nlohmann::json& assetData);
+    // This adds the jobs that load all the assets to the graph without running it (see "AssetLoader<T>::schedule")
+    // The json object must stay alive until the graph is finished.
+    void scheduleAllAssets(const nlohmann::json& assetData, AssetJobGraph& graph);
+    // This calls "AssetLoader<T>::remove" for the asset type T named by the given key of the assets json
+    // (for example: "textures" for AssetLoader<Texture2D>)
+    void removeAsset(const std::string& type, const std::string& name);
     // This will call "AssetLoader<T>::clear" for all the different asset types T
     void clearAllAssets();
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "audio-utils.hpp"
-#include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <cstdint>
@@ -28,26 +29,32 @@ struct DataSubchunk {
 };
 
 namespace our::audio_utils {
-    AudioBuffer* loadWavFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::binary);
+    WavData readWavFile(const std::string& filename) {
+        FileView file = FileSystem::getInstance().open(filename);
         if (!file) {
             throw std::runtime_error("Failed to open file: " + filename);
         }
+        // The chunks are read in place in the mapped file
+        size_t offset = 0;
+        auto read = [&](void* output, size_t size) {
+            if (file.size() - offset < size) return false;
+            std::memcpy(output, file.data() + offset, size);
+            offset += size;
+            return true;
+        };
+        auto skip = [&](size_t size) { offset += std::min(size, file.size() - offset); };
 
         // Read main header
         RiffHeader riffHeader;
-        file.read(reinterpret_cast<char*>(&riffHeader), sizeof(RiffHeader));
-        
-        if (std::string(riffHeader.chunkID, 4) != "RIFF" ||
+        if (!read(&riffHeader, sizeof(RiffHeader)) ||
+            std::string(riffHeader.chunkID, 4) != "RIFF" ||
             std::string(riffHeader.format, 4) != "WAVE") {
             throw std::runtime_error("Invalid RIFF/WAVE header in: " + filename);
         }
 
         // Read fmt subchunk
         FmtSubchunk fmtSubchunk;
-        file.read(reinterpret_cast<char*>(&fmtSubchunk), sizeof(FmtSubchunk));
-        
-        if (std::string(fmtSubchunk.subchunkID, 4) != "fmt ") {
+        if (!read(&fmtSubchunk, sizeof(FmtSubchunk)) || std::string(fmtSubchunk.subchunkID, 4) != "fmt ") {
             throw std::runtime_error("fmt subchunk not found in: " + filename);
         }
 
@@ -57,36 +64,47 @@ namespace our::audio_utils {
 
         // Skip any extra format bytes
         if (fmtSubchunk.subchunkSize > 16) {
-            file.seekg(fmtSubchunk.subchunkSize - 16, std::ios::cur);
+            skip(fmtSubchunk.subchunkSize - 16);
         }
 
         // Find data subchunk
         DataSubchunk dataSubchunk;
         while(true) {
-            file.read(reinterpret_cast<char*>(&dataSubchunk), sizeof(DataSubchunk));
+            if (!read(&dataSubchunk, sizeof(DataSubchunk))) {
+                throw std::runtime_error("data subchunk not found in: " + filename);
+            }
             if (std::string(dataSubchunk.subchunkID, 4) == "data") break;
             
             // Skip unknown chunks
-            file.seekg(dataSubchunk.subchunkSize, std::ios::cur);
+            skip(dataSubchunk.subchunkSize);
         }
 
-        // Read audio data
-        std::vector<char> audioData(dataSubchunk.subchunkSize);
-        if (!file.read(audioData.data(), dataSubchunk.subchunkSize)) {
+        // The audio data stays in the mapped file until the buffer is created
+        if (file.size() - offset < dataSubchunk.subchunkSize) {
             throw std::runtime_error("Failed to read audio data in: " + filename);
         }
 
+        WavData wav;
+        wav.samples = file.subview(offset, dataSubchunk.subchunkSize);
+        wav.format = (fmtSubchunk.numChannels == 1) ? 
+            AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+        wav.sampleRate = fmtSubchunk.sampleRate;
+        return wav;
+    }
+
+    AudioBuffer* createBuffer(const WavData& wav) {
         // Create OpenAL buffer
         ALuint buffer;
         alGenBuffers(1, &buffer);
-        
-        ALenum format = (fmtSubchunk.numChannels == 1) ? 
-            AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
 
-        alBufferData(buffer, format, audioData.data(), 
-                    static_cast<ALsizei>(audioData.size()), 
-                    fmtSubchunk.sampleRate);
+        alBufferData(buffer, wav.format, wav.samples.data(), 
+                    static_cast<ALsizei>(wav.samples.size()), 
+                    wav.sampleRate);
+
+        return new AudioBuffer(buffer, wav.format, wav.sampleRate);
+    }
 
-        return new AudioBuffer(buffer, format, fmtSubchunk.sampleRate);
+    AudioBuffer* loadWavFile(const std::string& filename) {
+        return createBuffer(readWavFile(filename));
     }
 }
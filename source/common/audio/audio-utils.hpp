@@ -3,8 +3,23 @@
 #include <AL/alc.h>
 #include <string>
 #include <memory>
+#include <vector>
 #include "audio-buffer.hpp"
+#include "file-system.hpp"
 
 namespace our::audio_utils {
+    // The decoded samples of a wav file
+    struct WavData {
+        FileView samples; // The samples in the mapped file
+        ALenum format;
+        ALsizei sampleRate;
+    };
+
+    // Reads a 16-bit PCM wav file, throws if the file is invalid
+    // It does not touch OpenAL so it can run on any thread
+    WavData readWavFile(const std::string& filename);
+    // Creates the OpenAL buffer holding the samples
+    AudioBuffer* createBuffer(const WavData& wav);
+    // Reads the wav file and creates its buffer
     AudioBuffer* loadWavFile(const std::string& filename);
 }
\ No newline at end of file
@@ -1,5 +1,10 @@
 #include "animation-component.hpp"
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include "../animation/animation-bounds.hpp"
+#include "../animation/cpu-skinning.hpp"
+#include "../animation/pose-blending.hpp"
 #include "../asset-loader.hpp"
 
 namespace our {
@@ -15,48 +20,319 @@ void AnimationComponent::initialize() {
     initialized = true;
 }
 
+// The slot is free again
+static void releaseClip(AnimationComponent::ClipState& clip) {
+    clip.player = AnimationPlayer();
+    clip.weight = 0.0f;
+    clip.fadeSpeed = 0.0f;
+}
+
 void AnimationComponent::update(float deltaTime) {
-    if (modelAsset) {
-        player.update(deltaTime);
+    if (!modelAsset) {
+        return;
+    }
+    poseEvaluated = false;
+    for (ClipState& clip : clips) {
+        if (!clip.isActive()) {
+            continue;
+        }
+        if (clip.player.isCurrentlyPlaying()) {
+            clip.player.update(deltaTime);
+        }
+        if (clip.fadeSpeed != 0.0f) {
+            clip.weight += clip.fadeSpeed * deltaTime;
+            if (clip.weight >= 1.0f) {
+                clip.weight = 1.0f;
+                clip.fadeSpeed = 0.0f;
+            } else if (clip.weight <= 0.0f) {
+                releaseClip(clip);
+            }
+        }
     }
 }
 
 bool AnimationComponent::playAnimation(const std::string& animationName, bool loop) {
-    std::cout << "[AnimationComponent] Attempting to play animation: '" << animationName << "'" << std::endl;
+    return playAnimation(internAnimationClip(animationName), loop);
+}
+
+bool AnimationComponent::playAnimation(AnimationClipId clip, bool loop) {
+    const std::string& animationName = getAnimationClipName(clip);
     if (!modelAsset) {
         std::cerr << "[AnimationComponent] Cannot play animation '" << animationName << "': modelAsset is null."
                   << std::endl;
         return false;
     }
 
-    Animation* animToPlay = nullptr;
-    for (auto& anim : modelAsset->animations) {
-        if (anim.name == animationName) {
-            animToPlay = &anim;
-            break;
+    // Binding builds the bone tracks of the clip the first time it is played
+    Animation* animToPlay = modelAsset->bindAnimation(clip);
+    if (!animToPlay) {
+        std::cerr << "[AnimationComponent] Animation '" << animationName << "' not found in model asset." << std::endl;
+        return false;
+    }
+
+    for (ClipState& state : clips) {
+        if (state.isActive() && state.layer == 0) {
+            releaseClip(state);
         }
     }
+    ClipState& state = acquireClip();
+    state.player.playAnimation(animToPlay, loop);
+    state.layer = 0;
+    state.weight = 1.0f;
+    return true;
+}
 
-    if (animToPlay) {
-        player.playAnimation(animToPlay, loop);
-        std::cout << "[AnimationComponent] Started animation: '" << animationName << "'" << std::endl;
-        return true;
-    } else {
+bool AnimationComponent::crossfade(const std::string& animationName, float fadeSeconds, bool loop, size_t layer) {
+    return crossfade(internAnimationClip(animationName), fadeSeconds, loop, layer);
+}
+
+bool AnimationComponent::crossfade(AnimationClipId clip, float fadeSeconds, bool loop, size_t layer) {
+    const std::string& animationName = getAnimationClipName(clip);
+    if (!modelAsset || layer >= layers.size()) {
+        std::cerr << "[AnimationComponent] Cannot fade to animation '" << animationName
+                  << "': modelAsset is null or the layer doesn't exist." << std::endl;
+        return false;
+    }
+    Animation* animation = modelAsset->bindAnimation(clip);
+    if (!animation) {
         std::cerr << "[AnimationComponent] Animation '" << animationName << "' not found in model asset." << std::endl;
         return false;
     }
+
+    ClipState* current = nullptr;
+    for (ClipState& state : clips) {
+        if (!state.isActive() || state.layer != layer) {
+            continue;
+        }
+        if (!current && state.player.getCurrentAnimation() == animation) {
+            current = &state;
+        } else if (fadeSeconds <= 0.0f) {
+            releaseClip(state);
+        } else {
+            state.fadeSpeed = -state.weight / fadeSeconds;
+        }
+    }
+
+    // A clip that is already on the layer fades back in from its current weight instead of restarting
+    if (current) {
+        current->fadeSpeed = fadeSeconds > 0.0f ? (1.0f - current->weight) / fadeSeconds : 0.0f;
+        if (fadeSeconds <= 0.0f) {
+            current->weight = 1.0f;
+        }
+        return true;
+    }
+
+    ClipState& state = acquireClip();
+    state.player.playAnimation(animation, loop);
+    state.layer = layer;
+    state.weight = fadeSeconds > 0.0f ? 0.0f : 1.0f;
+    state.fadeSpeed = fadeSeconds > 0.0f ? 1.0f / fadeSeconds : 0.0f;
+    if (layers[layer].mode == BlendMode::ADDITIVE) {
+        // The player is at the start of the clip
+        state.player.sampleLocalPose(modelAsset->skeleton.getLocalBindPose(), state.reference);
+    }
+    return true;
+}
+
+void AnimationComponent::fadeOutLayer(size_t layer, float fadeSeconds) {
+    for (ClipState& state : clips) {
+        if (!state.isActive() || state.layer != layer) {
+            continue;
+        }
+        if (fadeSeconds <= 0.0f) {
+            releaseClip(state);
+        } else {
+            state.fadeSpeed = -state.weight / fadeSeconds;
+        }
+    }
+}
+
+int AnimationComponent::findLayer(const std::string& name) const {
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (layers[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+AnimationComponent::ClipState& AnimationComponent::acquireClip() {
+    ClipState* lowest = &clips[0];
+    for (ClipState& state : clips) {
+        if (!state.isActive()) {
+            return state;
+        }
+        if (state.weight < lowest->weight) {
+            lowest = &state;
+        }
+    }
+    releaseClip(*lowest);
+    return *lowest;
+}
+
+size_t AnimationComponent::getActiveClipCount() const {
+    size_t count = 0;
+    for (const ClipState& state : clips) {
+        if (state.isActive()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void AnimationComponent::evaluatePose() {
+    if (!modelAsset) {
+        return;
+    }
+    const Skeleton& skeleton = modelAsset->skeleton;
+    samplePose(skeleton);
+    skeleton.evaluateLocalPose(pose);
+    poseEvaluated = true;
+}
+
+void AnimationComponent::samplePose(const Skeleton& skeleton) {
+    const std::vector<BoneTransform>& bindPose = skeleton.getLocalBindPose();
+    size_t boneCount = bindPose.size();
+    pose.resize(boneCount);
+    std::copy(bindPose.begin(), bindPose.end(), pose.localPose.begin());
+
+    for (size_t layerIndex = 0; layerIndex < layers.size(); ++layerIndex) {
+        Layer& layer = layers[layerIndex];
+        if (layer.weight <= 0.0f) {
+            continue;
+        }
+        if (!layer.maskBone.empty() && layer.mask.size() != boneCount) {
+            layer.mask = skeleton.buildBoneMask(layer.maskBone);
+        }
+        const float* mask = layer.maskBone.empty() ? nullptr : layer.mask.data();
+        // A layer that covers the whole pose is accumulated in place (over the bind pose)
+        bool inPlace = layer.mode == BlendMode::OVERRIDE && layerIndex == 0 && !mask && layer.weight >= 1.0f;
+        std::vector<BoneTransform>& accumulated = inPlace ? pose.localPose : layerPose;
+
+        // The weighted average of the clips of the layer, accumulated one clip at a time
+        float layerClipWeight = 0.0f;
+        for (ClipState& clip : clips) {
+            if (!clip.isActive() || clip.layer != layerIndex || clip.weight <= 0.0f) {
+                continue;
+            }
+            if (layer.mode == BlendMode::ADDITIVE) {
+                if (clip.reference.size() != boneCount) {
+                    continue;
+                }
+                clip.player.sampleLocalPose(bindPose, clipPose);
+                pose_blending::add(pose.localPose.data(), clipPose.data(), clip.reference.data(), boneCount,
+                                   layer.weight * clip.weight, mask);
+                continue;
+            }
+            if (layerClipWeight == 0.0f) {
+                clip.player.sampleLocalPose(bindPose, accumulated);
+            } else {
+                clip.player.sampleLocalPose(bindPose, clipPose);
+                pose_blending::blend(accumulated.data(), clipPose.data(), boneCount,
+                                     clip.weight / (layerClipWeight + clip.weight));
+            }
+            layerClipWeight += clip.weight;
+        }
+
+        if (layer.mode != BlendMode::OVERRIDE || layerClipWeight <= 0.0f) {
+            continue;
+        }
+        // The clips are averaged among themselves, their total weight fades the layer in and out over the layers
+        // below (the bind pose for the base layer, so fading out the base layer returns to it smoothly)
+        float weight = layer.weight * std::min(layerClipWeight, 1.0f);
+        if (!inPlace) {
+            pose_blending::blend(pose.localPose.data(), layerPose.data(), boneCount, weight, mask);
+        } else if (weight < 1.0f) {
+            pose_blending::blend(pose.localPose.data(), bindPose.data(), boneCount, 1.0f - weight);
+        }
+    }
+}
+
+void AnimationComponent::skinOnCpu() {
+    const std::vector<MeshRendererComponent*>& submeshes = modelAsset->getSubmeshes();
+    const std::vector<glm::mat4>& matrices = pose.finalTransforms;
+    cpuSkin.vertices.resize(submeshes.size());
+    glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < submeshes.size(); ++i) {
+        const std::vector<Vertex>& source = submeshes[i]->mesh->cpuVertices;
+        std::vector<Vertex>& skinned = cpuSkin.vertices[i];
+        skinned.resize(source.size());
+        cpu_skinning::skin(source.data(), source.size(), matrices.data(), matrices.size(), skinned.data());
+        if (skinned.empty()) {
+            continue;
+        }
+
+        // The box of the submesh is moved to the space of the model through its 8 corners
+        glm::vec3 submeshMin = skinned[0].position, submeshMax = skinned[0].position;
+        for (const Vertex& vertex : skinned) {
+            submeshMin = glm::min(submeshMin, vertex.position);
+            submeshMax = glm::max(submeshMax, vertex.position);
+        }
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec3 point((corner & 1) ? submeshMax.x : submeshMin.x, (corner & 2) ? submeshMax.y : submeshMin.y,
+                            (corner & 4) ? submeshMax.z : submeshMin.z);
+            point = glm::vec3(submeshes[i]->localToParent * glm::vec4(point, 1.0f));
+            minimum = glm::min(minimum, point);
+            maximum = glm::max(maximum, point);
+        }
+    }
+    cpuSkin.valid = minimum.x <= maximum.x;
+    cpuSkin.boundsMin = cpuSkin.valid ? minimum : glm::vec3(0.0f);
+    cpuSkin.boundsMax = cpuSkin.valid ? maximum : glm::vec3(0.0f);
+    cpuSkin.dirty = true;
+}
+
+bool AnimationComponent::getAnimatedBounds(glm::vec3& minimum, glm::vec3& maximum) const {
+    AnimationBounds bounds{glm::vec3(std::numeric_limits<float>::max()),
+                           glm::vec3(std::numeric_limits<float>::lowest())};
+    size_t blended = 0;
+    for (const ClipState& clip : clips) {
+        if (!clip.isActive() || clip.weight <= 0.0f || clip.layer >= layers.size() ||
+            layers[clip.layer].weight <= 0.0f) {
+            continue;
+        }
+        if (layers[clip.layer].mode == BlendMode::ADDITIVE) {
+            return false;
+        }
+        const Animation& animation = *clip.player.getCurrentAnimation();
+        if (animation.segmentBounds.size() != animation_bounds::SEGMENT_COUNT) {
+            return false;
+        }
+        size_t segment = animation_bounds::getSegment(animation, clip.player.getCurrentTimeInTicks());
+        size_t previous = (segment + animation_bounds::SEGMENT_COUNT - 1) % animation_bounds::SEGMENT_COUNT;
+        animation_bounds::merge(bounds, animation.segmentBounds[segment]);
+        animation_bounds::merge(bounds, animation.segmentBounds[previous]);
+        blended++;
+    }
+    if (blended == 0 || animation_bounds::isEmpty(bounds)) {
+        return false;
+    }
+    if (blended > 1) {
+        glm::vec3 margin = (bounds.maximum - bounds.minimum) * BLENDED_BOUNDS_MARGIN;
+        bounds.minimum -= margin;
+        bounds.maximum += margin;
+    }
+    minimum = bounds.minimum;
+    maximum = bounds.maximum;
+    return true;
 }
 
 void AnimationComponent::pauseAnimation() {
-    player.pause();
+    for (ClipState& state : clips) {
+        state.player.pause();
+    }
 }
 
 void AnimationComponent::resumeAnimation() {
-    player.resume();
+    for (ClipState& state : clips) {
+        state.player.resume();
+    }
 }
 
 void AnimationComponent::stopAnimation() {
-    player.stop();
+    for (ClipState& state : clips) {
+        releaseClip(state);
+    }
 }
 
 void AnimationComponent::deserialize(const nlohmann::json& data) {
@@ -66,6 +342,19 @@ void AnimationComponent::deserialize(const nlohmann::json& data) {
     initialAnimationName = data.value("initialAnimation", initialAnimationName);
     autoPlay = data.value("autoPlay", autoPlay);
 
+    // The layers over the base layer: {"name", "mode": "override" or "additive", "weight", "mask": bone name}
+    if (data.contains("layers") && data["layers"].is_array()) {
+        layers.resize(1);
+        for (const auto& layerData : data["layers"]) {
+            Layer layer;
+            layer.name = layerData.value("name", "");
+            layer.mode = layerData.value("mode", "override") == "additive" ? BlendMode::ADDITIVE : BlendMode::OVERRIDE;
+            layer.weight = layerData.value("weight", layer.weight);
+            layer.maskBone = layerData.value("mask", "");
+            layers.push_back(layer);
+        }
+    }
+
     std::string modelName = data.value("model", "");
     if (!modelName.empty()) {
         modelAsset = AssetLoader<Model>::get(modelName);
@@ -1,22 +1,82 @@
 #pragma once
 
 #include <nlohmann/json.hpp>
+#include <array>
+#include <memory>
 #include <string>
+#include <vector>
 #include "../animation/animation-player.hpp"
 #include "../ecs/component.hpp"
 #include "../model/model.hpp"
 
 namespace our {
 
+// Plays the clips of a model on one instance and blends them into its pose:
+// - Crossfades: a clip started with "crossfade" fades in while the other clips of its layer fade out.
+// - Layers: each layer blends the weighted average of its clips over the layers below it, on the bones of its mask
+//   only (e.g. an "upper body" layer firing while the base layer runs). An additive layer adds the difference
+//   between its clips and their first frame instead (e.g. breathing or recoil on top of any pose).
+//   The layers fade with the total weight of their clips, the base layer over the bind pose.
+// At most MAX_BLENDED_CLIPS clips play at once over all the layers, so the cost of an instance is bounded: starting
+// another one replaces the clip with the lowest weight.
 class AnimationComponent : public Component {
     public:
+    static constexpr size_t MAX_BLENDED_CLIPS = 4;
+    // The fraction of its size the animated bounds of a blend grow by on each side
+    static constexpr float BLENDED_BOUNDS_MARGIN = 0.25f;
+
+    enum class BlendMode { OVERRIDE, ADDITIVE };
+
+    struct Layer {
+        std::string name;
+        BlendMode mode = BlendMode::OVERRIDE;
+        float weight = 1.0f;
+        // The bone whose subtree the layer affects (all the bones if empty) and the resulting weight of each bone
+        std::string maskBone;
+        std::vector<float> mask;
+    };
+
+    struct ClipState {
+        AnimationPlayer player;
+        size_t layer = 0;
+        float weight = 0.0f;
+        float fadeSpeed = 0.0f; // Weight per second, negative while fading out (the clip stops at 0)
+        // The first frame of the clip, for the additive layers
+        std::vector<BoneTransform> reference;
+
+        bool isActive() const {
+            return player.getCurrentAnimation() != nullptr;
+        }
+    };
+
     Model* modelAsset = nullptr;
 
-    AnimationPlayer player;
+    // Layer 0 is the base layer, it is always there
+    std::vector<Layer> layers = {Layer{"base", BlendMode::OVERRIDE, 1.0f, "", {}}};
+    std::array<ClipState, MAX_BLENDED_CLIPS> clips;
+    // The pose of this instance, computed by the AnimationSystem and drawn by the renderer
+    // (the model only holds the bind skeleton, so many instances can share it)
+    AnimationPose pose;
 
     std::string initialAnimationName = "";
     bool autoPlay = true;
     bool initialized = false;
+    // The frames since the pose was last evaluated (see the animation LOD in AnimationSystem)
+    uint32_t framesSinceEvaluation = 0;
+    // The pose matches the clips (it is outdated as soon as they advance, until it is evaluated again)
+    bool poseEvaluated = false;
+
+    // The instance skinned on the CPU (see Settings::cpuSkinning): the AnimationSystem skins the vertices of every
+    // submesh of the model with the pose, the renderer uploads them to dynamic meshes drawn instead of the submeshes
+    struct CpuSkin {
+        std::vector<std::vector<Vertex>> vertices;  // One array per submesh (in the space of the submesh)
+        std::vector<std::unique_ptr<Mesh>> meshes;  // Created by the renderer (they draw the submesh elements)
+        // The bounds of the skinned vertices in the space of the model
+        glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+        bool valid = false; // The vertices match the current pose
+        bool dirty = false; // The vertices changed since the renderer uploaded them
+    };
+    CpuSkin cpuSkin;
 
     static std::string getID() {
         return "Animation";
@@ -28,13 +88,51 @@ class AnimationComponent : public Component {
 
     void update(float deltaTime);
 
+    // Starts the clip right away on the base layer (the other clips of the base layer are stopped)
     bool playAnimation(const std::string& animationName, bool loop = true);
+    // Same as above without the name lookup (see internAnimationClip)
+    bool playAnimation(AnimationClipId clip, bool loop = true);
+
+    // Fades the clip in over "fadeSeconds" while the other clips of the layer fade out.
+    // Nothing changes if the clip is already the one fading in or playing on the layer.
+    bool crossfade(AnimationClipId clip, float fadeSeconds, bool loop = true, size_t layer = 0);
+    bool crossfade(const std::string& animationName, float fadeSeconds, bool loop = true, size_t layer = 0);
+    // Fades out all the clips of the layer
+    void fadeOutLayer(size_t layer, float fadeSeconds);
+
+    // Returns the index of the layer (-1 if there is none with this name)
+    int findLayer(const std::string& name) const;
+
+    // Samples the clips and blends them into the local pose (pose.localPose), the skeleton then evaluates it
+    void samplePose(const Skeleton& skeleton);
+    // Samples the pose and evaluates it with the skeleton of the model. The AnimationSystem calls it for the
+    // instances it evaluates, the queries on the bones call it for the ones the animation LOD left behind.
+    void evaluatePose();
+
+    // Skins the vertices of the model with the current pose into "cpuSkin" (see cpu_skinning)
+    void skinOnCpu();
+
+    // The bounds of the pose in the space of the model from the bounds cooked with the clips (see animation_bounds):
+    // the union of the boxes of the current and previous segments of the clips being played, so they also hold the
+    // poses evaluated a few frames late. A blend of clips can stray out of their boxes so it is padded by
+    // BLENDED_BOUNDS_MARGIN. Returns false if a clip has no bounds, nothing plays or an additive layer is active.
+    bool getAnimatedBounds(glm::vec3& minimum, glm::vec3& maximum) const;
+
+    // The number of clips being played
+    size_t getActiveClipCount() const;
 
     void pauseAnimation();
     void resumeAnimation();
     void stopAnimation();
 
     void deserialize(const nlohmann::json& data) override;
+
+    private:
+    // Poses reused by samplePose (one clip and one layer)
+    std::vector<BoneTransform> clipPose, layerPose;
+
+    // Returns a clip slot for a new clip (a free one or the one with the lowest weight)
+    ClipState& acquireClip();
 };
 
 } // namespace our
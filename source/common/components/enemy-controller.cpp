@@ -30,5 +30,16 @@ namespace our {
         attackRange = data.value("attackRange", attackRange);
         attackCooldown = data.value("attackCooldown", attackCooldown);
         distanceToKeep = data.value("distanceToKeep", distanceToKeep);
+
+        // {"patrolling": clip name, "chasing": ..., "attacking": ..., "searching": ..., "dead": ...}
+        static const char* STATE_NAMES[ENEMY_STATE_COUNT] = {"patrolling", "chasing", "attacking", "searching", "dead"};
+        if (data.contains("animations") && data["animations"].is_object()) {
+            for (size_t i = 0; i < ENEMY_STATE_COUNT; i++) {
+                std::string clip = data["animations"].value(STATE_NAMES[i], "");
+                if (!clip.empty())
+                    stateAnimations[i] = internAnimationClip(clip);
+            }
+        }
+        animationFadeTime = data.value("animationFadeTime", animationFadeTime);
     }
 }
\ No newline at end of file
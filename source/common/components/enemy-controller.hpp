@@ -1,5 +1,7 @@
 #pragma once
 #include <ecs/component.hpp>
+#include <animation/animation-clip-id.hpp>
+#include <array>
 #include <BulletDynamics/Character/btKinematicCharacterController.h>
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
 
@@ -12,6 +14,7 @@ namespace our {
         SEARCHING,
         DEAD
     };
+    constexpr size_t ENEMY_STATE_COUNT = 5;
     
     class EnemyControllerComponent : public Component {
     public:
@@ -30,6 +33,13 @@ namespace our {
         glm::vec3 moveDirection = glm::vec3(0.0f);
         glm::vec3 lastKnownPosition = glm::vec3(0.0f);
         float stateTimer = 0.0f;
+        // The clip played in each state (none if invalid), the switches between them are crossfaded
+        std::array<AnimationClipId, ENEMY_STATE_COUNT> stateAnimations = {
+            INVALID_ANIMATION_CLIP, INVALID_ANIMATION_CLIP, INVALID_ANIMATION_CLIP, INVALID_ANIMATION_CLIP,
+            INVALID_ANIMATION_CLIP};
+        float animationFadeTime = 0.25f;
+        // The state whose clip was started last (-1 before the first)
+        int animatedState = -1;
 
         ~EnemyControllerComponent();
 
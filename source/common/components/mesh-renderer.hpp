@@ -14,6 +14,7 @@ class MeshRendererComponent : public Component {
     Mesh *mesh;              // The mesh that should be drawn
     Material *material;      // The material used to draw the mesh
     glm::mat4 localToParent; // The transformation of the entity relative to its parent
+    size_t lod = 0;          // The level of detail drawn last frame (the renderer keeps it unless the size changes enough)
 
     // The ID of this component type is "Mesh Renderer"
     static std::string getID() { return "Mesh Renderer"; }
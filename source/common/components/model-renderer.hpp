@@ -10,6 +10,8 @@ namespace our {
     class ModelComponent : public Component {
     public:
         Model* model;
+        // The level of detail drawn last frame (the renderer keeps it unless the size changes enough)
+        size_t lod = 0;
 
         // The ID of this component type is "Mesh Renderer"
         static std::string getID() { return "Model Renderer"; }
@@ -32,6 +32,7 @@ namespace our {
         shininess = data.value("shininess", 1.0f);
         position = data.value("position", glm::vec3{0.0f, 0.0f, 0.0f});
         direction = data.value("direction", glm::vec3{0.0f, 0.0f, 0.0f});
+        range = data.value("range", 0.0f);
         if(data.contains("attenuation")){
             attenuation.constant = data["attenuation"].value("constant", 0.0f);
             attenuation.linear = data["attenuation"].value("linear", 0.0f);
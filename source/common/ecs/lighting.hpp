@@ -30,7 +30,7 @@ namespace our {
             // This affects how the light will dim out as we go further from the light.
             // The formula is light_received = light_emitted / (a*d^2 + b*d + c) where a, b, c are the quadratic, linear and constant factors respectively.
             struct {
-                float constant, linear, quadratic;
+                float constant = 0.0f, linear = 0.0f, quadratic = 1.0f;
             } attenuation; // Used for Point and Spot Lights only
             // This specifies the inner and outer cone of the spot light.
             // The light power is 0 outside the outer cone, the light power is full inside the inner cone.
@@ -38,6 +38,9 @@ namespace our {
             struct {
                 float inner, outer;
             } spot_angle; // Used for Spot Lights only
+            // The distance after which the light has no effect. It is used to assign the light to the clusters it touches.
+            // If it is 0, it is derived from the light color and attenuation (see ClusteredLighting::getLightRange).
+            float range = 0.0f; // Used for Point and Spot Lights only
 
             // Deserializes the entity data and components from a json object
             void deserialize(const nlohmann::json&);
@@ -6,16 +6,19 @@ namespace our
     // This will deserialize a json array of entities and add the new entities to the current world
     // If parent pointer is not null, the new entities will be have their parent set to that given pointer
     // If any of the entities has children, this function will be called recursively for these children
-    void World::deserialize(const nlohmann::json &data, Entity *parent)
+    // Returns the entities created directly from the array (not their children)
+    std::vector<Entity *> World::deserialize(const nlohmann::json &data, Entity *parent)
     {
+        std::vector<Entity *> created;
         if (!data.is_array())
-            return;
+            return created;
         for (const auto &entityData : data)
         {
             // TODO: (Req 8) Create an entity, make its parent "parent" and call its deserialize with "entityData".
             Entity *entity = this->add();
             entity->parent = parent;
             entity->deserialize(entityData);
+            created.push_back(entity);
 
             if (entityData.contains("children"))
             {
@@ -24,6 +27,7 @@ namespace our
                 deserialize(entityData["children"], entity);
             }
         }
+        return created;
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "file-system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace our {
+
+    // The pack layout: header, table (key length, key, offset, size for each file) then the data of the files
+    static const char PACK_MAGIC[4] = {'S', 'C', 'P', 'K'};
+    static const uint32_t PACK_VERSION = 1;
+    static const uint64_t PACK_ALIGNMENT = 16;
+
+    struct PackHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t count;
+        uint32_t reserved;
+    };
+
+    FileView FileView::copy(const void* data, size_t size) {
+        auto buffer = std::make_shared<std::vector<std::byte>>(size);
+        if (size > 0)
+            std::memcpy(buffer->data(), data, size);
+        const std::byte* bytes = buffer->data();
+        return FileView(std::move(buffer), bytes, size);
+    }
+
+    FileView FileView::subview(size_t offset, size_t count) const {
+        offset = std::min(offset, length);
+        count = std::min(count, length - offset);
+        return FileView(owner, bytes + offset, count);
+    }
+
+    // Maps the whole file in memory, the mapping is released with the last view of it
+    static FileView mapFile(const std::string& path) {
+        // Mapping an empty file fails, so it gets an empty view that is still valid
+        static const std::shared_ptr<const void> emptyFile = std::make_shared<char>(0);
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return FileView();
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            return FileView();
+        }
+        if (size.QuadPart == 0) {
+            CloseHandle(file);
+            return FileView(emptyFile, nullptr, 0);
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping)
+            return FileView();
+        // The view keeps the mapping alive after its handle is closed
+        void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (!address)
+            return FileView();
+        std::shared_ptr<const void> owner(address, [](const void* address) { UnmapViewOfFile(address); });
+        return FileView(std::move(owner), static_cast<const std::byte*>(address), size_t(size.QuadPart));
+#elif defined(__unix__) || defined(__APPLE__)
+        int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+            return FileView();
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+            ::close(descriptor);
+            return FileView();
+        }
+        size_t size = size_t(info.st_size);
+        if (size == 0) {
+            ::close(descriptor);
+            return FileView(emptyFile, nullptr, 0);
+        }
+        // The mapping keeps the file alive after its descriptor is closed
+        void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if (address == MAP_FAILED)
+            return FileView();
+        std::shared_ptr<const void> owner(address, [size](const void* address) {
+            munmap(const_cast<void*>(address), size);
+        });
+        return FileView(std::move(owner), static_cast<const std::byte*>(address), size);
+#else
+        // No memory mapping on this platform, the file is read once into a buffer shared by its views
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return FileView();
+        auto buffer = std::make_shared<std::vector<std::byte>>(size_t(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer->data()), std::streamsize(buffer->size()));
+        if (!file)
+            return FileView();
+        const std::byte* bytes = buffer->data();
+        size_t size = buffer->size();
+        return FileView(std::move(buffer), bytes, size);
+#endif
+    }
+
+    std::string FileSystem::getPackKey(const std::string& path) {
+        std::filesystem::path filePath(path);
+        if (filePath.is_absolute()) {
+            std::error_code error;
+            std::filesystem::path relative = filePath.lexically_relative(std::filesystem::current_path(error));
+            if (!error && !relative.empty() && *relative.begin() != "..")
+                filePath = relative;
+        }
+        return filePath.lexically_normal().generic_string();
+    }
+
+    std::string FileSystem::getTemporaryPath(const std::string& path) {
+        // The game and the cook tool may write the same file at the same time, so the name is unique to the process
+        static const uint64_t process =
+            (uint64_t(std::random_device()()) << 32) ^
+            uint64_t(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        static std::atomic<uint64_t> counter = 0;
+        std::ostringstream stream;
+        stream << path << "." << std::hex << process << "-" << counter++ << ".tmp";
+        return stream.str();
+    }
+
+    bool FileSystem::mountPack(const std::string& path) {
+        Pack pack;
+        pack.path = path;
+        pack.file = mapFile(path);
+        if (!pack.file) {
+            std::cerr << "[FileSystem] ERROR: Couldn't open pack: " << path << std::endl;
+            return false;
+        }
+
+        const std::byte* cursor = pack.file.data();
+        const std::byte* end = pack.file.end();
+        auto read = [&](void* output, size_t size) {
+            if (size_t(end - cursor) < size)
+                return false;
+            std::memcpy(output, cursor, size);
+            cursor += size;
+            return true;
+        };
+        PackHeader header;
+        if (!read(&header, sizeof(header)) || std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+            header.version != PACK_VERSION) {
+            std::cerr << "[FileSystem] ERROR: Invalid or outdated pack: " << path << std::endl;
+            return false;
+        }
+        for (uint32_t index = 0; index < header.count; index++) {
+            uint32_t keyLength;
+            PackEntry entry;
+            if (!read(&keyLength, sizeof(keyLength)) || size_t(end - cursor) < keyLength) {
+                std::cerr << "[FileSystem] ERROR: Corrupted pack table: " << path << std::endl;
+                return false;
+            }
+            std::string key(reinterpret_cast<const char*>(cursor), keyLength);
+            cursor += keyLength;
+            if (!read(&entry, sizeof(entry)) || entry.offset > pack.file.size() ||
+                entry.size > pack.file.size() - entry.offset) {
+                std::cerr << "[FileSystem] ERROR: Corrupted pack table: " << path << std::endl;
+                return false;
+            }
+            pack.entries[std::move(key)] = entry;
+        }
+
+        std::cout << "[FileSystem] Mounted " << path << " (" << pack.entries.size() << " files, "
+                  << pack.file.size() / 1048576.0 << " MB)" << std::endl;
+        std::unique_lock lock(mutex);
+        packs.push_back(std::move(pack));
+        return true;
+    }
+
+    void FileSystem::unmountAll() {
+        // The views that are still alive keep their pack mapped
+        std::unique_lock lock(mutex);
+        packs.clear();
+    }
+
+    void FileSystem::preferDisk(const std::string& path) {
+        std::unique_lock lock(mutex);
+        diskFiles.insert(getPackKey(path));
+    }
+
+    FileView FileSystem::openFromPacks(const std::string& key) const {
+        for (auto pack = packs.rbegin(); pack != packs.rend(); ++pack) {
+            auto entry = pack->entries.find(key);
+            if (entry != pack->entries.end())
+                return pack->file.subview(size_t(entry->second.offset), size_t(entry->second.size));
+        }
+        return FileView();
+    }
+
+    FileView FileSystem::open(const std::string& path) const {
+        std::string key;
+        bool diskFirst = false;
+        {
+            std::shared_lock lock(mutex);
+            if (!packs.empty()) {
+                key = getPackKey(path);
+                diskFirst = diskFiles.count(key) != 0;
+                if (FileView view = diskFirst ? FileView() : openFromPacks(key)) {
+                    packFiles++;
+                    return view;
+                }
+            }
+        }
+        FileView view = mapFile(path);
+        if (view) {
+            mappedFiles++;
+            return view;
+        }
+        // The file is not on the disk (anymore), the packed version is all we have
+        if (diskFirst) {
+            std::shared_lock lock(mutex);
+            if ((view = openFromPacks(key))) {
+                packFiles++;
+                return view;
+            }
+        }
+        failedOpens++;
+        return view;
+    }
+
+    FileView FileSystem::openFromDisk(const std::string& path) const {
+        FileView view = mapFile(path);
+        if (view)
+            mappedFiles++;
+        else
+            failedOpens++;
+        return view;
+    }
+
+    bool FileSystem::exists(const std::string& path) const {
+        {
+            std::shared_lock lock(mutex);
+            if (!packs.empty() && openFromPacks(getPackKey(path)))
+                return true;
+        }
+        std::error_code error;
+        return std::filesystem::is_regular_file(path, error);
+    }
+
+    std::string FileSystem::readText(const std::string& path) const {
+        FileView view = open(path);
+        return std::string(view.asString());
+    }
+
+    FileSystem::Statistics FileSystem::getStatistics() const {
+        Statistics statistics;
+        {
+            std::shared_lock lock(mutex);
+            statistics.mountedPacks = packs.size();
+            for (const Pack& pack : packs)
+                statistics.packedFiles += pack.entries.size();
+        }
+        statistics.mappedFiles = mappedFiles;
+        statistics.packFiles = packFiles;
+        statistics.failedOpens = failedOpens;
+        return statistics;
+    }
+
+    bool FileSystem::writePack(const std::string& packPath,
+                               const std::vector<std::pair<std::string, std::string>>& files) {
+        std::vector<FileView> views;
+        views.reserve(files.size());
+        uint64_t tableSize = 0;
+        for (const auto& [key, path] : files) {
+            views.push_back(mapFile(path));
+            if (!views.back()) {
+                std::cerr << "[FileSystem] ERROR: Couldn't open file to pack: " << path << std::endl;
+                return false;
+            }
+            tableSize += sizeof(uint32_t) + key.size() + sizeof(PackEntry);
+        }
+        auto align = [](uint64_t offset) { return (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT; };
+
+        // Written next to the pack then renamed, so a mounted pack is never seen half written
+        std::string temporaryPath = getTemporaryPath(packPath);
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "[FileSystem] ERROR: Couldn't write pack: " << packPath << std::endl;
+            return false;
+        }
+        PackHeader header;
+        std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+        header.version = PACK_VERSION;
+        header.count = uint32_t(files.size());
+        header.reserved = 0;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        uint64_t offset = align(sizeof(PackHeader) + tableSize);
+        std::vector<uint64_t> offsets;
+        for (size_t index = 0; index < files.size(); index++) {
+            const std::string& key = files[index].first;
+            uint32_t keyLength = uint32_t(key.size());
+            PackEntry entry = {offset, views[index].size()};
+            file.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));
+            file.write(key.data(), std::streamsize(key.size()));
+            file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            offsets.push_back(offset);
+            offset = align(offset + views[index].size());
+        }
+
+        static const char padding[PACK_ALIGNMENT] = {};
+        uint64_t position = sizeof(PackHeader) + tableSize;
+        for (size_t index = 0; index < files.size(); index++) {
+            file.write(padding, std::streamsize(offsets[index] - position));
+            file.write(views[index].asChars(), std::streamsize(views[index].size()));
+            position = offsets[index] + views[index].size();
+        }
+        file.close();
+        std::error_code error;
+        if (!file) {
+            std::cerr << "[FileSystem] ERROR: Couldn't write pack: " << packPath << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+
+        std::filesystem::rename(temporaryPath, packPath, error);
+        if (error) {
+            std::cerr << "[FileSystem] ERROR: Couldn't replace pack: " << packPath << " (" << error.message() << ")"
+                      << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+}
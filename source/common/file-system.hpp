@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace our {
+
+    // A read-only view of the bytes of a file, it plays the role of std::span<const std::byte> (which needs C++20).
+    // The bytes are usually memory mapped, either from the file itself or from the pack holding it, and they stay
+    // valid as long as a view (or a subview) of them exists. Copying a view does not copy the bytes.
+    class FileView {
+        std::shared_ptr<const void> owner; // The mapping (or buffer) holding the bytes
+        const std::byte* bytes = nullptr;
+        size_t length = 0;
+
+    public:
+        FileView() = default;
+        FileView(std::shared_ptr<const void> owner, const std::byte* bytes, size_t length)
+            : owner(std::move(owner)), bytes(bytes), length(length) {}
+
+        // Copies the bytes into a view that owns them (for data that does not come from a file)
+        static FileView copy(const void* data, size_t size);
+
+        const std::byte* data() const { return bytes; }
+        size_t size() const { return length; }
+        bool empty() const { return length == 0; }
+        const std::byte* begin() const { return bytes; }
+        const std::byte* end() const { return bytes + length; }
+
+        // The same bytes for the APIs that take them as characters (stb_image, OpenGL, json...)
+        const unsigned char* asBytes() const { return reinterpret_cast<const unsigned char*>(bytes); }
+        const char* asChars() const { return reinterpret_cast<const char*>(bytes); }
+        std::string_view asString() const { return std::string_view(asChars(), length); }
+
+        // Returns a view of a part of the bytes (clamped to the view), it keeps the whole mapping alive
+        FileView subview(size_t offset, size_t count) const;
+
+        // False if the file couldn't be opened (an empty file gives a valid empty view)
+        explicit operator bool() const { return owner != nullptr; }
+    };
+
+    // An input stream reading a view in place, for the parsers that only read from streams
+    class FileViewStream : public std::istream {
+        struct Buffer : public std::streambuf {
+            explicit Buffer(const FileView& view) {
+                char* begin = const_cast<char*>(view.asChars());
+                setg(begin, begin, begin + view.size());
+            }
+            pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode) override {
+                char* origin = direction == std::ios_base::beg   ? eback()
+                               : direction == std::ios_base::cur ? gptr()
+                                                                 : egptr();
+                if (offset < eback() - origin || offset > egptr() - origin)
+                    return pos_type(off_type(-1));
+                setg(eback(), origin + offset, egptr());
+                return pos_type(gptr() - eback());
+            }
+            pos_type seekpos(pos_type position, std::ios_base::openmode mode) override {
+                return seekoff(off_type(position), std::ios_base::beg, mode);
+            }
+        };
+
+        FileView view;
+        Buffer buffer;
+
+    public:
+        explicit FileViewStream(FileView file) : std::istream(nullptr), view(std::move(file)), buffer(view) {
+            rdbuf(&buffer);
+            if (!view)
+                setstate(std::ios_base::failbit);
+        }
+        bool isOpen() const { return bool(view); }
+    };
+
+    // The single entry point of the loaders to the files on disk.
+    // A file is opened by memory mapping it so the loaders read (or decode) the bytes in place instead of reading
+    // them into their own buffers first. Packs can be mounted too: a pack is a single file holding many files (see
+    // "writePack"), it is mapped once when it is mounted so opening one of its files is a table lookup with no
+    // system call at all. This is how the game is meant to be shipped.
+    // The packs are searched first (the last mounted first), then the file is opened from the disk. The paths are
+    // looked up in the packs relative to the working directory (e.g. "assets/textures/wood.png"). The files given to
+    // "preferDisk" are the exception: they are opened from the disk whenever they exist there.
+    // A mapped file must never be rewritten in place (its readers crash with SIGBUS when it is truncated), so the
+    // files are written to a temporary file (see "getTemporaryPath") which is then renamed over the old one.
+    // "open" can be called from any thread, mounting is meant to happen at startup.
+    class FileSystem {
+        struct PackEntry {
+            uint64_t offset, size;
+        };
+        struct Pack {
+            std::string path;
+            FileView file;
+            std::unordered_map<std::string, PackEntry> entries;
+        };
+
+        mutable std::shared_mutex mutex;
+        std::vector<Pack> packs;
+        // The pack keys of the files that are opened from the disk first
+        std::unordered_set<std::string> diskFiles;
+
+        mutable std::atomic<size_t> mappedFiles = 0, packFiles = 0, failedOpens = 0;
+
+        FileSystem() = default;
+        FileSystem(const FileSystem&) = delete;
+        FileSystem& operator=(const FileSystem&) = delete;
+
+        // Looks the path up in the mounted packs, returns an invalid view if no pack holds it
+        FileView openFromPacks(const std::string& key) const;
+
+    public:
+        static FileSystem& getInstance() {
+            static FileSystem instance;
+            return instance;
+        }
+
+        struct Statistics {
+            size_t mountedPacks = 0, packedFiles = 0;
+            size_t mappedFiles = 0, packFiles = 0, failedOpens = 0; // What "open" returned so far
+        };
+
+        // Maps the pack and adds its files to the file system, returns false if it is not a valid pack
+        bool mountPack(const std::string& path);
+        void unmountAll();
+        // Opens the file from the disk rather than from the packs while it exists there (see HotReload, the edited
+        // files must not be shadowed by the packed version)
+        void preferDisk(const std::string& path);
+
+        // Returns a view of the bytes of the file or an invalid view if it does not exist (no error is printed, the
+        // callers print their own)
+        FileView open(const std::string& path) const;
+        // Same as "open" but never looks in the packs, for the files the game writes itself (caches, manifests...)
+        // whose packed copy would be outdated
+        FileView openFromDisk(const std::string& path) const;
+        bool exists(const std::string& path) const;
+        // Returns the file as a string (for the few APIs that need a null terminated copy)
+        std::string readText(const std::string& path) const;
+
+        Statistics getStatistics() const;
+
+        // The path a file is stored under in a pack (normalized and relative to the working directory)
+        static std::string getPackKey(const std::string& path);
+        // A path next to the given one that no other thread or process writes to, for writing a file before renaming
+        // it over the given one
+        static std::string getTemporaryPath(const std::string& path);
+
+        // Writes a pack holding the given files, each one is a pair (pack key, path of the file to store)
+        // The file data is aligned to 16 bytes inside the pack so it can be read in place
+        static bool writePack(const std::string& packPath, const std::vector<std::pair<std::string, std::string>>& files);
+    };
+
+}
@@ -0,0 +1,145 @@
+#include "file-watcher.hpp"
+
+#include <filesystem>
+#include <iostream>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#endif
+
+namespace our {
+
+    static void getStamp(const std::string& path, uint64_t& size, int64_t& time, bool& exists) {
+        std::error_code error;
+        size = std::filesystem::file_size(path, error);
+        exists = !error;
+        time = exists ? std::filesystem::last_write_time(path, error).time_since_epoch().count() : 0;
+    }
+
+    FileWatcher::FileWatcher(double settleTime, double pollInterval)
+        : settleTime(settleTime), pollInterval(pollInterval), lastPoll(Clock::now()) {
+#if defined(__linux__)
+        inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyDescriptor < 0)
+            std::cerr << "[FileWatcher] WARNING: inotify is not available, the files will be polled" << std::endl;
+#endif
+    }
+
+    FileWatcher::~FileWatcher() {
+#if defined(__linux__)
+        // Closing the descriptor removes all its watches
+        if (inotifyDescriptor >= 0)
+            close(inotifyDescriptor);
+#endif
+    }
+
+    std::string FileWatcher::normalize(const std::string& path) {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        return error ? std::filesystem::path(path).lexically_normal().generic_string() : canonical.generic_string();
+    }
+
+    void FileWatcher::watch(const std::string& path) {
+        std::string normalized = normalize(path);
+        if (files.count(normalized))
+            return;
+        WatchedFile& file = files[normalized];
+        getStamp(normalized, file.size, file.time, file.exists);
+
+#if defined(__linux__)
+        if (inotifyDescriptor < 0)
+            return;
+        std::string directory = std::filesystem::path(normalized).parent_path().generic_string();
+        for (const auto& [descriptor, watchedDirectory] : directoryWatches) {
+            if (watchedDirectory == directory) {
+                file.polled = false;
+                return;
+            }
+        }
+        int descriptor = inotify_add_watch(inotifyDescriptor, directory.c_str(),
+                                           IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE);
+        if (descriptor < 0) {
+            std::cerr << "[FileWatcher] WARNING: Couldn't watch " << directory << ", it will be polled" << std::endl;
+            return;
+        }
+        directoryWatches[descriptor] = directory;
+        file.polled = false;
+#endif
+    }
+
+    bool FileWatcher::isWatched(const std::string& path) const { return files.count(normalize(path)) != 0; }
+
+    void FileWatcher::readNotifications(Clock::time_point now) {
+#if defined(__linux__)
+        if (inotifyDescriptor < 0)
+            return;
+        alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+        while (true) {
+            ssize_t length = read(inotifyDescriptor, buffer, sizeof(buffer));
+            // EAGAIN: there is nothing left to read
+            if (length <= 0)
+                break;
+            for (char* cursor = buffer; cursor < buffer + length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+                cursor += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // Some events were lost, so every file is considered changed
+                    for (const auto& [path, file] : files)
+                        pending[path] = now;
+                    continue;
+                }
+                auto directory = directoryWatches.find(event->wd);
+                if (event->len == 0 || directory == directoryWatches.end())
+                    continue;
+                std::string path = directory->second + "/" + event->name;
+                if (files.count(path))
+                    pending[path] = now;
+            }
+        }
+#endif
+    }
+
+    void FileWatcher::pollFiles(Clock::time_point now) {
+        if (std::chrono::duration<double>(now - lastPoll).count() < pollInterval)
+            return;
+        lastPoll = now;
+        for (auto& [path, file] : files) {
+            if (!file.polled)
+                continue;
+            uint64_t size;
+            int64_t time;
+            bool exists;
+            getStamp(path, size, time, exists);
+            if (size == file.size && time == file.time && exists == file.exists)
+                continue;
+            file.size = size;
+            file.time = time;
+            file.exists = exists;
+            pending[path] = now;
+        }
+    }
+
+    std::vector<std::string> FileWatcher::poll() {
+        Clock::time_point now = Clock::now();
+        readNotifications(now);
+        pollFiles(now);
+
+        std::vector<std::string> changed;
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (std::chrono::duration<double>(now - it->second).count() < settleTime) {
+                ++it;
+                continue;
+            }
+            // A file that was deleted (or is being replaced) is reported once it exists again
+            std::error_code error;
+            if (std::filesystem::exists(it->first, error))
+                changed.push_back(it->first);
+            it = pending.erase(it);
+        }
+        return changed;
+    }
+
+}
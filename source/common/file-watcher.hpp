@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+    // Detects the changes of a set of files.
+    // On Linux, the directories of the watched files are watched with inotify (so editors that save by writing a new
+    // file and renaming it over the old one are detected too). Everywhere else, or if a directory can't be watched,
+    // the size and modification time of the files are compared every "pollInterval" seconds.
+    // A change is only reported once the file stopped changing for "settleTime" seconds, so a file that is written in
+    // several steps is not read half written.
+    // Everything happens in "poll" on the calling thread, nothing runs in the background.
+    class FileWatcher {
+        using Clock = std::chrono::steady_clock;
+
+        struct WatchedFile {
+            uint64_t size = 0;
+            int64_t time = 0;
+            bool exists = false;
+            bool polled = true; // False if its directory is watched with inotify
+        };
+
+        double settleTime, pollInterval;
+        // Normalized path -> stamp
+        std::unordered_map<std::string, WatchedFile> files;
+        // The changed files that wait for the settle time, with the time of their last change
+        std::unordered_map<std::string, Clock::time_point> pending;
+        Clock::time_point lastPoll;
+
+        int inotifyDescriptor = -1;
+        // Watch descriptor -> normalized directory path
+        std::unordered_map<int, std::string> directoryWatches;
+
+        void readNotifications(Clock::time_point now);
+        void pollFiles(Clock::time_point now);
+
+    public:
+        FileWatcher(double settleTime = 0.1, double pollInterval = 0.5);
+        ~FileWatcher();
+
+        // Starts watching the file (it does not need to exist yet), watching the same file twice does nothing
+        void watch(const std::string& path);
+        bool isWatched(const std::string& path) const;
+
+        // Returns the normalized paths of the watched files that changed since the last call (each path once)
+        std::vector<std::string> poll();
+
+        // Returns the path the way it is reported by "poll"
+        static std::string normalize(const std::string& path);
+        bool isUsingNotifications() const { return inotifyDescriptor >= 0; }
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+    };
+
+}
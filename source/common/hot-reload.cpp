@@ -0,0 +1,253 @@
+#include "hot-reload.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <typeinfo>
+#include "asset-loader.hpp"
+#include "file-system.hpp"
+#include "material/material.hpp"
+#include "shader/shader.hpp"
+#include "shader/shader-permutations.hpp"
+#include "shader/shader-preprocessor.hpp"
+#include "texture/async-texture-loader.hpp"
+#include "texture/texture2d.hpp"
+
+namespace our {
+
+    // The asset types that can be rebuilt in place, in the order they must be rebuilt (materials use the others)
+    static const char* RELOADABLE_TYPES[] = {"shaders", "textures", "materials"};
+    // The keys of a shader description that hold the path of a stage
+    static const char* SHADER_STAGE_KEYS[] = {"vs", "fs"};
+
+    static const nlohmann::json& getAssets(const nlohmann::json& config, const nlohmann::json::json_pointer& pointer) {
+        static const nlohmann::json empty = nlohmann::json::object();
+        return config.contains(pointer) && config[pointer].is_object() ? config[pointer] : empty;
+    }
+
+    static bool isLoaded(const std::string& type, const std::string& name) {
+        if (type == "shaders")
+            return AssetLoader<ShaderProgram>::get(name) != nullptr;
+        if (type == "textures")
+            return AssetLoader<Texture2D>::get(name) != nullptr;
+        if (type == "materials")
+            return AssetLoader<Material>::get(name) != nullptr;
+        return false;
+    }
+
+    // Returns an empty object if the config can't be read or parsed
+    static nlohmann::json readConfig(const std::string& path) {
+        FileView file = FileSystem::getInstance().open(path);
+        nlohmann::json config = nlohmann::json::parse(file.asChars(), file.asChars() + file.size(), nullptr, false, true);
+        return config.is_discarded() ? nlohmann::json::object() : config;
+    }
+
+    void HotReload::configure(const nlohmann::json& config) {
+        if (!config.is_object())
+            return;
+        enabled = config.value("enabled", false);
+        settleTime = config.value("settle-time", settleTime);
+        pollInterval = config.value("poll-interval", pollInterval);
+        if (!enabled) {
+            watcher.reset();
+            return;
+        }
+        watcher = std::make_unique<FileWatcher>(settleTime, pollInterval);
+        // The edits are made on the disk, so the watched configs are read from there even if a pack holds them
+        for (WatchedConfig& watched : configs) {
+            FileSystem::getInstance().preferDisk(watched.path);
+            watched.config = readConfig(watched.path);
+        }
+        indexFiles();
+        std::cout << "[HotReload] Watching " << configs.size() << " configs, " << shaderFiles.size()
+                  << " shader files and " << textureFiles.size() << " textures"
+                  << (watcher->isUsingNotifications() ? "" : " (polling)") << std::endl;
+    }
+
+    void HotReload::watchConfig(const std::string& path, const std::string& assetsPointer,
+                                std::function<void(const nlohmann::json&)> onReload) {
+        WatchedConfig watched;
+        watched.path = FileWatcher::normalize(path);
+        watched.assetsPointer = nlohmann::json::json_pointer(assetsPointer);
+        watched.onReload = std::move(onReload);
+        if (watcher)
+            FileSystem::getInstance().preferDisk(watched.path);
+        watched.config = readConfig(watched.path);
+        configs.push_back(std::move(watched));
+        if (watcher)
+            indexFiles();
+    }
+
+    void HotReload::indexFiles() {
+        shaderFiles.clear();
+        textureFiles.clear();
+        for (const WatchedConfig& watched : configs) {
+            const nlohmann::json& assets = getAssets(watched.config, watched.assetsPointer);
+            if (assets.contains("shaders") && assets["shaders"].is_object())
+                for (auto& [name, desc] : assets["shaders"].items())
+                    for (const char* stage : SHADER_STAGE_KEYS)
+                        if (desc.is_object() && desc.contains(stage)) {
+                            std::string path = desc[stage].get<std::string>();
+                            shaderFiles[FileWatcher::normalize(path)][name] = desc;
+                            // Editing an included file rebuilds every shader that includes it
+                            for (const std::string& include : ShaderPreprocessor::collectIncludes(path))
+                                shaderFiles[FileWatcher::normalize(include)][name] = desc;
+                        }
+            if (assets.contains("textures") && assets["textures"].is_object())
+                for (auto& [name, desc] : assets["textures"].items())
+                    if (desc.is_string())
+                        textureFiles[FileWatcher::normalize(desc.get<std::string>())][name] = desc;
+        }
+
+        if (!watcher)
+            return;
+        // The reloads must read the edited files, not the packed versions
+        FileSystem& fileSystem = FileSystem::getInstance();
+        for (const WatchedConfig& watched : configs)
+            watcher->watch(watched.path);
+        for (const auto& [path, assets] : shaderFiles) {
+            fileSystem.preferDisk(path);
+            watcher->watch(path);
+        }
+        for (const auto& [path, assets] : textureFiles) {
+            fileSystem.preferDisk(path);
+            watcher->watch(path);
+        }
+    }
+
+    void HotReload::count(bool reloaded) {
+        if (reloaded)
+            reloadCount++;
+        else
+            failureCount++;
+    }
+
+    void HotReload::update() {
+        if (!watcher)
+            return;
+        bool shadersReloaded = false;
+        for (const std::string& path : watcher->poll()) {
+            for (WatchedConfig& watched : configs)
+                if (watched.path == path)
+                    reloadConfig(watched);
+            if (auto it = shaderFiles.find(path); it != shaderFiles.end())
+                for (const auto& [name, desc] : it->second)
+                    if (isLoaded("shaders", name)) {
+                        count(reloadShader(name, desc));
+                        shadersReloaded = true;
+                    }
+            if (auto it = textureFiles.find(path); it != textureFiles.end())
+                for (const auto& [name, desc] : it->second)
+                    if (isLoaded("textures", name))
+                        count(reloadTexture(name, desc));
+        }
+        // The edited shaders may include new files
+        if (shadersReloaded)
+            indexFiles();
+        // The reloaded textures are uploaded as soon as their decode finishes
+        AsyncTextureLoader::getInstance().uploadFinished();
+    }
+
+    void HotReload::reloadConfig(WatchedConfig& watched) {
+        FileView file = FileSystem::getInstance().open(watched.path);
+        nlohmann::json config = nlohmann::json::parse(file.asChars(), file.asChars() + file.size(), nullptr, false, true);
+        if (!file || config.is_discarded()) {
+            std::cerr << "[HotReload] ERROR: Couldn't parse " << watched.path << ", keeping the current version"
+                      << std::endl;
+            failureCount++;
+            return;
+        }
+        if (config == watched.config)
+            return;
+        std::cout << "[HotReload] Reloading config: " << watched.path << std::endl;
+
+        reloadChangedAssets(getAssets(watched.config, watched.assetsPointer), getAssets(config, watched.assetsPointer));
+        watched.config = std::move(config);
+        // The config may reference new shader or texture files
+        indexFiles();
+        if (watched.onReload)
+            watched.onReload(watched.config);
+    }
+
+    void HotReload::reloadChangedAssets(const nlohmann::json& oldAssets, const nlohmann::json& newAssets) {
+        for (const char* type : RELOADABLE_TYPES) {
+            if (!newAssets.contains(type) || !newAssets[type].is_object())
+                continue;
+            for (auto& [name, desc] : newAssets[type].items()) {
+                if (oldAssets.contains(type) && oldAssets[type].contains(name) && oldAssets[type][name] == desc)
+                    continue;
+                if (!isLoaded(type, name)) {
+                    std::cout << "[HotReload] " << name << " (" << type << ") is not loaded, it will be loaded with "
+                              << "the next level that uses it" << std::endl;
+                    continue;
+                }
+                if (type == std::string("shaders"))
+                    count(reloadShader(name, desc));
+                else if (type == std::string("textures"))
+                    count(reloadTexture(name, desc));
+                else
+                    count(reloadMaterial(name, desc));
+            }
+        }
+    }
+
+    bool HotReload::reloadShader(const std::string& name, const nlohmann::json& desc) {
+        ShaderProgram* shader = AssetLoader<ShaderProgram>::get(name);
+        if (!shader || !desc.is_object())
+            return false;
+        // The shader and its permutations are rebuilt on the side, the errors were already printed by attach and link
+        if (!ShaderPermutations::getInstance().reload(name, desc)) {
+            std::cerr << "[HotReload] ERROR: Shader " << name << " failed to build, keeping the current version"
+                      << std::endl;
+            return false;
+        }
+        std::cout << "[HotReload] Reloaded shader: " << name << std::endl;
+        return true;
+    }
+
+    bool HotReload::reloadTexture(const std::string& name, const nlohmann::json& desc) {
+        Texture2D* texture = AssetLoader<Texture2D>::get(name);
+        if (!texture || !desc.is_string())
+            return false;
+        std::string path = desc.get<std::string>();
+        std::string extension = path.substr(path.find_last_of(".") + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        // Same options as AssetLoader<Texture2D>, decode errors are printed by the loader and leave the texture as is
+        if (extension == "hdr")
+            AsyncTextureLoader::getInstance().reloadHDR(texture, path);
+        else
+            AsyncTextureLoader::getInstance().reloadImage(texture, path);
+        std::cout << "[HotReload] Reloading texture: " << name << std::endl;
+        return true;
+    }
+
+    bool HotReload::reloadMaterial(const std::string& name, const nlohmann::json& desc) {
+        Material* material = AssetLoader<Material>::get(name);
+        if (!material || !desc.is_object())
+            return false;
+        // The description is checked on a new material first so a bad edit never leaves the material half updated
+        std::unique_ptr<Material> rebuilt(createMaterialFromType(desc.value("type", "")));
+        try {
+            rebuilt->deserialize(desc);
+        } catch (const nlohmann::json::exception& error) {
+            std::cerr << "[HotReload] ERROR: Material " << name << " is invalid (" << error.what()
+                      << "), keeping the current version" << std::endl;
+            return false;
+        }
+        if (!rebuilt->validate(name)) {
+            std::cerr << "[HotReload] ERROR: Material " << name << " is invalid, keeping the current version"
+                      << std::endl;
+            return false;
+        }
+        if (typeid(*rebuilt) != typeid(*material)) {
+            std::cerr << "[HotReload] ERROR: The type of material " << name << " changed, restart to apply it"
+                      << std::endl;
+            return false;
+        }
+        // The keys removed from the pipeline state must go back to their defaults
+        material->pipelineState = PipelineState();
+        material->deserialize(desc);
+        std::cout << "[HotReload] Reloaded material: " << name << std::endl;
+        return true;
+    }
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "file-watcher.hpp"
+
+namespace our {
+
+    // Applies the changes made on disk to the running game, so editing a shader, a texture or a config file does not
+    // need a restart (which means loading every asset and baking the IBL maps again).
+    // The configuration files (app.jsonc and the levels) are registered with "watchConfig" along with where their
+    // assets are. The shader and texture files they reference are watched too. When a file changes:
+    //  - Shader source: the shaders that use it are compiled and linked again.
+    //  - Texture image: the textures made from it are decoded again (on worker threads) and uploaded.
+    //  - Config file: the shaders, textures and materials whose description changed are rebuilt, then the
+    //    "onReload" callback of the file receives the new config (the levels use it to rebuild their entities).
+    // Everything is rebuilt in place: the AssetLoader pointers stay the same so nothing that points to them needs to
+    // be initialized again. If a shader does not compile or link, or a config does not parse, the old version is kept
+    // and the error is printed. Only the assets that are already loaded are rebuilt, the ones added to a config are
+    // loaded with the level the next time it is loaded.
+    // Everything happens in "update" on the OpenGL thread.
+    class HotReload {
+        struct WatchedConfig {
+            std::string path; // Normalized (see FileWatcher::normalize)
+            nlohmann::json::json_pointer assetsPointer;
+            nlohmann::json config;
+            std::function<void(const nlohmann::json&)> onReload;
+        };
+
+        bool enabled = false;
+        double settleTime = 0.1, pollInterval = 0.5;
+        std::unique_ptr<FileWatcher> watcher;
+        std::vector<WatchedConfig> configs;
+        // Normalized source path -> the descriptions of the assets made from it (name -> description)
+        std::unordered_map<std::string, std::unordered_map<std::string, nlohmann::json>> shaderFiles, textureFiles;
+        size_t reloadCount = 0, failureCount = 0;
+
+        HotReload() = default;
+        HotReload(const HotReload&) = delete;
+        HotReload& operator=(const HotReload&) = delete;
+
+        // Rebuilds the source file maps from the configs and watches all the files
+        void indexFiles();
+        void reloadConfig(WatchedConfig& watched);
+        // Rebuilds the assets whose description is not the same in the two asset sections
+        void reloadChangedAssets(const nlohmann::json& oldAssets, const nlohmann::json& newAssets);
+        void count(bool reloaded);
+
+    public:
+        static HotReload& getInstance() {
+            static HotReload instance;
+            return instance;
+        }
+
+        // Reads "enabled", "settle-time" and "poll-interval" (both in seconds), the files are only watched when enabled
+        void configure(const nlohmann::json& config);
+        bool isEnabled() const { return enabled; }
+
+        // Registers a config file whose assets are at the given json pointer (e.g. "/scene/assets")
+        // "onReload" is called with the new config every time the file changes and parses
+        void watchConfig(const std::string& path, const std::string& assetsPointer,
+                         std::function<void(const nlohmann::json&)> onReload = {});
+
+        // Checks the watched files and applies their changes (call it once per frame on the OpenGL thread)
+        void update();
+
+        // Rebuild the named asset in place from its description, they return false (and keep the current version)
+        // if the asset is not loaded or if the new version can't be built
+        static bool reloadShader(const std::string& name, const nlohmann::json& desc);
+        static bool reloadTexture(const std::string& name, const nlohmann::json& desc);
+        static bool reloadMaterial(const std::string& name, const nlohmann::json& desc);
+
+        size_t getReloadCount() const { return reloadCount; }
+        size_t getFailureCount() const { return failureCount; }
+    };
+
+}
@@ -0,0 +1,190 @@
+#include "level-streamer.hpp"
+
+#include <chrono>
+#include <iostream>
+#include "asset-database.hpp"
+#include "asset-loader.hpp"
+#include "ecs/lighting.hpp"
+#include "texture/async-texture-loader.hpp"
+#include "texture/texture-cache.hpp"
+
+namespace our {
+
+    nlohmann::json LevelStreamer::acquire(const nlohmann::json& assets) {
+        nlohmann::json missing = nlohmann::json::object();
+        if (!assets.is_object())
+            return missing;
+        for (auto& [type, entries] : assets.items()) {
+            if (!entries.is_object())
+                continue;
+            for (auto& [name, desc] : entries.items()) {
+                ResidentAsset& asset = residentAssets[getKey(type, name)];
+                if (asset.references++ == 0) {
+                    asset.type = type;
+                    asset.name = name;
+                    missing[type][name] = desc;
+                }
+            }
+        }
+        return missing;
+    }
+
+    size_t LevelStreamer::release(const nlohmann::json& assets) {
+        if (!assets.is_object())
+            return 0;
+        std::vector<ResidentAsset> evicted;
+        for (auto& [type, entries] : assets.items()) {
+            if (!entries.is_object())
+                continue;
+            for (auto& [name, desc] : entries.items()) {
+                auto it = residentAssets.find(getKey(type, name));
+                if (it == residentAssets.end() || --it->second.references > 0)
+                    continue;
+                evicted.push_back(std::move(it->second));
+                residentAssets.erase(it);
+            }
+        }
+        if (evicted.empty())
+            return 0;
+
+        // No decode may still be writing into a texture that is about to be deleted
+        AsyncTextureLoader::getInstance().flush();
+        for (const auto& asset : evicted)
+            removeAsset(asset.type, asset.name);
+        // The evicted models released the last handles of their textures
+        TextureCache::getInstance().collectGarbage();
+        return evicted.size();
+    }
+
+    void LevelStreamer::startLoading(int level) {
+        LevelAssets& levelAssets = levels[level - 1];
+        levelAssets.held = true;
+        loadingAssets = acquire(levelAssets.assets);
+        // The renderer uses every light asset, so the lights of a level are only created when it becomes current
+        // (its materials look them up by name when they are drawn)
+        loadingAssets.erase("lights");
+
+        loadingLevel = level;
+        loadingGraph = std::make_unique<AssetJobGraph>();
+        scheduleAllAssets(loadingAssets, *loadingGraph);
+        loadingGraph->start();
+    }
+
+    void LevelStreamer::finishLoading() {
+        if (!loadingLevel)
+            return;
+        // Does nothing if the graph is already finished
+        loadingGraph->pump();
+        AssetDatabase::getInstance().saveManifest();
+        std::cout << "[LevelStreamer] Level " << loadingLevel << " is resident" << std::endl;
+        levels[loadingLevel - 1].resident = true;
+        loadingGraph.reset();
+        loadingAssets = nlohmann::json();
+        loadingLevel = 0;
+    }
+
+    void LevelStreamer::initialize(const nlohmann::json& sharedAssets, const std::vector<nlohmann::json>& levelsConfigs) {
+        // The shared assets keep one reference forever
+        deserializeAllAssets(acquire(sharedAssets));
+        sharedAssetCount = residentAssets.size();
+
+        levels.clear();
+        for (const auto& levelConfig : levelsConfigs) {
+            LevelAssets levelAssets;
+            if (levelConfig.contains("assets"))
+                levelAssets.assets = levelConfig["assets"];
+            levels.push_back(std::move(levelAssets));
+        }
+    }
+
+    void LevelStreamer::activate(int level, int nextLevel) {
+        if (level < 1 || level > (int)levels.size()) {
+            std::cerr << "[LevelStreamer] ERROR: Level " << level << " does not exist" << std::endl;
+            return;
+        }
+        if (nextLevel < 1 || nextLevel > (int)levels.size() || nextLevel == level)
+            nextLevel = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        bool wasResident = levels[level - 1].resident;
+
+        // Only one level loads at a time, so whatever is loading finishes first
+        finishLoading();
+        if (!levels[level - 1].held) {
+            startLoading(level);
+            finishLoading();
+        }
+
+        const nlohmann::json& assets = levels[level - 1].assets;
+        if (assets.contains("lights")) {
+            nlohmann::json missingLights = nlohmann::json::object();
+            for (auto& [name, desc] : assets["lights"].items())
+                if (!AssetLoader<Light>::get(name))
+                    missingLights[name] = desc;
+            AssetLoader<Light>::deserialize(missingLights);
+        }
+
+        // Evict the levels that are neither current nor next
+        size_t evictedCount = 0;
+        for (int other = 1; other <= (int)levels.size(); other++) {
+            LevelAssets& otherAssets = levels[other - 1];
+            if (other == level || other == nextLevel || !otherAssets.held)
+                continue;
+            evictedCount += release(otherAssets.assets);
+            otherAssets.held = false;
+            otherAssets.resident = false;
+        }
+        activeLevel = level;
+
+        std::cout << "[LevelStreamer] Activated level " << level << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count()
+                  << " ms (" << (wasResident ? "prefetched" : "not prefetched") << ", " << evictedCount
+                  << " assets evicted)" << std::endl;
+
+        if (nextLevel && !levels[nextLevel - 1].held)
+            startLoading(nextLevel);
+    }
+
+    void LevelStreamer::reloadLevelAssets(int level, const nlohmann::json& assets) {
+        if (level < 1 || level > (int)levels.size())
+            return;
+        LevelAssets& levelAssets = levels[level - 1];
+        nlohmann::json oldAssets = std::move(levelAssets.assets);
+        levelAssets.assets = assets.is_object() ? assets : nlohmann::json::object();
+        if (!levelAssets.held)
+            return;
+
+        // The references move from the old set to the new one, so the assets of both are not evicted in between
+        finishLoading();
+        nlohmann::json missing = acquire(levelAssets.assets);
+        // Like in "startLoading", only the current level creates its lights
+        if (level != activeLevel)
+            missing.erase("lights");
+        deserializeAllAssets(missing);
+        size_t evictedCount = release(oldAssets);
+        std::cout << "[LevelStreamer] Reloaded the assets of level " << level << " (" << evictedCount
+                  << " assets evicted)" << std::endl;
+    }
+
+    void LevelStreamer::update(double budgetMilliseconds) {
+        if (loadingLevel && loadingGraph->pump(budgetMilliseconds))
+            finishLoading();
+        // The textures keep their placeholder until their decode finishes
+        AsyncTextureLoader::getInstance().uploadFinished();
+    }
+
+    bool LevelStreamer::isResident(int level) const {
+        return level >= 1 && level <= (int)levels.size() && levels[level - 1].resident;
+    }
+
+    LevelStreamer::Statistics LevelStreamer::getStatistics() const {
+        Statistics statistics;
+        statistics.activeLevel = activeLevel;
+        statistics.loadingLevel = loadingLevel;
+        statistics.remainingJobs = loadingGraph ? loadingGraph->getRemainingJobCount() : 0;
+        statistics.residentAssets = residentAssets.size();
+        statistics.sharedAssets = sharedAssetCount;
+        return statistics;
+    }
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <json/json.hpp>
+#include "asset-job-graph.hpp"
+
+namespace our {
+
+    // Keeps the assets of the levels resident in the background so switching levels does not stall on loading.
+    // The assets of the scene config are shared by all the levels (weapons, enemies, shaders, ...) and stay loaded.
+    // Each level config can also list its own assets (in the same form as the scene assets) under "assets".
+    // Every level that is current or being prefetched holds one reference to each of its assets, and an asset is
+    // evicted once no level references it anymore, so the assets that two levels share are only loaded once.
+    // The cpu stages of a prefetch run on the TBB workers while the current level plays, and the uploads are
+    // spread over the frames with a time budget (see "update").
+    // The levels are numbered from 1 like Application::getLevelIndex.
+    class LevelStreamer {
+        struct ResidentAsset {
+            std::string type, name;
+            size_t references = 0;
+        };
+        struct LevelAssets {
+            nlohmann::json assets;
+            bool held = false;     // The level holds references to its assets
+            bool resident = false; // All of its assets are uploaded
+        };
+
+        // The resident assets identified by "type/name"
+        std::unordered_map<std::string, ResidentAsset> residentAssets;
+        std::vector<LevelAssets> levels;
+        size_t sharedAssetCount = 0;
+        int activeLevel = 0;
+
+        // The level whose assets are being loaded (0 if none) and the assets it still had to load when it started
+        // (the graph jobs reference this json so it must outlive them)
+        int loadingLevel = 0;
+        nlohmann::json loadingAssets;
+        std::unique_ptr<AssetJobGraph> loadingGraph;
+
+        LevelStreamer() = default;
+
+        static std::string getKey(const std::string& type, const std::string& name) { return type + "/" + name; }
+
+        // Adds one reference to each asset of the given json and returns the assets that are not resident yet
+        // (in the same form as the given json)
+        nlohmann::json acquire(const nlohmann::json& assets);
+        // Removes one reference from each asset of the given json and evicts the ones that are no longer referenced
+        // Returns the number of evicted assets
+        size_t release(const nlohmann::json& assets);
+        // Acquires the assets of the given level and starts loading the missing ones
+        void startLoading(int level);
+        // Blocks until the level that is being loaded is resident
+        void finishLoading();
+
+    public:
+        static LevelStreamer& getInstance() {
+            static LevelStreamer instance;
+            return instance;
+        }
+
+        LevelStreamer(const LevelStreamer&) = delete;
+        LevelStreamer& operator=(const LevelStreamer&) = delete;
+
+        // Loads the shared assets (they are never evicted) and remembers the asset set of each level
+        void initialize(const nlohmann::json& sharedAssets, const std::vector<nlohmann::json>& levelsConfigs);
+
+        // Makes the given level the current one, then starts loading "nextLevel" in the background (0 for none).
+        // This only blocks if the assets of the level are not resident yet (they were not prefetched or the prefetch
+        // did not finish). The assets that are referenced by neither of the two levels are evicted.
+        void activate(int level, int nextLevel = 0);
+
+        // Replaces the asset set of a level (see HotReload). If the level holds its assets, the new ones are loaded
+        // right away and the ones it no longer lists are released.
+        void reloadLevelAssets(int level, const nlohmann::json& assets);
+
+        // Uploads the prefetched assets whose cpu stage is done until the time budget runs out.
+        // It must be called once per frame from the OpenGL thread.
+        void update(double budgetMilliseconds);
+
+        bool isResident(int level) const;
+
+        struct Statistics {
+            int activeLevel = 0;
+            int loadingLevel = 0;
+            size_t remainingJobs = 0;  // The jobs of the loading level that are not uploaded yet
+            size_t residentAssets = 0; // Including the shared ones
+            size_t sharedAssets = 0;
+        };
+        Statistics getStatistics() const;
+    };
+
+}
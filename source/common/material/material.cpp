@@ -1,7 +1,9 @@
 #include "material.hpp"
 
 #include "../asset-loader.hpp"
+#include "../shader/shader-permutations.hpp"
 #include "deserialize-utils.hpp"
+#include <systems/clustered-lighting.hpp>
 #include <iostream>
 namespace our
 {
@@ -28,6 +30,43 @@ namespace our
         transparent = data.value("transparent", false);
     }
 
+    bool Material::validate(const std::string &name) const
+    {
+        if (!shader)
+        {
+            std::cerr << "[Material] ERROR: " << name << " uses an unknown shader" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Material::checkUniform(const std::string &name, const std::string &uniform, GLenum type) const
+    {
+        const ShaderReflection::Uniform *reflected = shader->getReflection().findUniform(uniform);
+        if (reflected && reflected->type != type)
+        {
+            std::cerr << "[Material] ERROR: " << name << " sends \"" << uniform << "\" as "
+                      << ShaderReflection::getTypeName(type) << " but the shader declares it as "
+                      << ShaderReflection::getTypeName(reflected->type) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Material::checkTexture(const std::string &name, const std::string &sampler, const Texture2D *texture) const
+    {
+        bool sampled = shader->getReflection().hasSampler(sampler);
+        if (sampled && !texture)
+        {
+            std::cerr << "[Material] ERROR: " << name << " has no texture for \"" << sampler << "\"" << std::endl;
+            return false;
+        }
+        if (!sampled && texture)
+            std::cerr << "[Material] WARNING: " << name << " has a texture for \"" << sampler
+                      << "\" but its shader never samples it" << std::endl;
+        return true;
+    }
+
     // This function should call the setup of its parent and
     // set the "tint" uniform to the value in the member variable tint
     void TintedMaterial::setup() const
@@ -46,6 +85,11 @@ namespace our
         tint = data.value("tint", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
     }
 
+    bool TintedMaterial::validate(const std::string &name) const
+    {
+        return Material::validate(name) && checkUniform(name, "tint", GL_FLOAT_VEC4);
+    }
+
     void TintedMaterial::teardown() {
         glBlendEquation(GL_FUNC_ADD);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -76,17 +120,27 @@ namespace our
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
     }
 
+    bool TexturedMaterial::validate(const std::string &name) const
+    {
+        return TintedMaterial::validate(name) && checkUniform(name, "alphaThreshold", GL_FLOAT) &&
+               checkTexture(name, "tex", texture);
+    }
+
+    // The units of the lit materials are shared by all of them, so a unit without sampler must not keep the one of
+    // the previous material
+    static void bindSampler(GLuint unit, const Sampler *sampler)
+    {
+        if (sampler)
+            sampler->bind(unit);
+        else
+            Sampler::unbind(unit);
+    }
+
     void LitMaterial::setup() const
     {
         TintedMaterial::setup();
 
-        shader->set("material.useTextureAlbedo", useTextureAlbedo);
-        shader->set("material.useTextureMetallic", useTextureMetallic);
-        shader->set("material.useTextureRoughness", useTextureRoughness);
-        shader->set("material.useTextureMetallicRoughness", useTextureMetallicRoughness);
-        shader->set("material.useTextureNormal", useTextureNormal);
-        shader->set("material.useTextureAmbientOcclusion", useTextureAmbientOcclusion);
-        shader->set("material.useTextureEmissive", useTextureEmissive);
+        // The "useTexture..." flags are compiled into the shader permutation (see "selectVariant")
         shader->set("material.albedo", albedo);
         shader->set("material.metallic", metallic);
         shader->set("material.roughness", roughness);
@@ -95,90 +149,60 @@ namespace our
         shader->set("irradianceMap", our::TextureUnits::TEXTURE_UNIT_IRRADIANCE);
         shader->set("prefilterMap", our::TextureUnits::TEXTURE_UNIT_PREFILTER);
         shader->set("brdfLUT", our::TextureUnits::TEXTURE_UNIT_BRDF);
-        shader->set("lightCount", static_cast<int>(lights.size()));
-        setupLight();
+        ClusteredLighting& clusteredLighting = ClusteredLighting::getInstance();
+        clusteredLighting.setupShader(shader, allLights ? ClusteredLighting::ALL_LIGHTS_MASK
+                                                        : clusteredLighting.getLightMask(lights));
         if (useTextureAlbedo)
         {
             glActiveTexture(GL_TEXTURE0 + our::TextureUnits::TEXTURE_UNIT_ALBEDO);
             textureAlbedo->bind();
+            bindSampler(our::TextureUnits::TEXTURE_UNIT_ALBEDO, samplerAlbedo);
             shader->set("material.textureAlbedo", our::TextureUnits::TEXTURE_UNIT_ALBEDO);
         }
         if (useTextureMetallic)
         {
             glActiveTexture(GL_TEXTURE0 + our::TextureUnits::TEXTURE_UNIT_METALLIC);
             textureMetallic->bind();
+            bindSampler(our::TextureUnits::TEXTURE_UNIT_METALLIC, samplerMetallic);
             shader->set("material.textureMetallic", our::TextureUnits::TEXTURE_UNIT_METALLIC);
         }
         if (useTextureRoughness)
         {
             glActiveTexture(GL_TEXTURE0 + our::TextureUnits::TEXTURE_UNIT_ROUGHNESS);
             textureRoughness->bind();
+            bindSampler(our::TextureUnits::TEXTURE_UNIT_ROUGHNESS, samplerRoughness);
             shader->set("material.textureRoughness", our::TextureUnits::TEXTURE_UNIT_ROUGHNESS);
         }
         if (useTextureMetallicRoughness)
         {
             glActiveTexture(GL_TEXTURE0 + our::TextureUnits::TEXTURE_UNIT_METALLIC_ROUGHNESS);
             textureMetallicRoughness->bind();
+            bindSampler(our::TextureUnits::TEXTURE_UNIT_METALLIC_ROUGHNESS, samplerMetallicRoughness);
             shader->set("material.textureMetallicRoughness", our::TextureUnits::TEXTURE_UNIT_METALLIC_ROUGHNESS);
         }
         if (useTextureNormal)
         {
             glActiveTexture(GL_TEXTURE0 + our::TextureUnits::TEXTURE_UNIT_NORMAL);
             textureNormal->bind();
+            bindSampler(our::TextureUnits::TEXTURE_UNIT_NORMAL, samplerNormal);
             shader->set("material.textureNormal", our::TextureUnits::TEXTURE_UNIT_NORMAL);
         }
         if (useTextureAmbientOcclusion)
         {
             glActiveTexture(GL_TEXTURE0 + our::TextureUnits::TEXTURE_UNIT_AMBIENT_OCCLUSION);
             textureAmbientOcclusion->bind();
+            bindSampler(our::TextureUnits::TEXTURE_UNIT_AMBIENT_OCCLUSION, samplerAmbientOcclusion);
             shader->set("material.textureAmbientOcclusion", our::TextureUnits::TEXTURE_UNIT_AMBIENT_OCCLUSION);
         }
         if (useTextureEmissive)
         {
             glActiveTexture(GL_TEXTURE0 + our::TextureUnits::TEXTURE_UNIT_EMISSIVE);
             textureEmissive->bind();
+            bindSampler(our::TextureUnits::TEXTURE_UNIT_EMISSIVE, samplerEmissive);
             shader->set("material.textureEmissive", our::TextureUnits::TEXTURE_UNIT_EMISSIVE);
         }
     }
 
-    void LitMaterial::setupLight() const
-    {
-        int light_index = 0;
-        for (const auto &light : lights)
-        {
-            if (light->enabled)
-            {
-                std::string prefix = "lights[" + std::to_string(light_index) + "].";
-
-                shader->set(prefix + "color", light->color);
-                shader->set(prefix + "type", int(light->type));
-     
-                switch (light->type)
-                {
-                case our::LightType::DIRECTIONAL:
-                    shader->set(prefix + "direction", normalize(light->direction));
-                    break;
-                case our::LightType::POINT:
-                    shader->set(prefix + "position", light->position);
-                    shader->set(prefix + "attenuation_constant", light->attenuation.constant);
-                    shader->set(prefix + "attenuation_linear", light->attenuation.linear);
-                    shader->set(prefix + "attenuation_quadratic", light->attenuation.quadratic);
-                    break;
-                case our::LightType::SPOT:
-                    shader->set(prefix + "position", light->position);
-                    shader->set(prefix + "direction", glm::normalize(light->direction));
-                    shader->set(prefix + "attenuation_constant", light->attenuation.constant);
-                    shader->set(prefix + "attenuation_linear", light->attenuation.linear);
-                    shader->set(prefix + "attenuation_quadratic", light->attenuation.quadratic);
-                    shader->set(prefix + "inner_angle", light->spot_angle.inner);
-                    shader->set(prefix + "outer_angle", light->spot_angle.outer);
-                    break;
-                }
-            }
-            light_index++;
-        }
-    }
-
     void LitMaterial::deserialize(const nlohmann::json &data)
     {
         TintedMaterial::deserialize(data);
@@ -203,23 +227,60 @@ namespace our
         textureNormal = AssetLoader<Texture2D>::get(data.value("textureNormal", ""));
         textureAmbientOcclusion = AssetLoader<Texture2D>::get(data.value("textureAmbientOcclusion", ""));
         textureEmissive = AssetLoader<Texture2D>::get(data.value("textureEmissive", ""));
+        lights.clear();
+        if (data.contains("lights") && data["lights"].is_array())
+            lights = data["lights"].get<std::vector<std::string>>();
+        selectVariant();
+    }
 
-        if (data.contains("lights"))
-        {
-            if (data["lights"].is_array())
-            {
-                lights.clear();
-                auto lightNames = data["lights"].get<std::vector<std::string>>();
-                for (const auto &name : lightNames)
-                {
-                    auto lightPtr = AssetLoader<Light>::get(name);
-                    if (lightPtr)
-                    {
-                        lights.push_back(lightPtr);
-                    }
-                }
-            }
-        }
+    std::vector<std::string> LitMaterial::getDefines() const
+    {
+        std::vector<std::string> defines;
+        if (useTextureAlbedo)
+            defines.push_back("USE_TEXTURE_ALBEDO");
+        if (useTextureMetallic)
+            defines.push_back("USE_TEXTURE_METALLIC");
+        if (useTextureRoughness)
+            defines.push_back("USE_TEXTURE_ROUGHNESS");
+        if (useTextureMetallicRoughness)
+            defines.push_back("USE_TEXTURE_METALLIC_ROUGHNESS");
+        if (useTextureNormal)
+            defines.push_back("USE_TEXTURE_NORMAL");
+        if (useTextureAmbientOcclusion)
+            defines.push_back("USE_TEXTURE_AMBIENT_OCCLUSION");
+        if (useTextureEmissive)
+            defines.push_back("USE_TEXTURE_EMISSIVE");
+        if (skinned)
+            defines.push_back("SKINNED");
+        return defines;
+    }
+
+    void LitMaterial::selectVariant()
+    {
+        shader = ShaderPermutations::getInstance().getVariant(shader, getDefines());
+    }
+
+    bool LitMaterial::validate(const std::string &name) const
+    {
+        if (!TintedMaterial::validate(name))
+            return false;
+        // Every check runs so that all the problems are printed at once
+        bool valid = checkUniform(name, "material.albedo", GL_FLOAT_VEC3);
+        valid &= checkUniform(name, "material.metallic", GL_FLOAT);
+        valid &= checkUniform(name, "material.roughness", GL_FLOAT);
+        valid &= checkUniform(name, "material.ambientOcclusion", GL_FLOAT);
+        valid &= checkUniform(name, "material.emission", GL_FLOAT_VEC3);
+        // The textures are only bound when their flag is set
+        valid &= checkTexture(name, "material.textureAlbedo", useTextureAlbedo ? textureAlbedo : nullptr);
+        valid &= checkTexture(name, "material.textureMetallic", useTextureMetallic ? textureMetallic : nullptr);
+        valid &= checkTexture(name, "material.textureRoughness", useTextureRoughness ? textureRoughness : nullptr);
+        valid &= checkTexture(name, "material.textureMetallicRoughness",
+                              useTextureMetallicRoughness ? textureMetallicRoughness : nullptr);
+        valid &= checkTexture(name, "material.textureNormal", useTextureNormal ? textureNormal : nullptr);
+        valid &= checkTexture(name, "material.textureAmbientOcclusion",
+                              useTextureAmbientOcclusion ? textureAmbientOcclusion : nullptr);
+        valid &= checkTexture(name, "material.textureEmissive", useTextureEmissive ? textureEmissive : nullptr);
+        return valid;
     }
 
 }
@@ -9,6 +9,8 @@
 
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
+#include <string>
+#include <vector>
 
 
 namespace our {
@@ -29,6 +31,16 @@ namespace our {
         virtual void setup() const;
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json& data);
+        // This function checks the material against the reflection of its shader (called when it is loaded)
+        // It returns false (and prints why) if the shader reads a uniform with another type than the one the
+        // material sends, or samples a texture the material doesn't have. The material's name is for the messages.
+        virtual bool validate(const std::string& name) const;
+
+    protected:
+        // Only the uniforms the shader uses are checked, the others are ignored by "set" anyway
+        bool checkUniform(const std::string& name, const std::string& uniform, GLenum type) const;
+        // Also warns about a texture the shader never samples
+        bool checkTexture(const std::string& name, const std::string& sampler, const Texture2D* texture) const;
     };
 
     // This material adds a uniform for a tint (a color that will be sent to the shader)
@@ -40,6 +52,7 @@ namespace our {
         void teardown();
         void setup() const override;
         void deserialize(const nlohmann::json& data) override;
+        bool validate(const std::string& name) const override;
     };
 
     // This material adds two uniforms (besides the tint from Tinted Material)
@@ -55,12 +68,16 @@ namespace our {
 
         void setup() const override;
         void deserialize(const nlohmann::json& data) override;
+        bool validate(const std::string& name) const override;
     };
 
     // LitMaterial: Supports full PBR-like lighting with multiple textures
+    // The lights are gathered per frame by the ClusteredLighting system, the material only selects which of them
+    // light it (the "lights" of its json, or all of them for the materials of the models)
+    // The "useTexture..." flags are compiled into the shader: the material uses the permutation of its shader with
+    // a "USE_TEXTURE_..." define for each of them (see ShaderPermutations), so an untextured material runs a shader
+    // without any texture fetch.
     class LitMaterial : public TintedMaterial {
-        private:
-            void setupLight() const;     
         public:
             bool useTextureAlbedo = false;
             bool useTextureMetallic = false;
@@ -69,6 +86,14 @@ namespace our {
             bool useTextureNormal = false;
             bool useTextureAmbientOcclusion = false;
             bool useTextureEmissive = false;
+            // Set by the models that have a skeleton: the vertices are skinned by the "SKINNED" permutation
+            // with the matrices of the drawn instance (see SkinningBuffer)
+            bool skinned = false;
+            // The names of the lights that light the material, ignored if "allLights" is set. They are looked up when
+            // the material is drawn: the lights of a level are only created once it is current, after its materials
+            // (see LevelStreamer::activate)
+            std::vector<std::string> lights;
+            bool allLights = false;
         
             glm::vec3 albedo = glm::vec3(1.0, 1.0, 1.0);
             float metallic = 0.2f;
@@ -83,11 +108,23 @@ namespace our {
             Texture2D* textureNormal;
             Texture2D* textureAmbientOcclusion;
             Texture2D* textureEmissive;
-
-            std::vector<our::Light*> lights;
+            // The sampler of each texture (nullptr to sample with the state of the texture itself)
+            Sampler* samplerAlbedo = nullptr;
+            Sampler* samplerMetallic = nullptr;
+            Sampler* samplerRoughness = nullptr;
+            Sampler* samplerMetallicRoughness = nullptr;
+            Sampler* samplerNormal = nullptr;
+            Sampler* samplerAmbientOcclusion = nullptr;
+            Sampler* samplerEmissive = nullptr;
 
             void setup() const override;
             void deserialize(const nlohmann::json& data) override;
+            bool validate(const std::string& name) const override;
+
+            // The permutation defines matching the "useTexture..." flags (and "skinned")
+            std::vector<std::string> getDefines() const;
+            // Replaces the shader by its permutation for the current flags (call it after changing them)
+            void selectVariant();
         };
 
     // This function returns a new material instance based on the given type
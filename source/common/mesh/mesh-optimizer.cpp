@@ -0,0 +1,285 @@
+#include "mesh-optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace our::mesh_optimizer {
+
+    // The parameters of Forsyth's vertex scoring
+    static constexpr size_t SCORING_CACHE_SIZE = 32;
+    static constexpr float CACHE_DECAY_POWER = 1.5f;
+    static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+    static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+    // A vertex scores higher if it is recently used (so its triangles hit the cache)
+    // and if it has few triangles left (so it does not stay around as a lone vertex)
+    static float getVertexScore(int cachePosition, uint32_t liveTriangles) {
+        if (liveTriangles == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // The vertices of the last triangle are penalized so the strip does not fold back on itself
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                float scaler = 1.0f / (SCORING_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        return score + VALENCE_BOOST_SCALE * std::pow(float(liveTriangles), -VALENCE_BOOST_POWER);
+    }
+
+    VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                             size_t cacheSize) {
+        VertexCacheStatistics statistics;
+        statistics.triangles = indexCount / 3;
+
+        // A vertex is in the FIFO cache if less than "cacheSize" vertices entered the cache after it
+        std::vector<size_t> entryTime(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        size_t time = cacheSize + 1;
+        for (size_t i = 0; i < indexCount; i++) {
+            uint32_t vertex = indices[i];
+            if (vertex >= vertexCount)
+                continue;
+            if (!referenced[vertex]) {
+                referenced[vertex] = true;
+                statistics.vertices++;
+            }
+            if (time - entryTime[vertex] > cacheSize) {
+                entryTime[vertex] = time++;
+                statistics.transformed++;
+            }
+        }
+        return statistics;
+    }
+
+    void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return;
+
+        // The triangles that use each vertex, stored back to back. The live (not emitted yet) triangles of a vertex
+        // are kept at the start of its range so removing a triangle is a swap.
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            liveTriangles[indices[i]]++;
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+            adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangles[vertex];
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t triangle = 0; triangle < triangleCount; triangle++)
+                for (size_t k = 0; k < 3; k++)
+                    adjacency[fill[indices[triangle * 3 + k]]++] = static_cast<uint32_t>(triangle);
+        }
+
+        std::vector<int> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+            vertexScores[vertex] = getVertexScore(-1, liveTriangles[vertex]);
+        std::vector<float> triangleScores(triangleCount);
+        for (size_t triangle = 0; triangle < triangleCount; triangle++)
+            triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] +
+                                       vertexScores[indices[triangle * 3 + 2]];
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> result;
+        result.reserve(triangleCount * 3);
+        std::vector<uint32_t> cache, nextCache;
+        cache.reserve(SCORING_CACHE_SIZE + 3);
+        nextCache.reserve(SCORING_CACHE_SIZE + 3);
+
+        // Start with the best triangle, then only the triangles of the cached vertices are considered.
+        // When none of them is left (a dead end), continue with the first triangle that was not emitted yet.
+        size_t bestTriangle = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+        size_t deadEndCursor = 0;
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            if (bestTriangle == triangleCount) {
+                while (emitted[deadEndCursor])
+                    deadEndCursor++;
+                bestTriangle = deadEndCursor;
+            }
+
+            const uint32_t* triangleIndices = indices + bestTriangle * 3;
+            emitted[bestTriangle] = true;
+            nextCache.clear();
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t vertex = triangleIndices[k];
+                result.push_back(vertex);
+                if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end())
+                    nextCache.push_back(vertex);
+
+                uint32_t* begin = adjacency.data() + adjacencyOffsets[vertex];
+                uint32_t* end = begin + liveTriangles[vertex];
+                uint32_t* it = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+                if (it != end) {
+                    std::swap(*it, *(end - 1));
+                    liveTriangles[vertex]--;
+                }
+            }
+            size_t triangleVertexCount = nextCache.size();
+            for (uint32_t vertex : cache)
+                if (std::find(nextCache.begin(), nextCache.begin() + triangleVertexCount, vertex) ==
+                    nextCache.begin() + triangleVertexCount)
+                    nextCache.push_back(vertex);
+
+            // Update the scores of the vertices that moved in the cache (including the ones pushed out of it)
+            for (size_t position = 0; position < nextCache.size(); position++) {
+                uint32_t vertex = nextCache[position];
+                cachePositions[vertex] = position < SCORING_CACHE_SIZE ? static_cast<int>(position) : -1;
+                float score = getVertexScore(cachePositions[vertex], liveTriangles[vertex]);
+                float delta = score - vertexScores[vertex];
+                vertexScores[vertex] = score;
+                const uint32_t* begin = adjacency.data() + adjacencyOffsets[vertex];
+                for (uint32_t i = 0; i < liveTriangles[vertex]; i++)
+                    triangleScores[begin[i]] += delta;
+            }
+            if (nextCache.size() > SCORING_CACHE_SIZE)
+                nextCache.resize(SCORING_CACHE_SIZE);
+
+            // The next triangle is the best live triangle of the cached vertices
+            float bestScore = -std::numeric_limits<float>::infinity();
+            bestTriangle = triangleCount;
+            for (uint32_t vertex : nextCache) {
+                const uint32_t* begin = adjacency.data() + adjacencyOffsets[vertex];
+                for (uint32_t i = 0; i < liveTriangles[vertex]; i++) {
+                    if (triangleScores[begin[i]] > bestScore) {
+                        bestScore = triangleScores[begin[i]];
+                        bestTriangle = begin[i];
+                    }
+                }
+            }
+            std::swap(cache, nextCache);
+        }
+
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+                          float threshold) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount < 2)
+            return;
+
+        // Split the triangles into clusters where all three vertices of a triangle miss the cache,
+        // the cache is cold at these points anyway so reordering the clusters barely changes the ACMR
+        std::vector<size_t> clusterStarts;
+        {
+            std::vector<size_t> entryTime(vertexCount, 0);
+            size_t time = ANALYSIS_CACHE_SIZE + 1;
+            for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+                int misses = 0;
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t vertex = indices[triangle * 3 + k];
+                    if (time - entryTime[vertex] > ANALYSIS_CACHE_SIZE) {
+                        entryTime[vertex] = time++;
+                        misses++;
+                    }
+                }
+                if (triangle == 0 || misses == 3)
+                    clusterStarts.push_back(triangle);
+            }
+        }
+        if (clusterStarts.size() < 2)
+            return;
+        clusterStarts.push_back(triangleCount);
+        size_t clusterCount = clusterStarts.size() - 1;
+
+        // The area weighted centroid and normal of each cluster (the cross product is twice the area times the normal)
+        std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+        std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+        std::vector<float> clusterAreas(clusterCount, 0.0f);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+            for (size_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++) {
+                const glm::vec3& p0 = vertices[indices[triangle * 3]].position;
+                const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].position;
+                const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                clusterNormals[cluster] += normal;
+                clusterCentroids[cluster] += (p0 + p1 + p2) * (area / 3.0f);
+                clusterAreas[cluster] += area;
+            }
+            meshCentroid += clusterCentroids[cluster];
+            meshArea += clusterAreas[cluster];
+        }
+        if (meshArea <= 0.0f)
+            return;
+        meshCentroid /= meshArea;
+
+        // The clusters that face away from the center are on the outside of the mesh, so they are drawn first
+        std::vector<float> sortKeys(clusterCount, 0.0f);
+        for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+            if (clusterAreas[cluster] <= 0.0f)
+                continue;
+            glm::vec3 centroid = clusterCentroids[cluster] / clusterAreas[cluster];
+            float normalLength = glm::length(clusterNormals[cluster]);
+            if (normalLength > 0.0f)
+                sortKeys[cluster] = glm::dot(centroid - meshCentroid, clusterNormals[cluster] / normalLength);
+        }
+        std::vector<size_t> clusterOrder(clusterCount);
+        std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+        std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+                         [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(triangleCount * 3);
+        for (size_t cluster : clusterOrder)
+            result.insert(result.end(), indices + clusterStarts[cluster] * 3, indices + clusterStarts[cluster + 1] * 3);
+
+        VertexCacheStatistics before = analyzeVertexCache(indices, triangleCount * 3, vertexCount);
+        VertexCacheStatistics after = analyzeVertexCache(result.data(), result.size(), vertexCount);
+        if (after.transformed <= before.transformed * threshold)
+            std::copy(result.begin(), result.end(), indices);
+    }
+
+    void optimizeVertexFetch(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount) {
+        constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> remap(vertexCount, UNUSED);
+        uint32_t next = 0;
+        for (size_t i = 0; i < indexCount; i++) {
+            uint32_t& newIndex = remap[indices[i]];
+            if (newIndex == UNUSED)
+                newIndex = next++;
+            indices[i] = newIndex;
+        }
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+            if (remap[vertex] == UNUSED)
+                remap[vertex] = next++;
+
+        std::vector<Vertex> original(vertices, vertices + vertexCount);
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+            vertices[remap[vertex]] = original[vertex];
+    }
+
+    OptimizationResult optimizeMesh(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount) {
+        OptimizationResult result;
+        result.before = analyzeVertexCache(indices, indexCount, vertexCount);
+        result.after = result.before;
+        if (indexCount % 3 != 0 || vertexCount > std::numeric_limits<uint32_t>::max())
+            return result;
+        for (size_t i = 0; i < indexCount; i++) {
+            if (indices[i] >= vertexCount) {
+                std::cerr << "[MeshOptimizer] ERROR: Index " << indices[i] << " is out of range (" << vertexCount
+                          << " vertices), the mesh is left as is" << std::endl;
+                return result;
+            }
+        }
+
+        optimizeVertexCache(indices, indexCount, vertexCount);
+        optimizeOverdraw(indices, indexCount, vertices, vertexCount);
+        optimizeVertexFetch(vertices, vertexCount, indices, indexCount);
+        result.after = analyzeVertexCache(indices, indexCount, vertexCount);
+        return result;
+    }
+
+}
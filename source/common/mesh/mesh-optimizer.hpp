@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "vertex.hpp"
+
+// Reorders the triangles and vertices of indexed triangle lists so the GPU does less work drawing them:
+//  - Vertex cache: the triangles are reordered so consecutive triangles share vertices, which lets the
+//    post-transform cache skip running the vertex shader again (Forsyth's "Linear-Speed Vertex Cache Optimisation").
+//  - Overdraw: the triangles are then grouped into clusters at the points where the cache is flushed anyway, and the
+//    clusters are sorted so the ones facing away from the center of the mesh (most likely to occlude the others)
+//    are drawn first (Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+//  - Vertex fetch: the vertices are reordered in the order they are first used so the fetches stay local in memory.
+// The result is the same mesh (same triangles with the same winding), only the order changes.
+// Nothing in here depends on OpenGL so it can run in the cooker and on worker threads.
+namespace our::mesh_optimizer {
+
+    struct VertexCacheStatistics {
+        size_t triangles = 0;
+        size_t vertices = 0;    // The vertices referenced by the indices
+        size_t transformed = 0; // The vertex shader invocations (cache misses)
+        // Average Cache Miss Ratio: transformed vertices per triangle (0.5 is ideal, 3 is the worst)
+        float getACMR() const { return triangles ? float(transformed) / triangles : 0.0f; }
+        // Average Transformed to Vertex Ratio: transformed vertices per vertex (1 is ideal)
+        float getATVR() const { return vertices ? float(transformed) / vertices : 0.0f; }
+        VertexCacheStatistics& operator+=(const VertexCacheStatistics& other) {
+            triangles += other.triangles;
+            vertices += other.vertices;
+            transformed += other.transformed;
+            return *this;
+        }
+    };
+
+    // The size of the FIFO cache used to measure the meshes
+    constexpr size_t ANALYSIS_CACHE_SIZE = 16;
+
+    // Simulates a FIFO post-transform cache of the given size while drawing the triangles
+    VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                             size_t cacheSize = ANALYSIS_CACHE_SIZE);
+
+    // Reorders the triangles for the post-transform vertex cache
+    void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+    // Reorders the clusters of a vertex cache optimized triangle list to reduce overdraw
+    // A new order is only kept if the ACMR does not grow by more than the threshold (1.05 allows 5% more misses)
+    void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+                          float threshold = 1.05f);
+    // Reorders the vertices in the order the triangles use them and remaps the indices
+    // The vertices that are not used by any triangle are moved after the used ones
+    void optimizeVertexFetch(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount);
+
+    // Runs the three passes in order and returns the statistics of the mesh before and after
+    struct OptimizationResult {
+        VertexCacheStatistics before, after;
+    };
+    OptimizationResult optimizeMesh(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount);
+
+}
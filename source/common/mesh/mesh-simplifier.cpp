@@ -0,0 +1,275 @@
+#include "mesh-simplifier.hpp"
+#include "mesh-optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace our::mesh_simplifier {
+
+    // The sum of the squared distances to a set of planes (weighted by the area of their triangles):
+    // Q(p) = p^T A p + 2 b.p + c, with A symmetric so only 10 coefficients are stored
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        static Quadric fromPlane(const glm::dvec3& normal, double distance, double weight) {
+            Quadric q;
+            q.a00 = normal.x * normal.x * weight;
+            q.a01 = normal.x * normal.y * weight;
+            q.a02 = normal.x * normal.z * weight;
+            q.a11 = normal.y * normal.y * weight;
+            q.a12 = normal.y * normal.z * weight;
+            q.a22 = normal.z * normal.z * weight;
+            q.b0 = normal.x * distance * weight;
+            q.b1 = normal.y * distance * weight;
+            q.b2 = normal.z * distance * weight;
+            q.c = distance * distance * weight;
+            q.weight = weight;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+
+        // The average squared distance of the point to the planes
+        double evaluate(const glm::dvec3& p) const {
+            double value = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+                           2 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+                           2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return weight > 0 ? std::max(value, 0.0) / weight : 0.0;
+        }
+    };
+
+    static uint64_t getEdgeKey(uint32_t from, uint32_t to) { return (uint64_t(from) << 32) | to; }
+
+    std::vector<uint32_t> simplify(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                                   size_t targetIndexCount, float maxError, float* resultError) {
+        std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+        if (resultError)
+            *resultError = 0.0f;
+        if (result.empty() || result.size() <= targetIndexCount)
+            return result;
+
+        // The errors are relative to the radius of the mesh
+        glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+        for (uint32_t index : result) {
+            minimum = glm::min(minimum, vertices[index].position);
+            maximum = glm::max(maximum, vertices[index].position);
+        }
+        double radius = glm::length(glm::dvec3(maximum - minimum)) * 0.5;
+        if (radius <= 0)
+            return result;
+        double maxSquaredError = double(maxError) * maxError * radius * radius;
+
+        // The vertices that share their position with another vertex are on a seam and stay where they are
+        std::vector<bool> locked(vertexCount, false);
+        {
+            std::unordered_map<glm::vec3, uint32_t> firstVertexAt;
+            for (uint32_t index : result) {
+                auto [it, inserted] = firstVertexAt.try_emplace(vertices[index].position, index);
+                if (!inserted && it->second != index) {
+                    locked[index] = true;
+                    locked[it->second] = true;
+                }
+            }
+        }
+
+        // The edges that are used by a single triangle (in one direction) are on the border of the mesh
+        auto findBorderEdges = [&result]() {
+            std::unordered_set<uint64_t> directedEdges;
+            directedEdges.reserve(result.size());
+            for (size_t i = 0; i < result.size(); i += 3)
+                for (size_t k = 0; k < 3; k++)
+                    directedEdges.insert(getEdgeKey(result[i + k], result[i + (k + 1) % 3]));
+            std::unordered_set<uint64_t> borderEdges;
+            for (uint64_t edge : directedEdges) {
+                uint32_t from = uint32_t(edge >> 32), to = uint32_t(edge);
+                if (!directedEdges.count(getEdgeKey(to, from))) {
+                    borderEdges.insert(edge);
+                    borderEdges.insert(getEdgeKey(to, from));
+                }
+            }
+            return borderEdges;
+        };
+
+        // Each vertex starts with the planes of its triangles, the border edges add a plane perpendicular to their
+        // triangle so that moving a border vertex away from the border is expensive
+        std::vector<Quadric> quadrics(vertexCount);
+        std::unordered_set<uint64_t> borderEdges = findBorderEdges();
+        std::vector<bool> onBorder(vertexCount, false);
+        for (size_t i = 0; i < result.size(); i += 3) {
+            glm::dvec3 p[3];
+            for (size_t k = 0; k < 3; k++)
+                p[k] = glm::dvec3(vertices[result[i + k]].position);
+            glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            double area = glm::length(normal);
+            if (area <= 0)
+                continue;
+            normal /= area;
+            Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, p[0]), area);
+            for (size_t k = 0; k < 3; k++)
+                quadrics[result[i + k]] += plane;
+
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t from = result[i + k], to = result[i + (k + 1) % 3];
+                if (!borderEdges.count(getEdgeKey(from, to)))
+                    continue;
+                onBorder[from] = onBorder[to] = true;
+                glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+                double length = glm::length(edge);
+                if (length <= 0)
+                    continue;
+                glm::dvec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+                Quadric borderPlane = Quadric::fromPlane(borderNormal, -glm::dot(borderNormal, p[k]), length * length);
+                quadrics[from] += borderPlane;
+                quadrics[to] += borderPlane;
+            }
+        }
+
+        struct Collapse {
+            uint32_t from, to;
+            double cost;
+        };
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1), triangleFill(vertexCount), adjacency;
+        std::vector<bool> touched(vertexCount);
+        std::vector<uint32_t> remap(vertexCount);
+        double reachedSquaredError = 0;
+
+        // Each pass collapses the cheapest edges whose neighbourhoods don't overlap, then the mesh is rebuilt
+        while (result.size() > targetIndexCount) {
+            size_t triangleCount = result.size() / 3;
+
+            // The triangles around each vertex
+            std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+            for (uint32_t index : result)
+                triangleOffsets[index + 1]++;
+            for (size_t vertex = 0; vertex < vertexCount; vertex++)
+                triangleOffsets[vertex + 1] += triangleOffsets[vertex];
+            std::copy(triangleOffsets.begin(), triangleOffsets.end() - 1, triangleFill.begin());
+            adjacency.resize(result.size());
+            for (size_t i = 0; i < result.size(); i++)
+                adjacency[triangleFill[result[i]]++] = uint32_t(i / 3);
+
+            borderEdges = findBorderEdges();
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                    // Each edge is visited once from each of its triangles, so both directions are tried
+                    for (auto [from, to] : {std::pair{a, b}, std::pair{b, a}}) {
+                        if (locked[from])
+                            continue;
+                        if (onBorder[from] && !borderEdges.count(getEdgeKey(from, to)))
+                            continue;
+                        double cost = quadrics[from].evaluate(glm::dvec3(vertices[to].position));
+                        collapses.push_back({from, to, cost});
+                    }
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse& first, const Collapse& second) { return first.cost < second.cost; });
+
+            // A collapse removes about two triangles
+            size_t wantedCollapses = (triangleCount - targetIndexCount / 3 + 1) / 2;
+            size_t collapseCount = 0;
+            std::fill(touched.begin(), touched.end(), false);
+            for (size_t vertex = 0; vertex < vertexCount; vertex++)
+                remap[vertex] = uint32_t(vertex);
+
+            for (const Collapse& collapse : collapses) {
+                if (collapseCount >= wantedCollapses || collapse.cost > maxSquaredError)
+                    break;
+                if (touched[collapse.from] || touched[collapse.to])
+                    continue;
+
+                // Reject the collapse if it flips a triangle that keeps existing
+                bool flips = false;
+                glm::vec3 target = vertices[collapse.to].position;
+                for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; t++) {
+                    const uint32_t* triangle = result.data() + adjacency[t] * 3;
+                    if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                        continue;
+                    glm::vec3 before[3], after[3];
+                    for (size_t k = 0; k < 3; k++) {
+                        before[k] = vertices[triangle[k]].position;
+                        after[k] = triangle[k] == collapse.from ? target : before[k];
+                    }
+                    glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+                }
+                if (flips)
+                    continue;
+
+                // The triangles around the collapsed vertex change, so their vertices wait for the next pass
+                for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+                    const uint32_t* triangle = result.data() + adjacency[t] * 3;
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+                }
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to] += quadrics[collapse.from];
+                reachedSquaredError = std::max(reachedSquaredError, collapse.cost);
+                collapseCount++;
+            }
+            if (collapseCount == 0)
+                break;
+
+            // Apply the collapses and drop the triangles that became degenerate
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+                if (a == b || b == c || c == a)
+                    continue;
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        if (resultError)
+            *resultError = float(std::sqrt(reachedSquaredError) / radius);
+        return result;
+    }
+
+    std::vector<MeshLod> generateLods(const Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& indices) {
+        std::vector<MeshLod> lods;
+        MeshLod original;
+        original.indexCount = uint32_t(indices.size());
+        lods.push_back(original);
+
+        while (lods.size() < MAX_LOD_COUNT) {
+            const MeshLod& previous = lods.back();
+            size_t target = size_t(previous.indexCount / 3 * LOD_REDUCTION) * 3;
+            float error = 0.0f;
+            std::vector<uint32_t> simplified = simplify(vertices, vertexCount, indices.data() + previous.firstIndex,
+                                                        previous.indexCount, target, MAX_LOD_ERROR, &error);
+            // Not worth a level if it does not remove at least a quarter of the triangles of the previous one
+            if (simplified.empty() || simplified.size() > previous.indexCount * 3 / 4)
+                break;
+            mesh_optimizer::optimizeVertexCache(simplified.data(), simplified.size(), vertexCount);
+
+            MeshLod lod;
+            lod.firstIndex = uint32_t(indices.size());
+            lod.indexCount = uint32_t(simplified.size());
+            // The levels are simplified from each other, so their errors add up
+            lod.error = previous.error + error;
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            lods.push_back(lod);
+        }
+        return lods;
+    }
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "vertex.hpp"
+
+namespace our {
+
+    // A level of detail of a mesh: a range of its element buffer that draws a simplified version of the mesh.
+    // All the levels of a mesh share its vertices, so switching level only changes the range that is drawn.
+    struct MeshLod {
+        uint32_t firstIndex = 0, indexCount = 0;
+        // The largest distance between the simplified surface and the original one,
+        // relative to the radius of the bounding sphere of the mesh (0 for the original mesh)
+        float error = 0.0f;
+    };
+
+}
+
+// Simplifies meshes with edge collapses ordered by a quadric error metric (Garland & Heckbert "Surface
+// Simplification Using Quadric Error Metrics"). A vertex is always collapsed onto one of its neighbours, so the
+// simplified triangles reuse the vertices of the original mesh and only the indices change.
+// The vertices that have the same position as another vertex (UV or normal seams) are never moved so the seams
+// don't tear, and the vertices on the border of open meshes only move along the border.
+// Nothing in here depends on OpenGL so it can run in the cooker and on worker threads.
+namespace our::mesh_simplifier {
+
+    // The number of levels generated for each mesh (including the original one)
+    constexpr size_t MAX_LOD_COUNT = 4;
+    // Each level targets this fraction of the triangles of the previous one
+    constexpr float LOD_REDUCTION = 0.5f;
+    // The largest relative error a level can reach
+    constexpr float MAX_LOD_ERROR = 0.1f;
+
+    // Returns the indices of the simplified mesh, it has at most "targetIndexCount" indices unless that would make
+    // the error exceed "maxError" (relative to the radius of the mesh). The reached error is written to "resultError".
+    std::vector<uint32_t> simplify(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                                   size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+    // Generates the levels of detail of the mesh whose triangles are in "indices" (the first level).
+    // The indices of the other levels are appended to "indices" and the ranges of all the levels are returned.
+    // It stops early once a level can't remove enough triangles within MAX_LOD_ERROR.
+    std::vector<MeshLod> generateLods(const Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& indices);
+
+}
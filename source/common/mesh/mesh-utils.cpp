@@ -12,15 +12,72 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
+#include <file-system.hpp>
 #include <mesh/mesh.hpp>
+#include <mesh/mesh-optimizer.hpp>
+#include <mesh/mesh-simplifier.hpp>
+
+// The obj and gltf meshes have no cooked version, so they are optimized and their levels of detail are generated
+// every time they are read
+static void prepareMesh(const std::string& filename, std::vector<our::Vertex>& vertices, std::vector<GLuint>& elements,
+                        std::vector<our::MeshLod>& lods) {
+    auto result = our::mesh_optimizer::optimizeMesh(vertices.data(), vertices.size(), elements.data(), elements.size());
+    lods = our::mesh_simplifier::generateLods(vertices.data(), vertices.size(), elements);
+    std::cout << "Optimized mesh \"" << filename << "\": ACMR " << result.before.getACMR() << " -> "
+              << result.after.getACMR() << ", ATVR " << result.before.getATVR() << " -> " << result.after.getATVR()
+              << ", " << lods.size() << " levels of detail" << std::endl;
+}
 
-our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
+// Reads the ".mtl" files referenced by an obj through the file system
+class FileSystemMaterialReader : public tinyobj::MaterialReader {
+    std::string directory;
 
+public:
+    explicit FileSystemMaterialReader(std::string directory) : directory(std::move(directory)) {}
 
-    // The data that we will use to initialize our mesh
-    std::vector<our::Vertex> vertices;
-    std::vector<GLuint> elements;
+    bool operator()(const std::string& materialId, std::vector<tinyobj::material_t>* materials,
+                    std::map<std::string, int>* materialMap, std::string* warn, std::string* err) override {
+        our::FileViewStream stream(our::FileSystem::getInstance().open(directory + materialId));
+        if (!stream.isOpen()) {
+            if (warn) *warn += "Material file not found: " + directory + materialId + "\n";
+            return false;
+        }
+        tinyobj::LoadMtl(materialMap, materials, &stream, warn, err);
+        return true;
+    }
+};
+
+// Makes tinygltf read the buffers referenced by a gltf through the file system
+static tinygltf::FsCallbacks getFileSystemCallbacks() {
+    tinygltf::FsCallbacks callbacks;
+    callbacks.FileExists = [](const std::string& path, void*) { return our::FileSystem::getInstance().exists(path); };
+    callbacks.ExpandFilePath = [](const std::string& path, void*) { return path; };
+    callbacks.ReadWholeFile = [](std::vector<unsigned char>* output, std::string* err, const std::string& path, void*) {
+        our::FileView file = our::FileSystem::getInstance().open(path);
+        if (!file) {
+            if (err) *err += "File open error: " + path + "\n";
+            return false;
+        }
+        // tinygltf keeps its own copy of the buffers
+        output->assign(file.asBytes(), file.asBytes() + file.size());
+        return true;
+    };
+    callbacks.WriteWholeFile = tinygltf::WriteWholeFile;
+    callbacks.GetFileSizeInBytes = [](size_t* size, std::string* err, const std::string& path, void*) {
+        our::FileView file = our::FileSystem::getInstance().open(path);
+        if (!file) {
+            if (err) *err += "File open error: " + path + "\n";
+            return false;
+        }
+        *size = file.size();
+        return true;
+    };
+    callbacks.user_data = nullptr;
+    return callbacks;
+}
 
+bool our::mesh_utils::readOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements,
+                             std::vector<MeshLod>& lods) {
     // Since the OBJ can have duplicated vertices, we make them unique using this map
     // The key is the vertex, the value is its index in the vector "vertices".
     // That index will be used to populate the "elements" vector.
@@ -32,9 +89,16 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
     std::vector<tinyobj::material_t> materials;
     std::string warn, err;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
+    // The obj is parsed straight from the mapped file
+    our::FileViewStream stream(our::FileSystem::getInstance().open(filename));
+    FileSystemMaterialReader materialReader(filename.substr(0, filename.find_last_of("/\\") + 1));
+    if (!stream.isOpen()) {
+        std::cerr << "Failed to load obj file \"" << filename << "\" due to error: Couldn't open the file" << std::endl;
+        return false;
+    }
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader)) {
         std::cerr << "Failed to load obj file \"" << filename << "\" due to error: " << err << std::endl;
-        return nullptr;
+        return false;
     }
     if (!warn.empty()) {
         std::cout << "WARN while loading obj file \"" << filename << "\": " << warn << std::endl;
@@ -88,15 +152,23 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
         }
     }
 
-    return new our::Mesh(vertices, elements);
+    prepareMesh(filename, vertices, elements, lods);
+    return true;
 }
 
-
-our::Mesh* our::mesh_utils::loadGLTF(const std::string& filename) {
+our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
     // The data that we will use to initialize our mesh
     std::vector<our::Vertex> vertices;
     std::vector<GLuint> elements;
+    std::vector<our::MeshLod> lods;
+    if (!readOBJ(filename, vertices, elements, lods))
+        return nullptr;
+    return new our::Mesh(vertices, elements, lods);
+}
 
+
+bool our::mesh_utils::readGLTF(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements,
+                              std::vector<MeshLod>& lods) {
     // Since we may have duplicated vertices, we can make them unique
     std::unordered_map<our::Vertex, GLuint> vertex_map;
 
@@ -106,7 +178,15 @@ our::Mesh* our::mesh_utils::loadGLTF(const std::string& filename) {
     std::string err;
     std::string warn;
 
-    bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
+    loader.SetFsCallbacks(getFileSystemCallbacks());
+    // The gltf is parsed straight from the mapped file
+    our::FileView file = our::FileSystem::getInstance().open(filename);
+    if (!file) {
+        std::cerr << "Failed to load gltf file \"" << filename << "\"" << std::endl;
+        return false;
+    }
+    bool ret = loader.LoadASCIIFromString(&model, &err, &warn, file.asChars(), static_cast<unsigned int>(file.size()),
+                                          filename.substr(0, filename.find_last_of("/\\") + 1));
     
     if (!warn.empty()) {
         std::cout << "WARN while loading gltf file \"" << filename << "\": " << warn << std::endl;
@@ -114,12 +194,12 @@ our::Mesh* our::mesh_utils::loadGLTF(const std::string& filename) {
 
     if (!err.empty()) {
         std::cerr << "ERROR loading gltf file \"" << filename << "\": " << err << std::endl;
-        return nullptr;
+        return false;
     }
 
     if (!ret) {
         std::cerr << "Failed to load gltf file \"" << filename << "\"" << std::endl;
-        return nullptr;
+        return false;
     }
 
     // Process all meshes in the GLTF file (assuming we want to combine all meshes)
@@ -317,10 +397,21 @@ our::Mesh* our::mesh_utils::loadGLTF(const std::string& filename) {
     // Create and return the mesh
     if (vertices.empty() || elements.empty()) {
         std::cerr << "No valid mesh data found in GLTF file \"" << filename << "\"" << std::endl;
-        return nullptr;
+        return false;
     }
     
-    return new our::Mesh(vertices, elements);
+    prepareMesh(filename, vertices, elements, lods);
+    return true;
+}
+
+our::Mesh* our::mesh_utils::loadGLTF(const std::string& filename) {
+    // The data that we will use to initialize our mesh
+    std::vector<our::Vertex> vertices;
+    std::vector<GLuint> elements;
+    std::vector<our::MeshLod> lods;
+    if (!readGLTF(filename, vertices, elements, lods))
+        return nullptr;
+    return new our::Mesh(vertices, elements, lods);
 }
 
 
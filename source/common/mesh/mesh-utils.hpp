@@ -2,12 +2,20 @@
 
 #include "mesh.hpp"
 #include <string>
+#include <vector>
 
 namespace our::mesh_utils {
     // Load an ".obj" file into the mesh
     Mesh* loadOBJ(const std::string& filename);
     // Load a ".gltf" file into the mesh
     our::Mesh* loadGLTF(const std::string& filename);
+    // Read the vertices and elements of an ".obj" or ".gltf" file without creating the mesh
+    // The elements hold all the levels of detail of the mesh whose ranges are returned in "lods"
+    // They only do CPU work so they can run on any thread, they return false on failure
+    bool readOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements,
+                 std::vector<MeshLod>& lods);
+    bool readGLTF(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements,
+                  std::vector<MeshLod>& lods);
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
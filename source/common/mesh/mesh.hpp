@@ -1,7 +1,10 @@
 #pragma once
 
 #include "vertex.hpp"
+#include "mesh-simplifier.hpp"
 #include <glad/gl.h>
+#include <algorithm>
+#include <limits>
 
 namespace our {
 
@@ -17,8 +20,37 @@ class Mesh {
     // A vertex array object, A vertex buffer and an element buffer
     unsigned int VBO, EBO;
     unsigned int VAO;
+    // A second, position-only stream used by depth-only passes (e.g. the depth pre-pass).
+    // It shares the element buffer with the main VAO but only fetches tightly packed positions.
+    unsigned int positionVBO;
+    unsigned int depthVAO;
+    // False if the element buffer belongs to another mesh (see the vertex stream constructor)
+    bool ownsElements = true;
+    // The mesh whose elements and CPU data this one uses (nullptr if it owns them)
+    const Mesh *source = nullptr;
     // We need to remember the number of elements that will be draw by glDrawElements
     GLsizei elementCount;
+    // The ranges of the element buffer that draw each level of detail (the first one is the full mesh)
+    std::vector<MeshLod> lods;
+    // The bounding sphere of the vertices (in the local space of the mesh), used to pick the level of detail
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+
+    void computeBounds(const std::vector<Vertex> &vertices) {
+        if (vertices.empty())
+            return;
+        glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+        for (const auto &vertex : vertices) {
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+        // The sphere around the bounding box (the errors of the levels of detail are relative to its radius)
+        boundsCenter = (minimum + maximum) * 0.5f;
+        boundsRadius = glm::length(maximum - minimum) * 0.5f;
+    }
+
+    // Returns the level that is drawn when the given one is requested (the coarsest one if it does not exist)
+    const MeshLod &getDrawnLod(size_t lod) const { return lods[std::min(lod, lods.size() - 1)]; }
 
     void setupBuffers(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements) {
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -28,6 +60,22 @@ class Mesh {
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(unsigned int), elements.data(), GL_STATIC_DRAW);
     }
 
+    void setupPositionStream(const std::vector<Vertex> &vertices) {
+        std::vector<glm::vec3> positions;
+        positions.reserve(vertices.size());
+        for (const auto &vertex : vertices)
+            positions.push_back(vertex.position);
+
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+        glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+
+        // The element buffer binding is part of the VAO state
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    }
+
     void setupAttributes() {
 
         // 0. Position attribute (glm::vec3)
@@ -65,6 +113,7 @@ class Mesh {
 
   public:
     // Add CPU-side storage
+    // (only the indices of the full mesh are kept, the other levels of detail are only on the GPU)
     std::vector<Vertex> cpuVertices;
     std::vector<unsigned int> cpuIndices;
 
@@ -75,13 +124,24 @@ class Mesh {
     // a vertex buffer to store the vertex data on the VRAM,
     // an element buffer to store the element data on the VRAM,
     // a vertex array object to define how to read the vertex & element buffer during rendering
-    Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements)
-        : cpuVertices(vertices), cpuIndices(elements) {
+    // The elements can hold several levels of detail, in which case "levels" gives their ranges
+    // (see mesh_simplifier::generateLods). Otherwise, all the elements are the only level.
+    Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements,
+         const std::vector<MeshLod> &levels = {})
+        : lods(levels), cpuVertices(vertices) {
         // TODO: (Req 2) Write this function
         //  remember to store the number of elements in "elementCount" since you will need it for drawing
         //  For the attribute locations, use the constants defined above: ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, etc
 
         elementCount = static_cast<GLsizei>(elements.size());
+        if (lods.empty()) {
+            MeshLod full;
+            full.indexCount = static_cast<uint32_t>(elements.size());
+            lods.push_back(full);
+        }
+        cpuIndices.assign(elements.begin() + lods[0].firstIndex,
+                          elements.begin() + lods[0].firstIndex + lods[0].indexCount);
+        computeBounds(vertices);
 
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -91,16 +151,72 @@ class Mesh {
         setupBuffers(vertices, elements);
         setupAttributes();
         glBindVertexArray(0);
+
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &positionVBO);
+
+        glBindVertexArray(depthVAO);
+        setupPositionStream(vertices);
+        glBindVertexArray(0);
+    }
+
+    // A mesh that draws the elements (and levels of detail) of "source" from a vertex buffer of its own, starting
+    // with "vertices" which are usually replaced every frame by "updateVertices" (e.g. an instance skinned on the
+    // CPU). The element buffer and the CPU data are shared (its "cpuVertices" and "cpuIndices" stay empty, see
+    // "getSource"), so the source must outlive this mesh. It has no position-only stream, "drawDepthOnly" draws
+    // the full stream.
+    Mesh(const Mesh &source, const std::vector<Vertex> &vertices)
+        : EBO(source.EBO), positionVBO(0), depthVAO(0), ownsElements(false), source(&source.getSource()),
+          elementCount(source.elementCount), lods(source.lods), boundsCenter(source.boundsCenter),
+          boundsRadius(source.boundsRadius) {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        setupAttributes();
+        glBindVertexArray(0);
+    }
+
+    // Replaces the content of the vertex buffer (the vertex count must not change).
+    // The position-only stream, the bounds and "cpuVertices" are left as they are.
+    void updateVertices(const std::vector<Vertex> &vertices) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        // Re-specifying the storage avoids waiting for the draws of the previous frame to stop reading it
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     // Get the vertex array object of the mesh
     unsigned int getVertexArray() const { return VAO; }
+    // The mesh holding the CPU data of this one (itself unless it was made from another mesh)
+    const Mesh &getSource() const { return source ? *source : *this; }
+
+    size_t getLodCount() const { return lods.size(); }
+    const MeshLod &getLod(size_t lod) const { return getDrawnLod(lod); }
+    size_t getTriangleCount(size_t lod = 0) const { return getDrawnLod(lod).indexCount / 3; }
+    const glm::vec3 &getBoundsCenter() const { return boundsCenter; }
+    float getBoundsRadius() const { return boundsRadius; }
 
     // this function should render the mesh
-    void draw() {
+    // "lod" is the level of detail to draw (0 is the full mesh), the coarsest level is drawn if it does not exist
+    void draw(size_t lod = 0) {
         // TODO: (Req 2) Write this function
+        const MeshLod &level = getDrawnLod(lod);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                       (void *)(level.firstIndex * sizeof(unsigned int)));
+        glBindVertexArray(0);
+    }
+
+    // Draws the mesh using only the position stream (no color, uv, normal or skinning data is fetched)
+    void drawDepthOnly(size_t lod = 0) {
+        const MeshLod &level = getDrawnLod(lod);
+        glBindVertexArray(depthVAO ? depthVAO : VAO);
+        glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                       (void *)(level.firstIndex * sizeof(unsigned int)));
         glBindVertexArray(0);
     }
 
@@ -109,7 +225,10 @@ class Mesh {
         // TODO: (Req 2) Write this function
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
+        if (ownsElements)
+            glDeleteBuffers(1, &EBO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &positionVBO);
     }
 
     Mesh(Mesh &&other) noexcept { *this = std::move(other); }
@@ -119,7 +238,14 @@ class Mesh {
             std::swap(VAO, other.VAO);
             std::swap(VBO, other.VBO);
             std::swap(EBO, other.EBO);
+            std::swap(depthVAO, other.depthVAO);
+            std::swap(positionVBO, other.positionVBO);
+            std::swap(ownsElements, other.ownsElements);
+            std::swap(source, other.source);
             std::swap(elementCount, other.elementCount);
+            std::swap(lods, other.lods);
+            std::swap(boundsCenter, other.boundsCenter);
+            std::swap(boundsRadius, other.boundsRadius);
             std::swap(cpuVertices, other.cpuVertices);
             std::swap(cpuIndices, other.cpuIndices);
         }
@@ -0,0 +1,52 @@
+#include "assimp-file-system.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace our {
+
+    size_t AssimpFileStream::Read(void* buffer, size_t size, size_t count) {
+        if (size == 0)
+            return 0;
+        // Like fread, only whole elements are read
+        count = std::min(count, (file.size() - position) / size);
+        std::memcpy(buffer, file.data() + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    aiReturn AssimpFileStream::Seek(size_t offset, aiOrigin origin) {
+        size_t target;
+        switch (origin) {
+        case aiOrigin_SET:
+            target = offset;
+            break;
+        case aiOrigin_CUR:
+            target = position + offset;
+            break;
+        case aiOrigin_END:
+            // The offset is negative, stored in a size_t
+            target = file.size() + offset;
+            break;
+        default:
+            return aiReturn_FAILURE;
+        }
+        if (target > file.size())
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    bool AssimpFileSystem::Exists(const char* path) const { return FileSystem::getInstance().exists(path); }
+
+    Assimp::IOStream* AssimpFileSystem::Open(const char* path, const char* mode) {
+        // Assimp only writes when exporting, which the game never does
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a'))
+            return nullptr;
+        FileView file = FileSystem::getInstance().open(path);
+        if (!file)
+            return nullptr;
+        return new AssimpFileStream(std::move(file));
+    }
+
+}
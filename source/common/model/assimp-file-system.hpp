@@ -0,0 +1,37 @@
+#pragma once
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include "file-system.hpp"
+
+namespace our {
+
+    // Reads a file opened by the FileSystem, Assimp copies from the mapped bytes directly
+    class AssimpFileStream : public Assimp::IOStream {
+        FileView file;
+        size_t position = 0;
+
+    public:
+        explicit AssimpFileStream(FileView file) : file(std::move(file)) {}
+
+        size_t Read(void* buffer, size_t size, size_t count) override;
+        // The stream is read only
+        size_t Write(const void*, size_t, size_t) override { return 0; }
+        aiReturn Seek(size_t offset, aiOrigin origin) override;
+        size_t Tell() const override { return position; }
+        size_t FileSize() const override { return file.size(); }
+        void Flush() override {}
+    };
+
+    // Makes Assimp open the model files (and the files they reference, like the ".bin" of a gltf) through the
+    // FileSystem, so models are read from the mounted packs too. Give a new instance to each importer with
+    // "SetIOHandler" (the importer deletes it).
+    class AssimpFileSystem : public Assimp::IOSystem {
+    public:
+        bool Exists(const char* path) const override;
+        char getOsSeparator() const override { return '/'; }
+        Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+        void Close(Assimp::IOStream* stream) override { delete stream; }
+    };
+
+}
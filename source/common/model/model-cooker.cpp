@@ -0,0 +1,768 @@
+#include "model-cooker.hpp"
+#include "asset-database.hpp"
+#include "assimp-file-system.hpp"
+#include "file-system.hpp"
+#include "animation/animation-bounds.hpp"
+#include "animation/animation-compression.hpp"
+#include "mesh/mesh-optimizer.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/material.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <type_traits>
+#include <unordered_map>
+
+namespace our::model_cooker {
+
+    static const char MAGIC[4] = {'C', 'M', 'D', 'L'};
+    static const uint32_t VERSION = COOKED_MODEL_VERSION;
+
+    static_assert(std::is_trivially_copyable_v<Vertex> && sizeof(Vertex) == 68,
+                  "Update COOKED_MODEL_VERSION if Vertex changes");
+    static_assert(std::is_trivially_copyable_v<VectorKey> && sizeof(VectorKey) == 16,
+                  "Update COOKED_MODEL_VERSION if VectorKey changes");
+    static_assert(std::is_trivially_copyable_v<RotationKey> && sizeof(RotationKey) == 20,
+                  "Update COOKED_MODEL_VERSION if RotationKey changes");
+    static_assert(std::is_trivially_copyable_v<MeshLod> && sizeof(MeshLod) == 12,
+                  "Update COOKED_MODEL_VERSION if MeshLod changes");
+    static_assert(std::is_trivially_copyable_v<AnimationBounds> && sizeof(AnimationBounds) == 24,
+                  "Update COOKED_MODEL_VERSION if AnimationBounds changes");
+    static_assert(std::is_trivially_copyable_v<BoneCapsule> && sizeof(BoneCapsule) == 32,
+                  "Update COOKED_MODEL_VERSION if BoneCapsule changes");
+
+    // ------------------------------------------------------------------------------------------------------------
+    // Import (Assimp)
+    // ------------------------------------------------------------------------------------------------------------
+
+    static glm::mat4 toGlm(const aiMatrix4x4& m) {
+        return glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+    }
+    static glm::vec3 toGlm(const aiVector3D& v) { return {v.x, v.y, v.z}; }
+    static glm::quat toGlm(const aiQuaternion& q) { return glm::quat(q.w, q.x, q.y, q.z); }
+
+    // Copies the keys of an Assimp channel as they are
+    static std::vector<VectorKey> importKeys(const aiVectorKey* keys, unsigned int numKeys) {
+        std::vector<VectorKey> result(numKeys);
+        for (unsigned int k = 0; k < numKeys; ++k)
+            result[k] = {static_cast<float>(keys[k].mTime), toGlm(keys[k].mValue)};
+        return result;
+    }
+    static std::vector<RotationKey> importKeys(const aiQuatKey* keys, unsigned int numKeys) {
+        std::vector<RotationKey> result(numKeys);
+        for (unsigned int k = 0; k < numKeys; ++k)
+            result[k] = {static_cast<float>(keys[k].mTime), toGlm(keys[k].mValue)};
+        return result;
+    }
+
+    // Bones are the nodes that deform meshes (the ones in aiMesh::mBones), they are added in depth first order
+    // so a parent always comes before its children
+    static void importSkeletonNode(const aiNode* node, int parentIndex, const std::map<std::string, glm::mat4>& offsets,
+                                   CookedModel& model, std::unordered_map<std::string, int>& boneIndices) {
+        std::string nodeName = node->mName.C_Str();
+        int currentIndex = parentIndex;
+
+        if (auto it = offsets.find(nodeName); it != offsets.end()) {
+            if (boneIndices.count(nodeName)) {
+                std::cerr << "[ModelCooker] WARNING: Duplicate bone node '" << nodeName << "', skipping it." << std::endl;
+            } else {
+                Bone bone;
+                bone.name = nodeName;
+                bone.id = static_cast<int>(model.bones.size());
+                bone.localBindTransform = toGlm(node->mTransformation);
+                bone.offsetMatrix = it->second;
+                bone.parentIndex = parentIndex;
+                currentIndex = bone.id;
+                boneIndices[nodeName] = bone.id;
+                model.bones.push_back(bone);
+            }
+        }
+
+        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+            importSkeletonNode(node->mChildren[i], currentIndex, offsets, model, boneIndices);
+        }
+    }
+
+    static void importSkeleton(const aiScene* scene, CookedModel& model,
+                               std::unordered_map<std::string, int>& boneIndices) {
+        // Collect all the bones used by the meshes and their offset matrices
+        std::map<std::string, glm::mat4> offsets;
+        for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+            const aiMesh* mesh = scene->mMeshes[i];
+            for (unsigned int j = 0; j < mesh->mNumBones; ++j) {
+                const aiBone* assimpBone = mesh->mBones[j];
+                offsets.try_emplace(assimpBone->mName.C_Str(), toGlm(assimpBone->mOffsetMatrix));
+            }
+        }
+        if (offsets.empty()) {
+            std::cout << "[ModelCooker] No bones found in any mesh, skipping skeleton." << std::endl;
+            return;
+        }
+
+        importSkeletonNode(scene->mRootNode, -1, offsets, model, boneIndices);
+        std::cout << "[ModelCooker] Skeleton imported with " << model.bones.size() << " bones." << std::endl;
+    }
+
+    static void importAnimations(const aiScene* scene, CookedModel& model,
+                                 const std::unordered_map<std::string, int>& boneIndices) {
+        model.animations.reserve(scene->mNumAnimations);
+
+        for (unsigned int i = 0; i < scene->mNumAnimations; ++i) {
+            const aiAnimation* assimpAnimation = scene->mAnimations[i];
+            Animation animation;
+            animation.name = assimpAnimation->mName.C_Str();
+            animation.duration = static_cast<float>(assimpAnimation->mDuration);
+            animation.ticksPerSecond = static_cast<float>(assimpAnimation->mTicksPerSecond);
+            if (animation.ticksPerSecond == 0) {
+                animation.ticksPerSecond = 25.0f; // Default to 25 FPS if not specified
+            }
+            animation.boneAnimations.reserve(assimpAnimation->mNumChannels);
+            size_t keyCount = 0;
+
+            for (unsigned int j = 0; j < assimpAnimation->mNumChannels; ++j) {
+                const aiNodeAnim* nodeAnim = assimpAnimation->mChannels[j];
+                BoneAnimation track;
+                track.boneName = nodeAnim->mNodeName.C_Str();
+
+                if (boneIndices.find(track.boneName) == boneIndices.end()) {
+                    std::cout << "[ModelCooker] Warning: Animation channel for node '" << track.boneName
+                              << "' which is not in the skeleton. Still loading channel." << std::endl;
+                }
+
+                // The channels keep their own key times, resampling them at the union of the times would
+                // multiply the keys of the channels that barely move
+                track.positionKeys = importKeys(nodeAnim->mPositionKeys, nodeAnim->mNumPositionKeys);
+                track.rotationKeys = importKeys(nodeAnim->mRotationKeys, nodeAnim->mNumRotationKeys);
+                track.scaleKeys = importKeys(nodeAnim->mScalingKeys, nodeAnim->mNumScalingKeys);
+                keyCount += track.positionKeys.size() + track.rotationKeys.size() + track.scaleKeys.size();
+                animation.boneAnimations.push_back(std::move(track));
+            }
+
+            std::cout << "[ModelCooker] Animation '" << animation.name << "': " << animation.duration << " ticks at "
+                      << animation.ticksPerSecond << " ticks/s, " << animation.boneAnimations.size() << " tracks, " << keyCount << " keys."
+                      << std::endl;
+            model.animations.push_back(std::move(animation));
+        }
+    }
+
+    static CookedWrapMode toWrapMode(aiTextureMapMode mode) {
+        switch (mode) {
+        case aiTextureMapMode_Clamp:
+        case aiTextureMapMode_Decal:
+            return CookedWrapMode::CLAMP;
+        case aiTextureMapMode_Mirror:
+            return CookedWrapMode::MIRROR;
+        default:
+            return CookedWrapMode::REPEAT;
+        }
+    }
+
+    // Finds the first texture of the given type. Returns false if there is none or if it can't be loaded
+    // (so that the caller can try another texture type instead).
+    static bool importTexture(const aiMaterial* aiMat, const aiScene* scene, const std::string& directory,
+                              aiTextureType type, CookedModel& model, CookedTextureRef& texture) {
+        aiString pathFromAssimp;
+        if (aiMat->GetTexture(type, 0, &pathFromAssimp) != AI_SUCCESS)
+            return false;
+        std::string texturePath = pathFromAssimp.C_Str();
+        CookedTextureRef result;
+
+        if (texturePath.rfind('*', 0) == 0) { // Starts with '*' indicates an embedded texture
+            unsigned int embeddedIndex = 0;
+            try {
+                embeddedIndex = std::stoi(texturePath.substr(1));
+            } catch (const std::exception& e) {
+                std::cerr << "[ModelCooker] ERROR: Invalid embedded texture index format: " << texturePath << " ("
+                          << e.what() << ")" << std::endl;
+                return false;
+            }
+            if (embeddedIndex >= scene->mNumTextures) {
+                std::cerr << "[ModelCooker] ERROR: Invalid embedded texture index " << embeddedIndex << std::endl;
+                return false;
+            }
+            const aiTexture* embeddedTexture = scene->mTextures[embeddedIndex];
+            if (embeddedTexture->mHeight != 0) {
+                std::cerr << "[ModelCooker] WARNING: Uncompressed embedded texture format not supported for "
+                          << texturePath << std::endl;
+                return false;
+            }
+            // Only the referenced textures are stored, the others stay empty
+            model.embeddedTextures.resize(std::max<size_t>(model.embeddedTextures.size(), scene->mNumTextures));
+            std::vector<uint8_t>& bytes = model.embeddedTextures[embeddedIndex];
+            if (bytes.empty()) {
+                auto data = reinterpret_cast<const uint8_t*>(embeddedTexture->pcData);
+                bytes.assign(data, data + embeddedTexture->mWidth); // mWidth is the size in bytes
+            }
+            result.embedded = static_cast<int32_t>(embeddedIndex);
+        } else {
+            std::string fullPath = directory + texturePath;
+            if (!FileSystem::getInstance().exists(fullPath) &&
+                AssetDatabase::getInstance().getCookedPath("texture", fullPath).empty()) {
+                std::cerr << "[ModelCooker] WARNING: Texture not found: " << fullPath << std::endl;
+                return false;
+            }
+            result.path = texturePath;
+        }
+
+        aiTextureMapMode mode;
+        if (aiMat->Get(AI_MATKEY_MAPPINGMODE_U(type, 0), mode) == AI_SUCCESS)
+            result.wrapS = toWrapMode(mode);
+        if (aiMat->Get(AI_MATKEY_MAPPINGMODE_V(type, 0), mode) == AI_SUCCESS)
+            result.wrapT = toWrapMode(mode);
+        texture = result;
+        return true;
+    }
+
+    static CookedMaterial importMaterial(const aiMaterial* aiMat, const aiScene* scene, const std::string& directory,
+                                         CookedModel& model) {
+        CookedMaterial material;
+
+        aiString name;
+        if (aiMat->Get(AI_MATKEY_NAME, name) == AI_SUCCESS)
+            material.name = name.C_Str();
+
+        aiColor4D color(0.0f, 0.0f, 0.0f, 1.0f);
+        if (aiMat->Get(AI_MATKEY_BASE_COLOR, color) == AI_SUCCESS ||
+            aiMat->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) { // Fallback for non-PBR
+            material.albedo = glm::vec3(color.r, color.g, color.b);
+            material.alpha = color.a;
+        }
+
+        float factor = 1.0f;
+        if (aiMat->Get(AI_MATKEY_METALLIC_FACTOR, factor) == AI_SUCCESS)
+            material.metallic = factor;
+        if (aiMat->Get(AI_MATKEY_ROUGHNESS_FACTOR, factor) == AI_SUCCESS)
+            material.roughness = factor;
+        material.metallic = glm::clamp(material.metallic, 0.0f, 1.0f);
+        material.roughness = glm::clamp(material.roughness, 0.04f, 1.0f);
+
+        aiColor3D emissiveColor(0.0f, 0.0f, 0.0f);
+        if (aiMat->Get(AI_MATKEY_COLOR_EMISSIVE, emissiveColor) == AI_SUCCESS)
+            material.emission = glm::vec3(emissiveColor.r, emissiveColor.g, emissiveColor.b);
+
+        float opacity = 1.0f;
+        if (aiMat->Get(AI_MATKEY_OPACITY, opacity) == AI_SUCCESS)
+            material.alpha *= opacity; // Modulate the base color alpha with the overall opacity
+
+        // Assimp has no ambient occlusion factor, the occlusion comes from the AMBIENT_OCCLUSION texture slot
+        // (the glTF occlusion map or a light map) so the constant factor stays 1
+        material.ambientOcclusion = 1.0f;
+
+        int twoSided = 0;
+        material.twoSided = aiMat->Get(AI_MATKEY_TWOSIDED, twoSided) == AI_SUCCESS && twoSided;
+
+        // Each slot takes the first texture type that can be loaded
+        auto importFirst = [&](CookedTextureSlot slot, std::initializer_list<aiTextureType> types) {
+            for (aiTextureType type : types)
+                if (importTexture(aiMat, scene, directory, type, model, material.textures[slot]))
+                    return true;
+            return false;
+        };
+        importFirst(ALBEDO, {aiTextureType_BASE_COLOR, aiTextureType_DIFFUSE});
+        // GLTF ORM texture, some formats pack roughness in the specular alpha or use metalness for the combined map
+        if (!importFirst(METALLIC_ROUGHNESS, {aiTextureType_UNKNOWN, aiTextureType_SPECULAR, aiTextureType_METALNESS})) {
+            importFirst(METALLIC, {aiTextureType_METALNESS});
+            importFirst(ROUGHNESS, {aiTextureType_DIFFUSE_ROUGHNESS, aiTextureType_SHININESS});
+        }
+        importFirst(NORMAL, {aiTextureType_NORMALS, aiTextureType_HEIGHT});
+        // Some GLTF files pack AO with MetallicRoughness, Assimp might expose it as LIGHTMAP too
+        importFirst(AMBIENT_OCCLUSION, {aiTextureType_AMBIENT_OCCLUSION, aiTextureType_LIGHTMAP});
+        importFirst(EMISSIVE, {aiTextureType_EMISSIVE});
+
+        return material;
+    }
+
+    static void importMesh(const aiMesh* mesh, const glm::mat4& transform, CookedModel& model,
+                           const std::unordered_map<std::string, int>& boneIndices) {
+        CookedSubmesh submesh;
+        submesh.firstVertex = static_cast<uint32_t>(model.vertices.size());
+        submesh.vertexCount = mesh->mNumVertices;
+        submesh.firstIndex = static_cast<uint32_t>(model.indices.size());
+        submesh.localToParent = transform;
+        if (mesh->mMaterialIndex < model.materials.size())
+            submesh.material = static_cast<int32_t>(mesh->mMaterialIndex);
+
+        model.vertices.reserve(model.vertices.size() + mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+            Vertex v; // No bone influence by default
+            v.position = toGlm(mesh->mVertices[i]);
+            if (mesh->mNormals)
+                v.normal = toGlm(mesh->mNormals[i]);
+            if (mesh->mTextureCoords[0])
+                v.tex_coord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+            if (mesh->mColors[0])
+                v.color = Color(mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b,
+                                mesh->mColors[0][i].a);
+            model.vertices.push_back(v);
+        }
+
+        Vertex* vertices = model.vertices.data() + submesh.firstVertex;
+        for (unsigned int b = 0; b < mesh->mNumBones; ++b) {
+            const aiBone* assimpBone = mesh->mBones[b];
+            auto it = boneIndices.find(assimpBone->mName.C_Str());
+            if (it == boneIndices.end()) {
+                std::cout << "[ModelCooker] WARNING: Mesh bone '" << assimpBone->mName.C_Str()
+                          << "' was not found in the skeleton. Its vertex weights are skipped." << std::endl;
+                continue;
+            }
+            for (unsigned int w = 0; w < assimpBone->mNumWeights; ++w) {
+                const aiVertexWeight& weight = assimpBone->mWeights[w];
+                if (weight.mVertexId >= mesh->mNumVertices) {
+                    std::cerr << "[ModelCooker] ERROR: Invalid vertexId " << weight.mVertexId
+                              << " in the weights of bone '" << assimpBone->mName.C_Str() << "'." << std::endl;
+                    continue;
+                }
+                // Influences beyond MAX_BONE_INFLUENCE are dropped
+                Vertex& vertex = vertices[weight.mVertexId];
+                for (int slot = 0; slot < MAX_BONE_INFLUENCE; ++slot) {
+                    if (vertex.bone_ids[slot] == -1) {
+                        vertex.bone_ids[slot] = it->second;
+                        vertex.weights[slot] = weight.mWeight;
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+            const aiFace& face = mesh->mFaces[f];
+            for (unsigned int j = 0; j < face.mNumIndices; ++j)
+                model.indices.push_back(face.mIndices[j]);
+        }
+        submesh.indexCount = static_cast<uint32_t>(model.indices.size()) - submesh.firstIndex;
+        model.submeshes.push_back(submesh);
+    }
+
+    static void importNode(const aiNode* node, const aiScene* scene, const glm::mat4& parentTransform,
+                           CookedModel& model, const std::unordered_map<std::string, int>& boneIndices) {
+        glm::mat4 nodeTransform = parentTransform * toGlm(node->mTransformation);
+
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            importMesh(scene->mMeshes[node->mMeshes[i]], nodeTransform, model, boneIndices);
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+            importNode(node->mChildren[i], scene, nodeTransform, model, boneIndices);
+        }
+    }
+
+    // Reorders the triangles and vertices of each submesh (this replaces Assimp's aiProcess_ImproveCacheLocality)
+    static void optimizeSubmeshes(CookedModel& model) {
+        mesh_optimizer::VertexCacheStatistics before, after;
+        for (const CookedSubmesh& submesh : model.submeshes) {
+            auto result = mesh_optimizer::optimizeMesh(model.vertices.data() + submesh.firstVertex, submesh.vertexCount,
+                                                       model.indices.data() + submesh.firstIndex, submesh.indexCount);
+            before += result.before;
+            after += result.after;
+        }
+        std::cout << "[ModelCooker] Optimized " << model.submeshes.size() << " submeshes: ACMR " << before.getACMR()
+                  << " -> " << after.getACMR() << ", ATVR " << before.getATVR() << " -> " << after.getATVR()
+                  << std::endl;
+    }
+
+    // Appends the levels of detail of each submesh after its indices (the index buffer is rebuilt since the ranges grow)
+    static void generateSubmeshLods(CookedModel& model) {
+        std::vector<uint32_t> indices;
+        size_t fullTriangles = 0, lodTriangles = 0;
+        for (CookedSubmesh& submesh : model.submeshes) {
+            std::vector<uint32_t> submeshIndices(model.indices.begin() + submesh.firstIndex,
+                                                 model.indices.begin() + submesh.firstIndex + submesh.indexCount);
+            std::vector<MeshLod> lods =
+                mesh_simplifier::generateLods(model.vertices.data() + submesh.firstVertex, submesh.vertexCount,
+                                              submeshIndices);
+            fullTriangles += lods.front().indexCount / 3;
+            lodTriangles += lods.back().indexCount / 3;
+
+            submesh.firstIndex = static_cast<uint32_t>(indices.size());
+            submesh.indexCount = static_cast<uint32_t>(submeshIndices.size());
+            submesh.firstLod = static_cast<uint32_t>(model.lods.size());
+            submesh.lodCount = static_cast<uint32_t>(lods.size());
+            indices.insert(indices.end(), submeshIndices.begin(), submeshIndices.end());
+            model.lods.insert(model.lods.end(), lods.begin(), lods.end());
+        }
+        model.indices = std::move(indices);
+        std::cout << "[ModelCooker] Generated levels of detail: " << fullTriangles << " triangles at full detail, "
+                  << lodTriangles << " at the coarsest levels" << std::endl;
+    }
+
+    // Replaces the keys of each clip by its compressed blob
+    static void compressAnimations(CookedModel& model) {
+        for (Animation& animation : model.animations) {
+            animation_compression::Report report;
+            animation.compressedData = animation_compression::compress(animation, report);
+            for (BoneAnimation& track : animation.boneAnimations) {
+                track.positionKeys = {};
+                track.rotationKeys = {};
+                track.scaleKeys = {};
+            }
+            std::cout << "[ModelCooker] Compressed animation '" << animation.name << "': " << report.keptKeys << "/"
+                      << report.rawKeys << " keys, " << report.rawBytes << " -> " << report.compressedBytes
+                      << " bytes (" << report.getRatio() << ":1), max error: position " << report.maxPositionError
+                      << ", rotation " << report.maxRotationError << " rad, scale " << report.maxScaleError
+                      << std::endl;
+        }
+    }
+
+    // Fits the bone capsules and samples the bounds of each (compressed) clip
+    static void computeAnimationBounds(CookedModel& model) {
+        if (model.bones.empty())
+            return;
+        std::vector<animation_bounds::SkinnedMesh> meshes;
+        meshes.reserve(model.submeshes.size());
+        for (const CookedSubmesh& submesh : model.submeshes)
+            meshes.push_back({model.vertices.data() + submesh.firstVertex, submesh.vertexCount,
+                              submesh.localToParent});
+        model.boneCapsules = animation_bounds::computeBoneCapsules(model.bones, meshes);
+
+        for (Animation& animation : model.animations) {
+            if (!animation_bounds::computeClipBounds(animation, model.bones, meshes))
+                continue;
+            AnimationBounds bounds = animation.segmentBounds.front();
+            for (const AnimationBounds& segment : animation.segmentBounds)
+                animation_bounds::merge(bounds, segment);
+            glm::vec3 size = bounds.maximum - bounds.minimum;
+            std::cout << "[ModelCooker] Bounds of animation '" << animation.name << "': " << size.x << " x "
+                      << size.y << " x " << size.z << " over " << animation.segmentBounds.size() << " segments"
+                      << std::endl;
+        }
+    }
+
+    bool importModel(const std::string& sourcePath, CookedModel& model) {
+        Assimp::Importer importer;
+        // The model and the files it references are read through the file system (so from the packs too)
+        importer.SetIOHandler(new AssimpFileSystem());
+
+        const aiScene* scene = importer.ReadFile(
+            sourcePath, aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals |
+                            aiProcess_JoinIdenticalVertices |
+                            aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph | aiProcess_SortByPType |
+                            aiProcess_PopulateArmatureData | aiProcess_GenUVCoords | aiProcess_TransformUVCoords);
+
+        if (!scene || (!scene->mRootNode && (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE))) {
+            std::cerr << "[ModelCooker] ERROR: Failed to import model: " << sourcePath << " ("
+                      << importer.GetErrorString() << ")" << std::endl;
+            return false;
+        }
+
+        std::cout << "[ModelCooker] Imported scene with " << scene->mNumMeshes << " meshes, " << scene->mNumMaterials
+                  << " materials and " << scene->mNumTextures << " embedded textures." << std::endl;
+
+        model = CookedModel();
+        std::string directory = sourcePath.substr(0, sourcePath.find_last_of("/\\") + 1);
+        std::unordered_map<std::string, int> boneIndices;
+
+        importSkeleton(scene, model, boneIndices);
+        importAnimations(scene, model, boneIndices);
+
+        model.materials.reserve(scene->mNumMaterials);
+        for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+            model.materials.push_back(importMaterial(scene->mMaterials[i], scene, directory, model));
+
+        importNode(scene->mRootNode, scene, glm::mat4(1.0f), model, boneIndices);
+        optimizeSubmeshes(model);
+        generateSubmeshLods(model);
+        compressAnimations(model);
+        computeAnimationBounds(model);
+        return true;
+    }
+
+    // ------------------------------------------------------------------------------------------------------------
+    // Cooked file
+    // ------------------------------------------------------------------------------------------------------------
+
+    // Appends the values to an in-memory buffer that is written with a single call
+    class BinaryWriter {
+    public:
+        std::vector<uint8_t> bytes;
+
+        template <typename T> void write(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            auto data = reinterpret_cast<const uint8_t*>(&value);
+            bytes.insert(bytes.end(), data, data + sizeof(T));
+        }
+        void writeString(const std::string& value) {
+            write(static_cast<uint32_t>(value.size()));
+            bytes.insert(bytes.end(), value.begin(), value.end());
+        }
+        template <typename T> void writeArray(const std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            write(static_cast<uint32_t>(values.size()));
+            auto data = reinterpret_cast<const uint8_t*>(values.data());
+            bytes.insert(bytes.end(), data, data + values.size() * sizeof(T));
+        }
+    };
+
+    // Reads the values back from the file bytes. Reading past the end sets "ok" to false and returns zeros.
+    class BinaryReader {
+        const uint8_t* cursor;
+        const uint8_t* end;
+
+        bool take(void* output, size_t size) {
+            if (!ok || size_t(end - cursor) < size) {
+                ok = false;
+                return false;
+            }
+            std::memcpy(output, cursor, size);
+            cursor += size;
+            return true;
+        }
+
+    public:
+        bool ok = true;
+
+        BinaryReader(const FileView& file) : cursor(file.asBytes()), end(file.asBytes() + file.size()) {}
+
+        template <typename T> T read() {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T value;
+            if (!take(&value, sizeof(T)))
+                std::memset(&value, 0, sizeof(T));
+            return value;
+        }
+        std::string readString() {
+            uint32_t size = read<uint32_t>();
+            if (!ok || size_t(end - cursor) < size) {
+                ok = false;
+                return std::string();
+            }
+            std::string value(reinterpret_cast<const char*>(cursor), size);
+            cursor += size;
+            return value;
+        }
+        // Reads an element count, the count is rejected if the remaining bytes can't hold that many elements
+        uint32_t readCount(size_t minElementSize) {
+            uint32_t count = read<uint32_t>();
+            if (!ok || size_t(end - cursor) / minElementSize < count) {
+                ok = false;
+                return 0;
+            }
+            return count;
+        }
+        template <typename T> void readArray(std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            uint32_t count = read<uint32_t>();
+            if (!ok || size_t(end - cursor) / sizeof(T) < count) {
+                ok = false;
+                return;
+            }
+            values.resize(count);
+            take(values.data(), count * sizeof(T));
+        }
+    };
+
+    bool writeCookedModel(const std::string& path, const CookedModel& model) {
+        BinaryWriter writer;
+        writer.write(MAGIC);
+        writer.write(VERSION);
+
+        writer.writeArray(model.vertices);
+        writer.writeArray(model.indices);
+        writer.writeArray(model.submeshes);
+        writer.writeArray(model.lods);
+
+        writer.write(static_cast<uint32_t>(model.materials.size()));
+        for (const CookedMaterial& material : model.materials) {
+            writer.writeString(material.name);
+            writer.write(material.albedo);
+            writer.write(material.alpha);
+            writer.write(material.metallic);
+            writer.write(material.roughness);
+            writer.write(material.emission);
+            writer.write(material.ambientOcclusion);
+            writer.write(static_cast<uint32_t>(material.twoSided));
+            for (const CookedTextureRef& texture : material.textures) {
+                writer.writeString(texture.path);
+                writer.write(texture.embedded);
+                writer.write(texture.wrapS);
+                writer.write(texture.wrapT);
+            }
+        }
+
+        writer.write(static_cast<uint32_t>(model.embeddedTextures.size()));
+        for (const auto& texture : model.embeddedTextures)
+            writer.writeArray(texture);
+
+        writer.write(static_cast<uint32_t>(model.bones.size()));
+        for (const Bone& bone : model.bones) {
+            writer.writeString(bone.name);
+            writer.write(bone.localBindTransform);
+            writer.write(bone.offsetMatrix);
+            writer.write(static_cast<int32_t>(bone.parentIndex));
+        }
+
+        writer.write(static_cast<uint32_t>(model.animations.size()));
+        for (const Animation& animation : model.animations) {
+            writer.writeString(animation.name);
+            writer.write(animation.duration);
+            writer.write(animation.ticksPerSecond);
+            writer.writeArray(animation.compressedData);
+            writer.write(static_cast<uint32_t>(animation.boneAnimations.size()));
+            for (const BoneAnimation& track : animation.boneAnimations) {
+                writer.writeString(track.boneName);
+                writer.writeArray(track.positionKeys);
+                writer.writeArray(track.rotationKeys);
+                writer.writeArray(track.scaleKeys);
+            }
+            writer.writeArray(animation.segmentBounds);
+            writer.writeArray(animation.boneBounds);
+        }
+        writer.writeArray(model.boneCapsules);
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "ERROR: Couldn't open cooked model file for writing: " << path << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(writer.bytes.data()), std::streamsize(writer.bytes.size()));
+        if (!file) {
+            std::cerr << "ERROR: Failed to write cooked model: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Checks that all the ranges and indices stored in the file are valid
+    static bool validate(const CookedModel& model) {
+        for (const CookedSubmesh& submesh : model.submeshes) {
+            if (uint64_t(submesh.firstVertex) + submesh.vertexCount > model.vertices.size() ||
+                uint64_t(submesh.firstIndex) + submesh.indexCount > model.indices.size() ||
+                submesh.material >= int32_t(model.materials.size()))
+                return false;
+            for (uint32_t i = 0; i < submesh.indexCount; i++)
+                if (model.indices[submesh.firstIndex + i] >= submesh.vertexCount)
+                    return false;
+            if (submesh.lodCount == 0 || uint64_t(submesh.firstLod) + submesh.lodCount > model.lods.size())
+                return false;
+            for (uint32_t i = 0; i < submesh.lodCount; i++) {
+                const MeshLod& lod = model.lods[submesh.firstLod + i];
+                if (uint64_t(lod.firstIndex) + lod.indexCount > submesh.indexCount)
+                    return false;
+            }
+        }
+        for (const CookedMaterial& material : model.materials)
+            for (const CookedTextureRef& texture : material.textures)
+                if (texture.embedded >= int32_t(model.embeddedTextures.size()))
+                    return false;
+        for (size_t i = 0; i < model.bones.size(); i++)
+            if (model.bones[i].parentIndex >= int(i))
+                return false;
+        // The skinning indexes the bone matrices with every bone id (the unused ones are 0 or -1 with no weight)
+        int boneCount = int(model.bones.size());
+        for (const Vertex& vertex : model.vertices)
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+                int bone = vertex.bone_ids[i];
+                if (bone < -1 || bone >= std::max(boneCount, 1) ||
+                    (vertex.weights[i] != 0.0f && (bone < 0 || bone >= boneCount)))
+                    return false;
+            }
+        for (const Animation& animation : model.animations) {
+            if (animation.isCompressed() && !animation_compression::validate(animation))
+                return false;
+            if (!animation.segmentBounds.empty() && animation.segmentBounds.size() != animation_bounds::SEGMENT_COUNT)
+                return false;
+            if (!animation.boneBounds.empty() && animation.boneBounds.size() != model.bones.size())
+                return false;
+        }
+        if (!model.boneCapsules.empty() && model.boneCapsules.size() != model.bones.size())
+            return false;
+        for (const BoneCapsule& capsule : model.boneCapsules)
+            if (capsule.submesh >= int32_t(model.submeshes.size()))
+                return false;
+        return true;
+    }
+
+    bool readCookedModel(const std::string& path, CookedModel& model) {
+        // The arrays are copied straight from the mapped file
+        FileView file = FileSystem::getInstance().open(path);
+        if (!file) {
+            std::cerr << "[ModelCooker] ERROR: Couldn't open cooked model: " << path << std::endl;
+            return false;
+        }
+
+        BinaryReader reader(file);
+        std::array<char, 4> magic = reader.read<std::array<char, 4>>();
+        uint32_t version = reader.read<uint32_t>();
+        if (!reader.ok || std::memcmp(magic.data(), MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+            std::cerr << "[ModelCooker] ERROR: Invalid or outdated cooked model: " << path << std::endl;
+            return false;
+        }
+        model = CookedModel();
+        reader.readArray(model.vertices);
+        reader.readArray(model.indices);
+        reader.readArray(model.submeshes);
+        reader.readArray(model.lods);
+
+        model.materials.resize(reader.readCount(sizeof(float) * 12));
+        for (CookedMaterial& material : model.materials) {
+            if (!reader.ok)
+                break;
+            material.name = reader.readString();
+            material.albedo = reader.read<glm::vec3>();
+            material.alpha = reader.read<float>();
+            material.metallic = reader.read<float>();
+            material.roughness = reader.read<float>();
+            material.emission = reader.read<glm::vec3>();
+            material.ambientOcclusion = reader.read<float>();
+            material.twoSided = reader.read<uint32_t>() != 0;
+            for (CookedTextureRef& texture : material.textures) {
+                texture.path = reader.readString();
+                texture.embedded = reader.read<int32_t>();
+                texture.wrapS = reader.read<CookedWrapMode>();
+                texture.wrapT = reader.read<CookedWrapMode>();
+            }
+        }
+
+        model.embeddedTextures.resize(reader.readCount(sizeof(uint32_t)));
+        for (auto& texture : model.embeddedTextures)
+            reader.readArray(texture);
+
+        model.bones.resize(reader.readCount(sizeof(glm::mat4) * 2));
+        for (size_t i = 0; i < model.bones.size() && reader.ok; i++) {
+            Bone& bone = model.bones[i];
+            bone.name = reader.readString();
+            bone.id = static_cast<int>(i);
+            bone.localBindTransform = reader.read<glm::mat4>();
+            bone.offsetMatrix = reader.read<glm::mat4>();
+            bone.parentIndex = reader.read<int32_t>();
+        }
+
+        model.animations.resize(reader.readCount(sizeof(float) * 2));
+        for (Animation& animation : model.animations) {
+            if (!reader.ok)
+                break;
+            animation.name = reader.readString();
+            animation.duration = reader.read<float>();
+            animation.ticksPerSecond = reader.read<float>();
+            reader.readArray(animation.compressedData);
+            animation.boneAnimations.resize(reader.readCount(sizeof(uint32_t) * 4));
+            for (BoneAnimation& track : animation.boneAnimations) {
+                track.boneName = reader.readString();
+                reader.readArray(track.positionKeys);
+                reader.readArray(track.rotationKeys);
+                reader.readArray(track.scaleKeys);
+            }
+            reader.readArray(animation.segmentBounds);
+            reader.readArray(animation.boneBounds);
+        }
+        reader.readArray(model.boneCapsules);
+
+        if (!reader.ok || !validate(model)) {
+            std::cerr << "[ModelCooker] ERROR: Corrupted cooked model: " << path << std::endl;
+            model = CookedModel();
+            return false;
+        }
+        return true;
+    }
+
+    bool cookFile(const std::string& sourcePath, const std::string& outputPath) {
+        CookedModel model;
+        return importModel(sourcePath, model) && writeCookedModel(outputPath, model);
+    }
+
+}
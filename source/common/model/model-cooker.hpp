@@ -0,0 +1,108 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "animation/animation.hpp"
+#include "animation/bone.hpp"
+#include "mesh/mesh-simplifier.hpp"
+#include "mesh/vertex.hpp"
+
+// The model cooker converts a model file (fbx, gltf, ...) into the data the runtime needs to create a Model:
+// the final (optimized) vertex/index buffers, the submesh ranges and their levels of detail, the material parameters
+// and texture references, the skeleton (with its offset matrices) and the animation clips, already compressed
+// (see animation-compression.hpp).
+// Importing with Assimp (triangulation, tangents, vertex joining, ...) is slow, so the result is stored in a
+// binary file (".cmdl") that is loaded with a single read on the next launches.
+// The cooked files are stored and kept up to date by the asset database (see asset-database.hpp).
+// Nothing in here depends on OpenGL so it can be used by offline tools.
+namespace our::model_cooker {
+
+    // How a texture is sampled outside of [0, 1]
+    enum class CookedWrapMode : uint32_t { REPEAT = 0, CLAMP = 1, MIRROR = 2 };
+
+    struct CookedTextureRef {
+        std::string path;      // Relative to the model directory (empty for embedded textures)
+        int32_t embedded = -1; // Index in CookedModel::embeddedTextures for textures stored inside the model file
+        CookedWrapMode wrapS = CookedWrapMode::REPEAT, wrapT = CookedWrapMode::REPEAT;
+
+        bool isValid() const { return !path.empty() || embedded >= 0; }
+    };
+
+    // The textures a material can reference (see LitMaterial)
+    enum CookedTextureSlot : uint32_t {
+        ALBEDO,
+        METALLIC_ROUGHNESS,
+        METALLIC,
+        ROUGHNESS,
+        NORMAL,
+        AMBIENT_OCCLUSION,
+        EMISSIVE,
+        TEXTURE_SLOT_COUNT
+    };
+
+    struct CookedMaterial {
+        std::string name;
+        glm::vec3 albedo = glm::vec3(0.8f, 1.0f, 1.0f);
+        float alpha = 1.0f;
+        float metallic = 0.95f;
+        float roughness = 0.1f;
+        glm::vec3 emission = glm::vec3(0.0f);
+        float ambientOcclusion = 1.0f;
+        bool twoSided = false;
+        CookedTextureRef textures[TEXTURE_SLOT_COUNT];
+    };
+
+    struct CookedSubmesh {
+        // The vertices and indices of the submesh in CookedModel::vertices and CookedModel::indices
+        // The indices are relative to the first vertex of the submesh
+        uint32_t firstVertex = 0, vertexCount = 0;
+        uint32_t firstIndex = 0, indexCount = 0;
+        int32_t material = -1;
+        glm::mat4 localToParent = glm::mat4(1.0f);
+        // The levels of detail of the submesh in CookedModel::lods (their ranges are relative to the first index
+        // of the submesh, and the index range of the submesh covers all of them)
+        uint32_t firstLod = 0, lodCount = 0;
+    };
+
+    struct CookedModel {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<CookedSubmesh> submeshes;
+        std::vector<MeshLod> lods;
+        std::vector<CookedMaterial> materials;
+        // The encoded bytes (png, jpg, ...) of the textures embedded in the model file
+        std::vector<std::vector<uint8_t>> embeddedTextures;
+        // The bones in skeleton order (a parent always comes before its children)
+        std::vector<Bone> bones;
+        std::vector<Animation> animations;
+        // The capsule around the vertices of each bone (empty if the model has no skinned vertex)
+        std::vector<BoneCapsule> boneCapsules;
+    };
+
+    // The extension of the cooked model files
+    inline const char* COOKED_MODEL_EXTENSION = ".cmdl";
+    // Increase the version whenever the layout of the file changes (including the layout of Vertex and the keys)
+    // or the cooked data changes (version 2: the submeshes are optimized by the mesh optimizer, version 3: the
+    // submeshes have levels of detail, version 4: the source stamp moved to the asset database, version 5: the
+    // animation channels keep their own key times, version 6: the animation clips are compressed, version 7: the
+    // animation clips have bounds and the bones have capsules, version 8: the ambient occlusion factor is no longer
+    // read from the opacity)
+    constexpr uint32_t COOKED_MODEL_VERSION = 8;
+
+    // Imports the source model with Assimp. On failure, an error is printed and false is returned.
+    bool importModel(const std::string& sourcePath, CookedModel& model);
+
+    // Writes/reads the cooked model file. On failure, an error is printed and false is returned.
+    // The file is written in place, so it must not be one that may be mapped (the asset database writes a temporary
+    // file and renames it over the output).
+    bool writeCookedModel(const std::string& path, const CookedModel& model);
+    bool readCookedModel(const std::string& path, CookedModel& model);
+
+    // Imports the source model and writes it to the output path (the cook function of the asset database, there are
+    // no settings for models yet)
+    bool cookFile(const std::string& sourcePath, const std::string& outputPath);
+
+}
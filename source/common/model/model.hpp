@@ -1,7 +1,7 @@
 #pragma once
 
-#include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <components/camera.hpp>
 #include <components/mesh-renderer.hpp>
 #include <map>
@@ -13,29 +13,88 @@
 #include <vector>
 #include "animation/animation.hpp"
 #include "animation/skeleton.hpp"
+#include "model-cooker.hpp"
+#include "texture/sampler.hpp"
+#include "texture/texture-cache.hpp"
 #include "texture/texture2d.hpp"
 
 namespace our {
 
 class Model {
     public:
+    // The bind skeleton and the animations are shared by all the instances, the poses belong to the instances
     Skeleton skeleton;
     std::vector<Animation> animations; // List of animations associated with this model
 
     Model() = default;
     ~Model();
 
-    // Load a model file (fbx, obj, gltf, etc.) using Assimp
+    // Load a model file (fbx, obj, gltf, etc.)
+    // The model is imported with Assimp only the first time (or when the file changes), the result is cooked
+    // into a ".cmdl" file in the asset database cache which is loaded directly on the next launches
+    // (see model_cooker and AssetDatabase).
+    // A ".cmdl" file can also be loaded directly.
     bool loadFromFile(const std::string& path);
 
+    // The two halves of loadFromFile so that the CPU work can run on another thread (see AssetLoader<Model>)
+    // Reads (or imports and cooks) the model data, it does not touch OpenGL so it can run on any thread
+    static bool loadCookedModel(const std::string& path, model_cooker::CookedModel& cooked);
+    // The images of the textures of a cooked model, read and hashed ahead of createFromCookedModel (see
+    // TextureCache::prepareImage). They are keyed by their path in the model ("*index" for the embedded ones).
+    using PreparedTextures = std::unordered_map<std::string, TextureCache::PreparedImage>;
+    // Prepares the textures of the model, it does not touch OpenGL so it can run on any thread
+    static void prepareTextures(const std::string& path, const model_cooker::CookedModel& cooked,
+                                PreparedTextures& textures);
+    // Creates the meshes, materials and skeleton from the cooked data (must run on the OpenGL thread)
+    // The textures that were not prepared are read and hashed here
+    void createFromCookedModel(const std::string& path, const model_cooker::CookedModel& cooked,
+                               PreparedTextures textures = {});
+
     // Draw all meshes in the model
+    // If depthPrePassed is true, the opaque meshes were already drawn by drawDepthOnly this frame
+    // so they are shaded with GL_EQUAL depth testing and without writing depth.
+    // "lod" is the level of detail drawn by every mesh (the meshes with fewer levels draw their coarsest one)
+    // "skinningOffset" is where the pose of the instance being drawn starts in the SkinningBuffer of the frame
+    // (the value returned by SkinningBuffer::append), it is required by the skinned models and ignored otherwise.
+    // "meshes" replaces the mesh of every submesh when given (e.g. the meshes skinned on the CPU by the instance)
     void draw(CameraComponent* camera, const glm::mat4& localToWorld, const glm::ivec2& windowSize,
-              float bloomCutoff) const;
+              float bloomCutoff, bool depthPrePassed = false, size_t lod = 0, int32_t skinningOffset = -1,
+              const std::vector<std::unique_ptr<Mesh>>* meshes = nullptr) const;
+
+    // Draw the depth of the opaque meshes only (using their position-only stream, or their full stream when they
+    // are skinned).
+    // The given depth shader must be in use and have its "view" and "projection" uniforms set, it must be the
+    // "SKINNED" permutation for a skinned model.
+    // It must use the same level of detail and skinning offset as "draw" for the depth test to match.
+    void drawDepthOnly(ShaderProgram* depthShader, const glm::mat4& localToWorld, size_t lod = 0,
+                       int32_t skinningOffset = -1, const std::vector<std::unique_ptr<Mesh>>* meshes = nullptr) const;
+
+    // The levels of detail of the model (the most levels any of its meshes has)
+    size_t getLodCount() const { return std::max<size_t>(lodErrors.size(), 1); }
+    // The error of a level of detail relative to the radius of the model bounds
+    float getLodError(size_t lod) const { return lod < lodErrors.size() ? lodErrors[lod] : 0.0f; }
+    // The number of triangles drawn at the given level of detail
+    size_t getTriangleCount(size_t lod = 0) const;
+
+    // Returns the index of the clip in "animations" (-1 if the model has no such clip)
+    int findAnimation(AnimationClipId id) const;
+    // Returns the clip ready to be sampled by the instances (its bone tracks are built the first time), or nullptr
+    Animation* bindAnimation(AnimationClipId id);
+
+    // The pose of the skeleton at rest (drawn by the instances that have no pose of their own)
+    const AnimationPose& getBindPose() const { return bindPose; }
+    // True if the model has a skeleton, its materials then skin the vertices (see SkinningBuffer)
+    bool isSkinned() const { return skeleton.getBoneCount() > 0; }
+
+    // The submeshes of the model (their mesh, material and transform in the model)
+    const std::vector<MeshRendererComponent*>& getSubmeshes() const { return meshRenderers; }
+    // A capsule per bone in the space of the bone, empty for the models cooked without skeleton
+    const std::vector<BoneCapsule>& getBoneCapsules() const { return boneCapsules; }
 
     // Generate a single combined mesh for all submeshes
     void generateCombinedMesh();
 
-    // Access the combined mesh for collision or other purposes
+    // Access the combined mesh for collision or other purposes (its bounds are the bounds of the model)
     Mesh* getCombinedMesh() const {
         return combinedMesh.get();
     }
@@ -44,55 +103,36 @@ class Model {
     std::string directory;
     std::vector<MeshRendererComponent*> meshRenderers;
     std::unique_ptr<Mesh> combinedMesh;
+    AnimationPose bindPose;
+    std::vector<BoneCapsule> boneCapsules;
+    // The index of each clip in "animations" by its id
+    std::unordered_map<AnimationClipId, size_t> clipIndices;
+    // The error of each level of detail relative to the radius of the combined mesh bounds
+    std::vector<float> lodErrors;
+
+    void computeLodErrors();
 
     // Materials and textures owned by this model.
     std::vector<std::unique_ptr<Material>> materials;
     std::map<std::string, std::shared_ptr<Texture2D>> texture_cache; // Key: relative path from model fill
+    // The textures are shared with other models (and levels) through the TextureCache, so their sampling state is
+    // in samplers owned by the model, one per wrap mode pair
+    std::unordered_map<uint32_t, std::unique_ptr<Sampler>> samplers;
+    // Only set while createFromCookedModel runs
+    PreparedTextures preparedTextures;
 
-    // Assimp import methods
-    void processNode(const aiNode* node, const aiScene* scene, const glm::mat4& parentTransform);
-    MeshRendererComponent* processMesh(const aiMesh* mesh, const aiScene* scene, const glm::mat4& transform);
+    // Returns the sampler of the wrap modes of the reference (creating it the first time)
+    Sampler* getSampler(const model_cooker::CookedTextureRef& reference);
 
-    // Material and Texture loading helpers
-    void loadMaterialsFromScene(const aiScene* scene);
-    std::unique_ptr<Material> processMaterial(const aiMaterial* aiMat, const aiScene* scene);
+    std::unique_ptr<Material> createMaterial(const model_cooker::CookedMaterial& cooked,
+                                             const model_cooker::CookedModel& model);
 
-    // Loads texture, uses mTextureCache. `texturePathInModel` is relative path as
+    // Loads texture, uses texture_cache. `texturePathInModel` is relative path as
     // stored in model file.
     std::shared_ptr<Texture2D> loadTexture(const std::string& texturePathInModel);
-    // Gets texture path from aiMaterial and then calls loadTexture.
-    std::shared_ptr<Texture2D> loadMaterialTexture(const aiMaterial* aiMat, const aiScene* scene, aiTextureType type,
-                                                   unsigned int index = 0);
-
-    // Skeleton
-    void loadSkeletonFromScene(const aiScene* scene);
-    void processNodeForSkeleton(const aiNode* assimpNode, int parentBoneIndexInSkeleton,
-                                const std::map<std::string, glm::mat4>& boneOffsetMatrices,
-                                const std::set<std::string>& boneNamesFromMeshes);
-    void processVertexBoneData(const aiMesh* mesh, std::vector<Vertex>& vertices);
-
-    // Animation
-    void loadAnimationsFromScene(const aiScene* scene);
-    template <typename TKey> static int findKeyFrameIndex(float animationTime, const TKey* keys, unsigned int numKeys);
-
-    // Helpers
-    public:
-    static glm::mat4 aiToGlm(const aiMatrix4x4& m);
-    static glm::vec3 aiToGlm(const aiVector3D& v) {
-        return {v.x, v.y, v.z};
-    }
-    static glm::quat aiToGlm(const aiQuaternion& q) {
-        return glm::quat(q.w, q.x, q.y, q.z);
-    }
-    static glm::vec3 aiToGlm(const aiColor3D& c) {
-        return {c.r, c.g, c.b};
-    }
-    static glm::vec4 aiToGlm(const aiColor4D& c) {
-        return {c.r, c.g, c.b, c.a};
-    }
-    static std::string aiToStr(const aiString& s) {
-        return s.C_Str();
-    }
+    // Loads the referenced texture (from a file or embedded in the model) and applies its wrap modes
+    std::shared_ptr<Texture2D> loadTexture(const model_cooker::CookedTextureRef& reference,
+                                           const model_cooker::CookedModel& model);
 };
 
 } // namespace our
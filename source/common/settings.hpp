@@ -13,6 +13,25 @@ public:
     bool showImGuiShaderDebugMenu = false;
     std::string shaderDebugMode = "none";
 
+    // When enabled, the forward renderer lays down the depth of all opaque PBR geometry first
+    // and then shades it with GL_EQUAL depth testing so that every pixel is shaded only once.
+    bool depthPrePass = true;
+
+    // The renderer draws the coarsest level of detail whose error covers at most this many pixels on screen
+    float lodPixelError = 1.0f;
+    // When not negative, every mesh and model is drawn at this level of detail (or its coarsest one)
+    int forcedLod = -1;
+
+    // Animation LOD: the poses of the animated instances the camera can't see are not evaluated, and those whose
+    // bounds are smaller than these radii on screen (in pixels) are evaluated every few frames or frozen
+    bool animationLod = true;
+    float animationThrottlePixels = 48.0f;
+    float animationFreezePixels = 4.0f;
+
+    // When enabled, the animated instances are skinned on the CPU (see cpu_skinning) and drawn from dynamic vertex
+    // buffers instead of being skinned by the vertex shader
+    bool cpuSkinning = false;
+
     int shaderDebugModeToInt(const std::string& mode) {
         if (mode == "none")
             return 0;
@@ -36,6 +55,10 @@ public:
             return 9;
         if (mode == "texture_coordinates")
             return 10;
+        if (mode == "overdraw")
+            return 11;
+        if (mode == "light_clusters")
+            return 12;
 
         return -1; // Invalid mode
     }
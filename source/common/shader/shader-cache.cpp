@@ -0,0 +1,148 @@
+#include "shader-cache.hpp"
+#include "asset-database.hpp"
+#include "file-system.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace our {
+
+    static const char MAGIC[4] = {'S', 'C', 'S', 'B'};
+    // Increase it whenever the layout of the files changes
+    static const uint32_t VERSION = 1;
+
+    struct ShaderBinaryHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint64_t driverHash;
+        uint32_t format; // The binary format returned by glGetProgramBinary
+        uint32_t length;
+    };
+
+    void ShaderCache::configure(const nlohmann::json& config) {
+        if (!config.is_object())
+            return;
+        enabled = config.value("enabled", enabled);
+        directory = config.value("directory", directory);
+    }
+
+    void ShaderCache::initialize() {
+        initialized = true;
+        GLint formatCount = 0;
+        if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        supported = formatCount > 0;
+
+        // A driver update may change the binaries (or make them invalid), so the driver is part of every key
+        std::string driver;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const GLubyte* value = glGetString(name);
+            driver += value ? reinterpret_cast<const char*>(value) : "";
+            driver += '\n';
+        }
+        driverHash = AssetDatabase::hashBytes(driver.data(), driver.size());
+        if (enabled && !supported)
+            std::cout << "[ShaderCache] The driver has no program binary format, the shaders will always be compiled"
+                      << std::endl;
+    }
+
+    bool ShaderCache::isEnabled() {
+        if (!initialized)
+            initialize();
+        return enabled && supported;
+    }
+
+    uint64_t ShaderCache::getDriverHash() {
+        if (!initialized)
+            initialize();
+        return driverHash;
+    }
+
+    std::string ShaderCache::getPath(uint64_t key) const {
+        std::ostringstream path;
+        path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+        return path.str();
+    }
+
+    bool ShaderCache::load(GLuint program, uint64_t key) {
+        if (!isEnabled())
+            return false;
+        std::string path = getPath(key);
+        // The binaries only match the driver they were made with, so they are never read from a pack
+        FileView file = FileSystem::getInstance().openFromDisk(path);
+        ShaderBinaryHeader header;
+        if (!file || file.size() < sizeof(header)) {
+            misses++;
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+                     header.key == key && header.driverHash == driverHash &&
+                     header.length == file.size() - sizeof(header);
+        if (valid) {
+            glProgramBinary(program, header.format, file.data() + sizeof(header), GLsizei(header.length));
+            GLint status = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            valid = status == GL_TRUE;
+        }
+        if (!valid) {
+            // The driver may reject its own binaries (e.g. after an update that kept the same version string)
+            file = FileView();
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            rejected++;
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    void ShaderCache::store(GLuint program, uint64_t key) {
+        if (!isEnabled())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(static_cast<size_t>(length));
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        ShaderBinaryHeader header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.key = key;
+        header.driverHash = driverHash;
+        header.format = format;
+        header.length = uint32_t(length);
+
+        // Written next to the binary then renamed, so a crash never leaves a truncated binary behind
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string path = getPath(key);
+        std::string temporaryPath = FileSystem::getTemporaryPath(path);
+        {
+            std::ofstream file(temporaryPath, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(binary.data(), length);
+            if (!file) {
+                std::cerr << "[ShaderCache] ERROR: Couldn't write the program binary: " << temporaryPath << std::endl;
+                return;
+            }
+        }
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::cerr << "[ShaderCache] ERROR: Couldn't write the program binary: " << path << std::endl;
+            return;
+        }
+        stores++;
+    }
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <json/json.hpp>
+#include <cstdint>
+#include <string>
+
+namespace our {
+
+    // Stores the linked shader programs on disk (with glGetProgramBinary) so the next runs load them with
+    // glProgramBinary instead of compiling and linking their sources again.
+    // A program is identified by the hash of its stage sources and of the driver (vendor, renderer and version
+    // strings), so editing a shader or updating the driver simply misses the cache and stores a new binary. A binary
+    // the driver rejects anyway (it is allowed to) counts as a miss and is deleted.
+    // It is used by ShaderProgram::link, and does nothing if the driver has no binary format (GL 4.1 or
+    // ARB_get_program_binary is needed). All the functions must be called from the OpenGL thread.
+    class ShaderCache {
+        bool enabled = true;
+        std::string directory = "cache/shaders";
+        // Computed the first time they are needed (it needs an OpenGL context)
+        bool initialized = false, supported = false;
+        uint64_t driverHash = 0;
+        size_t hits = 0, misses = 0, stores = 0, rejected = 0;
+
+        ShaderCache() = default;
+        ShaderCache(const ShaderCache&) = delete;
+        ShaderCache& operator=(const ShaderCache&) = delete;
+
+        void initialize();
+        std::string getPath(uint64_t key) const;
+
+    public:
+        static ShaderCache& getInstance() {
+            static ShaderCache instance;
+            return instance;
+        }
+
+        struct Statistics {
+            size_t hits = 0, misses = 0;
+            size_t stores = 0;   // The binaries written after a miss
+            size_t rejected = 0; // The binaries the driver refused (they are included in the misses)
+        };
+
+        // Reads "enabled" and "directory"
+        void configure(const nlohmann::json& config);
+        bool isEnabled();
+
+        // The hash of the driver strings, every key must include it (see ShaderProgram::link)
+        uint64_t getDriverHash();
+
+        // Loads the binary stored for the key into the program, returns false (a miss) if there is none or if the
+        // driver rejects it. On success, the program is linked and ready to use.
+        bool load(GLuint program, uint64_t key);
+        // Stores the binary of a linked program (that was linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+        void store(GLuint program, uint64_t key);
+
+        Statistics getStatistics() const { return {hits, misses, stores, rejected}; }
+    };
+
+}
@@ -0,0 +1,138 @@
+#include "shader-permutations.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace our {
+
+    bool ShaderPermutations::attachStages(ShaderProgram& program, const nlohmann::json& description,
+                                          const std::vector<std::string>& defines) {
+        if (!description.is_object())
+            return false;
+        std::vector<std::string> allDefines = description.value("defines", std::vector<std::string>());
+        allDefines.insert(allDefines.end(), defines.begin(), defines.end());
+        return program.attach(description.value("vs", ""), GL_VERTEX_SHADER, allDefines) &&
+               program.attach(description.value("fs", ""), GL_FRAGMENT_SHADER, allDefines);
+    }
+
+    void ShaderPermutations::add(const std::string& name, ShaderProgram* base, const nlohmann::json& description,
+                                 uint64_t sourceHash) {
+        remove(name);
+        Family& family = families[name];
+        family.description = description;
+        family.base = base;
+        family.programs[""] = base;
+        family.bySource[sourceHash] = base;
+        familyNames[base] = name;
+    }
+
+    ShaderProgram* ShaderPermutations::build(Family& family, const std::vector<std::string>& defines) {
+        auto program = std::make_unique<ShaderProgram>();
+        if (!attachStages(*program, family.description, defines))
+            return family.base;
+        // Nothing is compiled if the defines change nothing
+        uint64_t hash = program->getSourceHash();
+        if (auto it = family.bySource.find(hash); it != family.bySource.end()) {
+            shared++;
+            return it->second;
+        }
+        if (!program->link())
+            return family.base;
+        ShaderProgram* variant = program.get();
+        family.bySource[hash] = variant;
+        family.variants.push_back({std::move(program), defines});
+        return variant;
+    }
+
+    ShaderProgram* ShaderPermutations::getVariant(ShaderProgram* shader, std::vector<std::string> defines) {
+        auto name = shader ? familyNames.find(shader) : familyNames.end();
+        if (name == familyNames.end())
+            return shader;
+        Family& family = families[name->second];
+
+        std::sort(defines.begin(), defines.end());
+        defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+        std::string key;
+        for (const std::string& define : defines)
+            key += (key.empty() ? "" : ";") + define;
+        if (auto it = family.programs.find(key); it != family.programs.end())
+            return it->second;
+
+        requests++;
+        ShaderProgram* program = build(family, defines);
+        if (program == family.base && !defines.empty())
+            std::cerr << "[ShaderPermutations] WARNING: Shader " << name->second << " with (" << key
+                      << ") uses the base shader" << std::endl;
+        family.programs[key] = program;
+        familyNames[program] = name->second;
+        return program;
+    }
+
+    bool ShaderPermutations::reload(const std::string& name, const nlohmann::json& description) {
+        auto it = families.find(name);
+        if (it == families.end())
+            return false;
+        Family& family = it->second;
+
+        // The base is built on the side first, a bad edit leaves every program as it is
+        ShaderProgram rebuiltBase;
+        if (!attachStages(rebuiltBase, description))
+            return false;
+        uint64_t baseHash = rebuiltBase.getSourceHash();
+        if (!rebuiltBase.link())
+            return false;
+        family.base->swap(rebuiltBase);
+        family.description = description;
+        // The edit may change which defines the sources use, so the define sets are resolved again when requested
+        family.programs.clear();
+        family.programs[""] = family.base;
+        family.bySource.clear();
+        family.bySource[baseHash] = family.base;
+
+        // The programs keep their addresses since the materials point to them
+        bool reloaded = true;
+        for (Variant& variant : family.variants) {
+            ShaderProgram rebuilt;
+            if (!attachStages(rebuilt, description, variant.defines)) {
+                reloaded = false;
+                continue;
+            }
+            uint64_t hash = rebuilt.getSourceHash();
+            if (!rebuilt.link()) {
+                std::cerr << "[ShaderPermutations] ERROR: A permutation of " << name
+                          << " failed to build, keeping its current version" << std::endl;
+                reloaded = false;
+                continue;
+            }
+            variant.program->swap(rebuilt);
+            family.bySource.try_emplace(hash, variant.program.get());
+        }
+        return reloaded;
+    }
+
+    void ShaderPermutations::remove(const std::string& name) {
+        auto it = families.find(name);
+        if (it == families.end())
+            return;
+        familyNames.erase(it->second.base);
+        for (const Variant& variant : it->second.variants)
+            familyNames.erase(variant.program.get());
+        families.erase(it);
+    }
+
+    void ShaderPermutations::clear() {
+        families.clear();
+        familyNames.clear();
+    }
+
+    ShaderPermutations::Statistics ShaderPermutations::getStatistics() const {
+        Statistics statistics;
+        statistics.families = families.size();
+        for (const auto& [name, family] : families)
+            statistics.variants += family.variants.size();
+        statistics.requests = requests;
+        statistics.shared = shared;
+        return statistics;
+    }
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "shader.hpp"
+
+#include <json/json.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+    // Builds the permutations of the shaders loaded as assets: the same stage files compiled with extra defines
+    // (e.g. a LitMaterial without textures gets the "pbr" shader compiled without the texture fetches instead of
+    // the full shader with branches that are never taken).
+    // The permutations of a shader are built the first time they are requested and deduplicated by the hash of
+    // their preprocessed sources: the defines a shader does not use are dropped by the ShaderPreprocessor, so the
+    // define sets that make no difference share one program (the base shader if none of them is used).
+    // The permutations are owned by this class, the base shaders stay owned by AssetLoader<ShaderProgram>.
+    // All the functions must be called from the OpenGL thread.
+    class ShaderPermutations {
+        struct Variant {
+            std::unique_ptr<ShaderProgram> program;
+            std::vector<std::string> defines;
+        };
+        struct Family {
+            nlohmann::json description; // {"vs", "fs", "defines"}
+            ShaderProgram* base;
+            std::vector<Variant> variants;
+            // The program used for each requested set of defines (sorted and joined by ";")
+            std::unordered_map<std::string, ShaderProgram*> programs;
+            // The base and the variants by the hash of their preprocessed sources
+            std::unordered_map<uint64_t, ShaderProgram*> bySource;
+        };
+
+        std::unordered_map<std::string, Family> families;
+        // The family of every base shader and permutation
+        std::unordered_map<const ShaderProgram*, std::string> familyNames;
+        size_t requests = 0, shared = 0;
+
+        ShaderPermutations() = default;
+        ShaderPermutations(const ShaderPermutations&) = delete;
+        ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+        ShaderProgram* build(Family& family, const std::vector<std::string>& defines);
+
+    public:
+        static ShaderPermutations& getInstance() {
+            static ShaderPermutations instance;
+            return instance;
+        }
+
+        struct Statistics {
+            size_t families = 0, variants = 0; // The variants that were compiled (the base shaders are not counted)
+            size_t requests = 0;               // The sets of defines that were requested
+            size_t shared = 0;                 // The requests that were given an existing program
+        };
+
+        // Attaches the stages of a shader description ({"vs", "fs", "defines"}) with the defines of the
+        // description followed by the given ones. The program still has to be linked.
+        static bool attachStages(ShaderProgram& program, const nlohmann::json& description,
+                                 const std::vector<std::string>& defines = {});
+
+        // Registers a shader loaded as an asset, "sourceHash" is its "getSourceHash" from before it was linked
+        void add(const std::string& name, ShaderProgram* base, const nlohmann::json& description, uint64_t sourceHash);
+        // Returns the permutation of the shader compiled with the defines (added to those of the description).
+        // The shader itself is returned if it is not registered, and its family's base if the permutation fails.
+        ShaderProgram* getVariant(ShaderProgram* shader, std::vector<std::string> defines);
+        // Rebuilds the base shader and its permutations in place (see HotReload), the programs that fail to build
+        // keep their current version. Returns false if the shader is not registered or anything failed.
+        bool reload(const std::string& name, const nlohmann::json& description);
+        // Deletes the permutations of the shader (before the base shader is deleted)
+        void remove(const std::string& name);
+        void clear();
+
+        Statistics getStatistics() const;
+    };
+
+}
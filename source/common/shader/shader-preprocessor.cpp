@@ -0,0 +1,134 @@
+#include "shader-preprocessor.hpp"
+#include "file-system.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <string_view>
+#include <unordered_set>
+
+namespace our {
+
+    // Returns true if the line (ignoring its indentation) starts with the directive
+    static bool isDirective(std::string_view line, std::string_view directive) {
+        size_t start = line.find_first_not_of(" \t");
+        return start != std::string_view::npos && line.substr(start, directive.size()) == directive;
+    }
+
+    // Returns the path of the "#include" on the line, or an empty string if the line is not an include
+    static std::string parseInclude(std::string_view line) {
+        if (!isDirective(line, "#include"))
+            return std::string();
+        size_t open = line.find('"');
+        size_t close = open == std::string_view::npos ? open : line.find('"', open + 1);
+        if (close == std::string_view::npos)
+            return std::string();
+        return std::string(line.substr(open + 1, close - open - 1));
+    }
+
+    static bool isIdentifierCharacter(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+    // Returns true if the name appears in the source as a whole identifier
+    static bool mentions(const std::string& source, const std::string& name) {
+        for (size_t position = source.find(name); position != std::string::npos;
+             position = source.find(name, position + 1)) {
+            size_t end = position + name.size();
+            if ((position == 0 || !isIdentifierCharacter(source[position - 1])) &&
+                (end == source.size() || !isIdentifierCharacter(source[end])))
+                return true;
+        }
+        return false;
+    }
+
+    namespace {
+        struct Expansion {
+            ShaderPreprocessor::Result& result;
+            std::unordered_set<std::string> included;
+            // Where the defines go (right after the "#version" line of the processed file)
+            size_t definesOffset = std::string::npos;
+            int versionLine = 0;
+
+            bool expand(const std::string& filename) {
+                FileView file = FileSystem::getInstance().open(filename);
+                if (!file) {
+                    std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
+                    return false;
+                }
+                int index = int(result.files.size());
+                result.files.push_back(filename);
+
+                std::string_view text = file.asString();
+                int lineNumber = 0;
+                for (size_t position = 0; position < text.size();) {
+                    size_t end = std::min(text.find('\n', position), text.size());
+                    std::string_view line = text.substr(position, end - position);
+                    position = end + 1;
+                    lineNumber++;
+
+                    if (std::string include = parseInclude(line); !include.empty()) {
+                        std::string path =
+                            (std::filesystem::path(filename).parent_path() / include).lexically_normal().generic_string();
+                        if (included.insert(path).second) {
+                            result.source += "#line 1 " + std::to_string(result.files.size()) + "\n";
+                            if (!expand(path)) {
+                                std::cerr << "  (included from " << filename << ":" << lineNumber << ")" << std::endl;
+                                return false;
+                            }
+                        }
+                        result.source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+                        continue;
+                    }
+
+                    result.source.append(line);
+                    result.source += '\n';
+                    if (index == 0 && definesOffset == std::string::npos && isDirective(line, "#version")) {
+                        definesOffset = result.source.size();
+                        versionLine = lineNumber;
+                    }
+                }
+                return true;
+            }
+        };
+    }
+
+    bool ShaderPreprocessor::process(const std::string& filename, const std::vector<std::string>& defines,
+                                     Result& result) {
+        result = Result();
+        Expansion expansion{result, {}};
+        expansion.included.insert(std::filesystem::path(filename).lexically_normal().generic_string());
+        if (!expansion.expand(filename))
+            return false;
+
+        std::string header;
+        for (const std::string& define : defines) {
+            size_t equal = define.find('=');
+            std::string name = define.substr(0, equal);
+            if (name.empty() || !mentions(result.source, name))
+                continue;
+            result.defines.push_back(define);
+            header += "#define " + name;
+            if (equal != std::string::npos)
+                header += " " + define.substr(equal + 1);
+            header += '\n';
+        }
+        if (header.empty())
+            return true;
+        // "#version" must stay the first directive, the lines that follow keep their numbers
+        size_t offset = expansion.definesOffset == std::string::npos ? 0 : expansion.definesOffset;
+        header += "#line " + std::to_string(expansion.versionLine + 1) + " 0\n";
+        result.source.insert(offset, header);
+        return true;
+    }
+
+    std::vector<std::string> ShaderPreprocessor::collectIncludes(const std::string& filename) {
+        Result result;
+        Expansion expansion{result, {}};
+        expansion.included.insert(std::filesystem::path(filename).lexically_normal().generic_string());
+        expansion.expand(filename);
+        if (!result.files.empty())
+            result.files.erase(result.files.begin());
+        return result.files;
+    }
+
+}
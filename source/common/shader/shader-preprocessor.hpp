@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // Turns a GLSL file into the source given to OpenGL:
+    // - "#include "path"" lines are replaced by the included file (the path is relative to the including file). A
+    //   file is included at most once per stage, so the shared files need no include guards.
+    // - The permutation defines ("NAME" or "NAME=VALUE") are injected right after the "#version" line.
+    //   A define whose name the shader never mentions is dropped, so the permutations that only differ by such
+    //   defines give the same source (and share one program, see ShaderPermutations).
+    // "#line" directives are emitted around each include, so the compiler errors point to the right line. Their
+    // source string number is the index of the file in "Result::files".
+    class ShaderPreprocessor {
+    public:
+        struct Result {
+            std::string source;
+            std::vector<std::string> files;   // The file of each source string number (0 is the processed file)
+            std::vector<std::string> defines; // The defines that were kept
+        };
+
+        // Returns false if the file (or one of its includes) can't be opened, the errors are printed
+        static bool process(const std::string& filename, const std::vector<std::string>& defines, Result& result);
+
+        // Returns every file included by the file (recursively), for HotReload
+        static std::vector<std::string> collectIncludes(const std::string& filename);
+    };
+
+}
@@ -0,0 +1,87 @@
+#include "shader-reflection.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace our {
+
+    ShaderReflection ShaderReflection::reflect(GLuint program) {
+        ShaderReflection reflection;
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> name(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            Uniform uniform;
+            glGetActiveUniform(program, GLuint(i), GLsizei(name.size()), &length, &uniform.size, &uniform.type,
+                               name.data());
+            std::string uniformName(name.data(), length);
+            // The uniforms of the blocks have no location, they are set through their buffer
+            uniform.location = glGetUniformLocation(program, uniformName.c_str());
+            if (uniform.location < 0)
+                continue;
+            reflection.uniforms[uniformName] = uniform;
+            // "set" is called with the name of the array, the driver reports its first element
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                reflection.uniforms[uniformName.substr(0, uniformName.size() - 3)] = uniform;
+        }
+
+        count = 0;
+        maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        name.resize(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            Block block;
+            block.index = GLuint(i);
+            glGetActiveUniformBlockName(program, block.index, GLsizei(name.size()), &length, name.data());
+            glGetActiveUniformBlockiv(program, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+            glGetActiveUniformBlockiv(program, block.index, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+            reflection.blocks[std::string(name.data(), length)] = block;
+        }
+        return reflection;
+    }
+
+    bool ShaderReflection::isSampler(GLenum type) {
+        switch (type) {
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    const char* ShaderReflection::getTypeName(GLenum type) {
+        switch (type) {
+        case GL_FLOAT: return "float";
+        case GL_FLOAT_VEC2: return "vec2";
+        case GL_FLOAT_VEC3: return "vec3";
+        case GL_FLOAT_VEC4: return "vec4";
+        case GL_INT: return "int";
+        case GL_UNSIGNED_INT: return "uint";
+        case GL_BOOL: return "bool";
+        case GL_FLOAT_MAT3: return "mat3";
+        case GL_FLOAT_MAT4: return "mat4";
+        case GL_SAMPLER_2D: return "sampler2D";
+        case GL_SAMPLER_CUBE: return "samplerCube";
+        case GL_SAMPLER_BUFFER: return "samplerBuffer";
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER: return "usamplerBuffer";
+        default: return isSampler(type) ? "sampler" : "other";
+        }
+    }
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <string>
+#include <unordered_map>
+
+namespace our {
+
+    // The active uniforms, samplers and uniform blocks of a linked program, as reported by the driver.
+    // It is read once after linking (it works the same for the programs loaded from the ShaderCache) and serves
+    // two purposes: "ShaderProgram::getUniformLocation" looks the locations up here instead of asking the driver
+    // on every "set", and the materials validate their uniforms and textures against it when they are loaded.
+    // Only the uniforms the compiler kept are listed, a declared uniform that the program never reads is not.
+    struct ShaderReflection {
+        struct Uniform {
+            GLint location;
+            GLenum type; // e.g. GL_FLOAT_VEC3 or GL_SAMPLER_2D
+            GLint size;  // The number of elements (1 unless it is an array)
+        };
+        struct Block {
+            GLuint index;
+            GLint dataSize; // In bytes
+            GLint binding;
+        };
+
+        // Arrays are listed under their name with and without "[0]"
+        std::unordered_map<std::string, Uniform> uniforms;
+        std::unordered_map<std::string, Block> blocks;
+
+        // Queries the program (which must be linked)
+        static ShaderReflection reflect(GLuint program);
+        static bool isSampler(GLenum type);
+        // The GLSL name of the type (for the error messages)
+        static const char* getTypeName(GLenum type);
+
+        const Uniform* findUniform(const std::string& name) const {
+            auto it = uniforms.find(name);
+            return it == uniforms.end() ? nullptr : &it->second;
+        }
+        bool hasSampler(const std::string& name) const {
+            const Uniform* uniform = findUniform(name);
+            return uniform && isSampler(uniform->type);
+        }
+    };
+
+}
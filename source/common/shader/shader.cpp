@@ -2,52 +2,94 @@
 
 #include <cassert>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <asset-database.hpp>
+#include <file-system.hpp>
+#include "shader-cache.hpp"
+#include "shader-preprocessor.hpp"
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
 std::string checkForLinkingErrors(GLuint program);
 
-bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const {
-    // Here, we open the file and read a string from it containing the GLSL code of our shader
-    std::ifstream file(filename);
-    if(!file){
-        std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
+bool our::ShaderProgram::attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines) {
+    // Here, we read the file containing the GLSL code of our shader with its includes and defines
+    // (the preprocessor prints the errors)
+    ShaderPreprocessor::Result result;
+    if (!ShaderPreprocessor::process(filename, defines, result))
         return false;
+    stages.push_back({type, std::move(result.source), std::move(result.files)});
+    return true;
+}
+
+uint64_t our::ShaderProgram::getSourceHash() const {
+    return hashStages(AssetDatabase::hashBytes(nullptr, 0));
+}
+
+uint64_t our::ShaderProgram::hashStages(uint64_t seed) const {
+    uint64_t hash = seed;
+    for (const Stage& stage : stages) {
+        hash = AssetDatabase::hashBytes(&stage.type, sizeof(stage.type), hash);
+        hash = AssetDatabase::hashBytes(stage.source.data(), stage.source.size(), hash);
+    }
+    return hash;
+}
+
+bool our::ShaderProgram::link() {
+    // The key covers the driver and every stage (type and preprocessed source), so any change (including in an
+    // included file or in the defines) gives a new key
+    ShaderCache& cache = ShaderCache::getInstance();
+    bool cached = cache.isEnabled();
+    uint64_t key = 0;
+    if (cached) {
+        key = hashStages(cache.getDriverHash());
+        if (cache.load(program, key)) {
+            stages.clear();
+            reflection = ShaderReflection::reflect(program);
+            return true;
+        }
+        // The binary can only be retrieved if it is requested before linking
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     }
-    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char* sourceCStr = sourceString.c_str();
-    file.close();
 
+    bool linked = compileAndLink();
+    stages.clear();
+    if (!linked)
+        return false;
+    if (cached)
+        cache.store(program, key);
+    reflection = ShaderReflection::reflect(program);
+    return true;
+}
+
+bool our::ShaderProgram::compileAndLink() {
     //TODO: Complete this function
     //Note: The function "checkForShaderCompilationErrors" checks if there is
     // an error in the given shader. You should use it to check if there is a
     // compilation error and print it so that you can know what is wrong with
     // the shader. The returned string will be empty if there is no errors.
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &sourceCStr, nullptr);
-    glCompileShader(shader);
-
-    std::string errorLog = checkForShaderCompilationErrors(shader);
-    if (!errorLog.empty()) {
-        std::cerr << "ERROR: Shader compilation failed (" << filename << "): " << errorLog << std::endl;
+    for (const Stage& stage : stages) {
+        const char* sourceCStr = stage.source.c_str();
+        GLint sourceLength = GLint(stage.source.size());
+
+        GLuint shader = glCreateShader(stage.type);
+        glShaderSource(shader, 1, &sourceCStr, &sourceLength);
+        glCompileShader(shader);
+
+        std::string errorLog = checkForShaderCompilationErrors(shader);
+        if (!errorLog.empty()) {
+            // The errors are reported as "source string number(line)", each number is one of the files
+            std::cerr << "ERROR: Shader compilation failed (" << stage.files.front() << "): " << errorLog << std::endl;
+            for (size_t index = 1; index < stage.files.size(); index++)
+                std::cerr << "  " << index << ": " << stage.files[index] << std::endl;
+            glDeleteShader(shader);
+            return false;
+        }
+
+        glAttachShader(program, shader);
         glDeleteShader(shader);
-        return false;
     }
 
-
-    glAttachShader(program, shader);
-    glDeleteShader(shader);
-
-    //We return true if the compilation succeeded
-    return true;
-}
-
-
-
-bool our::ShaderProgram::link() const {
-    //TODO: Complete this function
     //Note: The function "checkForLinkingErrors" checks if there is
     // an error in the given program. You should use it to check if there is a
     // linking error and print it so that you can know what is wrong with the
@@ -2,10 +2,13 @@
 #define SHADER_HPP
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "shader-reflection.hpp"
 
 namespace our {
 
@@ -15,6 +18,21 @@ namespace our {
         //Shader Program Handle (OpenGL object name)
         GLuint program;
 
+        // The stages given to "attach", they are only compiled by "link" if the program is not in the ShaderCache
+        struct Stage {
+            GLenum type;
+            std::string source;             // After the ShaderPreprocessor
+            std::vector<std::string> files; // The file of each source string number of the "#line" directives
+        };
+        std::vector<Stage> stages;
+
+        // Filled by "link"
+        ShaderReflection reflection;
+
+        // Compiles the attached stages and links them
+        bool compileAndLink();
+        uint64_t hashStages(uint64_t seed) const;
+
     public:
         ShaderProgram(){
             //TODO: (Req 1) Create A shader program
@@ -25,9 +43,29 @@ namespace our {
             glDeleteProgram(program);
         }
 
-        bool attach(const std::string &filename, GLenum type) const;
+        // Reads the source of a stage and preprocesses it with the given permutation defines (see ShaderPreprocessor),
+        // it returns false if the file (or one of its includes) can't be opened
+        // The compilation errors are reported by "link" (the stages are not compiled at all if the program is cached)
+        bool attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines = {});
+
+        // The hash of the preprocessed sources of the attached stages (before "link"), two programs with the same
+        // hash are the same program (see ShaderPermutations)
+        uint64_t getSourceHash() const;
+
+        // Loads the program from the ShaderCache or compiles and links the attached stages (then stores the result
+        // in the cache). Returns false if a stage doesn't compile or the program doesn't link.
+        bool link();
+
+        // Exchanges the OpenGL programs of the two shaders, so a shader can be rebuilt in place (see HotReload)
+        // while everything that points to it keeps working
+        void swap(ShaderProgram& other) {
+            std::swap(program, other.program);
+            std::swap(stages, other.stages);
+            std::swap(reflection, other.reflection);
+        }
 
-        bool link() const;
+        // The active uniforms and blocks of the linked program
+        const ShaderReflection& getReflection() const { return reflection; }
 
         void use() { 
             glUseProgram(program);
@@ -35,7 +73,12 @@ namespace our {
 
         GLuint getUniformLocation(const std::string &name) {
             //TODO: (Req 1) Return the location of the uniform with the given name
-            return glGetUniformLocation(program, name.c_str());
+            // The reflection has every active uniform but only the first element of the arrays
+            if (const ShaderReflection::Uniform* uniform = reflection.findUniform(name))
+                return uniform->location;
+            if (name.find('[') != std::string::npos)
+                return glGetUniformLocation(program, name.c_str());
+            return GLuint(-1);
         }
 
         void set(const std::string &uniform, GLfloat value) {
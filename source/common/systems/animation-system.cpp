@@ -1,15 +1,93 @@
 #include "animation-system.hpp"
 #include "../components/animation-component.hpp"
+#include "../components/camera.hpp"
+#include "../settings.hpp"
 
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_access.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 
 namespace our {
 
-void AnimationSystem::update(World* world, float deltaTime) {
+// The poses can reach further than the bind pose, so the bounds of the model are enlarged by this factor when the
+// clips being played have no cooked bounds
+static const float ANIMATED_BOUNDS_MARGIN = 1.5f;
+
+// The planes (normal, distance) of the frustum of a view projection matrix, pointing inside
+static void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+    glm::vec4 rows[4] = {glm::row(viewProjection, 0), glm::row(viewProjection, 1), glm::row(viewProjection, 2),
+                         glm::row(viewProjection, 3)};
+    for (int i = 0; i < 3; i++) {
+        planes[i * 2] = rows[3] + rows[i];
+        planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// Returns how often the pose of the instance is evaluated (every N frames, 0 for never) from its bounds on screen
+static uint32_t getUpdateInterval(const AnimationComponent* animation, const glm::mat4& localToWorld,
+                                  const glm::vec4 planes[6], const glm::vec3& cameraPosition, float pixelsPerUnit) {
+    glm::mat3 linear(localToWorld);
+    float scale = std::max({glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+    glm::vec3 localCenter;
+    float localRadius;
+    glm::vec3 minimum, maximum;
+    if (animation->getAnimatedBounds(minimum, maximum)) {
+        localCenter = (minimum + maximum) * 0.5f;
+        localRadius = glm::length(maximum - minimum) * 0.5f;
+    } else if (const Mesh* bounds = animation->modelAsset->getCombinedMesh()) {
+        localCenter = bounds->getBoundsCenter();
+        localRadius = bounds->getBoundsRadius() * ANIMATED_BOUNDS_MARGIN;
+    } else {
+        return 1;
+    }
+    glm::vec3 center = glm::vec3(localToWorld * glm::vec4(localCenter, 1.0f));
+    float radius = localRadius * scale;
+    for (int i = 0; i < 6; i++)
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+            return 0;
+
+    // The radius of the bounding sphere on the screen (in pixels), like the level of detail of the renderer
+    float distance = glm::length(center - cameraPosition);
+    if (distance <= radius)
+        return 1;
+    float pixels = radius / std::sqrt(distance * distance - radius * radius) * pixelsPerUnit;
+    Settings& settings = Settings::getInstance();
+    if (pixels < settings.animationFreezePixels)
+        return 0;
+    if (pixels >= settings.animationThrottlePixels)
+        return 1;
+    return pixels >= settings.animationThrottlePixels * 0.5f ? 2 : AnimationSystem::MAX_UPDATE_INTERVAL;
+}
+
+void AnimationSystem::update(World* world, float deltaTime, glm::ivec2 viewportSize) {
     if (!world)
         return;
+    statistics = Statistics();
+
+    // The first camera is the one the renderer draws with
+    CameraComponent* camera = nullptr;
+    for (auto entity : world->getEntities())
+        if ((camera = entity->getComponent<CameraComponent>()))
+            break;
+    bool lod = camera && Settings::getInstance().animationLod;
+    glm::vec4 planes[6];
+    glm::vec3 cameraPosition(0.0f);
+    float pixelsPerUnit = 0.0f;
+    if (lod) {
+        glm::mat4 projection = camera->getProjectionMatrix(viewportSize);
+        extractFrustumPlanes(projection * camera->getViewMatrix(), planes);
+        cameraPosition = glm::vec3(camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        pixelsPerUnit = projection[1][1] * viewportSize.y * 0.5f;
+    }
 
+    evaluations.clear();
     for (auto entity : world->getEntities()) {
         AnimationComponent* animComp = entity->getComponent<AnimationComponent>();
 
@@ -27,13 +105,55 @@ void AnimationSystem::update(World* world, float deltaTime) {
             std::cout << "[AnimationSystem] Initialized AnimationComponent for entity: '" << entity->name << "'" << std::endl;
         }
 
+        // The clips always advance, only the pose evaluation is throttled
         animComp->update(deltaTime);
+        statistics.instances++;
 
-        Skeleton* skeleton = &(animComp->modelAsset->skeleton);
-        AnimationPlayer* player = &(animComp->player);
+        // The first pose is always evaluated, then the instances are spread over the frames of their interval
+        if (animComp->pose.getBoneCount() != animComp->modelAsset->skeleton.getBoneCount()) {
+            animComp->framesSinceEvaluation = static_cast<uint32_t>(statistics.instances % MAX_UPDATE_INTERVAL);
+            evaluations.push_back(animComp);
+            continue;
+        }
+        uint32_t interval = lod ? getUpdateInterval(animComp, entity->getLocalToWorldMatrix(), planes, cameraPosition,
+                                                    pixelsPerUnit)
+                                : 1;
+        if (interval == 0) {
+            statistics.skipped++;
+        } else if (++animComp->framesSinceEvaluation < interval) {
+            statistics.throttled++;
+        } else {
+            animComp->framesSinceEvaluation = 0;
+            evaluations.push_back(animComp);
+        }
+    }
+
+    // Each instance writes its own pose, the skeleton of the model is only read
+    auto start = std::chrono::steady_clock::now();
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, evaluations.size()), [this](const tbb::blocked_range<size_t>& range) {
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            evaluations[i]->evaluatePose();
+        }
+    });
+    statistics.poseMicroseconds =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    // The CPU skinning of the evaluated instances (each one only writes its own vertices)
+    if (Settings::getInstance().cpuSkinning) {
+        start = std::chrono::steady_clock::now();
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, evaluations.size()),
+                          [this](const tbb::blocked_range<size_t>& range) {
+                              for (size_t i = range.begin(); i != range.end(); ++i)
+                                  evaluations[i]->skinOnCpu();
+                          });
+        statistics.skinningMicroseconds =
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
 
-        glm::mat4 skeletonRootNodeTransform = glm::mat4(1.0f);
-        skeleton->calculateAnimatedPose(player, skeletonRootNodeTransform);
+    for (AnimationComponent* animComp : evaluations) {
+        statistics.evaluated++;
+        statistics.clips += animComp->getActiveClipCount();
+        statistics.bones += animComp->modelAsset->skeleton.getBoneCount();
     }
 }
 
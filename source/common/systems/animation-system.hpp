@@ -1,13 +1,47 @@
 #pragma once
 
+#include <glm/glm.hpp>
+#include <vector>
 #include "../ecs/world.hpp"
 
 namespace our {
 
+class AnimationComponent;
+
+// Advances the clips of every animated instance, then evaluates their poses in parallel as TBB tasks (each
+// instance only writes its own pose and only reads its model).
+// Animation LOD: the poses of the instances the camera can't see are not evaluated, and those of the instances
+// that are small on screen are evaluated every few frames or frozen (see Settings). Their clips keep advancing
+// so they are in sync again as soon as they are evaluated.
 class AnimationSystem {
     public:
+    // The longest an instance on screen goes without being evaluated (in frames)
+    static constexpr uint32_t MAX_UPDATE_INTERVAL = 4;
+
+    // What the last update did, the pose sampling, blending and evaluation are timed alone (to compare bones per
+    // microsecond)
+    struct Statistics {
+        size_t instances = 0, bones = 0; // The bones of the evaluated instances
+        size_t clips = 0;                // The clips sampled and blended
+        size_t evaluated = 0;            // The instances whose pose was evaluated
+        size_t throttled = 0;            // The instances waiting for their next evaluation
+        size_t skipped = 0;              // The instances out of the camera frustum or frozen
+        double poseMicroseconds = 0.0;
+        double skinningMicroseconds = 0.0; // The CPU skinning of the evaluated instances (see Settings::cpuSkinning)
+    };
+
     AnimationSystem() = default;
-    void update(World* world, float deltaTime);
+    // The viewport size is the one the camera renders to (for the frustum and the sizes on screen)
+    void update(World* world, float deltaTime, glm::ivec2 viewportSize);
+
+    const Statistics& getStatistics() const {
+        return statistics;
+    }
+
+    private:
+    Statistics statistics;
+    // The instances evaluated by the current update
+    std::vector<AnimationComponent*> evaluations;
 };
 
 }
@@ -0,0 +1,375 @@
+#include "clustered-lighting.hpp"
+#include <asset-loader.hpp>
+#include <texture/texture-unit.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <glm/gtc/constants.hpp>
+
+// The cluster assignment tests 4 clusters at once using SSE when it is available
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLUSTERED_LIGHTING_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace our {
+
+static constexpr int CLUSTERS_PER_SLICE = ClusteredLighting::CLUSTER_X * ClusteredLighting::CLUSTER_Y;
+static_assert(CLUSTERS_PER_SLICE % 4 == 0, "A slice must contain a multiple of 4 clusters to be tested 4 at a time");
+
+float ClusteredLighting::getLightRange(const Light& light) {
+    if (light.range > 0.0f)
+        return light.range;
+    // The shader divides the light by (quadratic * d^2 + linear * d + constant), so the range is the positive root
+    // of quadratic * d^2 + linear * d + constant - intensity / cutoff
+    float intensity = glm::max(light.color.r, glm::max(light.color.g, light.color.b));
+    float a = glm::max(light.attenuation.quadratic, 0.0f);
+    float b = glm::max(light.attenuation.linear, 0.0f);
+    float c = light.attenuation.constant - glm::max(intensity, 0.0f) / LIGHT_INTENSITY_CUTOFF;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (a > 0.0f)
+        return (-b + std::sqrt(b * b - 4.0f * a * c)) / (2.0f * a);
+    if (b > 0.0f)
+        return -c / b;
+    return std::numeric_limits<float>::max();
+}
+
+void ClusteredLighting::initialize() {
+    auto createTextureBuffer = [](GLuint& buffer, GLuint& texture, GLenum format) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    };
+    createTextureBuffer(lightDataBuffer, lightDataTexture, GL_RGBA32F);
+    createTextureBuffer(clusterGridBuffer, clusterGridTexture, GL_RG32UI);
+    createTextureBuffer(lightIndexBuffer, lightIndexTexture, GL_R32UI);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    clusterGrid.resize(CLUSTER_COUNT);
+    clusterLightCounts.resize(CLUSTER_COUNT);
+    clusterLightSlots.resize(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+    boundsValid = false;
+}
+
+void ClusteredLighting::destroy() {
+    glDeleteTextures(1, &lightDataTexture);
+    glDeleteTextures(1, &clusterGridTexture);
+    glDeleteTextures(1, &lightIndexTexture);
+    glDeleteBuffers(1, &lightDataBuffer);
+    glDeleteBuffers(1, &clusterGridBuffer);
+    glDeleteBuffers(1, &lightIndexBuffer);
+    lightDataTexture = clusterGridTexture = lightIndexTexture = 0;
+    lightDataBuffer = clusterGridBuffer = lightIndexBuffer = 0;
+    boundsValid = false;
+}
+
+int ClusteredLighting::getSlice(float depth) const {
+    if (depth <= nearPlane)
+        return 0;
+    int slice = static_cast<int>(std::floor(std::log(depth) * sliceScale + sliceBias));
+    return glm::clamp(slice, 0, CLUSTER_Z - 1);
+}
+
+void ClusteredLighting::buildClusterBounds(const glm::mat4& projection) {
+    boundsMinX.resize(CLUSTER_COUNT);
+    boundsMinY.resize(CLUSTER_COUNT);
+    boundsMinZ.resize(CLUSTER_COUNT);
+    boundsMaxX.resize(CLUSTER_COUNT);
+    boundsMaxY.resize(CLUSTER_COUNT);
+    boundsMaxZ.resize(CLUSTER_COUNT);
+    sphereX.resize(CLUSTER_COUNT);
+    sphereY.resize(CLUSTER_COUNT);
+    sphereZ.resize(CLUSTER_COUNT);
+    sphereRadius.resize(CLUSTER_COUNT);
+
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    auto unproject = [&inverseProjection](float x, float y, float z) {
+        glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+        return glm::vec3(point) / point.w;
+    };
+
+    for (int y = 0; y < CLUSTER_Y; y++) {
+        for (int x = 0; x < CLUSTER_X; x++) {
+            // The tile corners in NDC, and the lines they cover from the near plane to the far plane in view space
+            float ndcX[2] = {-1.0f + 2.0f * x / CLUSTER_X, -1.0f + 2.0f * (x + 1) / CLUSTER_X};
+            float ndcY[2] = {-1.0f + 2.0f * y / CLUSTER_Y, -1.0f + 2.0f * (y + 1) / CLUSTER_Y};
+            glm::vec3 nearCorners[4], farCorners[4];
+            for (int corner = 0; corner < 4; corner++) {
+                nearCorners[corner] = unproject(ndcX[corner & 1], ndcY[corner >> 1], -1.0f);
+                farCorners[corner] = unproject(ndcX[corner & 1], ndcY[corner >> 1], 1.0f);
+            }
+
+            for (int z = 0; z < CLUSTER_Z; z++) {
+                // The slices are distributed exponentially so that they look roughly cubic on screen
+                float sliceDepths[2] = {nearPlane * std::pow(farPlane / nearPlane, float(z) / CLUSTER_Z),
+                                        nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / CLUSTER_Z)};
+                glm::vec3 boundsMin(std::numeric_limits<float>::max());
+                glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+                for (int corner = 0; corner < 4; corner++) {
+                    const glm::vec3& nearCorner = nearCorners[corner];
+                    const glm::vec3& farCorner = farCorners[corner];
+                    for (float depth : sliceDepths) {
+                        // Find the point on the corner line whose view space depth (-z) is the slice depth
+                        float t = (depth + nearCorner.z) / (nearCorner.z - farCorner.z);
+                        glm::vec3 point = glm::mix(nearCorner, farCorner, t);
+                        boundsMin = glm::min(boundsMin, point);
+                        boundsMax = glm::max(boundsMax, point);
+                    }
+                }
+
+                int cluster = x + y * CLUSTER_X + z * CLUSTERS_PER_SLICE;
+                boundsMinX[cluster] = boundsMin.x;
+                boundsMinY[cluster] = boundsMin.y;
+                boundsMinZ[cluster] = boundsMin.z;
+                boundsMaxX[cluster] = boundsMax.x;
+                boundsMaxY[cluster] = boundsMax.y;
+                boundsMaxZ[cluster] = boundsMax.z;
+                glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+                sphereX[cluster] = center.x;
+                sphereY[cluster] = center.y;
+                sphereZ[cluster] = center.z;
+                sphereRadius[cluster] = 0.5f * glm::length(boundsMax - boundsMin);
+            }
+        }
+    }
+    boundsProjection = projection;
+    boundsValid = true;
+}
+
+void ClusteredLighting::update(const std::vector<const Light*>& lights, const glm::mat4& view,
+                               const glm::mat4& projection, float zNear, float zFar, glm::ivec2 windowSize) {
+    zNear = glm::max(zNear, 0.001f);
+    zFar = glm::max(zFar, zNear * 1.001f);
+    if (!boundsValid || projection != boundsProjection || zNear != nearPlane || zFar != farPlane) {
+        nearPlane = zNear;
+        farPlane = zFar;
+        sliceScale = CLUSTER_Z / std::log(zFar / zNear);
+        sliceBias = -CLUSTER_Z * std::log(zNear) / std::log(zFar / zNear);
+        buildClusterBounds(projection);
+    }
+    tileSize = glm::vec2(windowSize) / glm::vec2(CLUSTER_X, CLUSTER_Y);
+
+    // Fill the light data, the directional lights come first since they are evaluated by every fragment.
+    // Each light is 4 texels: (position, range), (color, type + 4 * mask bit), (direction, cos(outer)),
+    // (cos(inner), constant, linear, quadratic attenuation)
+    lightData.clear();
+    localLights.clear();
+    lightBits.clear();
+    masked = lights.size() <= MAX_MASKED_LIGHTS;
+    if (!masked && !maskOverflowReported) {
+        std::cerr << "[ClusteredLighting] WARNING: " << lights.size() << " lights, the light masks of the materials "
+                  << "are ignored above " << MAX_MASKED_LIGHTS << std::endl;
+        maskOverflowReported = true;
+    }
+    // The bits don't matter when the masks are ignored
+    for (size_t i = 0; i < lights.size(); i++)
+        lightBits.emplace(lights[i], masked ? static_cast<uint32_t>(i) : 0u);
+    auto getTypeAndBit = [this](const Light* light) {
+        return float(int(light->type) + 4 * int(lightBits[light]));
+    };
+    directionalLightCount = 0;
+    for (const Light* light : lights) {
+        if (!light->enabled || light->type != LightType::DIRECTIONAL)
+            continue;
+        lightData.emplace_back(0.0f);
+        lightData.emplace_back(light->color, getTypeAndBit(light));
+        lightData.emplace_back(glm::normalize(light->direction), 0.0f);
+        lightData.emplace_back(0.0f);
+        directionalLightCount++;
+    }
+    glm::mat3 viewRotation = glm::mat3(view);
+    for (const Light* light : lights) {
+        if (!light->enabled || light->type == LightType::DIRECTIONAL)
+            continue;
+        float range = getLightRange(*light);
+        if (range <= 0.0f)
+            continue;
+
+        LocalLight local;
+        local.index = static_cast<uint32_t>(lightData.size() / TEXELS_PER_LIGHT);
+        local.position = glm::vec3(view * glm::vec4(light->position, 1.0f));
+        local.range = range;
+        local.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        local.cosOuter = -1.0f;
+        local.sinOuter = 0.0f;
+        local.coneTest = false;
+        float cosOuter = -1.0f, cosInner = -1.0f;
+        glm::vec3 direction(0.0f, 0.0f, -1.0f);
+        if (light->type == LightType::SPOT) {
+            direction = glm::normalize(light->direction);
+            cosOuter = std::cos(light->spot_angle.outer);
+            cosInner = std::cos(light->spot_angle.inner);
+            local.direction = viewRotation * direction;
+            local.cosOuter = cosOuter;
+            local.sinOuter = std::sin(light->spot_angle.outer);
+            // The cone test only works for cones that are narrower than a hemisphere
+            local.coneTest = light->spot_angle.outer < glm::half_pi<float>();
+        }
+        localLights.push_back(local);
+
+        lightData.emplace_back(light->position, range);
+        lightData.emplace_back(light->color, getTypeAndBit(light));
+        lightData.emplace_back(direction, cosOuter);
+        lightData.emplace_back(cosInner, light->attenuation.constant, light->attenuation.linear,
+                               light->attenuation.quadratic);
+    }
+    localLightCount = static_cast<int>(localLights.size());
+
+    // Assign every local light to the clusters it touches.
+    // Only the depth slices covered by the light bounding sphere are tested.
+    std::fill(clusterLightCounts.begin(), clusterLightCounts.end(), 0u);
+    for (const LocalLight& light : localLights) {
+        float depth = -light.position.z;
+        if (depth + light.range < nearPlane || depth - light.range > farPlane)
+            continue;
+        int firstCluster = getSlice(depth - light.range) * CLUSTERS_PER_SLICE;
+        int lastCluster = (getSlice(depth + light.range) + 1) * CLUSTERS_PER_SLICE;
+        float rangeSquared = light.range * light.range;
+
+#ifdef CLUSTERED_LIGHTING_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 centerX = _mm_set1_ps(light.position.x);
+        const __m128 centerY = _mm_set1_ps(light.position.y);
+        const __m128 centerZ = _mm_set1_ps(light.position.z);
+        const __m128 radiusSquared = _mm_set1_ps(rangeSquared);
+        const __m128 range = _mm_set1_ps(light.range);
+        const __m128 directionX = _mm_set1_ps(light.direction.x);
+        const __m128 directionY = _mm_set1_ps(light.direction.y);
+        const __m128 directionZ = _mm_set1_ps(light.direction.z);
+        const __m128 cosOuter = _mm_set1_ps(light.cosOuter);
+        const __m128 sinOuter = _mm_set1_ps(light.sinOuter);
+#endif
+        for (int cluster = firstCluster; cluster < lastCluster; cluster += 4) {
+            int mask = 0;
+#ifdef CLUSTERED_LIGHTING_SSE
+            // Sphere vs AABB: the squared distance from the sphere center to the closest point in the box
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinX[cluster]), centerX),
+                                              _mm_sub_ps(centerX, _mm_loadu_ps(&boundsMaxX[cluster]))),
+                                   zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinY[cluster]), centerY),
+                                              _mm_sub_ps(centerY, _mm_loadu_ps(&boundsMaxY[cluster]))),
+                                   zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinZ[cluster]), centerZ),
+                                              _mm_sub_ps(centerZ, _mm_loadu_ps(&boundsMaxZ[cluster]))),
+                                   zero);
+            __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 visible = _mm_cmple_ps(distanceSquared, radiusSquared);
+
+            if (light.coneTest) {
+                // Cone vs the cluster bounding sphere: cull the spheres outside the cone angle, beyond its range
+                // or behind its apex
+                __m128 radius = _mm_loadu_ps(&sphereRadius[cluster]);
+                __m128 vx = _mm_sub_ps(_mm_loadu_ps(&sphereX[cluster]), centerX);
+                __m128 vy = _mm_sub_ps(_mm_loadu_ps(&sphereY[cluster]), centerY);
+                __m128 vz = _mm_sub_ps(_mm_loadu_ps(&sphereZ[cluster]), centerZ);
+                __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+                __m128 axisLength = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, directionX), _mm_mul_ps(vy, directionY)),
+                                               _mm_mul_ps(vz, directionZ));
+                __m128 perpendicularLength =
+                    _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSquared, _mm_mul_ps(axisLength, axisLength)), zero));
+                __m128 closestDistance =
+                    _mm_sub_ps(_mm_mul_ps(cosOuter, perpendicularLength), _mm_mul_ps(axisLength, sinOuter));
+                __m128 culled = _mm_or_ps(_mm_cmpgt_ps(closestDistance, radius),
+                                          _mm_or_ps(_mm_cmpgt_ps(axisLength, _mm_add_ps(radius, range)),
+                                                    _mm_cmplt_ps(axisLength, _mm_sub_ps(zero, radius))));
+                visible = _mm_andnot_ps(culled, visible);
+            }
+            mask = _mm_movemask_ps(visible);
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                int index = cluster + lane;
+                glm::vec3 closest = glm::clamp(light.position, glm::vec3(boundsMinX[index], boundsMinY[index], boundsMinZ[index]),
+                                               glm::vec3(boundsMaxX[index], boundsMaxY[index], boundsMaxZ[index]));
+                glm::vec3 offset = closest - light.position;
+                bool visible = glm::dot(offset, offset) <= rangeSquared;
+                if (visible && light.coneTest) {
+                    float radius = sphereRadius[index];
+                    glm::vec3 v = glm::vec3(sphereX[index], sphereY[index], sphereZ[index]) - light.position;
+                    float axisLength = glm::dot(v, light.direction);
+                    float perpendicularLength = std::sqrt(glm::max(glm::dot(v, v) - axisLength * axisLength, 0.0f));
+                    float closestDistance = light.cosOuter * perpendicularLength - axisLength * light.sinOuter;
+                    visible = !(closestDistance > radius || axisLength > radius + light.range || axisLength < -radius);
+                }
+                if (visible)
+                    mask |= 1 << lane;
+            }
+#endif
+            for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (!(mask & 1))
+                    continue;
+                uint32_t& count = clusterLightCounts[cluster + lane];
+                if (count < MAX_LIGHTS_PER_CLUSTER)
+                    clusterLightSlots[(cluster + lane) * MAX_LIGHTS_PER_CLUSTER + count++] = light.index;
+            }
+        }
+    }
+
+    // Compact the per-cluster slots into a single index list
+    lightIndices.clear();
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+        uint32_t count = clusterLightCounts[cluster];
+        clusterGrid[cluster] = glm::uvec2(static_cast<uint32_t>(lightIndices.size()), count);
+        const uint32_t* slots = &clusterLightSlots[cluster * MAX_LIGHTS_PER_CLUSTER];
+        lightIndices.insert(lightIndices.end(), slots, slots + count);
+    }
+
+    // Upload everything, re-specifying the buffer storage every frame avoids waiting for the previous frame
+    auto upload = [](GLuint buffer, size_t size, const void* data) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if (size == 0)
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        else
+            glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+    };
+    upload(lightDataBuffer, lightData.size() * sizeof(glm::vec4), lightData.data());
+    upload(clusterGridBuffer, clusterGrid.size() * sizeof(glm::uvec2), clusterGrid.data());
+    upload(lightIndexBuffer, lightIndices.size() * sizeof(uint32_t), lightIndices.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::bindTextures() const {
+    glActiveTexture(GL_TEXTURE0 + TextureUnits::TEXTURE_UNIT_CLUSTER_LIGHT_DATA);
+    glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+    glActiveTexture(GL_TEXTURE0 + TextureUnits::TEXTURE_UNIT_CLUSTER_GRID);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterGridTexture);
+    glActiveTexture(GL_TEXTURE0 + TextureUnits::TEXTURE_UNIT_CLUSTER_LIGHT_INDICES);
+    glBindTexture(GL_TEXTURE_BUFFER, lightIndexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+uint32_t ClusteredLighting::getLightMask(const std::vector<std::string>& lightNames) const {
+    if (!masked)
+        return ALL_LIGHTS_MASK;
+    uint32_t mask = 0;
+    for (const std::string& name : lightNames) {
+        const Light* light = AssetLoader<Light>::get(name);
+        if (!light) {
+            if (unknownLights.insert(name).second)
+                std::cerr << "[ClusteredLighting] ERROR: A material is lit by an unknown light: " << name << std::endl;
+            continue;
+        }
+        auto it = lightBits.find(light);
+        if (it != lightBits.end())
+            mask |= 1u << it->second;
+    }
+    return mask;
+}
+
+void ClusteredLighting::setupShader(ShaderProgram* shader, uint32_t lightMask) const {
+    shader->set("clusterLightData", TextureUnits::TEXTURE_UNIT_CLUSTER_LIGHT_DATA);
+    shader->set("clusterGrid", TextureUnits::TEXTURE_UNIT_CLUSTER_GRID);
+    shader->set("clusterLightIndices", TextureUnits::TEXTURE_UNIT_CLUSTER_LIGHT_INDICES);
+    shader->set("directionalLightCount", directionalLightCount);
+    shader->set("lightMask", lightMask);
+    shader->set("clusterTileSize", tileSize);
+    shader->set("clusterSliceScale", sliceScale);
+    shader->set("clusterSliceBias", sliceBias);
+}
+
+} // namespace our
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <ecs/lighting.hpp>
+#include <shader/shader.hpp>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace our {
+
+// Clustered forward lighting.
+// The view frustum is split into a grid of clusters (froxels): CLUSTER_X x CLUSTER_Y screen tiles and CLUSTER_Z
+// exponentially distributed depth slices. Every frame, the point and spot lights are assigned to the clusters they
+// touch on the CPU, and the light data, the per-cluster (offset, count) grid and the light index list are uploaded
+// to texture buffers. The PBR fragment shader then only loops over the lights of the cluster it lies in.
+// Directional lights affect every cluster, so they are stored first in the light data and are always evaluated.
+// A lit material can be restricted to some of the lights: each light gets a bit (its index in the list given to
+// "update") and the shader skips the lights whose bit is not in the material's mask. Beyond MAX_MASKED_LIGHTS lights
+// the bits would be shared, so the masks are ignored and every material is lit by all the lights.
+class ClusteredLighting {
+  public:
+    static constexpr int CLUSTER_X = 16;
+    static constexpr int CLUSTER_Y = 9;
+    static constexpr int CLUSTER_Z = 24;
+    static constexpr int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+    // The number of lights a single cluster can reference, extra lights are dropped
+    static constexpr int MAX_LIGHTS_PER_CLUSTER = 128;
+    // The received light intensity below which a point or spot light is considered to have no effect.
+    // It is used to derive the range of lights that do not specify one.
+    static constexpr float LIGHT_INTENSITY_CUTOFF = 0.01f;
+    // Each light is stored as 4 RGBA32F texels in the light data buffer
+    static constexpr int TEXELS_PER_LIGHT = 4;
+    // The number of bits of a light mask, the masks are ignored when there are more lights
+    static constexpr uint32_t MAX_MASKED_LIGHTS = 32;
+    static constexpr uint32_t ALL_LIGHTS_MASK = 0xFFFFFFFFu;
+
+  private:
+    // A point or spot light prepared for the cluster assignment (in view space)
+    struct LocalLight {
+        glm::vec3 position;
+        float range;
+        glm::vec3 direction;
+        float cosOuter, sinOuter;
+        bool coneTest; // False for point lights and for spot lights too wide for the cone test
+        uint32_t index; // The index of the light in the light data buffer
+    };
+
+    // Texture buffers (and their backing buffer objects) read by the fragment shader
+    GLuint lightDataBuffer = 0, lightDataTexture = 0;
+    GLuint clusterGridBuffer = 0, clusterGridTexture = 0;
+    GLuint lightIndexBuffer = 0, lightIndexTexture = 0;
+
+    // The view space bounds of each cluster, stored as structure of arrays so that 4 clusters are tested at once.
+    // They only depend on the projection so they are rebuilt only when it changes.
+    std::vector<float> boundsMinX, boundsMinY, boundsMinZ, boundsMaxX, boundsMaxY, boundsMaxZ;
+    // The bounding sphere of each cluster (used by the spot light cone test)
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    glm::mat4 boundsProjection = glm::mat4(0.0f);
+    float nearPlane = 0.0f, farPlane = 0.0f;
+    bool boundsValid = false;
+
+    // CPU side staging data, kept as members to avoid reallocating them every frame
+    std::vector<glm::vec4> lightData;
+    std::vector<LocalLight> localLights;
+    std::vector<glm::uvec2> clusterGrid;
+    std::vector<uint32_t> lightIndices;
+    std::vector<uint32_t> clusterLightCounts;
+    std::vector<uint32_t> clusterLightSlots;
+    // The mask bit of each light given to the last "update"
+    std::unordered_map<const Light*, uint32_t> lightBits;
+    // False if the last "update" got more than MAX_MASKED_LIGHTS lights (reported once)
+    bool masked = true;
+    bool maskOverflowReported = false;
+    // The light names given to "getLightMask" that named no light asset
+    mutable std::unordered_set<std::string> unknownLights;
+
+    int directionalLightCount = 0;
+    int localLightCount = 0;
+    glm::vec2 tileSize = glm::vec2(1.0f);
+    float sliceScale = 0.0f, sliceBias = 0.0f;
+
+    ClusteredLighting() = default;
+    ClusteredLighting(const ClusteredLighting&) = delete;
+    ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+    // Recomputes the view space bounds of all the clusters for the given projection
+    void buildClusterBounds(const glm::mat4& projection);
+    // Returns the depth slice that contains the given (positive) view space depth
+    int getSlice(float depth) const;
+
+  public:
+    static ClusteredLighting& getInstance() {
+        static ClusteredLighting instance;
+        return instance;
+    }
+
+    // Creates the texture buffers
+    void initialize();
+    // Assigns the given lights to the clusters of the given camera and uploads the result to the GPU
+    // "zNear" and "zFar" must be the ones used to build the projection matrix
+    void update(const std::vector<const Light*>& lights, const glm::mat4& view, const glm::mat4& projection,
+                float zNear, float zFar, glm::ivec2 windowSize);
+    // Binds the texture buffers to their texture units (call once per frame after "update")
+    void bindTextures() const;
+    // Sets the cluster lookup uniforms on a shader that uses the clustered lights (e.g. "pbr")
+    // The cluster grid dimensions are compiled into the shader (CLUSTER_X, CLUSTER_Y and CLUSTER_Z in "pbr.frag")
+    // Only the lights whose bit is in "lightMask" light the drawn objects (see getLightMask)
+    void setupShader(ShaderProgram* shader, uint32_t lightMask = ALL_LIGHTS_MASK) const;
+    // The mask of the named lights for the last "update" (the lights it didn't get are ignored), ALL_LIGHTS_MASK if
+    // it got too many lights to mask them. The names of no light asset are reported once.
+    uint32_t getLightMask(const std::vector<std::string>& lightNames) const;
+    // Releases the GPU resources
+    void destroy();
+
+    int getDirectionalLightCount() const { return directionalLightCount; }
+    int getLocalLightCount() const { return localLightCount; }
+    // The total number of light references in all the clusters (useful to judge the light assignment cost)
+    size_t getLightIndexCount() const { return lightIndices.size(); }
+
+    // Returns the distance at which the light contribution falls below LIGHT_INTENSITY_CUTOFF
+    // (or the largest float for the lights that don't fall off)
+    static float getLightRange(const Light& light);
+};
+
+} // namespace our
@@ -4,6 +4,7 @@
 #include <systems/weapons-system.hpp>
 #include <systems/audio-system.hpp>
 #include <components/model-renderer.hpp>
+#include <components/animation-component.hpp>
 #include "enemy-system.hpp"
 namespace our {
 
@@ -42,6 +43,7 @@ void EnemySystem::update(World *world, float deltaTime) {
 
         enemyCount++;
         _updateAIState(entity, deltaTime);
+        _updateAnimation(entity);
         _handleMovement(entity, deltaTime);
         _syncDetectionArea(entity);
     }
@@ -88,18 +90,13 @@ void EnemySystem::_setCollisionCallbacks(Entity *entity) {
     auto collision = entity->getComponent<CollisionComponent>();
     if (!collision) return;
 
-    collision->callbacks.onEnter = [enemy, entity](Entity *other) {
+    collision->callbacks.onEnter = [this, enemy, entity](Entity *other) {
         if (enemy->currentState == EnemyState::DEAD) return;
-        if (other->name == "Projectile") { 
-            AudioSystem::getInstance().playSpatialSound("killing", entity, entity->localTransform.position, "sfx", false, 1.0f, 100.0f);
-            enemy->currentState = EnemyState::DEAD;
-            enemy->stateTimer = 0.0f;
+        if (other->name == "Projectile") {
+            // The bullets only go through the collision shape of the enemies hit through their bones (see hitEnemy)
+            if (!isHitThroughBones(entity)) _kill(entity);
         } else if (auto weapon = other->getComponent<WeaponComponent>()) {
-            if (entity->parent != entity) {
-                AudioSystem::getInstance().playSpatialSound("killing", entity, entity->localTransform.position, "sfx", false, 1.0f, 100.0f);
-                enemy->currentState = EnemyState::DEAD;
-                enemy->stateTimer = 0.0f;
-            }
+            if (entity->parent != entity) _kill(entity);
         }
     };
 
@@ -148,6 +145,22 @@ void EnemySystem::_updateAIState(Entity *entity, float deltaTime) {
     }
 }
 
+void EnemySystem::_updateAnimation(Entity *entity) {
+    auto enemy = entity->getComponent<EnemyControllerComponent>();
+    int state = static_cast<int>(enemy->currentState);
+    if (state == enemy->animatedState) return;
+
+    // The animation is on the model child when there is one
+    AnimationComponent *animation = enemy->model ? enemy->model->getComponent<AnimationComponent>() : nullptr;
+    if (!animation) animation = entity->getComponent<AnimationComponent>();
+    if (!animation) return;
+
+    enemy->animatedState = state;
+    AnimationClipId clip = enemy->stateAnimations[state];
+    if (clip != INVALID_ANIMATION_CLIP)
+        animation->crossfade(clip, enemy->animationFadeTime, enemy->currentState != EnemyState::DEAD);
+}
+
 void EnemySystem::_handleMovement(Entity *entity, float deltaTime) {
     auto collision = entity->getComponent<CollisionComponent>();
     auto enemy = entity->getComponent<EnemyControllerComponent>();
@@ -362,6 +375,37 @@ void EnemySystem::_handleDeath(Entity *entity) {
     }
 }
 
+void EnemySystem::_kill(Entity *entity) {
+    auto enemy = entity->getComponent<EnemyControllerComponent>();
+    AudioSystem::getInstance().playSpatialSound("killing", entity, entity->localTransform.position, "sfx", false, 1.0f, 100.0f);
+    enemy->currentState = EnemyState::DEAD;
+    enemy->stateTimer = 0.0f;
+}
+
+Entity *EnemySystem::_findEnemy(Entity *entity) {
+    for (; entity; entity = entity->parent)
+        if (entity->getComponent<EnemyControllerComponent>()) return entity;
+    return nullptr;
+}
+
+bool EnemySystem::isHitThroughBones(Entity *entity) {
+    Entity *enemyEntity = _findEnemy(entity);
+    if (!enemyEntity) return false;
+    auto enemy = enemyEntity->getComponent<EnemyControllerComponent>();
+    AnimationComponent *animation = enemy->model ? enemy->model->getComponent<AnimationComponent>() : nullptr;
+    if (!animation) animation = enemyEntity->getComponent<AnimationComponent>();
+    return animation && animation->modelAsset && !animation->modelAsset->getBoneCapsules().empty();
+}
+
+bool EnemySystem::hitEnemy(Entity *entity, int bone) {
+    Entity *enemyEntity = _findEnemy(entity);
+    if (!enemyEntity || bone < 0) return false;
+    auto enemy = enemyEntity->getComponent<EnemyControllerComponent>();
+    if (enemy->currentState == EnemyState::DEAD) return false;
+    _kill(enemyEntity);
+    return true;
+}
+
 void EnemySystem::onDestroy() {
     playerEntity = nullptr;
     enemyCount = 1;
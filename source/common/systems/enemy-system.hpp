@@ -28,6 +28,8 @@ class EnemySystem {
 
     void _updateAIState(Entity *entity, float deltaTime);
 
+    void _updateAnimation(Entity *entity);
+
     void _handleMovement(Entity *entity, float deltaTime);
 
     void _handlePatrolling(Entity *entity);
@@ -47,6 +49,11 @@ class EnemySystem {
     void _handleSearching(Entity *entity, float deltaTime);
 
     void _handleDeath(Entity *entity);
+
+    void _kill(Entity *entity);
+
+    // Returns the enemy that owns the entity (itself or one of its parents, e.g. for its model)
+    Entity *_findEnemy(Entity *entity);
 public:
     static EnemySystem& getInstance() {
         static EnemySystem instance;
@@ -63,6 +70,14 @@ public:
 
     void update(World *world, float deltaTime);
 
+    // The enemies whose animated model has bone capsules are hit by the bullets of the player through their bones
+    // (see WeaponsSystem::raycastAnimated) instead of their collision shapes, which don't follow the limbs
+    bool isHitThroughBones(Entity *entity);
+
+    // Kills the enemy that owns the entity when a bullet of the player hits one of its bones. Returns false if the
+    // entity isn't part of a living enemy.
+    bool hitEnemy(Entity *entity, int bone);
+
     void onDestroy();
 };
 
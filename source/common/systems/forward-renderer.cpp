@@ -1,10 +1,16 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
 #include "../texture/texture-utils.hpp"
+#include "../components/animation-component.hpp"
 #include <systems/trail-system.hpp>
+#include <settings.hpp>
+#include <limits>
 
 namespace our {
 
+// A level of detail only changes when its error is this much past the limit, so objects at the limit don't flicker
+static const float LOD_HYSTERESIS = 0.25f;
+
 void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json &config) {
     // First, we store the window size for later use
     this->windowSize = windowSize;
@@ -64,6 +70,22 @@ void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json &co
         this->skyMaterial->transparent = false;
     }
 
+    // Create the texture buffers that hold the per-frame light clusters
+    ClusteredLighting::getInstance().initialize();
+
+    // The depth pre-pass shader must transform the vertices exactly like "pbr.vert" so that GL_EQUAL passes
+    depthPrePassShader = new ShaderProgram();
+    depthPrePassShader->attach("assets/shaders/depth-prepass.vert", GL_VERTEX_SHADER);
+    depthPrePassShader->attach("assets/shaders/depth-prepass.frag", GL_FRAGMENT_SHADER);
+    depthPrePassShader->link();
+    skinnedDepthPrePassShader = new ShaderProgram();
+    skinnedDepthPrePassShader->attach("assets/shaders/depth-prepass.vert", GL_VERTEX_SHADER, {"SKINNED"});
+    skinnedDepthPrePassShader->attach("assets/shaders/depth-prepass.frag", GL_FRAGMENT_SHADER, {"SKINNED"});
+    skinnedDepthPrePassShader->link();
+
+    // Create the texture buffer that holds the per-frame skinning matrices
+    SkinningBuffer::getInstance().initialize();
+
     // Then we check if there is a postprocessing shader in the configuration
     if (config.contains("postprocess")) {
         postprocess = new PostProcess();
@@ -94,6 +116,103 @@ void ForwardRenderer::destroy() {
     if (hdrSystem) {
         delete hdrSystem;
     }
+
+    if (depthPrePassShader) {
+        delete depthPrePassShader;
+        depthPrePassShader = nullptr;
+    }
+    if (skinnedDepthPrePassShader) {
+        delete skinnedDepthPrePassShader;
+        skinnedDepthPrePassShader = nullptr;
+    }
+
+    ClusteredLighting::getInstance().destroy();
+    SkinningBuffer::getInstance().destroy();
+}
+
+bool ForwardRenderer::usesDepthPrePass(const RenderCommand &command) {
+    // Only the lit materials are worth it (and they share the vertex transform of the pre-pass shader)
+    if (!dynamic_cast<LitMaterial *>(command.material))
+        return false;
+    const PipelineState &state = command.material->pipelineState;
+    return !command.material->transparent && state.depthTesting.enabled && state.depthMask;
+}
+
+void ForwardRenderer::selectLod(RenderCommand &command, const glm::vec3 &cameraPosition, float pixelsPerUnit) {
+    if (!command.model && !command.mesh)
+        return;
+    size_t lodCount;
+    float radius;
+    glm::vec3 center;
+    if (command.model) {
+        lodCount = command.model->getLodCount();
+        Mesh *bounds = command.model->getCombinedMesh();
+        center = bounds ? bounds->getBoundsCenter() : glm::vec3(0.0f);
+        radius = bounds ? bounds->getBoundsRadius() : 0.0f;
+    } else {
+        lodCount = command.mesh->getLodCount();
+        center = command.mesh->getBoundsCenter();
+        radius = command.mesh->getBoundsRadius();
+    }
+    size_t current = command.lodState ? std::min(*command.lodState, lodCount - 1) : 0;
+    auto getError = [&command](size_t lod) {
+        return command.model ? command.model->getLodError(lod) : command.mesh->getLod(lod).error;
+    };
+
+    Settings &settings = Settings::getInstance();
+    if (lodCount <= 1) {
+        current = 0;
+    } else if (settings.forcedLod >= 0) {
+        current = std::min<size_t>(settings.forcedLod, lodCount - 1);
+    } else {
+        // The radius of the bounding sphere on the screen (in pixels), the errors are relative to it
+        glm::mat3 linear(command.localToWorld);
+        float scale = std::max({glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+        float worldRadius = radius * scale;
+        float distance = glm::length(glm::vec3(command.localToWorld * glm::vec4(center, 1.0f)) - cameraPosition);
+        float projectedRadius = distance > worldRadius
+                                    ? worldRadius / std::sqrt(distance * distance - worldRadius * worldRadius) * pixelsPerUnit
+                                    : std::numeric_limits<float>::infinity();
+
+        float maxPixelError = settings.lodPixelError;
+        if (getError(current) * projectedRadius > maxPixelError * (1.0f + LOD_HYSTERESIS)) {
+            // Too coarse: refine until the error is acceptable again
+            while (current > 0 && getError(current) * projectedRadius > maxPixelError)
+                current--;
+        } else {
+            // Only go coarser once the next level is well within the limit
+            while (current + 1 < lodCount && getError(current + 1) * projectedRadius <= maxPixelError * (1.0f - LOD_HYSTERESIS))
+                current++;
+        }
+    }
+    command.lod = current;
+    if (command.lodState)
+        *command.lodState = current;
+}
+
+void ForwardRenderer::countDraw(const RenderCommand &command) {
+    if (command.model) {
+        statistics.drawnTriangles += command.model->getTriangleCount(command.lod);
+        statistics.fullDetailTriangles += command.model->getTriangleCount(0);
+    } else {
+        statistics.drawnTriangles += command.mesh->getTriangleCount(command.lod);
+        statistics.fullDetailTriangles += command.mesh->getTriangleCount(0);
+    }
+    statistics.lodDraws[std::min(command.lod, mesh_simplifier::MAX_LOD_COUNT - 1)]++;
+}
+
+// Creates the dynamic meshes of an instance skinned on the CPU, or uploads its vertices if they changed
+static void uploadCpuSkin(AnimationComponent::CpuSkin &skin, const Model &model) {
+    const std::vector<MeshRendererComponent *> &submeshes = model.getSubmeshes();
+    if (skin.meshes.size() != submeshes.size()) {
+        skin.meshes.clear();
+        for (size_t i = 0; i < submeshes.size(); ++i)
+            skin.meshes.push_back(std::make_unique<Mesh>(*submeshes[i]->mesh, skin.vertices[i]));
+    } else if (skin.dirty) {
+        for (size_t i = 0; i < submeshes.size(); ++i)
+            skin.meshes[i]->updateVertices(skin.vertices[i]);
+    }
+    skin.dirty = false;
 }
 
 void ForwardRenderer::render(World *world) {
@@ -102,6 +221,9 @@ void ForwardRenderer::render(World *world) {
     opaqueCommands.clear();
     transparentCommands.clear();
     modelCommands.clear();
+    SkinningBuffer &skinningBuffer = SkinningBuffer::getInstance();
+    skinningBuffer.begin();
+    bool cpuSkinning = Settings::getInstance().cpuSkinning;
     for (auto entity : world->getEntities()) {
         // If we hadn't found a camera yet, we look for a camera in this entity
         if (!camera)
@@ -114,6 +236,7 @@ void ForwardRenderer::render(World *world) {
             command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
             command.mesh = meshRenderer->mesh;
             command.material = meshRenderer->material;
+            command.lodState = &meshRenderer->lod;
             // if it is transparent, we add it to the transparent commands list
             if (command.material->transparent) {
                 transparentCommands.push_back(command);
@@ -129,6 +252,28 @@ void ForwardRenderer::render(World *world) {
             command.localToWorld = model_renderer->getOwner()->getLocalToWorldMatrix();
             command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
             command.model = model_renderer->model;
+            command.lodState = &model_renderer->lod;
+            // Every instance of an animated model draws its own pose, the instances that have none (or that were
+            // not animated yet) share the bind pose of the model
+            if (command.model && command.model->isSkinned()) {
+                AnimationComponent *animation = entity->getComponent<AnimationComponent>();
+                if (animation && animation->modelAsset != command.model)
+                    animation = nullptr;
+                if (animation && !cpuSkinning && !animation->cpuSkin.vertices.empty())
+                    animation->cpuSkin = AnimationComponent::CpuSkin();
+
+                if (animation && cpuSkinning && animation->cpuSkin.valid) {
+                    uploadCpuSkin(animation->cpuSkin, *command.model);
+                    command.skinnedMeshes = &animation->cpuSkin.meshes;
+                    // The weights of the vertices skinned on the CPU are cleared, the shaders read no matrix
+                    command.skinningOffset = 0;
+                } else {
+                    const AnimationPose *pose = &command.model->getBindPose();
+                    if (animation && animation->pose.getBoneCount() > 0)
+                        pose = &animation->pose;
+                    command.skinningOffset = skinningBuffer.append(*pose);
+                }
+            }
             modelCommands.push_back(command);
         }
     }
@@ -150,11 +295,36 @@ void ForwardRenderer::render(World *world) {
                   float distance2 = glm::dot(second.center, cameraForward);
                   return distance1 < distance2;
               });
+    // Opaque objects are drawn front to back so that early-Z rejects the hidden fragments as soon as possible
+    // Since "cameraForward" points behind the camera, the nearest objects have the largest projection on it
+    auto frontToBack = [cameraForward](const RenderCommand &first, const RenderCommand &second) {
+        return glm::dot(first.center, cameraForward) > glm::dot(second.center, cameraForward);
+    };
+    std::sort(opaqueCommands.begin(), opaqueCommands.end(), frontToBack);
+    std::sort(modelCommands.begin(), modelCommands.end(), frontToBack);
 
     // TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
     glm::mat4 view = camera->getViewMatrix();
     glm::mat4 projection = camera->getProjectionMatrix(windowSize);
     glm::mat4 VP = projection * view;
+
+    // Pick the level of detail of every command before the depth pre-pass so both passes draw the same triangles
+    glm::vec3 cameraPosition = glm::vec3(cameraMatrix[3]);
+    float pixelsPerUnit = projection[1][1] * windowSize.y * 0.5f;
+    statistics = Statistics();
+    for (auto *commands : {&opaqueCommands, &transparentCommands, &modelCommands})
+        for (auto &command : *commands)
+            selectLod(command, cameraPosition, pixelsPerUnit);
+
+    // Assign the lights to the clusters of this camera (the lit materials read them in their shaders)
+    frameLights.clear();
+    for (const auto &[name, light] : AssetLoader<Light>::getAll()) {
+        frameLights.push_back(light);
+    }
+    ClusteredLighting &clusteredLighting = ClusteredLighting::getInstance();
+    clusteredLighting.update(frameLights, view, projection, camera->near, camera->far, windowSize);
+    // All the skinned instances are uploaded at once, each draw only points to its matrices
+    skinningBuffer.upload();
     // TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
     glm::vec2 viewportStart = glm::vec2(0, 0);
     glm::vec2 viewportSize = windowSize;
@@ -189,23 +359,75 @@ void ForwardRenderer::render(World *world) {
         // bind pre-computed IBL data
         this->hdrSystem->bindTextures();
     }
+    clusteredLighting.bindTextures();
+    skinningBuffer.bindTexture();
+
+    Settings &settings = Settings::getInstance();
+    bool overdrawMode = settings.shaderDebugMode == "overdraw";
+    bool depthPrePass = settings.depthPrePass && depthPrePassShader && skinnedDepthPrePassShader;
+
+    // Depth pre-pass: write the depth of the opaque lit objects (and models) without any shading so that the
+    // expensive PBR fragment shader only runs once per visible pixel
+    if (depthPrePass) {
+        depthPrePassShader->use();
+        depthPrePassShader->set("view", view);
+        depthPrePassShader->set("projection", projection);
+        for (auto &command : opaqueCommands) {
+            if (!usesDepthPrePass(command))
+                continue;
+            PipelineState depthState = command.material->pipelineState;
+            depthState.depthTesting.function = GL_LEQUAL;
+            depthState.blending.enabled = false;
+            depthState.colorMask = {false, false, false, false};
+            depthState.depthMask = true;
+            depthState.setup();
+            depthPrePassShader->set("model", command.localToWorld);
+            command.mesh->drawDepthOnly(command.lod);
+        }
+        for (auto &command : modelCommands) {
+            if (command.skinningOffset < 0)
+                command.model->drawDepthOnly(depthPrePassShader, command.localToWorld, command.lod);
+        }
+        skinnedDepthPrePassShader->use();
+        skinnedDepthPrePassShader->set("view", view);
+        skinnedDepthPrePassShader->set("projection", projection);
+        for (auto &command : modelCommands) {
+            if (command.skinningOffset >= 0)
+                command.model->drawDepthOnly(skinnedDepthPrePassShader, command.localToWorld, command.lod,
+                                             command.skinningOffset, command.skinnedMeshes);
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
 
     // TODO: (Req 9) Draw all the opaque commands
     //  Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
     for (auto &command : opaqueCommands) {
         glm::mat4 MVP = VP * command.localToWorld;
         command.material->setup();
+        bool isLit = dynamic_cast<LitMaterial *>(command.material) != nullptr;
+        if (depthPrePass && usesDepthPrePass(command)) {
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        if (overdrawMode && isLit) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+        }
+        if (isLit) {
+            command.material->shader->set("debugMode", settings.shaderDebugModeToInt(settings.shaderDebugMode));
+        }
         command.material->shader->set("transform", MVP);
         command.material->shader->set("cameraPosition", camera->getOwner()->localTransform.position);
         command.material->shader->set("view", view);
         command.material->shader->set("projection", projection);
         command.material->shader->set("model", command.localToWorld);
         command.material->shader->set("bloomBrightnessCutoff", bloomBrightnessCutoff);
-        command.mesh->draw();
+        command.mesh->draw(command.lod);
+        countDraw(command);
     }
 
-    // If there is a sky material, draw the sky
-    if (this->skyMaterial) {
+    // If there is a sky material, draw the sky (the overdraw view only shows the scene geometry)
+    if (this->skyMaterial && !overdrawMode) {
         // TODO: (Req 10) setup the sky material
         this->skyMaterial->setup();
 
@@ -233,11 +455,20 @@ void ForwardRenderer::render(World *world) {
     }
 
     for (auto &command : modelCommands) {
-        command.model->draw(camera, command.localToWorld, windowSize, bloomBrightnessCutoff);
+        command.model->draw(camera, command.localToWorld, windowSize, bloomBrightnessCutoff, depthPrePass, command.lod,
+                            command.skinningOffset, command.skinnedMeshes);
+        countDraw(command);
+    }
+
+    // Restore the depth state that may have been changed by the pre-passed draws
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_TRUE);
+    if (overdrawMode) {
+        glDisable(GL_BLEND);
     }
 
     //! The order of the hdrSystem is important
-    if (this->hdrSystem) {
+    if (this->hdrSystem && !overdrawMode) {
         // Render the background if the HDR system is enabled
         hdrSystem->renderBackground(projection, view, 10);
     }
@@ -265,7 +496,8 @@ void ForwardRenderer::render(World *world) {
         command.material->shader->set("projection", projection);
         command.material->shader->set("model", command.localToWorld);
         command.material->shader->set("bloomBrightnessCutoff", bloomBrightnessCutoff);
-        command.mesh->draw();
+        command.mesh->draw(command.lod);
+        countDraw(command);
     }
 
     // If there is a postprocess material, apply postprocessing
@@ -11,6 +11,8 @@
 #include <ibl/hdr-system.hpp>
 #include <ibl/fullscreenquad.hpp>
 #include <ibl/postprocess.hpp>
+#include <systems/clustered-lighting.hpp>
+#include <systems/skinning-buffer.hpp>
 #include <glad/gl.h>
 #include <vector>
 #include <algorithm>
@@ -25,9 +27,17 @@ namespace our
     struct RenderCommand {
         glm::mat4 localToWorld;
         glm::vec3 center;
-        Mesh* mesh;
-        Material* material;
+        Mesh* mesh = nullptr;
+        Material* material = nullptr;
         Model* model = nullptr;
+        // Where the pose of the skinned model instance starts in the SkinningBuffer (-1 if it is not skinned)
+        int32_t skinningOffset = -1;
+        // The meshes of the instance skinned on the CPU, drawn instead of the submeshes of the model (see
+        // AnimationComponent::CpuSkin)
+        const std::vector<std::unique_ptr<Mesh>>* skinnedMeshes = nullptr;
+        // The level of detail to draw, and where the component remembers it for the next frame
+        size_t lod = 0;
+        size_t* lodState = nullptr;
     };
 
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
@@ -42,18 +52,32 @@ namespace our
         std::vector<RenderCommand> opaqueCommands;
         std::vector<RenderCommand> transparentCommands;
         std::vector<RenderCommand> modelCommands;
+        // The lights gathered this frame to be assigned to the light clusters
+        std::vector<const Light*> frameLights;
         // Objects used for rendering a skybox
         Mesh* skySphere;
         TexturedMaterial* skyMaterial;
         
         Crosshair* crosshair = nullptr;
 
+        // Position-only shader used to lay down the depth of the opaque lit objects before shading them
+        ShaderProgram* depthPrePassShader = nullptr;
+        // Its "SKINNED" permutation for the skinned models
+        ShaderProgram* skinnedDepthPrePassShader = nullptr;
+
         HDRSystem* hdrSystem;
         // Objects used for Postprocessing
 
     public:
         PostProcess* postprocess;    
 
+        // The triangles drawn by the last frame (for the debug menu)
+        struct Statistics {
+            size_t drawnTriangles = 0;
+            size_t fullDetailTriangles = 0;     // What the same draws would cost at the full level of detail
+            size_t lodDraws[mesh_simplifier::MAX_LOD_COUNT] = {}; // The meshes and models drawn at each level
+        };
+
         static ForwardRenderer& getInstance() {
             static ForwardRenderer instance;
             return instance;
@@ -66,6 +90,17 @@ namespace our
         // This function should be called every frame to draw the given world
         void render(World* world);
 
+        const Statistics& getStatistics() const { return statistics; }
+
+    private:
+        Statistics statistics;
+
+        // Returns true if the command's depth is written in the depth pre-pass and shaded later with GL_EQUAL
+        static bool usesDepthPrePass(const RenderCommand& command);
+        // Picks the level of detail of the command from the size of its bounding sphere on the screen
+        void selectLod(RenderCommand& command, const glm::vec3& cameraPosition, float pixelsPerUnit);
+        // Counts the triangles of a draw in the statistics
+        void countDraw(const RenderCommand& command);
 
     };
 
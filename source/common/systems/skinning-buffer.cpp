@@ -0,0 +1,67 @@
+#include "skinning-buffer.hpp"
+#include <texture/texture-unit.hpp>
+
+namespace our {
+
+static_assert(sizeof(glm::mat4) == SkinningBuffer::TEXELS_PER_MATRIX * sizeof(glm::vec4),
+              "A matrix is uploaded as its 4 columns, one RGBA32F texel each");
+
+void SkinningBuffer::initialize() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void SkinningBuffer::destroy() {
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+    texture = buffer = 0;
+    matrices.clear();
+    offsets.clear();
+}
+
+void SkinningBuffer::begin() {
+    matrices.clear();
+    offsets.clear();
+}
+
+int32_t SkinningBuffer::append(const AnimationPose& pose) {
+    if (pose.getBoneCount() == 0)
+        return -1;
+    auto [it, inserted] = offsets.emplace(&pose, static_cast<int32_t>(matrices.size()));
+    if (inserted)
+        matrices.insert(matrices.end(), pose.finalTransforms.begin(), pose.finalTransforms.end());
+    return it->second;
+}
+
+void SkinningBuffer::upload() {
+    statistics.poses = offsets.size();
+    statistics.matrices = matrices.size();
+    statistics.bytes = matrices.size() * sizeof(glm::mat4);
+
+    // Re-specifying the buffer storage every frame avoids waiting for the previous frame to stop reading it
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (matrices.empty())
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    else
+        glBufferData(GL_TEXTURE_BUFFER, statistics.bytes, matrices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void SkinningBuffer::bindTexture() const {
+    glActiveTexture(GL_TEXTURE0 + TextureUnits::TEXTURE_UNIT_SKINNING);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void SkinningBuffer::setupShader(ShaderProgram* shader, int32_t offset) {
+    shader->set("boneMatrices", TextureUnits::TEXTURE_UNIT_SKINNING);
+    shader->set("boneOffset", static_cast<GLint>(offset));
+}
+
+} // namespace our
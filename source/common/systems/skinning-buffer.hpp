@@ -0,0 +1,69 @@
+#pragma once
+
+#include <animation/animation-pose.hpp>
+#include <shader/shader.hpp>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+// The skinning matrices of all the animated instances drawn in a frame, uploaded at once.
+// The renderer appends the pose of every skinned instance to a staging array while it builds its commands, then
+// uploads the whole array to a single texture buffer (4 RGBA32F texels per matrix) before the first draw. Each draw
+// only passes the offset of its first matrix ("boneOffset"), so the submeshes of a model share one upload instead of
+// setting every bone as a separate uniform for every submesh, and an instance drawn by several passes (the depth
+// pre-pass and the color pass) is uploaded once.
+class SkinningBuffer {
+  public:
+    static constexpr int TEXELS_PER_MATRIX = 4;
+
+    struct Statistics {
+        size_t poses = 0;    // The poses uploaded in the last frame
+        size_t matrices = 0; // Their matrices
+        size_t bytes = 0;    // The size of the upload
+    };
+
+  private:
+    GLuint buffer = 0, texture = 0;
+
+    // CPU side staging data, kept as members to avoid reallocating them every frame
+    std::vector<glm::mat4> matrices;
+    // The offset of every pose already appended this frame (the instances without a pose share the bind pose of
+    // their model)
+    std::unordered_map<const AnimationPose*, int32_t> offsets;
+
+    Statistics statistics;
+
+    SkinningBuffer() = default;
+    SkinningBuffer(const SkinningBuffer&) = delete;
+    SkinningBuffer& operator=(const SkinningBuffer&) = delete;
+
+  public:
+    static SkinningBuffer& getInstance() {
+        static SkinningBuffer instance;
+        return instance;
+    }
+
+    // Creates the texture buffer
+    void initialize();
+    // Starts a new frame (the offsets of the previous frame are no longer valid)
+    void begin();
+    // Stages the final transforms of the pose and returns the index of its first matrix (-1 if it has no bones).
+    // The pose must stay alive and unchanged until "upload".
+    int32_t append(const AnimationPose& pose);
+    // Uploads the staged matrices (call once per frame, after the last "append" and before the first draw)
+    void upload();
+    // Binds the texture buffer to its texture unit (call once per frame after "upload")
+    void bindTexture() const;
+    // Sets the uniforms of a skinned shader (a "SKINNED" permutation) for a draw of the pose at the given offset
+    static void setupShader(ShaderProgram* shader, int32_t offset);
+    // Releases the GPU resources
+    void destroy();
+
+    const Statistics& getStatistics() const { return statistics; }
+};
+
+} // namespace our
@@ -1,4 +1,6 @@
 #include "weapons-system.hpp"
+#include <animation/animation-bounds.hpp>
+#include <components/animation-component.hpp>
 #include <components/camera.hpp>
 #include <components/collision.hpp>
 #include <components/enemy-controller.hpp>
@@ -7,8 +9,10 @@
 #include <components/weapon.hpp>
 #include <systems/audio-system.hpp>
 #include <systems/collision-system.hpp>
+#include <systems/enemy-system.hpp>
 #include <systems/fps-controller.hpp>
 #include <systems/movement.hpp>
+#include <algorithm>
 
 namespace our {
 void WeaponsSystem::update(World *world, float deltaTime) {
@@ -22,6 +26,22 @@ void WeaponsSystem::update(World *world, float deltaTime) {
         }
         proj->timeAlive += deltaTime;
 
+        // The bullets of the player hit the animated enemies through their bones (see EnemySystem::hitEnemy)
+        glm::vec3 position = proj->entity->localTransform.position;
+        if (proj->entity->name == "Projectile") {
+            Entity *hitEntity = nullptr;
+            glm::vec3 hitPoint;
+            int bone = -1;
+            Entity *shooter = proj->owner ? proj->owner->parent : nullptr;
+            if (raycastAnimated(world, proj->previousPosition, position, hitEntity, hitPoint, bone, shooter) &&
+                EnemySystem::getInstance().hitEnemy(hitEntity, bone)) {
+                world->markForRemoval(proj->entity);
+                toRemove.push_back(proj);
+                continue;
+            }
+        }
+        proj->previousPosition = position;
+
         if (proj->lifetime > 0.0f && proj->timeAlive >= proj->lifetime) {
             world->markForRemoval(proj->entity);
             toRemove.push_back(proj);
@@ -96,6 +116,7 @@ bool WeaponsSystem::fireWeapon(World *world, Entity *entity, glm::vec3 direction
     float lifetime = 5.0f;
     Entity *projectileEntity = _createProjectile(world, entity, direction, speed, viewMatrix, projectionMatrix);
     Projectile *projectile = new Projectile(projectileEntity, entity, direction, speed, weapon->range, lifetime);
+    projectile->previousPosition = projectileEntity->localTransform.position;
     projectiles.insert(projectile);
     weapon->currentAmmo--;
     glm::vec3 globalPosition = entity->getLocalToWorldMatrix()[3];
@@ -200,6 +221,14 @@ Entity *WeaponsSystem::_createProjectile(World *world, Entity *owner, glm::vec3
         // If no hit, use the crosshair direction
         bulletDirection = glm::normalize((cameraPosition + crosshairDir * weapon->range) - muzzlePosition);
     }
+    // The animated meshes are aimed at through their limbs, which their collision shapes don't follow. The bone is only
+    // hit if the bullet still crosses it when it gets there (see update).
+    Entity *animatedEntity = nullptr;
+    glm::vec3 animatedPoint;
+    int animatedBone;
+    if (raycastAnimated(world, rayStart, rayEnd, animatedEntity, animatedPoint, animatedBone, owner->parent) &&
+        (!hitComponent || glm::distance(rayStart, animatedPoint) < glm::distance(rayStart, hitPoint)))
+        bulletDirection = glm::normalize(animatedPoint - muzzlePosition);
 
     movement->linearVelocity = bulletDirection * speed;
 
@@ -233,6 +262,9 @@ Entity *WeaponsSystem::_createProjectile(World *world, Entity *owner, glm::vec3
             return;
         if (other->getComponent<FPSControllerComponent>() != nullptr && name == "Projectile")
             return;
+        // The bullets of the player go through these until they cross one of their bones
+        if (name == "Projectile" && EnemySystem::getInstance().isHitThroughBones(other))
+            return;
         world->markForRemoval(projectileEntity);
     };
     // Add trail effect for the bullet
@@ -240,6 +272,63 @@ Entity *WeaponsSystem::_createProjectile(World *world, Entity *owner, glm::vec3
     return projectileEntity;
 }
 
+bool WeaponsSystem::raycastAnimated(World *world, const glm::vec3 &start, const glm::vec3 &end, Entity *&hitEntity,
+                                    glm::vec3 &hitPoint, int &bone, Entity *ignore) {
+    float nearest = 2.0f;
+    for (Entity *entity : world->getEntities()) {
+        AnimationComponent *animation = entity->getComponent<AnimationComponent>();
+        if (!animation || !animation->modelAsset)
+            continue;
+        const std::vector<BoneCapsule> &capsules = animation->modelAsset->getBoneCapsules();
+        if (capsules.empty())
+            continue;
+        bool ignored = false;
+        for (Entity *parent = entity; parent && !ignored; parent = parent->parent)
+            ignored = parent == ignore;
+        if (ignored)
+            continue;
+
+        glm::mat4 localToWorld = entity->getLocalToWorldMatrix();
+        // Most of the entities are rejected by the box of the clips they play
+        glm::vec3 minimum, maximum;
+        float fraction;
+        if (animation->getAnimatedBounds(minimum, maximum) &&
+            (!animation_bounds::intersectBox(start, end, animation_bounds::transform({minimum, maximum}, localToWorld),
+                                             fraction) ||
+             fraction >= nearest))
+            continue;
+
+        // The animation LOD leaves the poses it skipped or throttled behind the clips
+        if (!animation->poseEvaluated)
+            animation->evaluatePose();
+        const std::vector<glm::mat4> &boneTransforms = animation->pose.boneTransforms;
+        if (capsules.size() != boneTransforms.size())
+            continue;
+
+        const std::vector<MeshRendererComponent *> &submeshes = animation->modelAsset->getSubmeshes();
+        for (size_t i = 0; i < capsules.size(); ++i) {
+            const BoneCapsule &capsule = capsules[i];
+            if (capsule.submesh < 0 || static_cast<size_t>(capsule.submesh) >= submeshes.size())
+                continue;
+            glm::mat4 transform = localToWorld * submeshes[capsule.submesh]->localToParent * boneTransforms[i];
+            glm::mat3 linear(transform);
+            float scale = std::max({glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+            if (animation_bounds::intersectCapsule(start, end, glm::vec3(transform * glm::vec4(capsule.start, 1.0f)),
+                                                   glm::vec3(transform * glm::vec4(capsule.end, 1.0f)),
+                                                   capsule.radius * scale, fraction) &&
+                fraction < nearest) {
+                nearest = fraction;
+                hitEntity = entity;
+                bone = static_cast<int>(i);
+            }
+        }
+    }
+    if (nearest > 1.0f)
+        return false;
+    hitPoint = start + (end - start) * nearest;
+    return true;
+}
+
 void WeaponsSystem::onDestroy() {
     for (auto *proj : projectiles) {
         delete proj;
@@ -26,6 +26,8 @@ class WeaponsSystem {
         float range;
         float lifetime;
         float timeAlive = 0.0f;
+        // Where the bullet was at the last update, the segment it travels since is hit against the bones
+        glm::vec3 previousPosition = glm::vec3(0.0f);
 
         Projectile(Entity* entity, Entity* owner, glm::vec3 direction, float speed, float range, float lifetime)
             : entity(entity), owner(owner), direction(direction), speed(speed), range(range), lifetime(lifetime) {}
@@ -65,6 +67,13 @@ public:
 
     bool pickupWeapon(Entity* entity, Entity* weaponEntity);
 
+    // Hits the segment [start, end] against the bone capsules of the animated entities in their current pose (see
+    // animation_bounds), which follow the limbs unlike their collision shapes. Returns the nearest hit, its point and
+    // the index of the bone. The entities under "ignore" (e.g. the shooter) are skipped. The poses the animation LOD
+    // skipped or throttled are evaluated first (only for the entities whose box the segment crosses).
+    bool raycastAnimated(World* world, const glm::vec3& start, const glm::vec3& end, Entity*& hitEntity,
+                         glm::vec3& hitPoint, int& bone, Entity* ignore = nullptr);
+
     void onDestroy();
 };
 
@@ -0,0 +1,191 @@
+#include "async-texture-loader.hpp"
+#include "texture-utils.hpp"
+
+#include <stb/stb_image.h>
+#include <glad/gl.h>
+#include <algorithm>
+#include <iostream>
+
+namespace our {
+
+    AsyncTextureLoader::~AsyncTextureLoader() {
+        // Never leave tasks writing into jobs that are being destroyed
+        tasks.wait();
+        for (auto& job : jobs) {
+            stbi_image_free(job->pixels);
+            stbi_image_free(job->hdrPixels);
+        }
+    }
+
+    Texture2D* AsyncTextureLoader::schedule(std::unique_ptr<Job> job) {
+        // The placeholder makes the texture complete so it can be sampled before the real data arrives
+        // (a reloaded texture already has its old content)
+        if (!job->texture) {
+            static const unsigned char white[4] = {255, 255, 255, 255};
+            job->texture = new Texture2D();
+            job->texture->bind();
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+            Texture2D::unbind();
+        }
+
+        Job* decodedJob = job.get();
+        jobs.push_back(std::move(job));
+        tasks.run([decodedJob]() {
+            decode(*decodedJob);
+            decodedJob->done.store(true, std::memory_order_release);
+        });
+        return decodedJob->texture;
+    }
+
+    // The missing files are reported right away so the callers can fall back on their own defaults
+    static bool checkExists(const std::string& filename) {
+        if (FileSystem::getInstance().exists(filename))
+            return true;
+        std::cerr << "Failed to load image: " << filename << " (file not found)" << std::endl;
+        return false;
+    }
+
+    Texture2D* AsyncTextureLoader::loadImage(const std::string& filename, bool generate_mipmap) {
+        if (!checkExists(filename))
+            return nullptr;
+        auto job = std::make_unique<Job>();
+        job->kind = Kind::IMAGE;
+        job->path = filename;
+        job->generateMipmap = generate_mipmap;
+        return schedule(std::move(job));
+    }
+
+    Texture2D* AsyncTextureLoader::loadCooked(const std::string& cookedPath, const std::string& filename,
+                                              bool generate_mipmap) {
+        auto job = std::make_unique<Job>();
+        job->kind = Kind::IMAGE;
+        job->path = filename;
+        job->cookedPath = cookedPath;
+        job->generateMipmap = generate_mipmap;
+        return schedule(std::move(job));
+    }
+
+    Texture2D* AsyncTextureLoader::loadHDR(const std::string& filename, bool generate_mipmap) {
+        if (!checkExists(filename))
+            return nullptr;
+        auto job = std::make_unique<Job>();
+        job->kind = Kind::HDR;
+        job->path = filename;
+        job->generateMipmap = generate_mipmap;
+        return schedule(std::move(job));
+    }
+
+    void AsyncTextureLoader::reloadImage(Texture2D* texture, const std::string& filename, bool generate_mipmap) {
+        auto job = std::make_unique<Job>();
+        job->texture = texture;
+        job->kind = Kind::IMAGE;
+        job->path = filename;
+        job->generateMipmap = generate_mipmap;
+        schedule(std::move(job));
+    }
+
+    void AsyncTextureLoader::reloadHDR(Texture2D* texture, const std::string& filename, bool generate_mipmap) {
+        auto job = std::make_unique<Job>();
+        job->texture = texture;
+        job->kind = Kind::HDR;
+        job->path = filename;
+        job->generateMipmap = generate_mipmap;
+        schedule(std::move(job));
+    }
+
+    Texture2D* AsyncTextureLoader::loadFromMemory(const unsigned char* data, int size, bool generate_mipmap) {
+        if (!data || size <= 0) {
+            std::cerr << "Invalid data or size for embedded texture" << std::endl;
+            return nullptr;
+        }
+        return loadFromMemory(FileView::copy(data, size), "<embedded>", generate_mipmap);
+    }
+
+    Texture2D* AsyncTextureLoader::loadFromMemory(FileView encoded, const std::string& name, bool generate_mipmap) {
+        auto job = std::make_unique<Job>();
+        job->kind = Kind::MEMORY;
+        job->path = name;
+        job->encoded = std::move(encoded);
+        job->generateMipmap = generate_mipmap;
+        return schedule(std::move(job));
+    }
+
+    // Decodes the image straight from its mapped file
+    static unsigned char* decodeFile(const std::string& path, glm::ivec2& size) {
+        FileView file = FileSystem::getInstance().open(path);
+        int channels;
+        return file ? stbi_load_from_memory(file.asBytes(), int(file.size()), &size.x, &size.y, &channels, 4) : nullptr;
+    }
+
+    void AsyncTextureLoader::decode(Job& job) {
+        // The flip flag is thread local so the workers don't race with each other (or with texture_utils)
+        stbi_set_flip_vertically_on_load_thread(true);
+        int channels;
+        switch (job.kind) {
+        case Kind::IMAGE:
+            if (job.cookedPath.empty())
+                job.cookedPath = texture_utils::findCookedTexture(job.path);
+            if (const std::string& cookedPath = job.cookedPath; !cookedPath.empty()) {
+                job.isCooked = texture_cooker::readCookedTexture(cookedPath, job.cooked);
+                if (job.isCooked)
+                    break;
+            }
+            job.pixels = decodeFile(job.path, job.size);
+            break;
+        case Kind::HDR:
+            if (FileView file = FileSystem::getInstance().open(job.path))
+                job.hdrPixels = stbi_loadf_from_memory(file.asBytes(), int(file.size()), &job.size.x, &job.size.y,
+                                                       &channels, 3);
+            break;
+        case Kind::MEMORY:
+            job.pixels = stbi_load_from_memory(job.encoded.asBytes(), int(job.encoded.size()), &job.size.x,
+                                               &job.size.y, &channels, 4);
+            // The encoded bytes are not needed anymore (this may unmap the file)
+            job.encoded = FileView();
+            break;
+        }
+    }
+
+    void AsyncTextureLoader::upload(Job& job) {
+        if (job.isCooked) {
+            if (texture_utils::uploadCooked(job.texture, job.cooked, job.path))
+                return;
+            // The GPU does not support the cooked format, decode the source image instead
+            stbi_set_flip_vertically_on_load_thread(true);
+            job.pixels = decodeFile(job.path, job.size);
+        }
+
+        if (job.pixels) {
+            texture_utils::uploadImage(job.texture, job.pixels, job.size, job.generateMipmap);
+            stbi_image_free(job.pixels);
+            job.pixels = nullptr;
+        } else if (job.hdrPixels) {
+            texture_utils::uploadHDR(job.texture, job.hdrPixels, job.size, job.generateMipmap);
+            stbi_image_free(job.hdrPixels);
+            job.hdrPixels = nullptr;
+        } else {
+            // The file exists but can't be decoded, the texture keeps its placeholder
+            std::cerr << "Failed to load image: " << job.path << std::endl;
+        }
+    }
+
+    size_t AsyncTextureLoader::uploadFinished() {
+        size_t count = 0;
+        // Upload in submission order so that the results do not depend on the worker scheduling
+        auto firstPending = std::stable_partition(jobs.begin(), jobs.end(), [](const std::unique_ptr<Job>& job) {
+            return job->done.load(std::memory_order_acquire);
+        });
+        for (auto it = jobs.begin(); it != firstPending; ++it, ++count)
+            upload(**it);
+        jobs.erase(jobs.begin(), firstPending);
+        Texture2D::unbind();
+        uploadedCount += count;
+        return count;
+    }
+
+    void AsyncTextureLoader::flush() {
+        tasks.wait();
+        uploadFinished();
+    }
+
+}
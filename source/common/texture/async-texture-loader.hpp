@@ -0,0 +1,92 @@
+#pragma once
+
+#include "texture2d.hpp"
+#include "texture-cooker.hpp"
+#include "file-system.hpp"
+#include <tbb/task_group.h>
+#include <glm/vec2.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // Decodes images on worker threads so that loading dozens of textures does not serialize on the OpenGL thread.
+    // Each load function immediately returns a usable texture (holding a 1x1 white placeholder) and schedules the
+    // decoding (stb_image, HDR or cooked ".ctex" read) as a TBB task. Only the final upload happens on the OpenGL
+    // thread when "uploadFinished" or "flush" is called.
+    // All the functions must be called from the OpenGL thread, and a texture must not be deleted while its decode
+    // is still pending (call "flush" first).
+    class AsyncTextureLoader {
+        enum class Kind { IMAGE, HDR, MEMORY };
+
+        struct Job {
+            Texture2D* texture = nullptr;
+            Kind kind;
+            std::string path;
+            std::string cookedPath; // The up to date cooked version of "path" if the caller already looked it up
+            FileView encoded; // The encoded file bytes for Kind::MEMORY
+            bool generateMipmap;
+
+            // Filled by the worker thread
+            glm::ivec2 size = {0, 0};
+            unsigned char* pixels = nullptr;
+            float* hdrPixels = nullptr;
+            bool isCooked = false;
+            texture_cooker::CookedTexture cooked;
+            std::atomic<bool> done = false;
+        };
+
+        tbb::task_group tasks;
+        std::vector<std::unique_ptr<Job>> jobs;
+        size_t uploadedCount = 0;
+
+        AsyncTextureLoader() = default;
+        AsyncTextureLoader(const AsyncTextureLoader&) = delete;
+        AsyncTextureLoader& operator=(const AsyncTextureLoader&) = delete;
+
+        Texture2D* schedule(std::unique_ptr<Job> job);
+        // Runs on a worker thread
+        static void decode(Job& job);
+        // Runs on the OpenGL thread
+        static void upload(Job& job);
+
+    public:
+        static AsyncTextureLoader& getInstance() {
+            static AsyncTextureLoader instance;
+            return instance;
+        }
+
+        ~AsyncTextureLoader();
+
+        // Asynchronous versions of texture_utils::loadImage, loadHDR and loadFromMemory
+        // Like them, they return nullptr if the file doesn't exist (only a file that fails to decode keeps the
+        // placeholder, the error is then printed when it is uploaded)
+        // loadImage uses the cooked version of the image if there is an up to date one
+        // loadFromMemory copies the encoded bytes so the caller can free them right away
+        Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true);
+        Texture2D* loadHDR(const std::string& filename, bool generate_mipmap = true);
+        // Same as loadImage but reads the given up to date cooked version of the image without looking it up again
+        // (the image itself is only decoded if the cooked file can't be read)
+        Texture2D* loadCooked(const std::string& cookedPath, const std::string& filename, bool generate_mipmap = true);
+        Texture2D* loadFromMemory(const unsigned char* data, int size, bool generate_mipmap = true);
+        // Same as above but decodes a view of a file without copying it ("name" is only used in error messages)
+        Texture2D* loadFromMemory(FileView encoded, const std::string& name, bool generate_mipmap = true);
+
+        // Decodes the file again and uploads it to an existing texture (see HotReload). The texture keeps its current
+        // content until the upload, and keeps it for good if the file can't be decoded.
+        void reloadImage(Texture2D* texture, const std::string& filename, bool generate_mipmap = true);
+        void reloadHDR(Texture2D* texture, const std::string& filename, bool generate_mipmap = true);
+
+        // Uploads the textures whose decoding is finished without waiting for the others
+        // Returns the number of uploaded textures
+        size_t uploadFinished();
+        // Waits for all the pending decodes and uploads them
+        void flush();
+
+        size_t getPendingCount() const { return jobs.size(); }
+        size_t getUploadedCount() const { return uploadedCount; }
+    };
+
+}
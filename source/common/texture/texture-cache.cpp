@@ -0,0 +1,159 @@
+#include "texture-cache.hpp"
+#include "async-texture-loader.hpp"
+#include "texture-utils.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+namespace our {
+
+    // Returns a path that is the same for all the ways of referring to the same file
+    static std::string getCanonicalPath(const std::string& filename) {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(filename, error);
+        return error ? filename : canonical.generic_string();
+    }
+
+    static std::string getContentKey(const unsigned char* data, size_t size) {
+        std::ostringstream key;
+        key << std::hex << TextureCache::hashBytes(data, size) << ':' << std::dec << size;
+        return key.str();
+    }
+
+    uint64_t TextureCache::hashBytes(const unsigned char* data, size_t size) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::find(const std::string& key) {
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return nullptr;
+        std::shared_ptr<Texture2D> texture = it->second.texture.lock();
+        if (texture)
+            it->second.requests++;
+        return texture;
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::insert(const std::string& key, Texture2D* texture) {
+        if (!texture)
+            return nullptr;
+        std::shared_ptr<Texture2D> handle(texture);
+        entries[key] = Entry{handle, 1};
+        return handle;
+    }
+
+    static std::string getPathKey(const std::string& filename, bool generate_mipmap) {
+        return getCanonicalPath(filename) + (generate_mipmap ? "" : "|nomips");
+    }
+
+    TextureCache::PreparedImage TextureCache::prepareImage(const std::string& filename, bool generate_mipmap) {
+        PreparedImage image;
+        image.name = filename;
+        image.pathKey = getPathKey(filename, generate_mipmap);
+        image.generateMipmap = generate_mipmap;
+        // Cooked textures are read directly by the decoder, so they are only identified by their path
+        image.cookedPath = texture_utils::findCookedTexture(filename);
+        if (!image.cookedPath.empty()) {
+            image.key = "cooked:" + image.pathKey;
+            return image;
+        }
+        // Map the file once: its bytes give the content key and are then decoded in place
+        image.bytes = FileSystem::getInstance().open(filename);
+        if (image.bytes)
+            image.key = getContentKey(image.bytes.asBytes(), image.bytes.size()) + (generate_mipmap ? "" : "|nomips");
+        return image;
+    }
+
+    TextureCache::PreparedImage TextureCache::prepareFromMemory(const unsigned char* data, int size,
+                                                                bool generate_mipmap) {
+        PreparedImage image;
+        image.name = "<embedded>";
+        image.generateMipmap = generate_mipmap;
+        if (data && size > 0) {
+            image.bytes = FileView::copy(data, size_t(size));
+            image.key = getContentKey(data, size_t(size)) + (generate_mipmap ? "" : "|nomips");
+        }
+        return image;
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::load(PreparedImage image) {
+        if (image.key.empty()) {
+            std::cerr << "Failed to load image: " << image.name << std::endl;
+            return nullptr;
+        }
+        if (!image.pathKey.empty())
+            pathKeys[image.pathKey] = image.key;
+        if (std::shared_ptr<Texture2D> texture = find(image.key))
+            return texture;
+        AsyncTextureLoader& loader = AsyncTextureLoader::getInstance();
+        // The cooked file was already looked up, the decoder reads it directly
+        if (!image.cookedPath.empty())
+            return insert(image.key, loader.loadCooked(image.cookedPath, image.name, image.generateMipmap));
+        return insert(image.key, loader.loadFromMemory(std::move(image.bytes), image.name, image.generateMipmap));
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::loadImage(const std::string& filename, bool generate_mipmap) {
+        if (auto it = pathKeys.find(getPathKey(filename, generate_mipmap)); it != pathKeys.end())
+            if (std::shared_ptr<Texture2D> texture = find(it->second))
+                return texture;
+        return load(prepareImage(filename, generate_mipmap));
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::loadHDR(const std::string& filename, bool generate_mipmap) {
+        std::string key = "hdr:" + getCanonicalPath(filename) + (generate_mipmap ? "" : "|nomips");
+        if (std::shared_ptr<Texture2D> texture = find(key))
+            return texture;
+        return insert(key, AsyncTextureLoader::getInstance().loadHDR(filename, generate_mipmap));
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::loadFromMemory(const unsigned char* data, int size, bool generate_mipmap) {
+        if (!data || size <= 0) {
+            std::cerr << "Invalid data or size for embedded texture" << std::endl;
+            return nullptr;
+        }
+        // Only copied when it is not in the cache yet
+        std::string key = getContentKey(data, size_t(size)) + (generate_mipmap ? "" : "|nomips");
+        if (std::shared_ptr<Texture2D> texture = find(key))
+            return texture;
+        return insert(key, AsyncTextureLoader::getInstance().loadFromMemory(data, size, generate_mipmap));
+    }
+
+    TextureCache::Statistics TextureCache::getStatistics() const {
+        Statistics statistics;
+        for (const auto& [key, entry] : entries) {
+            std::shared_ptr<Texture2D> texture = entry.texture.lock();
+            if (!texture)
+                continue;
+            size_t bytes = texture->getResidentBytes();
+            statistics.uniqueTextures++;
+            statistics.requests += entry.requests;
+            statistics.residentBytes += bytes;
+            statistics.savedBytes += bytes * (entry.requests - 1);
+        }
+        return statistics;
+    }
+
+    void TextureCache::collectGarbage() {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.texture.expired())
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+        for (auto it = pathKeys.begin(); it != pathKeys.end();) {
+            if (entries.find(it->second) == entries.end())
+                it = pathKeys.erase(it);
+            else
+                ++it;
+        }
+    }
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "texture2d.hpp"
+#include "file-system.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace our {
+
+    // A single cache for all the textures loaded from files or memory (level assets, model textures, ...).
+    // Textures are identified by their content: a file is first looked up by its canonical path, then by the
+    // FNV-1a hash of its bytes, so the same image referenced through different paths (or embedded in several
+    // models) is decoded and uploaded only once.
+    // The cache hands out shared handles and only keeps weak references, so a texture is deleted as soon as
+    // its last user releases it. Decoding goes through the AsyncTextureLoader (see its constraints).
+    // Hashing a file reads all of it, so the asset loaders do it on their worker threads with "prepareImage" and
+    // "prepareFromMemory", only the lookup ("load") runs on the OpenGL thread.
+    class TextureCache {
+        struct Entry {
+            std::weak_ptr<Texture2D> texture;
+            // How many times this texture was requested (every request after the first one is a saved upload)
+            size_t requests = 0;
+        };
+
+        // Content key (hash of the bytes or of the cooked file path) -> entry
+        std::unordered_map<std::string, Entry> entries;
+        // Canonical path (+ load options) -> content key, to avoid hashing the same file twice
+        std::unordered_map<std::string, std::string> pathKeys;
+
+        TextureCache() = default;
+        TextureCache(const TextureCache&) = delete;
+        TextureCache& operator=(const TextureCache&) = delete;
+
+        // Returns the texture of the given key if it is still alive (and counts the request)
+        std::shared_ptr<Texture2D> find(const std::string& key);
+        std::shared_ptr<Texture2D> insert(const std::string& key, Texture2D* texture);
+
+    public:
+        static TextureCache& getInstance() {
+            static TextureCache instance;
+            return instance;
+        }
+
+        // An image whose content key is computed, ready to be looked up or decoded by "load"
+        struct PreparedImage {
+            std::string name;       // The file (or "<embedded>") for the messages and the cooked texture decode
+            std::string pathKey;    // The canonical path and load options (empty for the images in memory)
+            std::string key;        // The content key (empty if the file could not be read)
+            std::string cookedPath; // The up to date cooked version of the file (empty if there is none)
+            FileView bytes;         // The encoded bytes (empty for cooked textures, they are read by the decoder)
+            bool generateMipmap = true;
+        };
+        // They read and hash the image without touching OpenGL nor the cache so they can run on any thread
+        // (prepareFromMemory copies the bytes)
+        static PreparedImage prepareImage(const std::string& filename, bool generate_mipmap = true);
+        static PreparedImage prepareFromMemory(const unsigned char* data, int size, bool generate_mipmap = true);
+        // Returns the texture with the content of the prepared image, decoding it if there is none yet
+        // It returns nullptr if the image could not be read
+        std::shared_ptr<Texture2D> load(PreparedImage image);
+
+        // Shared versions of texture_utils::loadImage, loadHDR and loadFromMemory
+        // They return nullptr if the file could not be read
+        // They hash the image on the calling thread if its path was never loaded (prefer "prepareImage" + "load")
+        std::shared_ptr<Texture2D> loadImage(const std::string& filename, bool generate_mipmap = true);
+        std::shared_ptr<Texture2D> loadHDR(const std::string& filename, bool generate_mipmap = true);
+        std::shared_ptr<Texture2D> loadFromMemory(const unsigned char* data, int size, bool generate_mipmap = true);
+
+        struct Statistics {
+            size_t uniqueTextures = 0; // Textures currently alive
+            size_t requests = 0;       // Total requests for these textures
+            size_t residentBytes = 0;  // Estimated VRAM used by these textures
+            size_t savedBytes = 0;     // Estimated VRAM that deduplication avoided
+        };
+        // The sizes are the ones recorded when the textures were uploaded (see Texture2D::getResidentBytes)
+        Statistics getStatistics() const;
+
+        // Forgets the textures that were released by all their users
+        void collectGarbage();
+
+        // 64-bit FNV-1a hash
+        static uint64_t hashBytes(const unsigned char* data, size_t size);
+    };
+
+}
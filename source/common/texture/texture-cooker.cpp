@@ -0,0 +1,498 @@
+#include "texture-cooker.hpp"
+
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace our::texture_cooker {
+
+    namespace {
+        constexpr char MAGIC[4] = {'C', 'T', 'E', 'X'};
+        constexpr uint32_t VERSION = COOKED_TEXTURE_VERSION;
+
+        // Writes bits to a zero-initialized block, least significant bit first (as BC7 expects)
+        struct BitWriter {
+            uint8_t* output;
+            int position = 0;
+
+            void write(uint32_t value, int count) {
+                for (int i = 0; i < count; i++, position++)
+                    if ((value >> i) & 1u)
+                        output[position >> 3] |= uint8_t(1u << (position & 7));
+            }
+        };
+
+        // Finds the axis along which the given points vary the most (power iteration on the covariance matrix)
+        // "channels" is the number of components used from each point (3 for RGB, 4 for RGBA)
+        void findPrincipalAxis(const float points[][4], int count, int channels, float mean[4], float axis[4]) {
+            for (int c = 0; c < 4; c++)
+                mean[c] = axis[c] = 0.0f;
+            if (count == 0)
+                return;
+            for (int i = 0; i < count; i++)
+                for (int c = 0; c < channels; c++)
+                    mean[c] += points[i][c];
+            for (int c = 0; c < channels; c++)
+                mean[c] /= float(count);
+
+            float covariance[4][4] = {};
+            for (int i = 0; i < count; i++)
+                for (int a = 0; a < channels; a++)
+                    for (int b = 0; b < channels; b++)
+                        covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+
+            // Start from the bounding box diagonal which is usually close to the principal axis
+            float minimum[4] = {255.0f, 255.0f, 255.0f, 255.0f}, maximum[4] = {};
+            for (int i = 0; i < count; i++)
+                for (int c = 0; c < channels; c++) {
+                    minimum[c] = std::min(minimum[c], points[i][c]);
+                    maximum[c] = std::max(maximum[c], points[i][c]);
+                }
+            for (int c = 0; c < channels; c++)
+                axis[c] = maximum[c] - minimum[c];
+
+            for (int iteration = 0; iteration < 8; iteration++) {
+                float next[4] = {};
+                for (int a = 0; a < channels; a++)
+                    for (int b = 0; b < channels; b++)
+                        next[a] += covariance[a][b] * axis[b];
+                float length = 0.0f;
+                for (int c = 0; c < channels; c++)
+                    length += next[c] * next[c];
+                if (length < 1e-12f)
+                    break;
+                length = std::sqrt(length);
+                for (int c = 0; c < channels; c++)
+                    axis[c] = next[c] / length;
+            }
+        }
+
+        // Returns the two points (the endpoints) at the extremes of the projection of the points on their principal axis
+        void findEndpoints(const float points[][4], int count, int channels, float low[4], float high[4]) {
+            float mean[4], axis[4];
+            findPrincipalAxis(points, count, channels, mean, axis);
+            float minimumT = 0.0f, maximumT = 0.0f;
+            for (int i = 0; i < count; i++) {
+                float t = 0.0f;
+                for (int c = 0; c < channels; c++)
+                    t += (points[i][c] - mean[c]) * axis[c];
+                minimumT = std::min(minimumT, t);
+                maximumT = std::max(maximumT, t);
+            }
+            for (int c = 0; c < 4; c++) {
+                low[c] = std::clamp(mean[c] + axis[c] * minimumT, 0.0f, 255.0f);
+                high[c] = std::clamp(mean[c] + axis[c] * maximumT, 0.0f, 255.0f);
+            }
+        }
+
+        uint16_t packRGB565(const float color[4]) {
+            auto quantize = [](float value, int maximum) {
+                return uint16_t(std::clamp(int(std::lround(value * maximum / 255.0f)), 0, maximum));
+            };
+            return uint16_t((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+        }
+
+        void unpackRGB565(uint16_t packed, int color[3]) {
+            int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+            color[0] = (r << 3) | (r >> 2);
+            color[1] = (g << 2) | (g >> 4);
+            color[2] = (b << 3) | (b >> 2);
+        }
+
+        // Compresses the color part of a BC1/BC3 block.
+        // If "punchThrough" is true, the pixels with an alpha below 128 use the transparent index of BC1.
+        void compressColorBlock(const uint8_t block[64], uint8_t output[8], bool punchThrough) {
+            float points[16][4];
+            int count = 0;
+            bool transparent[16] = {};
+            bool hasTransparent = false;
+            for (int i = 0; i < 16; i++) {
+                if (punchThrough && block[i * 4 + 3] < 128) {
+                    transparent[i] = hasTransparent = true;
+                    continue;
+                }
+                for (int c = 0; c < 4; c++)
+                    points[count][c] = block[i * 4 + c];
+                count++;
+            }
+
+            float low[4], high[4];
+            findEndpoints(points, count, 3, low, high);
+            uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+            // color0 > color1 selects the 4 colors mode, color0 <= color1 selects the 3 colors + transparent mode
+            if ((!hasTransparent && color0 < color1) || (hasTransparent && color0 > color1))
+                std::swap(color0, color1);
+
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            int paletteSize;
+            if (color0 > color1) {
+                for (int c = 0; c < 3; c++) {
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                }
+                paletteSize = 4;
+            } else {
+                for (int c = 0; c < 3; c++)
+                    palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                paletteSize = 3;
+            }
+
+            uint32_t indices = 0;
+            for (int i = 0; i < 16; i++) {
+                int best = 3;
+                if (!transparent[i]) {
+                    int bestError = 1 << 30;
+                    for (int p = 0; p < paletteSize; p++) {
+                        int error = 0;
+                        for (int c = 0; c < 3; c++) {
+                            int difference = int(block[i * 4 + c]) - palette[p][c];
+                            error += difference * difference;
+                        }
+                        if (error < bestError) {
+                            bestError = error;
+                            best = p;
+                        }
+                    }
+                }
+                indices |= uint32_t(best) << (2 * i);
+            }
+
+            output[0] = uint8_t(color0 & 0xFF);
+            output[1] = uint8_t(color0 >> 8);
+            output[2] = uint8_t(color1 & 0xFF);
+            output[3] = uint8_t(color1 >> 8);
+            for (int i = 0; i < 4; i++)
+                output[4 + i] = uint8_t(indices >> (8 * i));
+        }
+
+        // Compresses a single channel of the block as a BC4 block (used for BC3 alpha and BC5 red/green)
+        void compressChannelBlock(const uint8_t block[64], int channel, uint8_t output[8]) {
+            int minimum = 255, maximum = 0;
+            for (int i = 0; i < 16; i++) {
+                minimum = std::min(minimum, int(block[i * 4 + channel]));
+                maximum = std::max(maximum, int(block[i * 4 + channel]));
+            }
+            std::memset(output, 0, 8);
+            output[0] = uint8_t(maximum);
+            output[1] = uint8_t(minimum);
+            if (maximum == minimum)
+                return; // All the indices are 0 which selects the first endpoint
+
+            // Since maximum > minimum, the 8 values mode is used
+            int palette[8] = {maximum, minimum};
+            for (int i = 1; i <= 6; i++)
+                palette[i + 1] = ((7 - i) * maximum + i * minimum + 3) / 7;
+
+            uint64_t indices = 0;
+            for (int i = 0; i < 16; i++) {
+                int value = block[i * 4 + channel];
+                int best = 0, bestError = 256;
+                for (int p = 0; p < 8; p++) {
+                    int error = std::abs(value - palette[p]);
+                    if (error < bestError) {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= uint64_t(best) << (3 * i);
+            }
+            for (int i = 0; i < 6; i++)
+                output[2 + i] = uint8_t(indices >> (8 * i));
+        }
+
+        // Reads the 4x4 block starting at the given pixel, the pixels outside the image are clamped to the edges
+        void readBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t block[64]) {
+            for (uint32_t j = 0; j < 4; j++) {
+                uint32_t row = std::min(y + j, height - 1);
+                for (uint32_t i = 0; i < 4; i++) {
+                    uint32_t column = std::min(x + i, width - 1);
+                    std::memcpy(&block[(j * 4 + i) * 4], &rgba[(size_t(row) * width + column) * 4], 4);
+                }
+            }
+        }
+
+        // Halves the image size (down to 1) by averaging every 2x2 pixels
+        std::vector<uint8_t> downsample(const std::vector<uint8_t>& source, uint32_t width, uint32_t height,
+                                        uint32_t& nextWidth, uint32_t& nextHeight) {
+            nextWidth = std::max(1u, width / 2);
+            nextHeight = std::max(1u, height / 2);
+            std::vector<uint8_t> result(size_t(nextWidth) * nextHeight * 4);
+            for (uint32_t y = 0; y < nextHeight; y++) {
+                uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                for (uint32_t x = 0; x < nextWidth; x++) {
+                    uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                    for (int c = 0; c < 4; c++) {
+                        uint32_t sum = source[(size_t(y0) * width + x0) * 4 + c] + source[(size_t(y0) * width + x1) * 4 + c] +
+                                       source[(size_t(y1) * width + x0) * 4 + c] + source[(size_t(y1) * width + x1) * 4 + c];
+                        result[(size_t(y) * nextWidth + x) * 4 + c] = uint8_t((sum + 2) / 4);
+                    }
+                }
+            }
+            return result;
+        }
+
+        size_t getBlockSize(CookedFormat format) { return format == CookedFormat::BC1 ? 8 : 16; }
+    }
+
+    bool parseFormat(const std::string& name, CookedFormat& format) {
+        if (name == "rgba8") format = CookedFormat::RGBA8;
+        else if (name == "bc1") format = CookedFormat::BC1;
+        else if (name == "bc3") format = CookedFormat::BC3;
+        else if (name == "bc5") format = CookedFormat::BC5;
+        else if (name == "bc7") format = CookedFormat::BC7;
+        else return false;
+        return true;
+    }
+
+    const char* getFormatName(CookedFormat format) {
+        switch (format) {
+        case CookedFormat::RGBA8: return "rgba8";
+        case CookedFormat::BC1: return "bc1";
+        case CookedFormat::BC3: return "bc3";
+        case CookedFormat::BC5: return "bc5";
+        case CookedFormat::BC7: return "bc7";
+        }
+        return "unknown";
+    }
+
+    bool isCompressed(CookedFormat format) { return format != CookedFormat::RGBA8; }
+
+    size_t getLevelSize(CookedFormat format, uint32_t width, uint32_t height) {
+        if (!isCompressed(format))
+            return size_t(width) * height * 4;
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+    }
+
+    CookedFormat pickFormat(const uint8_t* rgba, uint32_t width, uint32_t height) {
+        for (size_t i = 0, count = size_t(width) * height; i < count; i++)
+            if (rgba[i * 4 + 3] != 255)
+                return CookedFormat::BC3;
+        return CookedFormat::BC1;
+    }
+
+    void compressBlockBC1(const uint8_t block[64], uint8_t output[8]) { compressColorBlock(block, output, true); }
+
+    void compressBlockBC3(const uint8_t block[64], uint8_t output[16]) {
+        compressChannelBlock(block, 3, output);
+        compressColorBlock(block, output + 8, false);
+    }
+
+    void compressBlockBC5(const uint8_t block[64], uint8_t output[16]) {
+        compressChannelBlock(block, 0, output);
+        compressChannelBlock(block, 1, output + 8);
+    }
+
+    // Only BC7 mode 6 is used: a single subset with RGBA 7.7.7.7 endpoints (+ one p-bit per endpoint)
+    // and 4 bits indices. It is simple to encode and already beats BC3 on smooth gradients and alpha.
+    void compressBlockBC7(const uint8_t block[64], uint8_t output[16]) {
+        static const int WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        float points[16][4];
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 4; c++)
+                points[i][c] = block[i * 4 + c];
+        float endpoints[2][4];
+        findEndpoints(points, 16, 4, endpoints[0], endpoints[1]);
+
+        // Quantize each endpoint to 7 bits per channel and pick the p-bit that gives the smallest error
+        int quantized[2][4], pBits[2];
+        for (int e = 0; e < 2; e++) {
+            float bestError = 1e30f;
+            for (int p = 0; p < 2; p++) {
+                int candidate[4];
+                float error = 0.0f;
+                for (int c = 0; c < 4; c++) {
+                    candidate[c] = std::clamp(int(std::lround((endpoints[e][c] - p) / 2.0f)), 0, 127);
+                    float difference = float((candidate[c] << 1) | p) - endpoints[e][c];
+                    error += difference * difference;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    pBits[e] = p;
+                    std::copy(candidate, candidate + 4, quantized[e]);
+                }
+            }
+        }
+
+        int palette[16][4];
+        for (int c = 0; c < 4; c++) {
+            int low = (quantized[0][c] << 1) | pBits[0], high = (quantized[1][c] << 1) | pBits[1];
+            for (int i = 0; i < 16; i++)
+                palette[i][c] = ((64 - WEIGHTS[i]) * low + WEIGHTS[i] * high + 32) >> 6;
+        }
+
+        int indices[16];
+        for (int i = 0; i < 16; i++) {
+            int bestError = 1 << 30;
+            for (int p = 0; p < 16; p++) {
+                int error = 0;
+                for (int c = 0; c < 4; c++) {
+                    int difference = int(block[i * 4 + c]) - palette[p][c];
+                    error += difference * difference;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    indices[i] = p;
+                }
+            }
+        }
+
+        // The most significant bit of the first index is implicitly 0, so swap the endpoints if needed
+        if (indices[0] & 8) {
+            for (int c = 0; c < 4; c++)
+                std::swap(quantized[0][c], quantized[1][c]);
+            std::swap(pBits[0], pBits[1]);
+            for (int i = 0; i < 16; i++)
+                indices[i] = 15 - indices[i];
+        }
+
+        std::memset(output, 0, 16);
+        BitWriter writer{output};
+        writer.write(1u << 6, 7); // Mode 6
+        for (int c = 0; c < 4; c++) {
+            writer.write(quantized[0][c], 7);
+            writer.write(quantized[1][c], 7);
+        }
+        writer.write(pBits[0], 1);
+        writer.write(pBits[1], 1);
+        writer.write(indices[0], 3);
+        for (int i = 1; i < 16; i++)
+            writer.write(indices[i], 4);
+    }
+
+    CookedTexture cook(const uint8_t* rgba, uint32_t width, uint32_t height, CookedFormat format, bool generateMips) {
+        CookedTexture texture;
+        texture.format = format;
+
+        std::vector<uint8_t> image(rgba, rgba + size_t(width) * height * 4);
+        while (true) {
+            CookedMipLevel level;
+            level.width = width;
+            level.height = height;
+            if (!isCompressed(format)) {
+                level.data = image;
+            } else {
+                level.data.resize(getLevelSize(format, width, height));
+                size_t blockSize = getBlockSize(format);
+                uint8_t* output = level.data.data();
+                uint8_t block[64];
+                for (uint32_t y = 0; y < height; y += 4) {
+                    for (uint32_t x = 0; x < width; x += 4, output += blockSize) {
+                        readBlock(image.data(), width, height, x, y, block);
+                        switch (format) {
+                        case CookedFormat::BC1: compressBlockBC1(block, output); break;
+                        case CookedFormat::BC3: compressBlockBC3(block, output); break;
+                        case CookedFormat::BC5: compressBlockBC5(block, output); break;
+                        case CookedFormat::BC7: compressBlockBC7(block, output); break;
+                        default: break;
+                        }
+                    }
+                }
+            }
+            texture.levels.push_back(std::move(level));
+
+            if (!generateMips || (width == 1 && height == 1))
+                break;
+            image = downsample(image, width, height, width, height);
+        }
+        return texture;
+    }
+
+    bool writeCookedTexture(const std::string& path, const CookedTexture& texture) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "ERROR: Couldn't open cooked texture file for writing: " << path << std::endl;
+            return false;
+        }
+        uint32_t header[3] = {VERSION, uint32_t(texture.format), uint32_t(texture.levels.size())};
+        file.write(MAGIC, sizeof(MAGIC));
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (const CookedMipLevel& level : texture.levels) {
+            uint32_t levelHeader[3] = {level.width, level.height, uint32_t(level.getSize())};
+            file.write(reinterpret_cast<const char*>(levelHeader), sizeof(levelHeader));
+            file.write(reinterpret_cast<const char*>(level.getData()), std::streamsize(level.getSize()));
+        }
+        if (!file) {
+            std::cerr << "ERROR: Failed to write cooked texture: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool readCookedTexture(const std::string& path, CookedTexture& texture) {
+        FileView file = FileSystem::getInstance().open(path);
+        if (!file) {
+            std::cerr << "ERROR: Couldn't open cooked texture file: " << path << std::endl;
+            return false;
+        }
+        size_t offset = 0;
+        auto read = [&](void* output, size_t size) {
+            if (file.size() - offset < size)
+                return false;
+            std::memcpy(output, file.data() + offset, size);
+            offset += size;
+            return true;
+        };
+        char magic[4];
+        uint32_t header[3];
+        if (!read(magic, sizeof(magic)) || !read(header, sizeof(header)) ||
+            std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || header[0] != VERSION ||
+            header[1] > uint32_t(CookedFormat::BC7)) {
+            std::cerr << "ERROR: Invalid or outdated cooked texture: " << path << std::endl;
+            return false;
+        }
+        texture.format = CookedFormat(header[1]);
+        texture.levels.resize(header[2]);
+        for (CookedMipLevel& level : texture.levels) {
+            uint32_t levelHeader[3];
+            if (!read(levelHeader, sizeof(levelHeader)) ||
+                levelHeader[2] != getLevelSize(texture.format, levelHeader[0], levelHeader[1])) {
+                std::cerr << "ERROR: Corrupted cooked texture: " << path << std::endl;
+                return false;
+            }
+            if (file.size() - offset < levelHeader[2]) {
+                std::cerr << "ERROR: Truncated cooked texture: " << path << std::endl;
+                return false;
+            }
+            level.width = levelHeader[0];
+            level.height = levelHeader[1];
+            // The level is uploaded straight from the mapped file
+            level.mapped = file.subview(offset, levelHeader[2]);
+            offset += levelHeader[2];
+        }
+        return true;
+    }
+
+    bool cookFile(const std::string& sourcePath, const nlohmann::json& settings, const std::string& outputPath) {
+        std::string formatName = settings.value("format", "auto");
+        CookedFormat format = CookedFormat::RGBA8;
+        if (formatName != "auto" && !parseFormat(formatName, format)) {
+            std::cerr << "ERROR: Unknown cooked texture format: " << formatName << std::endl;
+            return false;
+        }
+
+        // The runtime expects the rows bottom to top (like loadImage does)
+        // The flag is thread local since the textures can be cooked on worker threads
+        stbi_set_flip_vertically_on_load_thread(true);
+        FileView source = FileSystem::getInstance().open(sourcePath);
+        int width, height, channels;
+        unsigned char* pixels = source ? stbi_load_from_memory(source.asBytes(), int(source.size()), &width, &height,
+                                                               &channels, 4)
+                                       : nullptr;
+        if (pixels == nullptr) {
+            std::cerr << "ERROR: Failed to load image: " << sourcePath << std::endl;
+            return false;
+        }
+        if (formatName == "auto")
+            format = pickFormat(pixels, width, height);
+        CookedTexture texture = cook(pixels, width, height, format, settings.value("mips", true));
+        stbi_image_free(pixels);
+        return writeCookedTexture(outputPath, texture);
+    }
+
+}
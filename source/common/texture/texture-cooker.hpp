@@ -0,0 +1,77 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "file-system.hpp"
+
+// The texture cooker converts decoded images into a ready-to-upload texture: all the mip levels are generated
+// ahead of time and each level can be block compressed (BC1/BC3/BC5/BC7) on the CPU.
+// The result is stored in a small container file (".ctex") that the runtime uploads level by level
+// (see texture_utils::loadCooked) without decoding or generating anything. The cooked files are stored and kept up
+// to date by the asset database (see asset-database.hpp).
+// Nothing in here depends on OpenGL so it can be used by offline tools.
+namespace our::texture_cooker {
+
+    // The pixel format of the cooked mip levels
+    enum class CookedFormat : uint32_t {
+        RGBA8 = 0, // Uncompressed, 4 bytes per pixel
+        BC1 = 1,   // RGB (+ 1 bit alpha), 8 bytes per 4x4 block
+        BC3 = 2,   // RGBA, 16 bytes per 4x4 block
+        BC5 = 3,   // RG (e.g. tangent space normals), 16 bytes per 4x4 block
+        BC7 = 4,   // RGBA with a higher quality than BC3, 16 bytes per 4x4 block
+    };
+
+    struct CookedMipLevel {
+        uint32_t width = 0, height = 0;
+        std::vector<uint8_t> data; // Filled by "cook"
+        FileView mapped;           // Filled by "readCookedTexture", the bytes are used in place in the mapped file
+
+        const uint8_t* getData() const { return mapped ? mapped.asBytes() : data.data(); }
+        size_t getSize() const { return mapped ? mapped.size() : data.size(); }
+    };
+
+    struct CookedTexture {
+        CookedFormat format = CookedFormat::RGBA8;
+        // The first level is the full resolution image
+        std::vector<CookedMipLevel> levels;
+    };
+
+    // The extension of the cooked texture files
+    inline const char* COOKED_TEXTURE_EXTENSION = ".ctex";
+    // Increase the version whenever the layout of the file or the cooked data changes
+    constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+
+    // Parses a format name ("rgba8", "bc1", "bc3", "bc5" or "bc7"), returns false if the name is unknown
+    bool parseFormat(const std::string& name, CookedFormat& format);
+    const char* getFormatName(CookedFormat format);
+    // Returns true if the format is block compressed
+    bool isCompressed(CookedFormat format);
+    // Returns the size in bytes of a level with the given size in the given format
+    size_t getLevelSize(CookedFormat format, uint32_t width, uint32_t height);
+
+    // Picks BC3 if any pixel is not fully opaque and BC1 otherwise
+    CookedFormat pickFormat(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+    // Cooks an RGBA8 image (rows stored bottom to top like OpenGL expects them).
+    // If "generateMips" is true, the full mip chain down to 1x1 is generated using a box filter.
+    CookedTexture cook(const uint8_t* rgba, uint32_t width, uint32_t height, CookedFormat format, bool generateMips = true);
+
+    // Block compression of a single 4x4 block of RGBA8 pixels (16 pixels, row by row)
+    void compressBlockBC1(const uint8_t block[64], uint8_t output[8]);
+    void compressBlockBC3(const uint8_t block[64], uint8_t output[16]);
+    void compressBlockBC5(const uint8_t block[64], uint8_t output[16]);
+    void compressBlockBC7(const uint8_t block[64], uint8_t output[16]);
+
+    // Writes/reads the container file. On failure, an error is printed and false is returned.
+    // The file is written in place, so it must not be one that may be mapped (the asset database writes a temporary
+    // file and renames it over the output).
+    bool writeCookedTexture(const std::string& path, const CookedTexture& texture);
+    bool readCookedTexture(const std::string& path, CookedTexture& texture);
+
+    // Decodes the source image, cooks it and writes it to the output path (the cook function of the asset database)
+    // The settings are the "format" ("auto" or a format name) and whether to generate the "mips"
+    bool cookFile(const std::string& sourcePath, const nlohmann::json& settings, const std::string& outputPath);
+
+}
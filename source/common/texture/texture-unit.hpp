@@ -20,6 +20,12 @@ namespace our {
         static const int TEXTURE_UNIT_BRDF = 10;
         static const int TEXTURE_UNIT_PREFILTER = 11;
         static const int TEXTURE_UNIT_METALLIC_ROUGHNESS = 12;
+        // Texture buffers of the clustered lights (see ClusteredLighting)
+        static const int TEXTURE_UNIT_CLUSTER_LIGHT_DATA = 13;
+        static const int TEXTURE_UNIT_CLUSTER_GRID = 14;
+        static const int TEXTURE_UNIT_CLUSTER_LIGHT_INDICES = 15;
+        // Texture buffer of the skinning matrices (see SkinningBuffer)
+        static const int TEXTURE_UNIT_SKINNING = 16;
     };
 
 }
\ No newline at end of file
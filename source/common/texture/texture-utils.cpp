@@ -3,7 +3,11 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
+#include "texture-cooker.hpp"
+#include <asset-database.hpp>
+#include <file-system.hpp>
 #include <glm/glm.hpp>
+#include <filesystem>
 #include <iostream>
 
 our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size) {
@@ -16,7 +20,124 @@ our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size) {
     return texture;
 }
 
+std::string our::texture_utils::findCookedTexture(const std::string& filename) {
+    // A cooked texture is its own up to date cooked version
+    if (std::filesystem::path(filename).extension() == texture_cooker::COOKED_TEXTURE_EXTENSION)
+        return filename;
+    return AssetDatabase::getInstance().getCookedPath("texture", filename);
+}
+
+// The size of an uncompressed image and of its mip chain
+static size_t getImageBytes(glm::ivec2 size, size_t bytesPerPixel, bool generate_mipmap) {
+    size_t bytes = 0;
+    for (glm::ivec2 level = size; level.x > 0 && level.y > 0; level = glm::max(level / 2, glm::ivec2(1))) {
+        bytes += size_t(level.x) * size_t(level.y) * bytesPerPixel;
+        if (!generate_mipmap || (level.x == 1 && level.y == 1))
+            break;
+    }
+    return bytes;
+}
+
+void our::texture_utils::uploadImage(Texture2D* texture, const unsigned char* pixels, glm::ivec2 size,
+                                     bool generate_mipmap) {
+    texture->bind();
+    // A texture that held a cooked image before being reloaded may still limit its levels (see uploadCooked)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    if (generate_mipmap) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    texture->setResidentBytes(getImageBytes(size, 4, generate_mipmap));
+}
+
+void our::texture_utils::uploadHDR(Texture2D* texture, const float* pixels, glm::ivec2 size, bool generate_mipmap) {
+    texture->bind();
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, size.x, size.y, 0, GL_RGB, GL_FLOAT, pixels);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (generate_mipmap) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    texture->setResidentBytes(getImageBytes(size, 6, generate_mipmap));
+}
+
+bool our::texture_utils::uploadCooked(Texture2D* texture, const texture_cooker::CookedTexture& cooked,
+                                      const std::string& filename) {
+    if (cooked.levels.empty())
+        return false;
+
+    GLenum internalFormat = GL_RGBA8;
+    bool supported = true;
+    switch (cooked.format) {
+    case texture_cooker::CookedFormat::RGBA8:
+        internalFormat = GL_RGBA8;
+        break;
+    case texture_cooker::CookedFormat::BC1:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        supported = GLAD_GL_EXT_texture_compression_s3tc;
+        break;
+    case texture_cooker::CookedFormat::BC3:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        supported = GLAD_GL_EXT_texture_compression_s3tc;
+        break;
+    case texture_cooker::CookedFormat::BC5:
+        // RGTC is part of the core profile since OpenGL 3.0
+        internalFormat = GL_COMPRESSED_RG_RGTC2;
+        break;
+    case texture_cooker::CookedFormat::BC7:
+        internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+        supported = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_compression_bptc;
+        break;
+    }
+    if (!supported) {
+        std::cerr << "Cooked texture format " << texture_cooker::getFormatName(cooked.format)
+                  << " is not supported by this GPU: " << filename << std::endl;
+        return false;
+    }
+
+    texture->bind();
+    // Only the levels present in the file are complete, so the sampler must not look beyond them
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(cooked.levels.size()) - 1);
+    size_t bytes = 0;
+    for (size_t level = 0; level < cooked.levels.size(); level++) {
+        const texture_cooker::CookedMipLevel& mip = cooked.levels[level];
+        bytes += mip.getSize();
+        if (texture_cooker::isCompressed(cooked.format)) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, GLint(level), internalFormat, mip.width, mip.height, 0,
+                                   GLsizei(mip.getSize()), mip.getData());
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, GLint(level), internalFormat, mip.width, mip.height, 0, GL_RGBA,
+                         GL_UNSIGNED_BYTE, mip.getData());
+        }
+    }
+    texture->setResidentBytes(bytes);
+    return true;
+}
+
+our::Texture2D* our::texture_utils::loadCooked(const std::string& filename) {
+    texture_cooker::CookedTexture cooked;
+    if (!texture_cooker::readCookedTexture(filename, cooked))
+        return nullptr;
+    our::Texture2D* texture = new our::Texture2D();
+    if (!uploadCooked(texture, cooked, filename)) {
+        delete texture;
+        return nullptr;
+    }
+    return texture;
+}
+
 our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool generate_mipmap) {
+    // Prefer the cooked texture since it needs no decoding nor mipmap generation
+    if (std::string cookedPath = findCookedTexture(filename); !cookedPath.empty()) {
+        if (our::Texture2D* texture = loadCooked(cookedPath))
+            return texture;
+    }
+
     glm::ivec2 size;
     int channels;
     // Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
@@ -30,21 +151,18 @@ our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool
     //- 3: RGB
     //- 4: RGB and Alpha (RGBA)
     // Note: channels (the 4th argument) always returns the original number of channels in the file
-    unsigned char* pixels = stbi_load(filename.c_str(), &size.x, &size.y, &channels, 4);
+    // The image is decoded straight from the mapped file
+    our::FileView file = our::FileSystem::getInstance().open(filename);
+    unsigned char* pixels =
+        file ? stbi_load_from_memory(file.asBytes(), int(file.size()), &size.x, &size.y, &channels, 4) : nullptr;
     if (pixels == nullptr) {
         std::cerr << "Failed to load image: " << filename << std::endl;
         return nullptr;
     }
     // Create a texture
     our::Texture2D* texture = new our::Texture2D();
-    // Bind the texture such that we upload the image data to its storage
     // TODO: (Req 5) Finish this function to fill the texture with the data found in "pixels"
-    texture->bind();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-
-    if (generate_mipmap) {
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
+    uploadImage(texture, pixels, size, generate_mipmap);
     stbi_image_free(pixels); // Free image data after uploading to GPU
     return texture;
 }
@@ -55,24 +173,17 @@ our::Texture2D* our::texture_utils::loadHDR(const std::string& filename, bool ge
     // Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
     // We need to till stb to flip images vertically after loading them
     stbi_set_flip_vertically_on_load(true);
-    float* pixels = stbi_loadf(filename.c_str(), &size.x, &size.y, &channels, 0);
+    // The texture is uploaded as RGB so we always ask for 3 channels
+    our::FileView file = our::FileSystem::getInstance().open(filename);
+    float* pixels =
+        file ? stbi_loadf_from_memory(file.asBytes(), int(file.size()), &size.x, &size.y, &channels, 3) : nullptr;
     if (pixels == nullptr) {
         std::cerr << "Failed to load HDR: " << filename << std::endl;
         return nullptr;
     }
     // Create a texture
     our::Texture2D* texture = new our::Texture2D();
-    texture->bind();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, size.x, size.y, 0, GL_RGB, GL_FLOAT, pixels);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    if (generate_mipmap) {
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
+    uploadHDR(texture, pixels, size, generate_mipmap);
 
     stbi_image_free(pixels); // Free image data after uploading to GPU
     return texture;
@@ -100,12 +211,7 @@ our::Texture2D* our::texture_utils::loadFromMemory(const unsigned char* data, in
 
     // Create a texture
     our::Texture2D* texture = new our::Texture2D();
-    texture->bind();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, imageSize.x, imageSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-
-    if (generate_mipmap) {
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
+    uploadImage(texture, pixels, imageSize, generate_mipmap);
 
     stbi_image_free(pixels); // Free image data after uploading to GPU
     return texture;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "texture2d.hpp"
+#include "texture-cooker.hpp"
 #include <string>
 
 #include <glad/gl.h>
@@ -10,9 +11,24 @@ namespace our::texture_utils {
     // This function create an empty texture with a specific format (useful for framebuffers)
     Texture2D* empty(GLenum format, glm::ivec2 size);
     // This function loads an image and sends its data to the given Texture2D 
+    // If a cooked version of the image (".ctex", see texture-cooker.hpp) is up to date, it is used instead
     Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true);
+    // This function loads a cooked texture and uploads its pre-generated (and possibly compressed) mip levels
+    // It returns nullptr if the file is invalid or if its compression format is not supported by the GPU
+    Texture2D* loadCooked(const std::string& filename);
     // This function loads a .hdr files
     Texture2D* loadHDR(const std::string& filename, bool generate_mipmap = true);
 
     our::Texture2D* loadFromMemory(const unsigned char* data, int size, bool generate_mipmap = false);
+
+    // Returns the path of the up to date cooked version of the given image, or an empty string if there is none
+    // (see AssetDatabase::getCookedPath). It does not touch OpenGL so it can be called from any thread
+    std::string findCookedTexture(const std::string& filename);
+
+    // These functions upload already decoded data to the given texture (they must be called on the OpenGL thread)
+    // "pixels" are RGBA8 for images and RGB floats for HDR images
+    void uploadImage(Texture2D* texture, const unsigned char* pixels, glm::ivec2 size, bool generate_mipmap);
+    void uploadHDR(Texture2D* texture, const float* pixels, glm::ivec2 size, bool generate_mipmap);
+    // Returns false if the cooked texture format is not supported by the GPU ("filename" is only used for errors)
+    bool uploadCooked(Texture2D* texture, const texture_cooker::CookedTexture& cooked, const std::string& filename);
 }
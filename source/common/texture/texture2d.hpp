@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/gl.h>
+#include <cstddef>
 
 namespace our
 {
@@ -10,6 +11,8 @@ namespace our
     {
         // The OpenGL object name of this texture
         GLuint name = 0;
+        // The memory used by all the levels of the texture, recorded when they are uploaded
+        size_t residentBytes = 0;
 
     public:
         // This constructor creates an OpenGL texture and saves its object name in the member variable "name"
@@ -32,6 +35,10 @@ namespace our
             return name;
         }
 
+        // The texture_utils upload functions record the size of what they upload (0 for the other textures)
+        size_t getResidentBytes() const { return residentBytes; }
+        void setResidentBytes(size_t bytes) { residentBytes = bytes; }
+
         // This method binds this texture to GL_TEXTURE_2D
         void bind() const
         {
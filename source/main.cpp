@@ -1,8 +1,10 @@
 #include <json/json.hpp>
 #include <application.hpp>
+#include <file-system.hpp>
+#include <hot-reload.hpp>
+#include <level-streamer.hpp>
 #include <filesystem>
 #include <flags/flags.h>
-#include <fstream>
 #include <iostream>
 #include <string>
 #include "states/entity-test-state.hpp"
@@ -79,17 +81,20 @@ void performAssimpSanityCheck() {
 
 namespace fs = std::filesystem;
 
-std::vector<nlohmann::json> parseLevels(int levels_count) {
+std::string getLevelPath(const std::string& levels_directory, int level) {
+    return levels_directory + "/level" + std::to_string(level) + ".jsonc";
+}
+
+std::vector<nlohmann::json> parseLevels(const std::string& levels_directory, int levels_count) {
     std::vector<nlohmann::json> levels;
     for (int i = 0; i < levels_count; i++) {
-        std::string path = "config/levels/level" + std::to_string(i + 1) + ".jsonc";
-        std::ifstream file_in(path);
-        if (!file_in) {
+        std::string path = getLevelPath(levels_directory, i + 1);
+        our::FileView file = our::FileSystem::getInstance().open(path);
+        if (!file) {
             std::cerr << "Couldn't open file: " << path << std::endl;
             return {};
         }
-        nlohmann::json level_config = nlohmann::json::parse(file_in, nullptr, true, true);
-        file_in.close();
+        nlohmann::json level_config = nlohmann::json::parse(file.asChars(), file.asChars() + file.size(), nullptr, true, true);
         levels.push_back(level_config);
     }
     return levels;
@@ -107,30 +112,30 @@ int main(int argc, char** argv) {
     // This is useful for testing multiple configurations in a batch
     // Default: 0 where the application runs indefinitely until manually closed
     int run_for_frames = args.get<int>("f", 0);
+    // pack_path is the path to a pack holding the game files (see FileSystem), it is mounted if it exists
+    // Default: "data.pack"
+    std::string pack_path = args.get<std::string>("p", "data.pack");
+    if (fs::exists(pack_path) && !our::FileSystem::getInstance().mountPack(pack_path))
+        return -1;
 
     // Open the config file and exit if failed
-    std::ifstream file_in(config_path);
+    our::FileView file_in = our::FileSystem::getInstance().open(config_path);
     if (!file_in) {
         std::cerr << "Couldn't open file: " << config_path << std::endl;
         return -1;
     }
-    // Read the file into a json object then close the file
-    nlohmann::json app_config = nlohmann::json::parse(file_in, nullptr, true, true);
-
-    file_in.close();
+    // Parse the file into a json object
+    nlohmann::json app_config = nlohmann::json::parse(file_in.asChars(), file_in.asChars() + file_in.size(), nullptr, true,
+                                                       true);
 
+    // The levels are numbered from 1, they may be in a pack so they are counted through the file system
+    // The "levels" of the config is their directory (a test config can bring its own levels)
+    std::string levels_directory = app_config.value("levels", std::string("config/levels"));
     int levels_count = 0;
-    try {
-        for (const auto& entry : fs::directory_iterator("config/levels")) {
-            if (entry.is_regular_file())
-                levels_count++;
-        }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Error accessing directory: " << e.what() << std::endl;
-        return -1;
-    }
+    while (our::FileSystem::getInstance().exists(getLevelPath(levels_directory, levels_count + 1)))
+        levels_count++;
 
-    std::vector<nlohmann::json> levels_configs = parseLevels(levels_count);
+    std::vector<nlohmann::json> levels_configs = parseLevels(levels_directory, levels_count);
 
     // Create the application
     our::Application app(app_config, levels_configs);
@@ -152,6 +157,18 @@ int main(int argc, char** argv) {
     // app.registerState<LightTestState>("light-test");
     app.registerState<PhysicsTestState>("physics-test");
 
+    // Watch the configs for hot reload (only active if it is enabled in the "hot-reload" section of the config)
+    our::HotReload& hotReload = our::HotReload::getInstance();
+    hotReload.watchConfig(config_path, "/scene/assets");
+    for (int i = 0; i < levels_count; i++) {
+        hotReload.watchConfig(getLevelPath(levels_directory, i + 1), "/assets", [&app, i](const nlohmann::json& config) {
+            // The streamer loads the assets the level now lists (the changed ones were already reloaded)
+            our::LevelStreamer::getInstance().reloadLevelAssets(
+                i + 1, config.contains("assets") ? config["assets"] : nlohmann::json::object());
+            app.reloadLevelConfig(i + 1, config);
+        });
+    }
+
     // Then choose the state to run based on the option "start-scene" in the config
     if (app_config.contains(std::string{"start-scene"})) {
         app.changeState(app_config["start-scene"].get<std::string>());
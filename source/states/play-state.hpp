@@ -2,9 +2,14 @@
 
 #include <asset-loader.hpp>
 #include <components/crosshair.hpp>
+#include <components/enemy-controller.hpp>
 #include <core/time-scale.hpp>
 #include <ecs/world.hpp>
+#include <hot-reload.hpp>
+#include <level-streamer.hpp>
 #include <settings.hpp>
+#include <shader/shader-cache.hpp>
+#include <shader/shader-permutations.hpp>
 #include <systems/animation-system.hpp>
 #include <systems/audio-system.hpp>
 #include <systems/collision-system.hpp>
@@ -14,6 +19,7 @@
 #include <systems/movement.hpp>
 #include <systems/text-renderer.hpp>
 #include <systems/trail-system.hpp>
+#include <texture/texture-cache.hpp>
 #include "imgui.h"
 
 class Playstate : public our::State {
@@ -32,6 +38,11 @@ class Playstate : public our::State {
     our::TrailSystem& trailSystem = our::TrailSystem::getInstance();
     bool gameEnded = false;
     our::AnimationSystem animationSystem;
+    our::LevelStreamer& levelStreamer = our::LevelStreamer::getInstance();
+    // The time each frame can spend uploading the assets of the next level
+    static constexpr double streamingBudgetMilliseconds = 2.0;
+    // The entities created from each entry of the level's "world" array (used to rebuild them on hot reload)
+    std::vector<our::Entity*> levelRoots;
 
     void initializeGame() {
         // Only initialize the game one time
@@ -43,10 +54,9 @@ class Playstate : public our::State {
         // Retrieve scene configuration from the app config
         auto& config = getApp()->getConfig()["scene"];
 
-        // Deserialize all assets from the configuration if present
-        if (config.contains("assets")) {
-            our::deserializeAllAssets(config["assets"]);
-        }
+        // Load the assets shared by all the levels, the ones of each level are streamed (see "onInitialize")
+        levelStreamer.initialize(config.contains("assets") ? config["assets"] : nlohmann::json::object(),
+                                 getApp()->getLevelsConfigs());
 
         // Initialize the renderer with the appropriate configuration
         auto size = getApp()->getFrameBufferSize();
@@ -74,10 +84,16 @@ class Playstate : public our::State {
     void onInitialize() override {
         initializeGame();
 
+        // The assets of this level were prefetched while the previous one was played
+        // and the assets of the next one load in the background while this one is played
+        int levelIndex = getApp()->getLevelIndex();
+        levelStreamer.activate(levelIndex, levelIndex + 1);
+
         auto& levelConfig = getApp()->getLevelConfig();
 
+        levelRoots.clear();
         if (levelConfig.contains("world")) {
-            world.deserialize(levelConfig["world"]);
+            levelRoots = world.deserialize(levelConfig["world"]);
         }
 
         textRenderer.showCenteredText("SUPER", "game");
@@ -90,6 +106,67 @@ class Playstate : public our::State {
         gameEnded = false;
     }
 
+    // Collects the entity and all its descendants (children only know their parent so the whole world is scanned)
+    std::vector<our::Entity*> getSubtree(our::Entity* root) {
+        std::vector<our::Entity*> subtree = {root};
+        for (size_t i = 0; i < subtree.size(); i++)
+            for (our::Entity* entity : world.getEntities())
+                if (entity->parent == subtree[i])
+                    subtree.push_back(entity);
+        return subtree;
+    }
+
+    // The systems keep pointers to the player, the weapons and the enemies, so these entities can't be rebuilt while
+    // the level runs
+    bool isOwnedByGameplay(const std::vector<our::Entity*>& subtree) {
+        for (our::Entity* entity : subtree)
+            if (entity->getComponent<our::CameraComponent>() || entity->getComponent<our::FPSControllerComponent>() ||
+                entity->getComponent<our::WeaponComponent>() || entity->getComponent<our::EnemyControllerComponent>())
+                return true;
+        return false;
+    }
+
+    // Rebuilds the entities whose entry in the "world" array changed, the entries are matched by their index
+    void onLevelConfigReload(const nlohmann::json& oldConfig, const nlohmann::json& newConfig) override {
+        static const nlohmann::json empty = nlohmann::json::array();
+        const nlohmann::json& oldWorld = oldConfig.contains("world") ? oldConfig["world"] : empty;
+        const nlohmann::json& newWorld = newConfig.contains("world") ? newConfig["world"] : empty;
+
+        size_t rebuilt = 0, skipped = 0;
+        std::vector<our::Entity*> roots;
+        for (size_t index = 0; index < std::max(oldWorld.size(), newWorld.size()); index++) {
+            our::Entity* root = index < levelRoots.size() ? levelRoots[index] : nullptr;
+            bool inOld = index < oldWorld.size(), inNew = index < newWorld.size();
+            if (inOld && inNew && oldWorld[index] == newWorld[index]) {
+                roots.push_back(root);
+                continue;
+            }
+            if (root) {
+                std::vector<our::Entity*> subtree = getSubtree(root);
+                if (isOwnedByGameplay(subtree)) {
+                    // The entry keeps its old entities, the indices after it still match
+                    if (inNew) roots.push_back(root);
+                    skipped++;
+                    continue;
+                }
+                for (our::Entity* entity : subtree)
+                    world.markForRemoval(entity);
+                world.deleteMarkedEntities();
+            }
+            if (inNew) {
+                std::vector<our::Entity*> created = world.deserialize(nlohmann::json::array({newWorld[index]}));
+                roots.push_back(created.empty() ? nullptr : created.front());
+            }
+            rebuilt++;
+        }
+        levelRoots = std::move(roots);
+
+        std::cout << "[HotReload] Rebuilt " << rebuilt << " level entities" << std::endl;
+        if (skipped > 0)
+            std::cerr << "[HotReload] WARNING: " << skipped << " changed entities hold the player, a weapon or an enemy, "
+                      << "restart the level to apply them" << std::endl;
+    }
+
     void onImmediateGui() {
         // Shader Debugger
         Settings& settings = Settings::getInstance();
@@ -110,7 +187,9 @@ class Playstate : public our::State {
                                          "ambient",
                                          "metailic_roughness",
                                          "wireframe",
-                                         "texture_coordinates"};
+                                         "texture_coordinates",
+                                         "overdraw",
+                                         "light_clusters"};
 
             if (ImGui::BeginCombo("Debug View Mode", settings.shaderDebugMode.c_str())) {
                 for (const auto& mode : shaderModes) {
@@ -125,6 +204,57 @@ class Playstate : public our::State {
                 ImGui::EndCombo();
             }
 
+            ImGui::Checkbox("Depth Pre-Pass", &settings.depthPrePass);
+
+            ImGui::SliderInt("Forced LOD (-1 = auto)", &settings.forcedLod, -1,
+                             (int)our::mesh_simplifier::MAX_LOD_COUNT - 1);
+            ImGui::SliderFloat("LOD Pixel Error", &settings.lodPixelError, 0.25f, 8.0f);
+            const our::ForwardRenderer::Statistics& renderStats = renderer.getStatistics();
+            ImGui::Text("Triangles: %zu drawn, %zu at full detail (draws per LOD: %zu / %zu / %zu / %zu)",
+                        renderStats.drawnTriangles, renderStats.fullDetailTriangles, renderStats.lodDraws[0],
+                        renderStats.lodDraws[1], renderStats.lodDraws[2], renderStats.lodDraws[3]);
+
+            our::ClusteredLighting& clusteredLighting = our::ClusteredLighting::getInstance();
+            ImGui::Text("Lights: %d directional, %d local, %zu cluster references",
+                        clusteredLighting.getDirectionalLightCount(), clusteredLighting.getLocalLightCount(), clusteredLighting.getLightIndexCount());
+
+            our::LevelStreamer::Statistics streamingStats = levelStreamer.getStatistics();
+            ImGui::Text("Streaming: level %d active, level %d loading (%zu jobs left), %zu assets resident (%zu shared)",
+                        streamingStats.activeLevel, streamingStats.loadingLevel, streamingStats.remainingJobs,
+                        streamingStats.residentAssets, streamingStats.sharedAssets);
+
+            our::TextureCache::Statistics textureStats = our::TextureCache::getInstance().getStatistics();
+            ImGui::Text("Textures: %zu unique, %zu requests, %.1f MB resident, %.1f MB saved",
+                        textureStats.uniqueTextures, textureStats.requests, textureStats.residentBytes / 1048576.0,
+                        textureStats.savedBytes / 1048576.0);
+
+            our::ShaderCache::Statistics shaderStats = our::ShaderCache::getInstance().getStatistics();
+            ImGui::Text("Shader Cache: %zu hits, %zu misses (%zu rejected), %zu stored", shaderStats.hits,
+                        shaderStats.misses, shaderStats.rejected, shaderStats.stores);
+            our::ShaderPermutations::Statistics permutationStats = our::ShaderPermutations::getInstance().getStatistics();
+            ImGui::Text("Shader Permutations: %zu variants of %zu shaders, %zu requests (%zu shared)",
+                        permutationStats.variants, permutationStats.families, permutationStats.requests,
+                        permutationStats.shared);
+
+            const our::AnimationSystem::Statistics& animationStats = animationSystem.getStatistics();
+            ImGui::Text("Animation: %zu instances, %zu clips, %zu bones in %.1f us (%.1f bones/us)",
+                        animationStats.instances, animationStats.clips, animationStats.bones,
+                        animationStats.poseMicroseconds,
+                        animationStats.poseMicroseconds > 0.0 ? animationStats.bones / animationStats.poseMicroseconds
+                                                              : 0.0);
+            ImGui::Text("Animation LOD: %zu evaluated, %zu throttled, %zu skipped", animationStats.evaluated,
+                        animationStats.throttled, animationStats.skipped);
+            const our::SkinningBuffer::Statistics& skinningStats = our::SkinningBuffer::getInstance().getStatistics();
+            ImGui::Text("Skinning: %zu poses, %zu matrices, %.1f KB uploaded, %.1f us on the CPU",
+                        skinningStats.poses, skinningStats.matrices, skinningStats.bytes / 1024.0,
+                        animationStats.skinningMicroseconds);
+            ImGui::Checkbox("CPU Skinning", &settings.cpuSkinning);
+
+            our::HotReload& hotReload = our::HotReload::getInstance();
+            if (hotReload.isEnabled())
+                ImGui::Text("Hot Reload: %zu reloads, %zu failures", hotReload.getReloadCount(),
+                            hotReload.getFailureCount());
+
             ImGui::Text("Press F9 to close this window");
 
             ImGui::End();
@@ -164,6 +294,8 @@ class Playstate : public our::State {
     }
 
     void onDraw(double deltaTime) override {
+        levelStreamer.update(streamingBudgetMilliseconds);
+
         std::string backgroundTrack = "level_" + std::to_string(getApp()->getLevelIndex() % 3 + 1);
         audioSystem.playBackgroundMusic(backgroundTrack, 0.2f, "music");
 
@@ -187,7 +319,7 @@ class Playstate : public our::State {
 
         // Update the collision system
         collisionSystem.update(&world, scaledDeltaTime);
-        animationSystem.update(&world, scaledDeltaTime);
+        animationSystem.update(&world, scaledDeltaTime, getApp()->getFrameBufferSize());
 
         float playerDeltaTime = deltaTime;
 
@@ -0,0 +1,140 @@
+// Animation benchmark
+// Times the evaluation of skeleton poses (see Skeleton::evaluateLocalPose) on a synthetic skeleton, so a change to
+// the evaluation can be measured on any machine without loading a model or opening a window.
+//
+// Usage: supercold-bench [--bones=64] [--instances=1000] [--iterations=100] [--seed=1]
+//   --bones:      the bones of the skeleton, each one is attached to a random earlier bone.
+//   --instances:  the animated instances, each one has its own random local pose.
+//   --iterations: how many times every instance is evaluated, the average and the best iteration are printed.
+//   --seed:       the seed of the skeleton and the poses, the same arguments always give the same work.
+// The recursive evaluation of the bone tree (how the poses were evaluated before the skeletons were flattened) is
+// timed too as a reference, and its result is checked against the flat one.
+
+#include <animation/skeleton.hpp>
+#include <flags/flags.h>
+
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// The reference: walks the bone tree from the roots
+static void evaluateRecursive(const our::Skeleton& skeleton, our::AnimationPose& pose, int bone,
+                              const glm::mat4& parentTransform) {
+    const Bone* data = skeleton.getBone(bone);
+    pose.boneTransforms[bone] = parentTransform * pose.localTransforms[bone];
+    pose.finalTransforms[bone] = pose.boneTransforms[bone] * data->offsetMatrix;
+    for (int child : data->children)
+        evaluateRecursive(skeleton, pose, child, pose.boneTransforms[bone]);
+}
+
+struct Timing {
+    double total = 0.0, best = 1e30;
+    void add(double milliseconds) {
+        total += milliseconds;
+        best = std::min(best, milliseconds);
+    }
+};
+
+// Times one pass over all the instances
+template <typename Function>
+static void time(Timing& timing, std::vector<our::AnimationPose>& poses, Function function) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (our::AnimationPose& pose : poses)
+        function(pose);
+    timing.add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+}
+
+int main(int argc, char** argv) {
+    flags::args args(argc, argv);
+    int boneCount = args.get<int>("bones", 64);
+    int instanceCount = args.get<int>("instances", 1000);
+    int iterations = args.get<int>("iterations", 100);
+    unsigned seed = args.get<unsigned>("seed", 1);
+    if (boneCount < 1 || instanceCount < 1 || iterations < 1) {
+        std::cerr << "Usage: supercold-bench [--bones=64] [--instances=1000] [--iterations=100] [--seed=1]"
+                  << std::endl;
+        return -1;
+    }
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    auto randomRotation = [&]() {
+        return glm::normalize(glm::quat(1.0f + unit(random), unit(random), unit(random), unit(random)));
+    };
+    auto randomTransform = [&](our::BoneTransform& transform) {
+        transform.rotation = randomRotation();
+        transform.position = glm::vec3(unit(random), unit(random), unit(random));
+        transform.scale = glm::vec3(1.0f + 0.1f * unit(random));
+    };
+
+    // Every bone hangs from a random earlier bone, so the skeleton is in topological order like a loaded one
+    our::Skeleton skeleton;
+    std::vector<glm::mat4> bindModel(static_cast<size_t>(boneCount));
+    for (int index = 0; index < boneCount; index++) {
+        our::BoneTransform bind;
+        randomTransform(bind);
+        Bone bone;
+        bone.name = "bone" + std::to_string(index);
+        bone.parentIndex = index == 0 ? -1 : int(random() % unsigned(index));
+        bone.localBindTransform = glm::translate(glm::mat4(1.0f), bind.position) * glm::mat4_cast(bind.rotation) *
+                                  glm::scale(glm::mat4(1.0f), bind.scale);
+        bindModel[index] =
+            (bone.parentIndex < 0 ? glm::mat4(1.0f) : bindModel[bone.parentIndex]) * bone.localBindTransform;
+        bone.offsetMatrix = glm::inverse(bindModel[index]);
+        if (skeleton.addBone(bone) < 0)
+            return -1;
+    }
+
+    std::vector<our::AnimationPose> poses(static_cast<size_t>(instanceCount));
+    for (our::AnimationPose& pose : poses) {
+        pose.resize(size_t(boneCount));
+        for (our::BoneTransform& transform : pose.localPose)
+            randomTransform(transform);
+    }
+    const glm::mat4 root(1.0f);
+
+    Timing localPose, flat, recursive;
+    std::vector<glm::mat4> flatResults(poses.size());
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        // Local pose to matrices then the hierarchy, what the AnimationSystem runs for each instance
+        time(localPose, poses, [&](our::AnimationPose& pose) { skeleton.evaluateLocalPose(pose, root); });
+        // The hierarchy alone, from the same local matrices
+        time(flat, poses, [&](our::AnimationPose& pose) { skeleton.evaluatePose(pose, root); });
+        for (size_t index = 0; index < poses.size(); index++)
+            flatResults[index] = poses[index].finalTransforms.back();
+        time(recursive, poses, [&](our::AnimationPose& pose) {
+            for (int bone : skeleton.getRootBones())
+                evaluateRecursive(skeleton, pose, bone, root);
+        });
+    }
+
+    // Both evaluations must give the same skinning matrices
+    float maximumError = 0.0f;
+    for (size_t index = 0; index < poses.size(); index++)
+        for (int column = 0; column < 4; column++)
+            for (int row = 0; row < 4; row++)
+                maximumError = std::max(maximumError, std::abs(flatResults[index][column][row] -
+                                                               poses[index].finalTransforms.back()[column][row]));
+
+    double bones = double(boneCount) * double(instanceCount);
+    std::cout << boneCount << " bones, " << instanceCount << " instances, " << iterations << " iterations (seed "
+              << seed << ")" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    auto print = [&](const char* name, const Timing& timing) {
+        double average = timing.total / iterations;
+        std::cout << "  " << std::left << std::setw(24) << name << std::right << " average " << std::setw(9)
+                  << average << " ms, best " << std::setw(9) << timing.best << " ms, "
+                  << std::setw(9) << bones / (timing.best * 1000.0) << " bones/us" << std::endl;
+    };
+    print("local pose + hierarchy", localPose);
+    print("hierarchy (flat)", flat);
+    print("hierarchy (recursive)", recursive);
+    std::cout << "  flat/recursive max difference: " << std::scientific << maximumError << std::endl;
+    return maximumError <= 1e-3f ? 0 : -1;
+}
@@ -0,0 +1,112 @@
+// Offline asset cooker
+// Cooks models and textures into the asset database cache (see asset-database.hpp), only the sources that changed
+// since they were last cooked (or whose settings or cooker changed) are cooked again. The game picks the cooked
+// files up automatically.
+//
+// Usage: supercold-cook [--cache=cache] [--force] [--type=model|texture] [--format=auto|rgba8|bc1|bc3|bc5|bc7]
+//                       [--mips=true|false] <file or directory>...
+//   --cache:  the cache directory of the asset database (default: "cache", like the game).
+//   --force:  cooks everything again even if it is up to date.
+//   --type:   the type of the given files, by default it is deduced from their extension. Directories are searched
+//             recursively for models (gltf, glb, fbx, dae) and images (png, jpg, jpeg, tga, bmp).
+//   --format: for textures, "auto" picks BC3 for images with transparency and BC1 otherwise.
+//             Use "bc5" for normal maps and "bc7" for high quality color/alpha textures.
+//   --mips:   for textures, whether to generate the mip chain.
+// The texture settings are remembered, so they only need to be given when they change.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include <asset-database.hpp>
+#include <flags/flags.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static std::string getTypeFromExtension(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return char(std::tolower(c)); });
+    if (extension == ".gltf" || extension == ".glb" || extension == ".fbx" || extension == ".dae")
+        return "model";
+    if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" ||
+        extension == ".bmp")
+        return "texture";
+    return "";
+}
+
+int main(int argc, char** argv) {
+    flags::args args(argc, argv);
+    std::string cacheDirectory = args.get<std::string>("cache", "cache");
+    bool force = args.get<bool>("force", false);
+    std::string forcedType = args.get<std::string>("type", "");
+
+    if (args.positional().empty()) {
+        std::cerr << "Usage: supercold-cook [--cache=cache] [--force] [--type=model|texture] "
+                     "[--format=auto|rgba8|bc1|bc3|bc5|bc7] [--mips=true|false] <file or directory>..."
+                  << std::endl;
+        return -1;
+    }
+
+    our::AssetDatabase& database = our::AssetDatabase::getInstance();
+    database.setCacheDirectory(cacheDirectory);
+    if (!forcedType.empty() && !database.hasCooker(forcedType)) {
+        std::cerr << "Unknown asset type: " << forcedType << std::endl;
+        return -1;
+    }
+
+    // Only the settings given on the command line override the ones the textures were last cooked with
+    nlohmann::json textureSettings = nlohmann::json::object();
+    if (auto format = args.get<std::string>("format"))
+        textureSettings["format"] = *format;
+    if (auto mips = args.get<bool>("mips"))
+        textureSettings["mips"] = *mips;
+
+    // Collect the sources (the directories only contribute the files with a known extension)
+    std::vector<std::pair<std::string, std::string>> sources;
+    int failures = 0;
+    for (const auto& argument : args.positional()) {
+        std::filesystem::path path(argument);
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& file : std::filesystem::recursive_directory_iterator(path, error)) {
+                std::string type = forcedType.empty() ? getTypeFromExtension(file.path()) : forcedType;
+                if (file.is_regular_file() && !type.empty())
+                    sources.emplace_back(type, file.path().generic_string());
+            }
+        } else {
+            std::string type = forcedType.empty() ? getTypeFromExtension(path) : forcedType;
+            if (type.empty()) {
+                std::cerr << "Unknown asset type (use --type): " << argument << std::endl;
+                failures++;
+                continue;
+            }
+            sources.emplace_back(type, path.generic_string());
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t cooked = 0, upToDate = 0;
+    for (const auto& [type, source] : sources) {
+        const nlohmann::json& settings = type == "texture" ? textureSettings : nlohmann::json::object();
+        our::AssetDatabase::CookResult result = database.cook(type, source, settings, force);
+        switch (result.status) {
+        case our::AssetDatabase::CookStatus::UP_TO_DATE: upToDate++; break;
+        case our::AssetDatabase::CookStatus::COOKED: cooked++; break;
+        case our::AssetDatabase::CookStatus::FAILED: failures++; break;
+        }
+    }
+    database.saveManifest();
+
+    auto milliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    our::AssetDatabase::Statistics statistics = database.getStatistics();
+    std::cout << sources.size() << " assets: " << cooked << " cooked, " << upToDate << " up to date ("
+              << statistics.hashed << " hashed), " << failures << " failed in " << milliseconds << " ms" << std::endl;
+    return failures == 0 ? 0 : -1;
+}
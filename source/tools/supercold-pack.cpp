@@ -0,0 +1,67 @@
+// Pack builder
+// Stores files in a single pack that the game mounts at startup (see file-system.hpp), so the shipped game opens one
+// file instead of thousands. The files are stored under their path relative to the working directory, so run it
+// from the directory the game runs from.
+//
+// Usage: supercold-pack [--output=data.pack] <file or directory>...
+//   --output: the pack to write (default: "data.pack", which the game mounts if it exists).
+// Directories are added recursively. For example, to ship the game with its cooked assets:
+//   supercold-cook assets && supercold-pack assets config cache/model cache/texture
+// The rest of "cache" (the asset manifest and the shader binaries) is written by the game and always read from the
+// disk, so it is not packed.
+
+#include <file-system.hpp>
+#include <flags/flags.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    flags::args args(argc, argv);
+    std::string output = args.get<std::string>("output", "data.pack");
+
+    if (args.positional().empty()) {
+        std::cerr << "Usage: supercold-pack [--output=data.pack] <file or directory>..." << std::endl;
+        return -1;
+    }
+
+    // Collect the files, each one once, sorted so the same inputs always give the same pack
+    std::set<std::string> keys;
+    std::vector<std::pair<std::string, std::string>> files;
+    std::string outputKey = our::FileSystem::getPackKey(output);
+    auto add = [&](const std::filesystem::path& path) {
+        std::string key = our::FileSystem::getPackKey(path.generic_string());
+        // Never pack the pack itself (or a previous one being replaced, see FileSystem::getTemporaryPath)
+        bool isTemporary = key.size() > 4 && key.compare(0, outputKey.size() + 1, outputKey + ".") == 0 &&
+                           key.compare(key.size() - 4, 4, ".tmp") == 0;
+        if (key == outputKey || isTemporary || !keys.insert(key).second)
+            return;
+        files.emplace_back(key, path.generic_string());
+    };
+    for (const auto& argument : args.positional()) {
+        std::filesystem::path path(argument);
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& file : std::filesystem::recursive_directory_iterator(path, error))
+                if (file.is_regular_file())
+                    add(file.path());
+        } else if (std::filesystem::is_regular_file(path, error)) {
+            add(path);
+        } else {
+            std::cerr << "File not found: " << argument << std::endl;
+            return -1;
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    if (!our::FileSystem::writePack(output, files))
+        return -1;
+    std::error_code error;
+    std::cout << "Packed " << files.size() << " files into " << output << " ("
+              << std::filesystem::file_size(output, error) / 1048576.0 << " MB)" << std::endl;
+    return 0;
+}
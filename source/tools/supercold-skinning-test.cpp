@@ -0,0 +1,191 @@
+// Headless skinning test
+// Poses a small skeleton described in a test config, skins its vertices on the CPU (see cpu-skinning.hpp) and
+// compares them with the positions and normals the config expects, so the pose evaluation and the skinning can be
+// checked without a window or a GPU.
+//
+// Usage: supercold-skinning-test <config file or directory>...
+// Directories are searched for ".jsonc" files (e.g. "config/skinning-test"). It returns 0 if every vertex of every
+// config is within the tolerance of its expected values.
+//
+// A test config holds:
+//   "tolerance": the largest difference allowed on each coordinate (default: 1e-4).
+//   "root":      the root transform of the pose (optional).
+//   "bones":     the bones in topological order, each one has a "name", a "parent" index (-1 for a root), a "bind"
+//                transform and the "pose" transform to check (local to its parent).
+//   "vertices":  each one has a "position", a "normal", up to 4 "bones" with their "weights" and the "expected"
+//                skinned "position" and "normal".
+// A transform has a "position", a "rotation" (euler angles in degrees) and a "scale" (a number or a vec3), they
+// default to the identity.
+
+#include <animation/cpu-skinning.hpp>
+#include <animation/skeleton.hpp>
+#include <flags/flags.h>
+#include <json/json.hpp>
+
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static glm::vec3 readVec3(const nlohmann::json& data, const char* key, glm::vec3 fallback) {
+    if (!data.contains(key))
+        return fallback;
+    const nlohmann::json& value = data[key];
+    if (value.is_number())
+        return glm::vec3(value.get<float>());
+    return glm::vec3(value[0].get<float>(), value[1].get<float>(), value[2].get<float>());
+}
+
+static our::BoneTransform readTransform(const nlohmann::json& data) {
+    our::BoneTransform transform;
+    if (!data.is_object())
+        return transform;
+    transform.position = readVec3(data, "position", glm::vec3(0.0f));
+    transform.rotation = glm::quat(glm::radians(readVec3(data, "rotation", glm::vec3(0.0f))));
+    transform.scale = readVec3(data, "scale", glm::vec3(1.0f));
+    return transform;
+}
+
+static glm::mat4 toMatrix(const our::BoneTransform& transform) {
+    return glm::translate(glm::mat4(1.0f), transform.position) * glm::mat4_cast(transform.rotation) *
+           glm::scale(glm::mat4(1.0f), transform.scale);
+}
+
+static std::ostream& operator<<(std::ostream& stream, const glm::vec3& vector) {
+    return stream << "(" << vector.x << ", " << vector.y << ", " << vector.z << ")";
+}
+
+static float getError(const glm::vec3& value, const glm::vec3& expected) {
+    glm::vec3 difference = glm::abs(value - expected);
+    return std::max(difference.x, std::max(difference.y, difference.z));
+}
+
+// Returns the number of vertices that don't match (-1 if the config is invalid)
+static int runTest(const std::string& path) {
+    std::ifstream file(path);
+    nlohmann::json config =
+        nlohmann::json::parse(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), nullptr, false,
+                              true);
+    if (!file || !config.is_object() || !config["bones"].is_array() || !config["vertices"].is_array()) {
+        std::cerr << path << ": invalid test config" << std::endl;
+        return -1;
+    }
+    float tolerance = config.value("tolerance", 1e-4f);
+
+    // The bind pose gives the offset matrices (like a loaded model), the pose to check is set as the local pose
+    our::Skeleton skeleton;
+    our::AnimationPose pose;
+    std::vector<glm::mat4> bindModel;
+    std::vector<our::BoneTransform> localPose;
+    for (const nlohmann::json& data : config["bones"]) {
+        Bone bone;
+        bone.name = data.value("name", "");
+        bone.parentIndex = data.value("parent", -1);
+        bone.localBindTransform = toMatrix(readTransform(data.value("bind", nlohmann::json::object())));
+        glm::mat4 parentTransform = bone.parentIndex < 0 ? glm::mat4(1.0f) : bindModel[bone.parentIndex];
+        bindModel.push_back(parentTransform * bone.localBindTransform);
+        bone.offsetMatrix = glm::inverse(bindModel.back());
+        if (skeleton.addBone(bone) < 0) {
+            std::cerr << path << ": invalid bone '" << bone.name << "'" << std::endl;
+            return -1;
+        }
+        localPose.push_back(readTransform(data.value("pose", nlohmann::json::object())));
+    }
+    pose.resize(skeleton.getBoneCount());
+    pose.localPose = localPose;
+    skeleton.evaluateLocalPose(pose, toMatrix(readTransform(config.value("root", nlohmann::json::object()))));
+
+    std::vector<our::Vertex> vertices;
+    std::vector<glm::vec3> expectedPositions, expectedNormals;
+    for (const nlohmann::json& data : config["vertices"]) {
+        our::Vertex vertex;
+        vertex.position = readVec3(data, "position", glm::vec3(0.0f));
+        vertex.normal = readVec3(data, "normal", glm::vec3(0.0f));
+        std::vector<int> bones = data.value("bones", std::vector<int>());
+        std::vector<float> weights = data.value("weights", std::vector<float>());
+        for (size_t slot = 0; slot < std::min<size_t>(bones.size(), MAX_BONE_INFLUENCE); slot++) {
+            vertex.bone_ids[slot] = bones[slot];
+            vertex.weights[slot] = slot < weights.size() ? weights[slot] : 0.0f;
+        }
+        vertices.push_back(vertex);
+        const nlohmann::json& expected = data.value("expected", nlohmann::json::object());
+        expectedPositions.push_back(readVec3(expected, "position", vertex.position));
+        expectedNormals.push_back(readVec3(expected, "normal", vertex.normal));
+    }
+
+    const std::vector<glm::mat4>& matrices = pose.finalTransforms;
+    std::vector<our::Vertex> skinned(vertices.size());
+    our::cpu_skinning::skin(vertices.data(), vertices.size(), matrices.data(), matrices.size(), skinned.data());
+    std::vector<glm::vec3> positions(vertices.size());
+    our::cpu_skinning::skinPositions(vertices.data(), vertices.size(), matrices.data(), matrices.size(),
+                                     positions.data());
+
+    int failures = 0;
+    for (size_t index = 0; index < vertices.size(); index++) {
+        float error = std::max({getError(skinned[index].position, expectedPositions[index]),
+                                getError(skinned[index].normal, expectedNormals[index]),
+                                getError(positions[index], expectedPositions[index])});
+        if (error <= tolerance)
+            continue;
+        failures++;
+        std::cerr << path << ": vertex " << index << " is at " << skinned[index].position << " (positions only "
+                  << positions[index] << ") with the normal " << skinned[index].normal << ", expected "
+                  << expectedPositions[index] << " with the normal " << expectedNormals[index] << std::endl;
+    }
+
+    // The bounds are the box of the expected positions
+    glm::vec3 minimum, maximum;
+    if (!vertices.empty() &&
+        our::cpu_skinning::computeBounds(vertices.data(), vertices.size(), matrices.data(), matrices.size(), minimum,
+                                         maximum)) {
+        glm::vec3 expectedMinimum = expectedPositions[0], expectedMaximum = expectedPositions[0];
+        for (const glm::vec3& position : expectedPositions) {
+            expectedMinimum = glm::min(expectedMinimum, position);
+            expectedMaximum = glm::max(expectedMaximum, position);
+        }
+        if (std::max(getError(minimum, expectedMinimum), getError(maximum, expectedMaximum)) > tolerance) {
+            failures++;
+            std::cerr << path << ": the bounds are " << minimum << " - " << maximum << ", expected "
+                      << expectedMinimum << " - " << expectedMaximum << std::endl;
+        }
+    }
+
+    std::cout << path << ": " << (failures == 0 ? "passed" : "FAILED") << " (" << skeleton.getBoneCount()
+              << " bones, " << vertices.size() << " vertices)" << std::endl;
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    flags::args args(argc, argv);
+    if (args.positional().empty()) {
+        std::cerr << "Usage: supercold-skinning-test <config file or directory>..." << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> configs;
+    for (const auto& argument : args.positional()) {
+        std::filesystem::path path(argument);
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& file : std::filesystem::directory_iterator(path, error))
+                if (file.is_regular_file() && file.path().extension() == ".jsonc")
+                    configs.push_back(file.path().generic_string());
+        } else {
+            configs.push_back(path.generic_string());
+        }
+    }
+    // The same order on every platform
+    std::sort(configs.begin(), configs.end());
+
+    int failedConfigs = 0;
+    for (const std::string& config : configs)
+        if (runTest(config) != 0)
+            failedConfigs++;
+    std::cout << configs.size() - failedConfigs << "/" << configs.size() << " skinning tests passed" << std::endl;
+    return failedConfigs == 0 ? 0 : -1;
+}